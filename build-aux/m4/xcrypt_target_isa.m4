@@ -0,0 +1,72 @@
+dnl To the extent possible under law, the author(s) have waived all
+dnl copyright and related or neighboring rights to this work.
+dnl
+dnl See https://creativecommons.org/publicdomain/zero/1.0/ for further
+dnl details.
+dnl
+dnl xcrypt_CHECK_TARGET_ISA(NAME, TARGET, PROLOGUE, BODY)
+dnl Find out whether the compiler can build a single function for an
+dnl instruction set extension that is not enabled by the command-line
+dnl flags, using __attribute__((target(TARGET))).  PROLOGUE should
+dnl include the headers declaring the intrinsics used by BODY; BODY
+dnl must return an int.  If the check succeeds, HAVE_TARGET_NAME is
+dnl defined (NAME is upcased).  Code compiled this way must only be
+dnl called after get_cpu_features() has confirmed that the CPU
+dnl supports the extension.
+AC_DEFUN([xcrypt_CHECK_TARGET_ISA],
+  [AC_REQUIRE([AC_PROG_CC])
+   AS_VAR_PUSHDEF([cache_var], [xcrypt_cv_target_isa_$1])
+   AC_CACHE_CHECK([whether functions can be compiled for $1],
+     [cache_var],
+     [AC_COMPILE_IFELSE([AC_LANG_SOURCE([[
+$3
+extern int xcrypt_isa_test (void);
+__attribute__ ((target ("$2"))) int
+xcrypt_isa_test (void)
+{
+$4
+}
+]])],
+       [AS_VAR_SET([cache_var], [yes])],
+       [AS_VAR_SET([cache_var], [no])])])
+   AS_VAR_IF([cache_var], [yes],
+     [AC_DEFINE([HAVE_TARGET_]m4_toupper([$1]), 1,
+        [Define to 1 if functions using $1 instructions can be compiled
+         with __attribute__((target("$2"))).])])
+   AS_VAR_POPDEF([cache_var])])
+
+dnl xcrypt_CHECK_TARGET_PRAGMA(NAME, TARGET, MACRO, PROLOGUE, BODY)
+dnl Find out whether the compiler can build the rest of a source file
+dnl for an instruction set extension that is not enabled by the
+dnl command-line flags, using #pragma GCC target(TARGET), and whether
+dnl that pragma also defines MACRO, the compiler's predefined macro for
+dnl the extension, as the equivalent -m option would.  Code that picks
+dnl its instructions with #ifdef needs this.  PROLOGUE and BODY are as
+dnl for xcrypt_CHECK_TARGET_ISA, except that PROLOGUE is placed after
+dnl the pragma.  If the check succeeds, HAVE_PRAGMA_TARGET_NAME is
+dnl defined (NAME is upcased).
+AC_DEFUN([xcrypt_CHECK_TARGET_PRAGMA],
+  [AC_REQUIRE([AC_PROG_CC])
+   AS_VAR_PUSHDEF([cache_var], [xcrypt_cv_target_pragma_$1])
+   AC_CACHE_CHECK([whether source files can be compiled for $1],
+     [cache_var],
+     [AC_COMPILE_IFELSE([AC_LANG_SOURCE([[
+#pragma GCC target ("$2")
+#ifndef $3
+#error "$3 not defined"
+#endif
+$4
+extern int xcrypt_isa_test (void);
+int
+xcrypt_isa_test (void)
+{
+$5
+}
+]])],
+       [AS_VAR_SET([cache_var], [yes])],
+       [AS_VAR_SET([cache_var], [no])])])
+   AS_VAR_IF([cache_var], [yes],
+     [AC_DEFINE([HAVE_PRAGMA_TARGET_]m4_toupper([$1]), 1,
+        [Define to 1 if source files using $1 instructions can be compiled
+         with @%:@pragma GCC target("$2").])])
+   AS_VAR_POPDEF([cache_var])])
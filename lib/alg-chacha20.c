@@ -0,0 +1,71 @@
+/* The ChaCha20 stream cipher (RFC 8439), keystream only.
+ *
+ * To the extent possible under law, the author(s) have waived all
+ * copyright and related or neighboring rights to this work.
+ *
+ * See https://creativecommons.org/publicdomain/zero/1.0/ for further
+ * details.
+ */
+
+#include "crypt-port.h"
+#include "alg-chacha20.h"
+#include "byteorder.h"
+
+#if ENABLE_RANDOM_POOL
+
+#define ROTL32(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+
+#define QUARTERROUND(a, b, c, d)                  \
+  do {                                            \
+    a += b; d ^= a; d = ROTL32 (d, 16);           \
+    c += d; b ^= c; b = ROTL32 (b, 12);           \
+    a += b; d ^= a; d = ROTL32 (d, 8);            \
+    c += d; b ^= c; b = ROTL32 (b, 7);            \
+  } while (0)
+
+void
+chacha20_keystream (uint8_t *out, size_t nblocks,
+                    const uint8_t key[CHACHA20_KEY_SIZE],
+                    const uint8_t nonce[CHACHA20_NONCE_SIZE],
+                    uint32_t counter)
+{
+  uint32_t input[16], x[16];
+  size_t i;
+  int r;
+
+  /* "expand 32-byte k" */
+  input[0] = 0x61707865;
+  input[1] = 0x3320646e;
+  input[2] = 0x79622d32;
+  input[3] = 0x6b206574;
+  for (i = 0; i < 8; i++)
+    input[4 + i] = le32_to_cpu (key + 4 * i);
+  input[12] = counter;
+  for (i = 0; i < 3; i++)
+    input[13 + i] = le32_to_cpu (nonce + 4 * i);
+
+  for (; nblocks > 0; nblocks--)
+    {
+      memcpy (x, input, sizeof x);
+      for (r = 0; r < 10; r++)
+        {
+          QUARTERROUND (x[0], x[4], x[ 8], x[12]);
+          QUARTERROUND (x[1], x[5], x[ 9], x[13]);
+          QUARTERROUND (x[2], x[6], x[10], x[14]);
+          QUARTERROUND (x[3], x[7], x[11], x[15]);
+          QUARTERROUND (x[0], x[5], x[10], x[15]);
+          QUARTERROUND (x[1], x[6], x[11], x[12]);
+          QUARTERROUND (x[2], x[7], x[ 8], x[13]);
+          QUARTERROUND (x[3], x[4], x[ 9], x[14]);
+        }
+      for (i = 0; i < 16; i++)
+        cpu_to_le32 (out + 4 * i, x[i] + input[i]);
+      out += CHACHA20_BLOCK_SIZE;
+      input[12]++;
+    }
+
+  explicit_bzero (input, sizeof input);
+  explicit_bzero (x, sizeof x);
+}
+
+#endif /* ENABLE_RANDOM_POOL */
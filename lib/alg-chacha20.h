@@ -0,0 +1,25 @@
+/* The ChaCha20 stream cipher (RFC 8439), keystream only.
+ *
+ * To the extent possible under law, the author(s) have waived all
+ * copyright and related or neighboring rights to this work.
+ *
+ * See https://creativecommons.org/publicdomain/zero/1.0/ for further
+ * details.
+ */
+
+#ifndef _CRYPT_ALG_CHACHA20_H
+#define _CRYPT_ALG_CHACHA20_H 1
+
+#define CHACHA20_KEY_SIZE   32
+#define CHACHA20_NONCE_SIZE 12
+#define CHACHA20_BLOCK_SIZE 64
+
+/* Write NBLOCKS blocks of the ChaCha20 keystream for KEY and NONCE,
+   starting with block number COUNTER, to OUT.  KEY and NONCE are read
+   before anything is written, so OUT may overlap them.  */
+extern void chacha20_keystream (uint8_t *out, size_t nblocks,
+                                const uint8_t key[CHACHA20_KEY_SIZE],
+                                const uint8_t nonce[CHACHA20_NONCE_SIZE],
+                                uint32_t counter);
+
+#endif /* alg-chacha20.h */
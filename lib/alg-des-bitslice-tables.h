@@ -0,0 +1,768 @@
+/* This file is generated by gen-des-bitslice.c.  Do not edit.
+
+   To the extent possible under law, the author(s) have waived all
+   copyright and related or neighboring rights to this work.
+
+   See https://creativecommons.org/publicdomain/zero/1.0/ for further
+   details.  */
+
+/* The DES S-boxes as circuits.  DES_BS_Sn (V, vec, a1, ..., a6, o1, ..., o4)
+   XORs the four outputs of S-box n for the inputs a1 to a6 (a1 being the
+   most significant) into o1 to o4 (o1 being the most significant).  The
+   operations are V##_AND, V##_ANDN (x & ~y), V##_OR, V##_XOR, V##_NOT and
+   V##_SEL (z ? y : x), on values of type vec.  */
+
+/* S-box 1: 89 operations.  */
+#define DES_BS_S1(V, vec, a1, a2, a3, a4, a5, a6, o1, o2, o3, o4) \
+  do \
+    { \
+      vec t1 = V##_NOT (a4); \
+      vec t2 = V##_ANDN (t1, a1); \
+      vec t3 = V##_AND (a3, t2); \
+      vec t4 = V##_XOR (t1, t3); \
+      vec t5 = V##_OR (a1, t1); \
+      vec t6 = V##_OR (a3, t5); \
+      vec t7 = V##_ANDN (t6, a6); \
+      vec t8 = V##_XOR (t4, t7); \
+      vec t9 = V##_NOT (t3); \
+      vec t10 = V##_AND (a1, t1); \
+      vec t11 = V##_ANDN (t10, a3); \
+      vec t12 = V##_AND (a6, t11); \
+      vec t13 = V##_XOR (t9, t12); \
+      vec t14 = V##_AND (a2, t13); \
+      vec t15 = V##_XOR (t8, t14); \
+      vec t16 = V##_ANDN (a1, a3); \
+      vec t17 = V##_XOR (a4, t16); \
+      vec t18 = V##_ANDN (t17, a6); \
+      vec t19 = V##_XOR (t6, t18); \
+      vec t20 = V##_AND (a1, a4); \
+      vec t21 = V##_AND (a6, t16); \
+      vec t22 = V##_XOR (t20, t21); \
+      vec t23 = V##_ANDN (t22, a2); \
+      vec t24 = V##_XOR (t19, t23); \
+      vec t25 = V##_ANDN (t24, a5); \
+      vec t26 = V##_XOR (t15, t25); \
+      vec t27 = V##_XOR (a1, a4); \
+      vec t28 = V##_XOR (a3, t27); \
+      vec t29 = V##_AND (a6, t3); \
+      vec t30 = V##_XOR (t28, t29); \
+      vec t31 = V##_ANDN (t10, a3); \
+      vec t32 = V##_XOR (t5, t31); \
+      vec t33 = V##_SEL (t32, a3, a6); \
+      vec t34 = V##_ANDN (t33, a2); \
+      vec t35 = V##_XOR (t30, t34); \
+      vec t36 = V##_OR (a3, t2); \
+      vec t37 = V##_ANDN (t9, a6); \
+      vec t38 = V##_XOR (t36, t37); \
+      vec t39 = V##_NOT (t2); \
+      vec t40 = V##_SEL (t17, t39, a6); \
+      vec t41 = V##_AND (a2, t40); \
+      vec t42 = V##_XOR (t38, t41); \
+      vec t43 = V##_AND (a5, t42); \
+      vec t44 = V##_XOR (t35, t43); \
+      vec t45 = V##_AND (a3, t5); \
+      vec t46 = V##_NOT (t27); \
+      vec t47 = V##_SEL (t45, t46, a6); \
+      vec t48 = V##_NOT (t45); \
+      vec t49 = V##_ANDN (t48, a6); \
+      vec t50 = V##_XOR (t28, t49); \
+      vec t51 = V##_AND (a2, t50); \
+      vec t52 = V##_XOR (t47, t51); \
+      vec t53 = V##_NOT (t28); \
+      vec t54 = V##_AND (a3, t20); \
+      vec t55 = V##_XOR (t27, t54); \
+      vec t56 = V##_AND (a6, t55); \
+      vec t57 = V##_XOR (t53, t56); \
+      vec t58 = V##_AND (a3, a1); \
+      vec t59 = V##_XOR (t39, t58); \
+      vec t60 = V##_ANDN (t59, a6); \
+      vec t61 = V##_XOR (t53, t60); \
+      vec t62 = V##_AND (a2, t61); \
+      vec t63 = V##_XOR (t57, t62); \
+      vec t64 = V##_ANDN (t63, a5); \
+      vec t65 = V##_XOR (t52, t64); \
+      vec t66 = V##_NOT (t20); \
+      vec t67 = V##_AND (a6, t66); \
+      vec t68 = V##_XOR (t28, t67); \
+      vec t69 = V##_ANDN (t32, a6); \
+      vec t70 = V##_XOR (t66, t69); \
+      vec t71 = V##_AND (a2, t70); \
+      vec t72 = V##_XOR (t68, t71); \
+      vec t73 = V##_ANDN (a3, t10); \
+      vec t74 = V##_NOT (t73); \
+      vec t75 = V##_ANDN (t74, a6); \
+      vec t76 = V##_XOR (a4, t75); \
+      vec t77 = V##_OR (a3, a1); \
+      vec t78 = V##_AND (a6, t77); \
+      vec t79 = V##_XOR (t2, t78); \
+      vec t80 = V##_ANDN (t79, a2); \
+      vec t81 = V##_XOR (t76, t80); \
+      vec t82 = V##_ANDN (t81, a5); \
+      vec t83 = V##_XOR (t72, t82); \
+      o1 = V##_XOR (o1, t26); \
+      o2 = V##_XOR (o2, t44); \
+      o3 = V##_XOR (o3, t65); \
+      o4 = V##_XOR (o4, t83); \
+    } \
+  while (0)
+
+/* S-box 2: 75 operations.  */
+#define DES_BS_S2(V, vec, a1, a2, a3, a4, a5, a6, o1, o2, o3, o4) \
+  do \
+    { \
+      vec t1 = V##_NOT (a1); \
+      vec t2 = V##_OR (a3, t1); \
+      vec t3 = V##_XOR (a4, t2); \
+      vec t4 = V##_XOR (a5, t3); \
+      vec t5 = V##_OR (a3, a1); \
+      vec t6 = V##_AND (a3, a1); \
+      vec t7 = V##_AND (a5, t6); \
+      vec t8 = V##_XOR (t5, t7); \
+      vec t9 = V##_AND (a6, t8); \
+      vec t10 = V##_XOR (t4, t9); \
+      vec t11 = V##_XOR (a4, t1); \
+      vec t12 = V##_OR (a5, t11); \
+      vec t13 = V##_NOT (t5); \
+      vec t14 = V##_ANDN (a1, a4); \
+      vec t15 = V##_AND (a5, t14); \
+      vec t16 = V##_XOR (t13, t15); \
+      vec t17 = V##_ANDN (t16, a6); \
+      vec t18 = V##_XOR (t12, t17); \
+      vec t19 = V##_ANDN (t18, a2); \
+      vec t20 = V##_XOR (t10, t19); \
+      vec t21 = V##_XOR (a5, t11); \
+      vec t22 = V##_NOT (a3); \
+      vec t23 = V##_AND (a4, t22); \
+      vec t24 = V##_AND (a5, t23); \
+      vec t25 = V##_XOR (t22, t24); \
+      vec t26 = V##_AND (a6, t25); \
+      vec t27 = V##_XOR (t21, t26); \
+      vec t28 = V##_AND (a4, a1); \
+      vec t29 = V##_XOR (t6, t28); \
+      vec t30 = V##_AND (a5, t29); \
+      vec t31 = V##_XOR (a4, t30); \
+      vec t32 = V##_ANDN (t31, a6); \
+      vec t33 = V##_XOR (t22, t32); \
+      vec t34 = V##_AND (a2, t33); \
+      vec t35 = V##_XOR (t27, t34); \
+      vec t36 = V##_OR (a4, t13); \
+      vec t37 = V##_AND (a5, t36); \
+      vec t38 = V##_XOR (t3, t37); \
+      vec t39 = V##_AND (a3, t1); \
+      vec t40 = V##_AND (a4, t39); \
+      vec t41 = V##_AND (a5, a1); \
+      vec t42 = V##_XOR (t40, t41); \
+      vec t43 = V##_ANDN (t42, a6); \
+      vec t44 = V##_XOR (t38, t43); \
+      vec t45 = V##_OR (a4, t2); \
+      vec t46 = V##_NOT (t2); \
+      vec t47 = V##_AND (a5, t46); \
+      vec t48 = V##_XOR (t45, t47); \
+      vec t49 = V##_ANDN (t1, a4); \
+      vec t50 = V##_XOR (t46, t49); \
+      vec t51 = V##_ANDN (t50, a5); \
+      vec t52 = V##_XOR (t13, t51); \
+      vec t53 = V##_AND (a6, t52); \
+      vec t54 = V##_XOR (t48, t53); \
+      vec t55 = V##_AND (a2, t54); \
+      vec t56 = V##_XOR (t44, t55); \
+      vec t57 = V##_ANDN (t39, a5); \
+      vec t58 = V##_XOR (t11, t57); \
+      vec t59 = V##_AND (a4, t1); \
+      vec t60 = V##_XOR (t46, t59); \
+      vec t61 = V##_AND (a5, t60); \
+      vec t62 = V##_XOR (t5, t61); \
+      vec t63 = V##_AND (a6, t62); \
+      vec t64 = V##_XOR (t58, t63); \
+      vec t65 = V##_NOT (t14); \
+      vec t66 = V##_ANDN (t6, a5); \
+      vec t67 = V##_XOR (t65, t66); \
+      vec t68 = V##_NOT (t29); \
+      vec t69 = V##_XOR (a4, t5); \
+      vec t70 = V##_AND (a5, t69); \
+      vec t71 = V##_XOR (t68, t70); \
+      vec t72 = V##_ANDN (t71, a6); \
+      vec t73 = V##_XOR (t67, t72); \
+      vec t74 = V##_AND (a2, t73); \
+      vec t75 = V##_XOR (t64, t74); \
+      o1 = V##_XOR (o1, t20); \
+      o2 = V##_XOR (o2, t35); \
+      o3 = V##_XOR (o3, t56); \
+      o4 = V##_XOR (o4, t75); \
+    } \
+  while (0)
+
+/* S-box 3: 74 operations.  */
+#define DES_BS_S3(V, vec, a1, a2, a3, a4, a5, a6, o1, o2, o3, o4) \
+  do \
+    { \
+      vec t1 = V##_NOT (a5); \
+      vec t2 = V##_XOR (a6, t1); \
+      vec t3 = V##_XOR (a4, t2); \
+      vec t4 = V##_ANDN (a5, a2); \
+      vec t5 = V##_ANDN (t4, a6); \
+      vec t6 = V##_XOR (a2, t5); \
+      vec t7 = V##_AND (a3, t6); \
+      vec t8 = V##_XOR (t3, t7); \
+      vec t9 = V##_XOR (a6, a2); \
+      vec t10 = V##_NOT (t5); \
+      vec t11 = V##_SEL (t9, t10, a4); \
+      vec t12 = V##_NOT (a2); \
+      vec t13 = V##_AND (a6, a5); \
+      vec t14 = V##_XOR (t12, t13); \
+      vec t15 = V##_ANDN (t14, a4); \
+      vec t16 = V##_AND (a3, t15); \
+      vec t17 = V##_XOR (t11, t16); \
+      vec t18 = V##_ANDN (t17, a1); \
+      vec t19 = V##_XOR (t8, t18); \
+      vec t20 = V##_XOR (a2, a5); \
+      vec t21 = V##_OR (a6, t20); \
+      vec t22 = V##_ANDN (t21, a4); \
+      vec t23 = V##_XOR (t6, t22); \
+      vec t24 = V##_AND (a2, t1); \
+      vec t25 = V##_ANDN (t24, a6); \
+      vec t26 = V##_XOR (t1, t25); \
+      vec t27 = V##_AND (a4, a2); \
+      vec t28 = V##_XOR (t26, t27); \
+      vec t29 = V##_AND (a3, t28); \
+      vec t30 = V##_XOR (t23, t29); \
+      vec t31 = V##_NOT (t25); \
+      vec t32 = V##_NOT (t14); \
+      vec t33 = V##_AND (a4, t32); \
+      vec t34 = V##_XOR (t31, t33); \
+      vec t35 = V##_OR (a3, t34); \
+      vec t36 = V##_AND (a1, t35); \
+      vec t37 = V##_XOR (t30, t36); \
+      vec t38 = V##_AND (a6, t4); \
+      vec t39 = V##_XOR (t1, t38); \
+      vec t40 = V##_AND (a6, a2); \
+      vec t41 = V##_XOR (t4, t40); \
+      vec t42 = V##_ANDN (t41, a4); \
+      vec t43 = V##_XOR (t39, t42); \
+      vec t44 = V##_OR (a4, t21); \
+      vec t45 = V##_ANDN (t44, a3); \
+      vec t46 = V##_XOR (t43, t45); \
+      vec t47 = V##_NOT (t2); \
+      vec t48 = V##_ANDN (t24, a6); \
+      vec t49 = V##_XOR (t12, t48); \
+      vec t50 = V##_AND (a4, t49); \
+      vec t51 = V##_XOR (t47, t50); \
+      vec t52 = V##_OR (a6, a2); \
+      vec t53 = V##_AND (a4, t1); \
+      vec t54 = V##_XOR (t52, t53); \
+      vec t55 = V##_ANDN (t54, a3); \
+      vec t56 = V##_XOR (t51, t55); \
+      vec t57 = V##_SEL (t46, t56, a1); \
+      vec t58 = V##_AND (a4, t1); \
+      vec t59 = V##_XOR (t9, t58); \
+      vec t60 = V##_AND (a3, a5); \
+      vec t61 = V##_XOR (t59, t60); \
+      vec t62 = V##_ANDN (t47, a4); \
+      vec t63 = V##_XOR (t31, t62); \
+      vec t64 = V##_ANDN (t1, a2); \
+      vec t65 = V##_ANDN (t40, a4); \
+      vec t66 = V##_XOR (t64, t65); \
+      vec t67 = V##_AND (a3, t66); \
+      vec t68 = V##_XOR (t63, t67); \
+      vec t69 = V##_AND (a1, t68); \
+      vec t70 = V##_XOR (t61, t69); \
+      o1 = V##_XOR (o1, t19); \
+      o2 = V##_XOR (o2, t37); \
+      o3 = V##_XOR (o3, t57); \
+      o4 = V##_XOR (o4, t70); \
+    } \
+  while (0)
+
+/* S-box 4: 53 operations.  */
+#define DES_BS_S4(V, vec, a1, a2, a3, a4, a5, a6, o1, o2, o3, o4) \
+  do \
+    { \
+      vec t1 = V##_ANDN (a5, a3); \
+      vec t2 = V##_NOT (t1); \
+      vec t3 = V##_ANDN (t2, a1); \
+      vec t4 = V##_XOR (a3, t3); \
+      vec t5 = V##_ANDN (a5, a4); \
+      vec t6 = V##_XOR (t4, t5); \
+      vec t7 = V##_NOT (a3); \
+      vec t8 = V##_XOR (a5, t7); \
+      vec t9 = V##_AND (a1, t8); \
+      vec t10 = V##_XOR (a3, t9); \
+      vec t11 = V##_AND (a4, t10); \
+      vec t12 = V##_XOR (t7, t11); \
+      vec t13 = V##_AND (a2, t12); \
+      vec t14 = V##_XOR (t6, t13); \
+      vec t15 = V##_AND (a1, t1); \
+      vec t16 = V##_XOR (t8, t15); \
+      vec t17 = V##_SEL (t16, t10, a4); \
+      vec t18 = V##_OR (a1, t2); \
+      vec t19 = V##_NOT (t8); \
+      vec t20 = V##_AND (a4, t19); \
+      vec t21 = V##_XOR (t18, t20); \
+      vec t22 = V##_AND (a2, t21); \
+      vec t23 = V##_XOR (t17, t22); \
+      vec t24 = V##_ANDN (t23, a6); \
+      vec t25 = V##_XOR (t14, t24); \
+      vec t26 = V##_NOT (t23); \
+      vec t27 = V##_AND (a6, t26); \
+      vec t28 = V##_XOR (t14, t27); \
+      vec t29 = V##_NOT (t3); \
+      vec t30 = V##_AND (a4, t29); \
+      vec t31 = V##_XOR (t16, t30); \
+      vec t32 = V##_ANDN (a1, t1); \
+      vec t33 = V##_NOT (t32); \
+      vec t34 = V##_AND (a4, t10); \
+      vec t35 = V##_XOR (t33, t34); \
+      vec t36 = V##_AND (a2, t35); \
+      vec t37 = V##_XOR (t31, t36); \
+      vec t38 = V##_ANDN (t4, a4); \
+      vec t39 = V##_XOR (t2, t38); \
+      vec t40 = V##_SEL (t8, t2, a1); \
+      vec t41 = V##_AND (a4, t19); \
+      vec t42 = V##_XOR (t40, t41); \
+      vec t43 = V##_ANDN (t42, a2); \
+      vec t44 = V##_XOR (t39, t43); \
+      vec t45 = V##_AND (a6, t44); \
+      vec t46 = V##_XOR (t37, t45); \
+      vec t47 = V##_NOT (t44); \
+      vec t48 = V##_ANDN (t47, a6); \
+      vec t49 = V##_XOR (t37, t48); \
+      o1 = V##_XOR (o1, t25); \
+      o2 = V##_XOR (o2, t28); \
+      o3 = V##_XOR (o3, t46); \
+      o4 = V##_XOR (o4, t49); \
+    } \
+  while (0)
+
+/* S-box 5: 85 operations.  */
+#define DES_BS_S5(V, vec, a1, a2, a3, a4, a5, a6, o1, o2, o3, o4) \
+  do \
+    { \
+      vec t1 = V##_XOR (a2, a5); \
+      vec t2 = V##_OR (a2, a5); \
+      vec t3 = V##_NOT (a5); \
+      vec t4 = V##_AND (a3, t3); \
+      vec t5 = V##_XOR (t2, t4); \
+      vec t6 = V##_AND (a4, t5); \
+      vec t7 = V##_XOR (t1, t6); \
+      vec t8 = V##_AND (a3, t2); \
+      vec t9 = V##_XOR (t1, t8); \
+      vec t10 = V##_ANDN (t3, a3); \
+      vec t11 = V##_XOR (t1, t10); \
+      vec t12 = V##_ANDN (t11, a4); \
+      vec t13 = V##_XOR (t9, t12); \
+      vec t14 = V##_AND (a6, t13); \
+      vec t15 = V##_XOR (t7, t14); \
+      vec t16 = V##_XOR (a3, a5); \
+      vec t17 = V##_AND (a2, t3); \
+      vec t18 = V##_AND (a3, t1); \
+      vec t19 = V##_XOR (t17, t18); \
+      vec t20 = V##_AND (a4, t19); \
+      vec t21 = V##_XOR (t16, t20); \
+      vec t22 = V##_NOT (t1); \
+      vec t23 = V##_ANDN (t22, a3); \
+      vec t24 = V##_NOT (t17); \
+      vec t25 = V##_ANDN (t24, a4); \
+      vec t26 = V##_XOR (t23, t25); \
+      vec t27 = V##_AND (a6, t26); \
+      vec t28 = V##_XOR (t21, t27); \
+      vec t29 = V##_AND (a1, t28); \
+      vec t30 = V##_XOR (t15, t29); \
+      vec t31 = V##_NOT (a2); \
+      vec t32 = V##_AND (a4, t31); \
+      vec t33 = V##_XOR (t16, t32); \
+      vec t34 = V##_ANDN (a3, t1); \
+      vec t35 = V##_NOT (t34); \
+      vec t36 = V##_OR (a4, t35); \
+      vec t37 = V##_AND (a6, t36); \
+      vec t38 = V##_XOR (t33, t37); \
+      vec t39 = V##_OR (a3, t3); \
+      vec t40 = V##_SEL (t22, t39, a4); \
+      vec t41 = V##_AND (a3, a2); \
+      vec t42 = V##_XOR (t1, t41); \
+      vec t43 = V##_ANDN (t42, a4); \
+      vec t44 = V##_ANDN (t43, a6); \
+      vec t45 = V##_XOR (t40, t44); \
+      vec t46 = V##_AND (a1, t45); \
+      vec t47 = V##_XOR (t38, t46); \
+      vec t48 = V##_ANDN (t24, a3); \
+      vec t49 = V##_XOR (t1, t48); \
+      vec t50 = V##_XOR (a4, t49); \
+      vec t51 = V##_ANDN (t25, a6); \
+      vec t52 = V##_XOR (t50, t51); \
+      vec t53 = V##_ANDN (t23, a4); \
+      vec t54 = V##_XOR (t2, t53); \
+      vec t55 = V##_ANDN (t2, a3); \
+      vec t56 = V##_NOT (t2); \
+      vec t57 = V##_AND (a4, t56); \
+      vec t58 = V##_XOR (t55, t57); \
+      vec t59 = V##_SEL (t54, t58, a6); \
+      vec t60 = V##_ANDN (t59, a1); \
+      vec t61 = V##_XOR (t52, t60); \
+      vec t62 = V##_AND (a3, t17); \
+      vec t63 = V##_XOR (a5, t62); \
+      vec t64 = V##_OR (a3, t31); \
+      vec t65 = V##_ANDN (t64, a4); \
+      vec t66 = V##_XOR (t63, t65); \
+      vec t67 = V##_NOT (t55); \
+      vec t68 = V##_ANDN (t17, a4); \
+      vec t69 = V##_XOR (t67, t68); \
+      vec t70 = V##_ANDN (t69, a6); \
+      vec t71 = V##_XOR (t66, t70); \
+      vec t72 = V##_AND (a3, t31); \
+      vec t73 = V##_XOR (t2, t72); \
+      vec t74 = V##_ANDN (a4, t73); \
+      vec t75 = V##_NOT (t74); \
+      vec t76 = V##_AND (a4, t4); \
+      vec t77 = V##_XOR (t48, t76); \
+      vec t78 = V##_ANDN (t77, a6); \
+      vec t79 = V##_XOR (t75, t78); \
+      vec t80 = V##_ANDN (t79, a1); \
+      vec t81 = V##_XOR (t71, t80); \
+      o1 = V##_XOR (o1, t30); \
+      o2 = V##_XOR (o2, t47); \
+      o3 = V##_XOR (o3, t61); \
+      o4 = V##_XOR (o4, t81); \
+    } \
+  while (0)
+
+/* S-box 6: 78 operations.  */
+#define DES_BS_S6(V, vec, a1, a2, a3, a4, a5, a6, o1, o2, o3, o4) \
+  do \
+    { \
+      vec t1 = V##_XOR (a4, a1); \
+      vec t2 = V##_XOR (a6, t1); \
+      vec t3 = V##_NOT (a3); \
+      vec t4 = V##_NOT (a1); \
+      vec t5 = V##_AND (a3, t4); \
+      vec t6 = V##_AND (a4, t5); \
+      vec t7 = V##_AND (a6, t6); \
+      vec t8 = V##_XOR (t3, t7); \
+      vec t9 = V##_AND (a2, t8); \
+      vec t10 = V##_XOR (t2, t9); \
+      vec t11 = V##_ANDN (t3, a4); \
+      vec t12 = V##_XOR (a1, t11); \
+      vec t13 = V##_ANDN (t12, a6); \
+      vec t14 = V##_XOR (t5, t13); \
+      vec t15 = V##_AND (a3, a1); \
+      vec t16 = V##_AND (a4, a1); \
+      vec t17 = V##_XOR (t15, t16); \
+      vec t18 = V##_AND (a6, t17); \
+      vec t19 = V##_ANDN (t18, a2); \
+      vec t20 = V##_XOR (t14, t19); \
+      vec t21 = V##_ANDN (t20, a5); \
+      vec t22 = V##_XOR (t10, t21); \
+      vec t23 = V##_ANDN (t4, a3); \
+      vec t24 = V##_XOR (a4, t23); \
+      vec t25 = V##_NOT (t15); \
+      vec t26 = V##_AND (a6, t25); \
+      vec t27 = V##_XOR (t24, t26); \
+      vec t28 = V##_XOR (a4, t25); \
+      vec t29 = V##_ANDN (t15, a4); \
+      vec t30 = V##_AND (a6, t29); \
+      vec t31 = V##_XOR (t28, t30); \
+      vec t32 = V##_AND (a2, t31); \
+      vec t33 = V##_XOR (t27, t32); \
+      vec t34 = V##_NOT (t5); \
+      vec t35 = V##_OR (a4, t34); \
+      vec t36 = V##_ANDN (t17, a6); \
+      vec t37 = V##_XOR (t35, t36); \
+      vec t38 = V##_NOT (t28); \
+      vec t39 = V##_AND (a6, t38); \
+      vec t40 = V##_XOR (t17, t39); \
+      vec t41 = V##_AND (a2, t40); \
+      vec t42 = V##_XOR (t37, t41); \
+      vec t43 = V##_AND (a5, t42); \
+      vec t44 = V##_XOR (t33, t43); \
+      vec t45 = V##_OR (a3, t4); \
+      vec t46 = V##_AND (a6, t45); \
+      vec t47 = V##_XOR (t38, t46); \
+      vec t48 = V##_NOT (t23); \
+      vec t49 = V##_AND (a2, t48); \
+      vec t50 = V##_XOR (t47, t49); \
+      vec t51 = V##_AND (a4, t4); \
+      vec t52 = V##_XOR (t15, t51); \
+      vec t53 = V##_AND (a6, t52); \
+      vec t54 = V##_XOR (t48, t53); \
+      vec t55 = V##_XOR (a4, t34); \
+      vec t56 = V##_NOT (t17); \
+      vec t57 = V##_ANDN (t56, a6); \
+      vec t58 = V##_XOR (t55, t57); \
+      vec t59 = V##_AND (a2, t58); \
+      vec t60 = V##_XOR (t54, t59); \
+      vec t61 = V##_AND (a5, t60); \
+      vec t62 = V##_XOR (t50, t61); \
+      vec t63 = V##_OR (a4, a1); \
+      vec t64 = V##_ANDN (t63, a6); \
+      vec t65 = V##_XOR (t55, t64); \
+      vec t66 = V##_NOT (t11); \
+      vec t67 = V##_SEL (t66, t48, a6); \
+      vec t68 = V##_AND (a2, t67); \
+      vec t69 = V##_XOR (t65, t68); \
+      vec t70 = V##_ANDN (t6, a6); \
+      vec t71 = V##_XOR (t56, t70); \
+      vec t72 = V##_AND (a6, t51); \
+      vec t73 = V##_ANDN (t72, a2); \
+      vec t74 = V##_XOR (t71, t73); \
+      vec t75 = V##_ANDN (t74, a5); \
+      vec t76 = V##_XOR (t69, t75); \
+      o1 = V##_XOR (o1, t22); \
+      o2 = V##_XOR (o2, t44); \
+      o3 = V##_XOR (o3, t62); \
+      o4 = V##_XOR (o4, t76); \
+    } \
+  while (0)
+
+/* S-box 7: 79 operations.  */
+#define DES_BS_S7(V, vec, a1, a2, a3, a4, a5, a6, o1, o2, o3, o4) \
+  do \
+    { \
+      vec t1 = V##_NOT (a1); \
+      vec t2 = V##_AND (a3, t1); \
+      vec t3 = V##_XOR (a5, t2); \
+      vec t4 = V##_OR (a3, t1); \
+      vec t5 = V##_ANDN (a5, t4); \
+      vec t6 = V##_NOT (t5); \
+      vec t7 = V##_ANDN (t6, a2); \
+      vec t8 = V##_XOR (t3, t7); \
+      vec t9 = V##_AND (a5, t2); \
+      vec t10 = V##_XOR (t4, t9); \
+      vec t11 = V##_ANDN (t10, a6); \
+      vec t12 = V##_XOR (t8, t11); \
+      vec t13 = V##_ANDN (a1, a5); \
+      vec t14 = V##_OR (a2, t13); \
+      vec t15 = V##_OR (a3, a1); \
+      vec t16 = V##_AND (a5, t15); \
+      vec t17 = V##_AND (a2, t2); \
+      vec t18 = V##_XOR (t16, t17); \
+      vec t19 = V##_ANDN (t18, a6); \
+      vec t20 = V##_XOR (t14, t19); \
+      vec t21 = V##_ANDN (t20, a4); \
+      vec t22 = V##_XOR (t12, t21); \
+      vec t23 = V##_XOR (a3, t1); \
+      vec t24 = V##_ANDN (t23, a2); \
+      vec t25 = V##_XOR (t3, t24); \
+      vec t26 = V##_SEL (a1, t4, a2); \
+      vec t27 = V##_AND (a6, t26); \
+      vec t28 = V##_XOR (t25, t27); \
+      vec t29 = V##_AND (a3, a1); \
+      vec t30 = V##_ANDN (t29, a5); \
+      vec t31 = V##_XOR (a1, t30); \
+      vec t32 = V##_NOT (t29); \
+      vec t33 = V##_ANDN (t32, a2); \
+      vec t34 = V##_XOR (t31, t33); \
+      vec t35 = V##_AND (a5, a3); \
+      vec t36 = V##_OR (a5, a1); \
+      vec t37 = V##_AND (a2, t36); \
+      vec t38 = V##_XOR (t35, t37); \
+      vec t39 = V##_AND (a6, t38); \
+      vec t40 = V##_XOR (t34, t39); \
+      vec t41 = V##_AND (a4, t40); \
+      vec t42 = V##_XOR (t28, t41); \
+      vec t43 = V##_NOT (t4); \
+      vec t44 = V##_XOR (a2, t43); \
+      vec t45 = V##_AND (a5, t1); \
+      vec t46 = V##_XOR (t15, t45); \
+      vec t47 = V##_ANDN (t30, a2); \
+      vec t48 = V##_XOR (t46, t47); \
+      vec t49 = V##_ANDN (t48, a6); \
+      vec t50 = V##_XOR (t44, t49); \
+      vec t51 = V##_NOT (a5); \
+      vec t52 = V##_AND (a2, t36); \
+      vec t53 = V##_XOR (t51, t52); \
+      vec t54 = V##_ANDN (t3, a2); \
+      vec t55 = V##_XOR (t9, t54); \
+      vec t56 = V##_AND (a6, t55); \
+      vec t57 = V##_XOR (t53, t56); \
+      vec t58 = V##_AND (a4, t57); \
+      vec t59 = V##_XOR (t50, t58); \
+      vec t60 = V##_XOR (a5, t1); \
+      vec t61 = V##_NOT (a3); \
+      vec t62 = V##_ANDN (t61, a2); \
+      vec t63 = V##_XOR (t60, t62); \
+      vec t64 = V##_AND (a5, a1); \
+      vec t65 = V##_XOR (t32, t64); \
+      vec t66 = V##_ANDN (a2, t65); \
+      vec t67 = V##_NOT (t66); \
+      vec t68 = V##_AND (a6, t67); \
+      vec t69 = V##_XOR (t63, t68); \
+      vec t70 = V##_OR (a5, a3); \
+      vec t71 = V##_ANDN (t43, a5); \
+      vec t72 = V##_AND (a2, t60); \
+      vec t73 = V##_XOR (t71, t72); \
+      vec t74 = V##_AND (a6, t73); \
+      vec t75 = V##_XOR (t70, t74); \
+      vec t76 = V##_AND (a4, t75); \
+      vec t77 = V##_XOR (t69, t76); \
+      o1 = V##_XOR (o1, t22); \
+      o2 = V##_XOR (o2, t42); \
+      o3 = V##_XOR (o3, t59); \
+      o4 = V##_XOR (o4, t77); \
+    } \
+  while (0)
+
+/* S-box 8: 72 operations.  */
+#define DES_BS_S8(V, vec, a1, a2, a3, a4, a5, a6, o1, o2, o3, o4) \
+  do \
+    { \
+      vec t1 = V##_ANDN (a1, a3); \
+      vec t2 = V##_NOT (t1); \
+      vec t3 = V##_ANDN (t2, a5); \
+      vec t4 = V##_NOT (a3); \
+      vec t5 = V##_OR (a1, t4); \
+      vec t6 = V##_AND (a2, t5); \
+      vec t7 = V##_XOR (t3, t6); \
+      vec t8 = V##_ANDN (a5, a1); \
+      vec t9 = V##_NOT (t8); \
+      vec t10 = V##_XOR (a5, t5); \
+      vec t11 = V##_ANDN (t10, a2); \
+      vec t12 = V##_XOR (t9, t11); \
+      vec t13 = V##_ANDN (t12, a4); \
+      vec t14 = V##_XOR (t7, t13); \
+      vec t15 = V##_AND (a5, t1); \
+      vec t16 = V##_XOR (t5, t15); \
+      vec t17 = V##_AND (a2, t3); \
+      vec t18 = V##_XOR (t16, t17); \
+      vec t19 = V##_NOT (a5); \
+      vec t20 = V##_OR (a5, a1); \
+      vec t21 = V##_AND (a2, t20); \
+      vec t22 = V##_XOR (t19, t21); \
+      vec t23 = V##_ANDN (t22, a4); \
+      vec t24 = V##_XOR (t18, t23); \
+      vec t25 = V##_SEL (t14, t24, a6); \
+      vec t26 = V##_XOR (a1, t4); \
+      vec t27 = V##_ANDN (t26, a5); \
+      vec t28 = V##_OR (a1, a3); \
+      vec t29 = V##_ANDN (t28, a2); \
+      vec t30 = V##_XOR (t27, t29); \
+      vec t31 = V##_ANDN (a2, t20); \
+      vec t32 = V##_NOT (t31); \
+      vec t33 = V##_ANDN (t32, a4); \
+      vec t34 = V##_XOR (t30, t33); \
+      vec t35 = V##_NOT (t15); \
+      vec t36 = V##_SEL (t1, a1, a2); \
+      vec t37 = V##_AND (a4, t36); \
+      vec t38 = V##_XOR (t35, t37); \
+      vec t39 = V##_ANDN (t38, a6); \
+      vec t40 = V##_XOR (t34, t39); \
+      vec t41 = V##_AND (a5, t4); \
+      vec t42 = V##_XOR (t26, t41); \
+      vec t43 = V##_ANDN (t35, a2); \
+      vec t44 = V##_XOR (t42, t43); \
+      vec t45 = V##_AND (a4, t20); \
+      vec t46 = V##_XOR (t44, t45); \
+      vec t47 = V##_AND (a2, t15); \
+      vec t48 = V##_XOR (a1, t47); \
+      vec t49 = V##_ANDN (a1, a5); \
+      vec t50 = V##_XOR (a5, t26); \
+      vec t51 = V##_SEL (t49, t50, a2); \
+      vec t52 = V##_ANDN (t51, a4); \
+      vec t53 = V##_XOR (t48, t52); \
+      vec t54 = V##_AND (a6, t53); \
+      vec t55 = V##_XOR (t46, t54); \
+      vec t56 = V##_NOT (t24); \
+      vec t57 = V##_ANDN (t2, a5); \
+      vec t58 = V##_XOR (a3, t57); \
+      vec t59 = V##_OR (a2, t58); \
+      vec t60 = V##_OR (a5, t26); \
+      vec t61 = V##_ANDN (t1, a2); \
+      vec t62 = V##_XOR (t60, t61); \
+      vec t63 = V##_ANDN (t62, a4); \
+      vec t64 = V##_XOR (t59, t63); \
+      vec t65 = V##_AND (a6, t64); \
+      vec t66 = V##_XOR (t56, t65); \
+      o1 = V##_XOR (o1, t25); \
+      o2 = V##_XOR (o2, t40); \
+      o3 = V##_XOR (o3, t55); \
+      o4 = V##_XOR (o4, t66); \
+    } \
+  while (0)
+
+/* One round's S-boxes, from the 48 inputs in X, XORed into the 32 bits
+   in L through the P-box permutation.  */
+#define DES_BS_SBOXES(V, vec, x, l) \
+  DES_BS_S1 (V, vec, x[0], x[1], x[2], x[3], x[4], x[5], \
+             l[8], l[16], l[22], l[30]); \
+  DES_BS_S2 (V, vec, x[6], x[7], x[8], x[9], x[10], x[11], \
+             l[12], l[27], l[1], l[17]); \
+  DES_BS_S3 (V, vec, x[12], x[13], x[14], x[15], x[16], x[17], \
+             l[23], l[15], l[29], l[5]); \
+  DES_BS_S4 (V, vec, x[18], x[19], x[20], x[21], x[22], x[23], \
+             l[25], l[19], l[9], l[0]); \
+  DES_BS_S5 (V, vec, x[24], x[25], x[26], x[27], x[28], x[29], \
+             l[7], l[13], l[24], l[2]); \
+  DES_BS_S6 (V, vec, x[30], x[31], x[32], x[33], x[34], x[35], \
+             l[3], l[28], l[10], l[18]); \
+  DES_BS_S7 (V, vec, x[36], x[37], x[38], x[39], x[40], x[41], \
+             l[31], l[11], l[21], l[6]); \
+  DES_BS_S8 (V, vec, x[42], x[43], x[44], x[45], x[46], x[47], \
+             l[4], l[26], l[14], l[20])
+
+/* The bits of the key, counting from the most significant bit of its
+   first byte, that make up each bit of the key for each round.  */
+static const uint8_t des_bs_key_bits[16][48] =
+{
+  {  9, 50, 33, 59, 48, 16, 32, 56,  1,  8, 18, 41,
+     2, 34, 25, 24, 43, 57, 58,  0, 35, 26, 17, 40,
+    21, 27, 38, 53, 36,  3, 46, 29,  4, 52, 22, 28,
+    60, 20, 37, 62, 14, 19, 44, 13, 12, 61, 54, 30 },
+  {  1, 42, 25, 51, 40,  8, 24, 48, 58,  0, 10, 33,
+    59, 26, 17, 16, 35, 49, 50, 57, 56, 18,  9, 32,
+    13, 19, 30, 45, 28, 62, 38, 21, 27, 44, 14, 20,
+    52, 12, 29, 54,  6, 11, 36,  5,  4, 53, 46, 22 },
+  { 50, 26,  9, 35, 24, 57,  8, 32, 42, 49, 59, 17,
+    43, 10,  1,  0, 48, 33, 34, 41, 40,  2, 58, 16,
+    60,  3, 14, 29, 12, 46, 22,  5, 11, 28, 61,  4,
+    36, 27, 13, 38, 53, 62, 20, 52, 19, 37, 30,  6 },
+  { 34, 10, 58, 48,  8, 41, 57, 16, 26, 33, 43,  1,
+    56, 59, 50, 49, 32, 17, 18, 25, 24, 51, 42,  0,
+    44, 54, 61, 13, 27, 30,  6, 52, 62, 12, 45, 19,
+    20, 11, 60, 22, 37, 46,  4, 36,  3, 21, 14, 53 },
+  { 18, 59, 42, 32, 57, 25, 41,  0, 10, 17, 56, 50,
+    40, 43, 34, 33, 16,  1,  2,  9,  8, 35, 26, 49,
+    28, 38, 45, 60, 11, 14, 53, 36, 46, 27, 29,  3,
+     4, 62, 44,  6, 21, 30, 19, 20, 54,  5, 61, 37 },
+  {  2, 43, 26, 16, 41,  9, 25, 49, 59,  1, 40, 34,
+    24, 56, 18, 17,  0, 50, 51, 58, 57, 48, 10, 33,
+    12, 22, 29, 44, 62, 61, 37, 20, 30, 11, 13, 54,
+    19, 46, 28, 53,  5, 14,  3,  4, 38, 52, 45, 21 },
+  { 51, 56, 10,  0, 25, 58,  9, 33, 43, 50, 24, 18,
+     8, 40,  2,  1, 49, 34, 35, 42, 41, 32, 59, 17,
+    27,  6, 13, 28, 46, 45, 21,  4, 14, 62, 60, 38,
+     3, 30, 12, 37, 52, 61, 54, 19, 22, 36, 29,  5 },
+  { 35, 40, 59, 49,  9, 42, 58, 17, 56, 34,  8,  2,
+    57, 24, 51, 50, 33, 18, 48, 26, 25, 16, 43,  1,
+    11, 53, 60, 12, 30, 29,  5, 19, 61, 46, 44, 22,
+    54, 14, 27, 21, 36, 45, 38,  3,  6, 20, 13, 52 },
+  { 56, 32, 51, 41,  1, 34, 50,  9, 48, 26,  0, 59,
+    49, 16, 43, 42, 25, 10, 40, 18, 17,  8, 35, 58,
+     3, 45, 52,  4, 22, 21, 60, 11, 53, 38, 36, 14,
+    46,  6, 19, 13, 28, 37, 30, 62, 61, 12,  5, 44 },
+  { 40, 16, 35, 25, 50, 18, 34, 58, 32, 10, 49, 43,
+    33,  0, 56, 26,  9, 59, 24,  2,  1, 57, 48, 42,
+    54, 29, 36, 19,  6,  5, 44, 62, 37, 22, 20, 61,
+    30, 53,  3, 60, 12, 21, 14, 46, 45, 27, 52, 28 },
+  { 24,  0, 48,  9, 34,  2, 18, 42, 16, 59, 33, 56,
+    17, 49, 40, 10, 58, 43,  8, 51, 50, 41, 32, 26,
+    38, 13, 20,  3, 53, 52, 28, 46, 21,  6,  4, 45,
+    14, 37, 54, 44, 27,  5, 61, 30, 29, 11, 36, 12 },
+  {  8, 49, 32, 58, 18, 51,  2, 26,  0, 43, 17, 40,
+     1, 33, 24, 59, 42, 56, 57, 35, 34, 25, 16, 10,
+    22, 60,  4, 54, 37, 36, 12, 30,  5, 53, 19, 29,
+    61, 21, 38, 28, 11, 52, 45, 14, 13, 62, 20, 27 },
+  { 57, 33, 16, 42,  2, 35, 51, 10, 49, 56,  1, 24,
+    50, 17,  8, 43, 26, 40, 41, 48, 18,  9,  0, 59,
+     6, 44, 19, 38, 21, 20, 27, 14, 52, 37,  3, 13,
+    45,  5, 22, 12, 62, 36, 29, 61, 60, 46,  4, 11 },
+  { 41, 17,  0, 26, 51, 48, 35, 59, 33, 40, 50,  8,
+    34,  1, 57, 56, 10, 24, 25, 32,  2, 58, 49, 43,
+    53, 28,  3, 22,  5,  4, 11, 61, 36, 21, 54, 60,
+    29, 52,  6, 27, 46, 20, 13, 45, 44, 30, 19, 62 },
+  { 25,  1, 49, 10, 35, 32, 48, 43, 17, 24, 34, 57,
+    18, 50, 41, 40, 59,  8,  9, 16, 51, 42, 33, 56,
+    37, 12, 54,  6, 52, 19, 62, 45, 20,  5, 38, 44,
+    13, 36, 53, 11, 30,  4, 60, 29, 28, 14,  3, 46 },
+  { 17, 58, 41,  2, 56, 24, 40, 35,  9, 16, 26, 49,
+    10, 42, 33, 32, 51,  0,  1,  8, 43, 34, 25, 48,
+    29,  4, 46, 61, 44, 11, 54, 37, 12, 60, 30, 36,
+     5, 28, 45,  3, 22, 27, 52, 21, 20,  6, 62, 38 }
+};
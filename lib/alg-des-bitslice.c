@@ -0,0 +1,318 @@
+/* Bitsliced DES, for hashing many DES-based passwords at once.
+
+   Instead of encrypting one block at a time with table lookups, as
+   des_crypt_block does, each bit of the DES state is held in its own
+   machine word, bit N of which belongs to the Nth block.  Every step
+   of DES is then a fixed sequence of bitwise operations, the S-boxes
+   included, applied to as many blocks at once as a word has bits: 64
+   with plain integers, and 128, 256 or 512 with SSE2, AVX2 or AVX-512.
+   The permutations cost nothing; they only decide which word is used
+   where.  Each block has its own key and its own salt, and all of them
+   are encrypted the same number of times.
+
+   The S-box circuits and key schedule are in alg-des-bitslice-tables.h,
+   generated by gen-des-bitslice.c.
+
+   To the extent possible under law, the author(s) have waived all
+   copyright and related or neighboring rights to this work.
+
+   See https://creativecommons.org/publicdomain/zero/1.0/ for further
+   details.  */
+
+#include "crypt-port.h"
+#include "alg-des.h"
+
+#if INCLUDE_descrypt || INCLUDE_bsdicrypt || INCLUDE_bigcrypt
+
+#if defined __SSE2__ || defined HAVE_TARGET_AVX2 || defined HAVE_TARGET_AVX512F
+#include <immintrin.h>
+#endif
+
+#include "alg-des-bitslice-tables.h"
+
+/* The expansion permutation: which bit of R, counting from the most
+   significant, goes into each of the 48 S-box inputs.  */
+static const uint8_t des_bs_expansion[48] =
+{
+  31,  0,  1,  2,  3,  4,  3,  4,  5,  6,  7,  8,
+   7,  8,  9, 10, 11, 12, 11, 12, 13, 14, 15, 16,
+  15, 16, 17, 18, 19, 20, 19, 20, 21, 22, 23, 24,
+  23, 24, 25, 26, 27, 28, 27, 28, 29, 30, 31,  0
+};
+
+/* The final permutation: which bit of R16 L16 goes into each bit of
+   the ciphertext.  */
+static const uint8_t des_bs_final[64] =
+{
+  39,  7, 47, 15, 55, 23, 63, 31, 38,  6, 46, 14, 54, 22, 62, 30,
+  37,  5, 45, 13, 53, 21, 61, 29, 36,  4, 44, 12, 52, 20, 60, 28,
+  35,  3, 43, 11, 51, 19, 59, 27, 34,  2, 42, 10, 50, 18, 58, 26,
+  33,  1, 41,  9, 49, 17, 57, 25, 32,  0, 40,  8, 48, 16, 56, 24
+};
+
+/* Transpose the 64x64 bit matrix in M, whose rows are its words and
+   whose columns count from the most significant bit.  */
+static void
+des_bs_transpose (uint64_t m[64])
+{
+  uint64_t mask = 0x00000000ffffffffULL, t;
+  unsigned int j, k;
+
+  for (j = 32; j != 0; j >>= 1, mask ^= mask << j)
+    for (k = 0; k < 64; k = ((k | j) + 1) & ~j)
+      {
+        t = (m[k] ^ (m[k | j] >> j)) & mask;
+        m[k] ^= t;
+        m[k | j] ^= t << j;
+      }
+}
+
+void
+des_bs_load (struct des_bs_ctx *restrict ctx, size_t group,
+             uint64_t keys[64], uint64_t salts[64])
+{
+  unsigned int i;
+
+  des_bs_transpose (keys);
+  for (i = 0; i < 64; i++)
+    ctx->keys[i][group] = keys[i];
+  des_bs_transpose (salts);
+  for (i = 0; i < 24; i++)
+    ctx->salts[i][group] = salts[i];
+}
+
+void
+des_bs_store (const struct des_bs_ctx *restrict ctx, size_t group,
+              uint64_t blocks[64])
+{
+  unsigned int i;
+
+  for (i = 0; i < 64; i++)
+    blocks[i] = ctx->blocks[i][group];
+  des_bs_transpose (blocks);
+}
+
+/* Encrypt the blocks of groups GROUP onward, one vector's worth, as
+   described for des_bs_crypt_zero.  MIXED has bit I set if any of them
+   has bit I of its salt set; the expansion only needs to look at those
+   bits of the salt.  */
+typedef void des_bs_kernel_fn (struct des_bs_ctx *restrict ctx,
+                               size_t group, uint32_t count, uint32_t mixed);
+
+/* The body of a kernel, parameterized by the prefix V of a set of
+   macros implementing the elementary operations on values of type
+   vec.  */
+#define DES_BS_KERNEL_BODY(V, vec)                                      \
+  vec lr[64], x[48], *l = lr, *r = lr + 32, *t;                         \
+  unsigned int i, round;                                                \
+                                                                        \
+  for (i = 0; i < 64; i++)                                              \
+    lr[i] = V##_ZERO;                                                   \
+                                                                        \
+  while (count--)                                                       \
+    {                                                                   \
+      for (round = 0; round < 16; round++)                              \
+        {                                                               \
+          const uint8_t *kb = des_bs_key_bits[round];                   \
+                                                                        \
+          /* Expand R, swapping the bits that the salt says to swap,    \
+             and add the round key.  */                                 \
+          for (i = 0; i < 24; i++)                                      \
+            {                                                           \
+              vec a = r[des_bs_expansion[i]];                           \
+              vec b = r[des_bs_expansion[i + 24]];                      \
+              if (mixed & (1u << i))                                    \
+                {                                                       \
+                  vec s = V##_AND (V##_XOR (a, b),                      \
+                                   V##_LOAD (&ctx->salts[i][group]));   \
+                  a = V##_XOR (a, s);                                   \
+                  b = V##_XOR (b, s);                                   \
+                }                                                       \
+              x[i] = V##_XOR (a, V##_LOAD (&ctx->keys[kb[i]][group]));  \
+              x[i + 24] =                                               \
+                V##_XOR (b, V##_LOAD (&ctx->keys[kb[i + 24]][group]));  \
+            }                                                           \
+                                                                        \
+          DES_BS_SBOXES (V, vec, x, l);                                 \
+          t = l;                                                        \
+          l = r;                                                        \
+          r = t;                                                        \
+        }                                                               \
+                                                                        \
+      /* Undo the last swap: the next encryption starts from R16 L16,   \
+         the initial and final permutations cancelling out.  */         \
+      t = l;                                                            \
+      l = r;                                                            \
+      r = t;                                                            \
+    }                                                                   \
+                                                                        \
+  for (i = 0; i < 64; i++)                                              \
+    {                                                                   \
+      unsigned int b = des_bs_final[i];                                 \
+      V##_STORE (&ctx->blocks[i][group], b < 32 ? l[b] : r[b - 32]);    \
+    }
+
+#define V1_ZERO          0
+#define V1_LOAD(p)       (*(p))
+#define V1_STORE(p, x)   (*(p) = (x))
+#define V1_AND(x, y)     ((x) & (y))
+#define V1_ANDN(x, y)    ((x) & ~(y))
+#define V1_OR(x, y)      ((x) | (y))
+#define V1_XOR(x, y)     ((x) ^ (y))
+#define V1_NOT(x)        (~(x))
+#define V1_SEL(x, y, z)  ((x) ^ ((z) & ((x) ^ (y))))
+
+/* 64 blocks at a time, in integer registers.  */
+static void
+des_bs_kernel_64 (struct des_bs_ctx *restrict ctx, size_t group,
+                  uint32_t count, uint32_t mixed)
+{
+  DES_BS_KERNEL_BODY (V1, uint64_t)
+}
+
+#ifdef __SSE2__
+#define V2_ZERO          _mm_setzero_si128 ()
+#define V2_LOAD(p)       _mm_loadu_si128 ((const __m128i *) (const void *) (p))
+#define V2_STORE(p, x)   _mm_storeu_si128 ((__m128i *) (void *) (p), x)
+#define V2_AND(x, y)     _mm_and_si128 (x, y)
+#define V2_ANDN(x, y)    _mm_andnot_si128 (y, x)
+#define V2_OR(x, y)      _mm_or_si128 (x, y)
+#define V2_XOR(x, y)     _mm_xor_si128 (x, y)
+#define V2_NOT(x)        _mm_xor_si128 (x, _mm_set1_epi32 (-1))
+#define V2_SEL(x, y, z)  V2_XOR (x, V2_AND (z, V2_XOR (x, y)))
+
+/* 128 blocks at a time, using SSE2.  */
+static void
+des_bs_kernel_128 (struct des_bs_ctx *restrict ctx, size_t group,
+                   uint32_t count, uint32_t mixed)
+{
+  DES_BS_KERNEL_BODY (V2, __m128i)
+}
+#endif
+
+#ifdef HAVE_TARGET_AVX2
+#define V4_ZERO          _mm256_setzero_si256 ()
+#define V4_LOAD(p)       _mm256_loadu_si256 ((const __m256i *) (const void *) (p))
+#define V4_STORE(p, x)   _mm256_storeu_si256 ((__m256i *) (void *) (p), x)
+#define V4_AND(x, y)     _mm256_and_si256 (x, y)
+#define V4_ANDN(x, y)    _mm256_andnot_si256 (y, x)
+#define V4_OR(x, y)      _mm256_or_si256 (x, y)
+#define V4_XOR(x, y)     _mm256_xor_si256 (x, y)
+#define V4_NOT(x)        _mm256_xor_si256 (x, _mm256_set1_epi32 (-1))
+#define V4_SEL(x, y, z)  V4_XOR (x, V4_AND (z, V4_XOR (x, y)))
+
+/* 256 blocks at a time, using AVX2.  */
+__attribute__((target("avx2")))
+static void
+des_bs_kernel_256 (struct des_bs_ctx *restrict ctx, size_t group,
+                   uint32_t count, uint32_t mixed)
+{
+  DES_BS_KERNEL_BODY (V4, __m256i)
+}
+#endif
+
+#ifdef HAVE_TARGET_AVX512F
+#define V8_ZERO          _mm512_setzero_si512 ()
+#define V8_LOAD(p)       _mm512_loadu_si512 ((const void *) (p))
+#define V8_STORE(p, x)   _mm512_storeu_si512 ((void *) (p), x)
+#define V8_AND(x, y)     _mm512_and_si512 (x, y)
+#define V8_ANDN(x, y)    _mm512_andnot_si512 (y, x)
+#define V8_OR(x, y)      _mm512_or_si512 (x, y)
+#define V8_XOR(x, y)     _mm512_xor_si512 (x, y)
+#define V8_NOT(x)        _mm512_ternarylogic_epi64 (x, x, x, 0x55)
+#define V8_SEL(x, y, z)  _mm512_ternarylogic_epi64 (z, y, x, 0xca)
+
+/* 512 blocks at a time, using AVX-512, which can also select bits in
+   one instruction.  */
+__attribute__((target("avx512f")))
+static void
+des_bs_kernel_512 (struct des_bs_ctx *restrict ctx, size_t group,
+                   uint32_t count, uint32_t mixed)
+{
+  DES_BS_KERNEL_BODY (V8, __m512i)
+}
+#endif
+
+/* Pick the narrowest kernel the CPU supports that covers NGROUPS
+   groups of blocks in one call, or the widest one if none does.
+   Return the number of groups it covers.  */
+static size_t
+des_bs_select (size_t ngroups, des_bs_kernel_fn **kernel)
+{
+  uint32_t features = get_cpu_features ();
+  size_t groups = 0;
+
+  (void) features;
+#ifdef HAVE_TARGET_AVX512F
+  if (features & CPU_FEATURE_AVX512F)
+    {
+      *kernel = des_bs_kernel_512;
+      groups = 8;
+    }
+#endif
+#ifdef HAVE_TARGET_AVX2
+  if ((features & CPU_FEATURE_AVX2) && (groups == 0 || ngroups <= 4))
+    {
+      *kernel = des_bs_kernel_256;
+      groups = 4;
+    }
+#endif
+#ifdef __SSE2__
+  if (groups == 0 || ngroups <= 2)
+    {
+      *kernel = des_bs_kernel_128;
+      groups = 2;
+    }
+#endif
+  if (groups == 0 || ngroups <= 1)
+    {
+      *kernel = des_bs_kernel_64;
+      groups = 1;
+    }
+  return groups;
+}
+
+size_t
+des_bs_lanes (void)
+{
+  des_bs_kernel_fn *kernel;
+  return 64 * des_bs_select (DES_BS_GROUPS, &kernel);
+}
+
+void
+des_bs_crypt_zero (struct des_bs_ctx *restrict ctx, size_t ngroups,
+                   uint32_t count)
+{
+  des_bs_kernel_fn *kernel;
+  size_t groups = des_bs_select (ngroups, &kernel);
+  size_t g, i;
+
+  /* Zero encryptions don't make sense, as for des_crypt_block.  */
+  if (count == 0)
+    count = 1;
+
+  /* The last call may cover groups that were not loaded; give them
+     keys and salts, so that they compute something harmless.  */
+  for (g = ngroups; g % groups != 0; g++)
+    {
+      for (i = 0; i < 64; i++)
+        ctx->keys[i][g] = 0;
+      for (i = 0; i < 24; i++)
+        ctx->salts[i][g] = 0;
+    }
+
+  for (g = 0; g < ngroups; g += groups)
+    {
+      uint32_t mixed = 0;
+      for (i = 0; i < 24; i++)
+        {
+          size_t j;
+          for (j = g; j < g + groups; j++)
+            if (ctx->salts[i][j])
+              mixed |= 1u << i;
+        }
+      kernel (ctx, g, count, mixed);
+    }
+}
+
+#endif
@@ -63,6 +63,44 @@ extern void des_crypt_block (struct des_ctx *restrict ctx,
                              unsigned char *out, const unsigned char *in,
                              unsigned int count, bool decrypt);
 
+/* des-bitslice.c */
+
+/* The most blocks des_bs_crypt_zero encrypts at once.  They are loaded
+   and stored in groups of 64.  */
+#define DES_BS_LANES_MAX 512
+#define DES_BS_GROUPS (DES_BS_LANES_MAX / 64)
+
+/* Each row has one bit from each block, the first group of 64 blocks
+   in its first word, and so on.  */
+struct des_bs_ctx
+{
+  uint64_t keys[64][DES_BS_GROUPS];
+  uint64_t salts[24][DES_BS_GROUPS];
+  uint64_t blocks[64][DES_BS_GROUPS];
+};
+
+/* Load the keys and salts of group GROUP of blocks.  KEYS[I] is the key
+   for its Ith block, with the first byte that des_set_key would take
+   as its most significant byte.  SALTS[I] has bit 63 - J set if that
+   block's salt, as des_set_salt would take it, has bit J set.  Both
+   arrays are overwritten.  */
+extern void des_bs_load (struct des_bs_ctx *restrict ctx, size_t group,
+                         uint64_t keys[64], uint64_t salts[64]);
+
+/* Encrypt a block of zeroes COUNT times with the key and salt of each
+   block in the first NGROUPS groups, as des_crypt_block would.  */
+extern void des_bs_crypt_zero (struct des_bs_ctx *restrict ctx,
+                               size_t ngroups, uint32_t count);
+
+/* Retrieve the ciphertexts of group GROUP, in the same form as
+   des_bs_load takes the keys.  */
+extern void des_bs_store (const struct des_bs_ctx *restrict ctx,
+                          size_t group, uint64_t blocks[64]);
+
+/* Return the number of blocks des_bs_crypt_zero encrypts at once, at
+   most, on this CPU.  */
+extern size_t des_bs_lanes (void);
+
 /* des-tables.c (generated by des-mktables) */
 extern const uint8_t m_sbox[4][4096];
 extern const uint32_t ip_maskl[8][256], ip_maskr[8][256];
@@ -26,38 +26,30 @@
     z->QWORD[7] = x->QWORD[7] ^ y->QWORD[7]; \
 }
 
-#ifndef __GOST3411_BIG_ENDIAN__
-#define __XLPS_FOR for (_i = 0; _i <= 7; _i++)
-#define _datai _i
-#else
-#define __XLPS_FOR for (_i = 7; _i >= 0; _i--)
-#define _datai 7 - _i
-#endif
-
+/*
+ * Byte i of every output word comes from byte i of each input word.  The
+ * input is XORed into a byte array and the table indices are loaded from it
+ * directly, which is cheaper than shifting and masking a word for each of
+ * the 64 lookups.  Byte i in memory is the one the tables for this byte
+ * order expect, so the same code works for both.
+ */
 #define XLPS(x, y, data) { \
-    register unsigned long long r0, r1, r2, r3, r4, r5, r6, r7; \
+    union { unsigned long long q[8]; unsigned char b[64]; } _r; \
     int _i; \
     \
-    r0 = x->QWORD[0] ^ y->QWORD[0]; \
-    r1 = x->QWORD[1] ^ y->QWORD[1]; \
-    r2 = x->QWORD[2] ^ y->QWORD[2]; \
-    r3 = x->QWORD[3] ^ y->QWORD[3]; \
-    r4 = x->QWORD[4] ^ y->QWORD[4]; \
-    r5 = x->QWORD[5] ^ y->QWORD[5]; \
-    r6 = x->QWORD[6] ^ y->QWORD[6]; \
-    r7 = x->QWORD[7] ^ y->QWORD[7]; \
-    \
+    for (_i = 0; _i < 8; _i++) \
+        _r.q[_i] = x->QWORD[_i] ^ y->QWORD[_i]; \
     \
-    __XLPS_FOR \
+    for (_i = 0; _i < 8; _i++) \
     {\
-        data->QWORD[_datai]  = Ax[0][(r0 >> (_i << 3)) & 0xFF]; \
-        data->QWORD[_datai] ^= Ax[1][(r1 >> (_i << 3)) & 0xFF]; \
-        data->QWORD[_datai] ^= Ax[2][(r2 >> (_i << 3)) & 0xFF]; \
-        data->QWORD[_datai] ^= Ax[3][(r3 >> (_i << 3)) & 0xFF]; \
-        data->QWORD[_datai] ^= Ax[4][(r4 >> (_i << 3)) & 0xFF]; \
-        data->QWORD[_datai] ^= Ax[5][(r5 >> (_i << 3)) & 0xFF]; \
-        data->QWORD[_datai] ^= Ax[6][(r6 >> (_i << 3)) & 0xFF]; \
-        data->QWORD[_datai] ^= Ax[7][(r7 >> (_i << 3)) & 0xFF]; \
+        data->QWORD[_i]  = Ax[0][_r.b[_i]]; \
+        data->QWORD[_i] ^= Ax[1][_r.b[_i + 8]]; \
+        data->QWORD[_i] ^= Ax[2][_r.b[_i + 16]]; \
+        data->QWORD[_i] ^= Ax[3][_r.b[_i + 24]]; \
+        data->QWORD[_i] ^= Ax[4][_r.b[_i + 32]]; \
+        data->QWORD[_i] ^= Ax[5][_r.b[_i + 40]]; \
+        data->QWORD[_i] ^= Ax[6][_r.b[_i + 48]]; \
+        data->QWORD[_i] ^= Ax[7][_r.b[_i + 56]]; \
     }\
 }
 
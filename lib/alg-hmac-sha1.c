@@ -34,6 +34,7 @@
 #include "crypt-port.h"
 #include "alg-hmac-sha1.h"
 #include "alg-sha1.h"
+#include "byteorder.h"
 
 #include <stdlib.h>
 
@@ -56,11 +57,9 @@
  * XOR with the key.
  */
 void
-hmac_sha1_process_data (const uint8_t *text, size_t text_len,
-                        const uint8_t *key, size_t key_len,
-                        void *resbuf)
+hmac_sha1_init_ctx (struct hmac_sha1_ctx *ctx,
+                    const uint8_t *key, size_t key_len)
 {
-  struct sha1_ctx ctx;
   /* Inner padding key XOR'd with ipad */
   uint8_t k_ipad[HMAC_BLOCKSZ];
   /* Outer padding key XOR'd with opad */
@@ -111,30 +110,93 @@ hmac_sha1_process_data (const uint8_t *text, size_t text_len,
   explicit_bzero (tk, HASH_LENGTH);
 
   /*
-   * Perform inner HASH.
-   * Start with inner pad,
-   * then the text.
+   * The pads are exactly one block each, so hashing them leaves
+   * nothing buffered: just the intermediate hash values to start
+   * every inner and outer hash from.
    */
-  sha1_init_ctx (&ctx);
-  sha1_process_bytes (k_ipad, &ctx, HMAC_BLOCKSZ);
-  sha1_process_bytes (text, &ctx, text_len);
-  sha1_finish_ctx(&ctx, resbuf);
+  sha1_init_ctx (&ctx->inner);
+  sha1_process_bytes (k_ipad, &ctx->inner, HMAC_BLOCKSZ);
+  sha1_init_ctx (&ctx->outer);
+  sha1_process_bytes (k_opad, &ctx->outer, HMAC_BLOCKSZ);
 
   /* Clean the stack. */
   explicit_bzero (k_ipad, HMAC_BLOCKSZ);
+  explicit_bzero (k_opad, HMAC_BLOCKSZ);
+}
+
+/*
+ * Finish a hash that started from MIDSTATE, the state after one
+ * padded key block, and continues with the HASH_LENGTH bytes at
+ * TEXT.  That is always the case for the outer hash, and for the
+ * inner hash of every iteration of PBKDF1 after the first.  The
+ * text and its padding fit in a single block, which is built
+ * directly instead of going through sha1_process_bytes and
+ * sha1_finish_ctx.
+ */
+static void
+finish_short (const uint32_t midstate[5], const uint8_t *text,
+              uint8_t *resbuf)
+{
+  uint8_t block[HMAC_BLOCKSZ];
+  uint32_t state[5];
+  size_t i;
+
+  memcpy (block, text, HASH_LENGTH);
+  block[HASH_LENGTH] = 0x80;
+  memset (block + HASH_LENGTH + 1, 0, HMAC_BLOCKSZ - HASH_LENGTH - 1 - 8);
+  /* Length in bits of the key block and the text.  */
+  cpu_to_be64 (block + HMAC_BLOCKSZ - 8,
+               (uint64_t) (HMAC_BLOCKSZ + HASH_LENGTH) * 8);
+
+  memcpy (state, midstate, sizeof state);
+  sha1_process_block (state, block);
+  for (i = 0; i < 5; i++)
+    cpu_to_be32 (resbuf + 4 * i, state[i]);
+
+  /* Clean the stack. */
+  explicit_bzero (block, sizeof block);
+  explicit_bzero (state, sizeof state);
+}
+
+void
+hmac_sha1_process_ctx (const struct hmac_sha1_ctx *ctx,
+                       const uint8_t *text, size_t text_len,
+                       void *resbuf)
+{
+  /*
+   * Perform inner HASH.
+   * Start with inner pad,
+   * then the text.
+   */
+  if (text_len == HASH_LENGTH)
+    finish_short (ctx->inner.state, text, resbuf);
+  else
+    {
+      struct sha1_ctx ictx = ctx->inner;
+      sha1_process_bytes (text, &ictx, text_len);
+      sha1_finish_ctx (&ictx, resbuf);
+    }
 
   /*
    * Perform outer HASH.
    * Start with the outer pad,
    * then the result of the inner hash.
    */
-  sha1_init_ctx (&ctx);
-  sha1_process_bytes (k_opad, &ctx, HMAC_BLOCKSZ);
-  sha1_process_bytes (resbuf, &ctx, HASH_LENGTH);
-  sha1_finish_ctx(&ctx, resbuf);
+  finish_short (ctx->outer.state, resbuf, resbuf);
+}
+
+void
+hmac_sha1_process_data (const uint8_t *text, size_t text_len,
+                        const uint8_t *key, size_t key_len,
+                        void *resbuf)
+{
+  struct hmac_sha1_ctx ctx;
+
+  hmac_sha1_init_ctx (&ctx, key, key_len);
+  hmac_sha1_process_ctx (&ctx, text, text_len, resbuf);
 
   /* Clean the stack. */
-  explicit_bzero (k_opad, HMAC_BLOCKSZ);
+  explicit_bzero (&ctx, sizeof ctx);
 }
 
 #endif
@@ -26,6 +26,35 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#ifndef _CRYPT_ALG_HMAC_SHA1_H
+#define _CRYPT_ALG_HMAC_SHA1_H 1
+
+#include "alg-sha1.h"
+
+/* The state of SHA-1 after the inner and outer padded keys have been
+   hashed.  Every HMAC with the same key starts from these, so a caller
+   that computes many of them, like the PBKDF1 loop of sha1crypt, can
+   set them up once and save two compressions per HMAC.  */
+struct hmac_sha1_ctx
+{
+  struct sha1_ctx inner;
+  struct sha1_ctx outer;
+};
+
+/* Set up CTX for computing HMACs with KEY.  */
+extern void
+hmac_sha1_init_ctx (struct hmac_sha1_ctx *ctx,
+                    const uint8_t *key, size_t key_len);
+
+/* Generate the HMAC of TEXT with the key CTX was set up with, and
+   write it into RESBUF, which should point to 20 bytes of storage.
+   RESBUF may be the same as TEXT.  CTX is not changed, and must be
+   erased by the caller when it is no longer needed.  */
+extern void
+hmac_sha1_process_ctx (const struct hmac_sha1_ctx *ctx,
+                       const uint8_t *text, size_t text_len,
+                       void *resbuf);
+
 /* Generate the keyed-hash message authentication code of TEXT and KEY.
    The resulting HMAC is written into RESBUF, which should point to 20
    bytes of storage.  */
@@ -33,3 +62,5 @@ extern void
 hmac_sha1_process_data (const uint8_t *text, size_t text_len,
                         const uint8_t *key, size_t key_len,
                         void *resbuf);
+
+#endif
@@ -40,6 +40,12 @@
 #if INCLUDE_md5crypt || INCLUDE_sunmd5
 
 #include "alg-md5.h"
+#include "byteorder.h"
+
+#if defined(__SSE2__) || defined(HAVE_TARGET_AVX2) || \
+    defined(HAVE_TARGET_AVX512F)
+#include <immintrin.h>
+#endif
 
 /*
  * The basic MD5 functions.
@@ -288,4 +294,449 @@ void MD5_Final(uint8_t result[16], MD5_CTX *ctx)
 	explicit_bzero(ctx, sizeof(*ctx));
 }
 
+/*
+ * Multi-buffer MD5: the same transformation as body(), applied to one block
+ * of each of several independent messages at once, one message per lane of
+ * a vector register.  Lanes whose message has no block in this call are
+ * masked out of the state update.
+ */
+typedef uint32_t MD5_MB_WORDS[MD5_MB_LANES];
+
+typedef void MD5_MB_Transform_fn(MD5_MB_WORDS state[4],
+    const uint8_t block[][64], const MD5_MB_WORDS mask);
+
+#if defined(__SSE2__) || defined(HAVE_TARGET_AVX2) || \
+    defined(HAVE_TARGET_AVX512F)
+/*
+ * The SIMD implementations only exist for little-endian CPUs, so the
+ * words of a block can be loaded as they are.
+ */
+static inline int32_t MB_Word(const uint8_t *p)
+{
+	int32_t w;
+
+	memcpy(&w, p, sizeof(w));
+	return w;
+}
+
+#define MB_STEP(V, f, a, b, c, d, x, t, s) \
+	(a) = V##_ADD(V##_ADD((a), V##_##f((b), (c), (d))), \
+	    V##_ADD(W[x], V##_SET1(t))); \
+	(a) = V##_ADD(V##_ROTL((a), s), (b));
+
+#define MB_TRANSFORM_BODY(V, vec) \
+	vec a, b, c, d, W[16]; \
+	int i; \
+\
+	for (i = 0; i < 16; i++) \
+		W[i] = V##_GATHER(block, i); \
+	a = V##_LOAD(state[0]); \
+	b = V##_LOAD(state[1]); \
+	c = V##_LOAD(state[2]); \
+	d = V##_LOAD(state[3]); \
+\
+	MB_STEP(V, F, a, b, c, d, 0, 0xd76aa478, 7) \
+	MB_STEP(V, F, d, a, b, c, 1, 0xe8c7b756, 12) \
+	MB_STEP(V, F, c, d, a, b, 2, 0x242070db, 17) \
+	MB_STEP(V, F, b, c, d, a, 3, 0xc1bdceee, 22) \
+	MB_STEP(V, F, a, b, c, d, 4, 0xf57c0faf, 7) \
+	MB_STEP(V, F, d, a, b, c, 5, 0x4787c62a, 12) \
+	MB_STEP(V, F, c, d, a, b, 6, 0xa8304613, 17) \
+	MB_STEP(V, F, b, c, d, a, 7, 0xfd469501, 22) \
+	MB_STEP(V, F, a, b, c, d, 8, 0x698098d8, 7) \
+	MB_STEP(V, F, d, a, b, c, 9, 0x8b44f7af, 12) \
+	MB_STEP(V, F, c, d, a, b, 10, 0xffff5bb1, 17) \
+	MB_STEP(V, F, b, c, d, a, 11, 0x895cd7be, 22) \
+	MB_STEP(V, F, a, b, c, d, 12, 0x6b901122, 7) \
+	MB_STEP(V, F, d, a, b, c, 13, 0xfd987193, 12) \
+	MB_STEP(V, F, c, d, a, b, 14, 0xa679438e, 17) \
+	MB_STEP(V, F, b, c, d, a, 15, 0x49b40821, 22) \
+\
+	MB_STEP(V, G, a, b, c, d, 1, 0xf61e2562, 5) \
+	MB_STEP(V, G, d, a, b, c, 6, 0xc040b340, 9) \
+	MB_STEP(V, G, c, d, a, b, 11, 0x265e5a51, 14) \
+	MB_STEP(V, G, b, c, d, a, 0, 0xe9b6c7aa, 20) \
+	MB_STEP(V, G, a, b, c, d, 5, 0xd62f105d, 5) \
+	MB_STEP(V, G, d, a, b, c, 10, 0x02441453, 9) \
+	MB_STEP(V, G, c, d, a, b, 15, 0xd8a1e681, 14) \
+	MB_STEP(V, G, b, c, d, a, 4, 0xe7d3fbc8, 20) \
+	MB_STEP(V, G, a, b, c, d, 9, 0x21e1cde6, 5) \
+	MB_STEP(V, G, d, a, b, c, 14, 0xc33707d6, 9) \
+	MB_STEP(V, G, c, d, a, b, 3, 0xf4d50d87, 14) \
+	MB_STEP(V, G, b, c, d, a, 8, 0x455a14ed, 20) \
+	MB_STEP(V, G, a, b, c, d, 13, 0xa9e3e905, 5) \
+	MB_STEP(V, G, d, a, b, c, 2, 0xfcefa3f8, 9) \
+	MB_STEP(V, G, c, d, a, b, 7, 0x676f02d9, 14) \
+	MB_STEP(V, G, b, c, d, a, 12, 0x8d2a4c8a, 20) \
+\
+	MB_STEP(V, H, a, b, c, d, 5, 0xfffa3942, 4) \
+	MB_STEP(V, H, d, a, b, c, 8, 0x8771f681, 11) \
+	MB_STEP(V, H, c, d, a, b, 11, 0x6d9d6122, 16) \
+	MB_STEP(V, H, b, c, d, a, 14, 0xfde5380c, 23) \
+	MB_STEP(V, H, a, b, c, d, 1, 0xa4beea44, 4) \
+	MB_STEP(V, H, d, a, b, c, 4, 0x4bdecfa9, 11) \
+	MB_STEP(V, H, c, d, a, b, 7, 0xf6bb4b60, 16) \
+	MB_STEP(V, H, b, c, d, a, 10, 0xbebfbc70, 23) \
+	MB_STEP(V, H, a, b, c, d, 13, 0x289b7ec6, 4) \
+	MB_STEP(V, H, d, a, b, c, 0, 0xeaa127fa, 11) \
+	MB_STEP(V, H, c, d, a, b, 3, 0xd4ef3085, 16) \
+	MB_STEP(V, H, b, c, d, a, 6, 0x04881d05, 23) \
+	MB_STEP(V, H, a, b, c, d, 9, 0xd9d4d039, 4) \
+	MB_STEP(V, H, d, a, b, c, 12, 0xe6db99e5, 11) \
+	MB_STEP(V, H, c, d, a, b, 15, 0x1fa27cf8, 16) \
+	MB_STEP(V, H, b, c, d, a, 2, 0xc4ac5665, 23) \
+\
+	MB_STEP(V, I, a, b, c, d, 0, 0xf4292244, 6) \
+	MB_STEP(V, I, d, a, b, c, 7, 0x432aff97, 10) \
+	MB_STEP(V, I, c, d, a, b, 14, 0xab9423a7, 15) \
+	MB_STEP(V, I, b, c, d, a, 5, 0xfc93a039, 21) \
+	MB_STEP(V, I, a, b, c, d, 12, 0x655b59c3, 6) \
+	MB_STEP(V, I, d, a, b, c, 3, 0x8f0ccc92, 10) \
+	MB_STEP(V, I, c, d, a, b, 10, 0xffeff47d, 15) \
+	MB_STEP(V, I, b, c, d, a, 1, 0x85845dd1, 21) \
+	MB_STEP(V, I, a, b, c, d, 8, 0x6fa87e4f, 6) \
+	MB_STEP(V, I, d, a, b, c, 15, 0xfe2ce6e0, 10) \
+	MB_STEP(V, I, c, d, a, b, 6, 0xa3014314, 15) \
+	MB_STEP(V, I, b, c, d, a, 13, 0x4e0811a1, 21) \
+	MB_STEP(V, I, a, b, c, d, 4, 0xf7537e82, 6) \
+	MB_STEP(V, I, d, a, b, c, 11, 0xbd3af235, 10) \
+	MB_STEP(V, I, c, d, a, b, 2, 0x2ad7d2bb, 15) \
+	MB_STEP(V, I, b, c, d, a, 9, 0xeb86d391, 21) \
+\
+	V##_STORE(state[0], V##_ADD(V##_LOAD(state[0]), \
+	    V##_AND(a, V##_LOAD(mask)))); \
+	V##_STORE(state[1], V##_ADD(V##_LOAD(state[1]), \
+	    V##_AND(b, V##_LOAD(mask)))); \
+	V##_STORE(state[2], V##_ADD(V##_LOAD(state[2]), \
+	    V##_AND(c, V##_LOAD(mask)))); \
+	V##_STORE(state[3], V##_ADD(V##_LOAD(state[3]), \
+	    V##_AND(d, V##_LOAD(mask))));
+#endif
+
+#ifdef __SSE2__
+#define V2_LOAD(p)	_mm_loadu_si128((const __m128i *)(const void *)(p))
+#define V2_STORE(p, x)	_mm_storeu_si128((__m128i *)(void *)(p), x)
+#define V2_GATHER(p, i) \
+	_mm_set_epi32(MB_Word(&(p)[3][4 * (i)]), MB_Word(&(p)[2][4 * (i)]), \
+	    MB_Word(&(p)[1][4 * (i)]), MB_Word(&(p)[0][4 * (i)]))
+#define V2_SET1(k)	_mm_set1_epi32((int)(k))
+#define V2_ADD(x, y)	_mm_add_epi32(x, y)
+#define V2_AND(x, y)	_mm_and_si128(x, y)
+#define V2_XOR(x, y)	_mm_xor_si128(x, y)
+#define V2_ROTL(x, n)	_mm_or_si128(_mm_slli_epi32(x, n), \
+	_mm_srli_epi32(x, 32 - (n)))
+#define V2_F(x, y, z)	V2_XOR(z, V2_AND(x, V2_XOR(y, z)))
+#define V2_G(x, y, z)	V2_XOR(y, V2_AND(z, V2_XOR(x, y)))
+#define V2_H(x, y, z)	V2_XOR(V2_XOR(x, y), z)
+#define V2_I(x, y, z)	V2_XOR(y, _mm_or_si128(x, \
+	_mm_xor_si128(z, _mm_set1_epi32(-1))))
+
+static void
+MD5_MB_Transform_sse2(MD5_MB_WORDS state[4],
+    const uint8_t block[][64], const MD5_MB_WORDS mask)
+{
+	MB_TRANSFORM_BODY(V2, __m128i)
+}
+#endif
+
+#ifdef HAVE_TARGET_AVX2
+#define V4_LOAD(p)	_mm256_loadu_si256((const __m256i *)(const void *)(p))
+#define V4_STORE(p, x)	_mm256_storeu_si256((__m256i *)(void *)(p), x)
+#define V4_GATHER(p, i) \
+	_mm256_i32gather_epi32((const int *)(const void *)&(p)[0][4 * (i)], \
+	    _mm256_setr_epi32(0, 16, 32, 48, 64, 80, 96, 112), 4)
+#define V4_SET1(k)	_mm256_set1_epi32((int)(k))
+#define V4_ADD(x, y)	_mm256_add_epi32(x, y)
+#define V4_AND(x, y)	_mm256_and_si256(x, y)
+#define V4_XOR(x, y)	_mm256_xor_si256(x, y)
+#define V4_ROTL(x, n)	_mm256_or_si256(_mm256_slli_epi32(x, n), \
+	_mm256_srli_epi32(x, 32 - (n)))
+#define V4_F(x, y, z)	V4_XOR(z, V4_AND(x, V4_XOR(y, z)))
+#define V4_G(x, y, z)	V4_XOR(y, V4_AND(z, V4_XOR(x, y)))
+#define V4_H(x, y, z)	V4_XOR(V4_XOR(x, y), z)
+#define V4_I(x, y, z)	V4_XOR(y, _mm256_or_si256(x, \
+	_mm256_xor_si256(z, _mm256_set1_epi32(-1))))
+
+__attribute__((target("avx2")))
+static void
+MD5_MB_Transform_avx2(MD5_MB_WORDS state[4],
+    const uint8_t block[][64], const MD5_MB_WORDS mask)
+{
+	MB_TRANSFORM_BODY(V4, __m256i)
+}
+#endif
+
+#ifdef HAVE_TARGET_AVX512F
+#define V8_LOAD(p)	_mm512_loadu_si512((const void *)(p))
+#define V8_STORE(p, x)	_mm512_storeu_si512((void *)(p), x)
+#define V8_GATHER(p, i) \
+	_mm512_i32gather_epi32(_mm512_setr_epi32(0, 16, 32, 48, 64, 80, 96, \
+	    112, 128, 144, 160, 176, 192, 208, 224, 240), \
+	    (const void *)&(p)[0][4 * (i)], 4)
+#define V8_SET1(k)	_mm512_set1_epi32((int)(k))
+#define V8_ADD(x, y)	_mm512_add_epi32(x, y)
+#define V8_AND(x, y)	_mm512_and_si512(x, y)
+#define V8_ROTL(x, n)	_mm512_rol_epi32(x, n)
+#define V8_F(x, y, z)	_mm512_ternarylogic_epi32(x, y, z, 0xca)
+#define V8_G(x, y, z)	_mm512_ternarylogic_epi32(z, x, y, 0xca)
+#define V8_H(x, y, z)	_mm512_ternarylogic_epi32(x, y, z, 0x96)
+#define V8_I(x, y, z)	_mm512_ternarylogic_epi32(x, y, z, 0x39)
+
+__attribute__((target("avx512f")))
+static void
+MD5_MB_Transform_avx512(MD5_MB_WORDS state[4],
+    const uint8_t block[][64], const MD5_MB_WORDS mask)
+{
+	MB_TRANSFORM_BODY(V8, __m512i)
+}
+#endif
+
+/*
+ * Pick the widest multi-buffer implementation the CPU supports.  Return
+ * the number of lanes it processes, or 1 if there is none.
+ */
+static size_t MD5_MB_Select(MD5_MB_Transform_fn **transform)
+{
+	uint32_t features = get_cpu_features();
+
+#ifdef HAVE_TARGET_AVX512F
+	if (features & CPU_FEATURE_AVX512F) {
+		*transform = MD5_MB_Transform_avx512;
+		return 16;
+	}
+#endif
+#ifdef HAVE_TARGET_AVX2
+	if (features & CPU_FEATURE_AVX2) {
+		*transform = MD5_MB_Transform_avx2;
+		return 8;
+	}
+#endif
+#ifdef __SSE2__
+	/* Always there on x86-64; checked so that tests can mask it. */
+	if (features & CPU_FEATURE_SSE2) {
+		*transform = MD5_MB_Transform_sse2;
+		return 4;
+	}
+#endif
+	(void)features;
+	*transform = NULL;
+	return 1;
+}
+
+/* Set every lane of state to the MD5 initial values. */
+static void MD5_MB_Start(MD5_MB_WORDS state[4], size_t lanes)
+{
+	size_t i;
+
+	for (i = 0; i < lanes; i++) {
+		state[0][i] = 0x67452301;
+		state[1][i] = 0xefcdab89;
+		state[2][i] = 0x98badcfe;
+		state[3][i] = 0x10325476;
+	}
+}
+
+/* Write the hashes in the first n lanes of state to digest. */
+static void MD5_MB_Finish(MD5_MB_WORDS state[4], uint8_t *const digest[],
+    size_t n)
+{
+	size_t i, j;
+
+	for (i = 0; i < n; i++)
+		for (j = 0; j < 4; j++)
+			cpu_to_le32(&digest[i][4 * j], state[j][i]);
+}
+
+/* How far MD5_MB_Group has got through one of its messages. */
+typedef struct {
+	size_t part, pos;
+	size_t len, blocks_left;
+	int padded;
+} MD5_MB_Cursor;
+
+/*
+ * Copy the next 64 bytes of the padded message msg to block.  The last
+ * block ends with the length in bits, as in MD5_Final.
+ */
+static void MD5_MB_Fill(const MD5_MB_MSG *msg, MD5_MB_Cursor *cur,
+    uint8_t block[64])
+{
+	size_t at = 0;
+
+	while (cur->part < MD5_MB_PARTS) {
+		size_t size = msg->size[cur->part];
+		size_t n = MIN(size - cur->pos, 64 - at);
+
+		if (n) {
+			memcpy(&block[at],
+			    (const uint8_t *)msg->data[cur->part] + cur->pos, n);
+			at += n;
+			cur->pos += n;
+		}
+		if (cur->pos < size)
+			break;
+		cur->part++;
+		cur->pos = 0;
+	}
+
+	if (at < 64) {
+		if (!cur->padded) {
+			block[at++] = 0x80;
+			cur->padded = 1;
+		}
+		memset(&block[at], 0, 64 - at);
+	}
+	if (--cur->blocks_left == 0) {
+		cpu_to_le32(&block[56], (uint32_t)(cur->len << 3));
+		cpu_to_le32(&block[60], (uint32_t)((uint64_t)cur->len >> 29));
+	}
+}
+
+/* Hash n <= lanes messages in parallel using transform. */
+static void MD5_MB_Group(MD5_MB_Transform_fn *transform, size_t lanes,
+    const MD5_MB_MSG msg[], uint8_t *const digest[], size_t n)
+{
+	MD5_MB_WORDS state[4];
+	MD5_MB_WORDS mask;
+	uint8_t block[MD5_MB_LANES][64];
+	MD5_MB_Cursor cur[MD5_MB_LANES];
+	size_t maxblocks = 0;
+	size_t i, j, b;
+
+	for (i = 0; i < n; i++) {
+		cur[i].part = cur[i].pos = 0;
+		cur[i].padded = 0;
+		cur[i].len = 0;
+		for (j = 0; j < MD5_MB_PARTS; j++)
+			cur[i].len += msg[i].size[j];
+		cur[i].blocks_left = (cur[i].len + 8) / 64 + 1;
+		if (cur[i].blocks_left > maxblocks)
+			maxblocks = cur[i].blocks_left;
+	}
+	for (i = n; i < lanes; i++) {
+		cur[i].blocks_left = 0;
+		memset(block[i], 0, 64);
+	}
+
+	MD5_MB_Start(state, lanes);
+	for (b = 0; b < maxblocks; b++) {
+		for (i = 0; i < lanes; i++) {
+			if (cur[i].blocks_left == 0) {
+				mask[i] = 0;
+				continue;
+			}
+			MD5_MB_Fill(&msg[i], &cur[i], block[i]);
+			mask[i] = UINT32_MAX;
+		}
+		transform(state, (const uint8_t (*)[64])block, mask);
+	}
+	MD5_MB_Finish(state, digest, n);
+
+	explicit_bzero(state, sizeof(state));
+	explicit_bzero(block, sizeof(block));
+}
+
+/* Hash n <= lanes padded messages in parallel using transform. */
+static void MD5_MB_Group_Padded(MD5_MB_Transform_fn *transform,
+    size_t lanes, const uint8_t *const msg[], const size_t nblocks[],
+    uint8_t *const digest[], size_t n)
+{
+	MD5_MB_WORDS state[4];
+	MD5_MB_WORDS mask;
+	uint8_t block[MD5_MB_LANES][64];
+	size_t maxblocks = 0;
+	size_t i, b;
+
+	for (i = 0; i < n; i++)
+		if (nblocks[i] > maxblocks)
+			maxblocks = nblocks[i];
+	for (i = n; i < lanes; i++)
+		memset(block[i], 0, 64);
+
+	MD5_MB_Start(state, lanes);
+	for (b = 0; b < maxblocks; b++) {
+		for (i = 0; i < lanes; i++) {
+			if (i >= n || b >= nblocks[i]) {
+				mask[i] = 0;
+				continue;
+			}
+			memcpy(block[i], &msg[i][64 * b], 64);
+			mask[i] = UINT32_MAX;
+		}
+		transform(state, (const uint8_t (*)[64])block, mask);
+	}
+	MD5_MB_Finish(state, digest, n);
+
+	explicit_bzero(state, sizeof(state));
+	explicit_bzero(block, sizeof(block));
+}
+
+size_t MD5_MB_Lanes(void)
+{
+	MD5_MB_Transform_fn *transform;
+
+	return MD5_MB_Select(&transform);
+}
+
+void MD5_MB_Hash(const MD5_MB_MSG msg[], uint8_t *const digest[], size_t n)
+{
+	MD5_MB_Transform_fn *transform;
+	size_t lanes = MD5_MB_Select(&transform);
+	size_t i, j;
+
+	if (lanes == 1) {
+		MD5_CTX ctx;
+
+		for (i = 0; i < n; i++) {
+			MD5_Init(&ctx);
+			for (j = 0; j < MD5_MB_PARTS; j++)
+				MD5_Update(&ctx, msg[i].data[j], msg[i].size[j]);
+			MD5_Final(digest[i], &ctx);
+		}
+		return;
+	}
+
+	for (i = 0; i < n; i += lanes)
+		MD5_MB_Group(transform, lanes, &msg[i], &digest[i],
+		    MIN(lanes, n - i));
+}
+
+size_t MD5_MB_Pad(uint8_t *buf, size_t len)
+{
+	size_t nblocks = (len + 8) / 64 + 1;
+
+	buf[len] = 0x80;
+	memset(&buf[len + 1], 0, nblocks * 64 - 8 - (len + 1));
+	cpu_to_le32(&buf[nblocks * 64 - 8], (uint32_t)(len << 3));
+	cpu_to_le32(&buf[nblocks * 64 - 4], (uint32_t)((uint64_t)len >> 29));
+	return nblocks;
+}
+
+void MD5_MB_Hash_Padded(const uint8_t *const msg[], const size_t nblocks[],
+    uint8_t *const digest[], size_t n)
+{
+	MD5_MB_Transform_fn *transform;
+	size_t lanes = MD5_MB_Select(&transform);
+	size_t i;
+
+	if (lanes == 1) {
+		MD5_CTX ctx;
+
+		for (i = 0; i < n; i++) {
+			MD5_Init(&ctx);
+			body(&ctx, msg[i], (unsigned long)nblocks[i] * 64);
+			OUT(&digest[i][0], ctx.a)
+			OUT(&digest[i][4], ctx.b)
+			OUT(&digest[i][8], ctx.c)
+			OUT(&digest[i][12], ctx.d)
+		}
+		explicit_bzero(&ctx, sizeof(ctx));
+		return;
+	}
+
+	for (i = 0; i < n; i += lanes)
+		MD5_MB_Group_Padded(transform, lanes, &msg[i], &nblocks[i],
+		    &digest[i], MIN(lanes, n - i));
+}
+
 #endif
@@ -40,4 +40,54 @@ extern void MD5_Init(MD5_CTX *ctx);
 extern void MD5_Update(MD5_CTX *ctx, const void *data, size_t size);
 extern void MD5_Final(uint8_t result[16], MD5_CTX *ctx);
 
+/* Maximum number of messages hashed in parallel by MD5_MB_Hash. */
+#define MD5_MB_LANES 16
+
+/* Maximum number of pieces a message given to MD5_MB_Hash may be made of. */
+#define MD5_MB_PARTS 4
+
+/*
+ * A message for MD5_MB_Hash: the concatenation of size[0] bytes from
+ * data[0], size[1] bytes from data[1], and so on.  Unused parts must have
+ * a size of zero.
+ */
+typedef struct {
+	const void *data[MD5_MB_PARTS];
+	size_t size[MD5_MB_PARTS];
+} MD5_MB_MSG;
+
+/*
+ * Return the number of messages MD5_MB_Hash can hash in parallel on this
+ * CPU, or 1 if it has no faster way than hashing them one by one.
+ */
+extern size_t MD5_MB_Lanes(void);
+
+/*
+ * Compute the MD5 hashes of n independent messages, writing the hash of
+ * msg[i] to digest[i].  A digest may overlap the message it is the hash
+ * of.  Up to MD5_MB_Lanes() messages are processed together, using SIMD
+ * instructions if the CPU supports them.
+ */
+extern void MD5_MB_Hash(const MD5_MB_MSG msg[], uint8_t *const digest[],
+    size_t n);
+
+/* The size of a buffer holding a message of len bytes and its padding. */
+#define MD5_MB_PADDED_SIZE(len) ((((len) + 8) / 64 + 1) * 64)
+
+/*
+ * Append the MD5 padding to the len bytes of message in buf, which must
+ * have room for MD5_MB_PADDED_SIZE(len) bytes, and return the number of
+ * 64-byte blocks the padded message takes up.
+ */
+extern size_t MD5_MB_Pad(uint8_t *buf, size_t len);
+
+/*
+ * Like MD5_MB_Hash, for messages that have already been padded with
+ * MD5_MB_Pad; msg[i] is nblocks[i] blocks long.  This saves gathering the
+ * pieces of a message together when the same message layout is hashed
+ * over and over.
+ */
+extern void MD5_MB_Hash_Padded(const uint8_t *const msg[],
+    const size_t nblocks[], uint8_t *const digest[], size_t n);
+
 #endif /* alg-md5.h */
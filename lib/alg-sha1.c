@@ -78,6 +78,13 @@ modified sha1_process_bytes() to fix compilation with -O3 and GCC >= 11
 #include "crypt-port.h"
 #include "alg-sha1.h"
 
+#ifdef HAVE_TARGET_SHA_NI
+#include <immintrin.h>
+#endif
+#ifdef HAVE_TARGET_ARMV8_SHA2
+#include <arm_neon.h>
+#endif
+
 #if INCLUDE_sha1crypt
 
 #define SHA1_DIGEST_SIZE 20
@@ -106,7 +113,7 @@ modified sha1_process_bytes() to fix compilation with -O3 and GCC >= 11
 
 /* Hash a single 512-bit block. This is the core of the algorithm. */
 static void
-sha1_do_transform (uint32_t state[5], const uint8_t buffer[64])
+sha1_do_transform_generic (uint32_t state[5], const uint8_t buffer[64])
 {
   uint32_t a, b, c, d, e;
   typedef union
@@ -218,6 +225,174 @@ sha1_do_transform (uint32_t state[5], const uint8_t buffer[64])
   a = b = c = d = e = 0;
 }
 
+/* In the versions below, the message schedule for rounds 4*i to
+   4*i + 3 is kept in M[i & 3], computed from the four groups before
+   it:  W[t] = rol(W[t-3] ^ W[t-8] ^ W[t-14] ^ W[t-16], 1).  */
+
+#ifdef HAVE_TARGET_SHA_NI
+/* Four rounds using the x86 SHA extensions.  E holds the value of e
+   for the first of them, plus the message, in its top lane; it is
+   worked out from the state four rounds earlier, PREV.  */
+#define SHANI_ROUNDS4(i, f)                                             \
+  do {                                                                  \
+    if ((i) >= 4)                                                       \
+      M[(i) & 3] = _mm_sha1msg2_epu32 (                                 \
+        _mm_xor_si128 (_mm_sha1msg1_epu32 (M[(i) & 3], M[((i) + 1) & 3]), \
+                       M[((i) + 2) & 3]),                               \
+        M[((i) + 3) & 3]);                                              \
+    E = _mm_sha1nexte_epu32 (PREV, M[(i) & 3]);                         \
+    PREV = ABCD;                                                        \
+    ABCD = _mm_sha1rnds4_epu32 (ABCD, E, f);                            \
+  } while (0)
+
+/* Hash a single 512-bit block using the x86 SHA extensions.  */
+__attribute__((target("sha,sse4.1")))
+static void
+sha1_do_transform_shani (uint32_t state[5], const uint8_t buffer[64])
+{
+  const __m128i BSWAP = _mm_set_epi64x (0x0001020304050607LL,
+                                        0x08090a0b0c0d0e0fLL);
+  __m128i ABCD, ABCD_SAVE, E, E_SAVE, PREV, M[4];
+
+  /* The instructions want a in the top lane.  */
+  ABCD = ABCD_SAVE = _mm_shuffle_epi32 (
+    _mm_loadu_si128 ((const __m128i *) &state[0]), 0x1b);
+  E_SAVE = _mm_set_epi32 ((int) state[4], 0, 0, 0);
+
+  M[0] = _mm_shuffle_epi8 (
+    _mm_loadu_si128 ((const __m128i *) &buffer[0]), BSWAP);
+  M[1] = _mm_shuffle_epi8 (
+    _mm_loadu_si128 ((const __m128i *) &buffer[16]), BSWAP);
+  M[2] = _mm_shuffle_epi8 (
+    _mm_loadu_si128 ((const __m128i *) &buffer[32]), BSWAP);
+  M[3] = _mm_shuffle_epi8 (
+    _mm_loadu_si128 ((const __m128i *) &buffer[48]), BSWAP);
+
+  /* The first e comes from the state, not from earlier rounds.  */
+  E = _mm_add_epi32 (E_SAVE, M[0]);
+  PREV = ABCD;
+  ABCD = _mm_sha1rnds4_epu32 (ABCD, E, 0);
+  SHANI_ROUNDS4 (1, 0);
+  SHANI_ROUNDS4 (2, 0);
+  SHANI_ROUNDS4 (3, 0);
+  SHANI_ROUNDS4 (4, 0);
+  SHANI_ROUNDS4 (5, 1);
+  SHANI_ROUNDS4 (6, 1);
+  SHANI_ROUNDS4 (7, 1);
+  SHANI_ROUNDS4 (8, 1);
+  SHANI_ROUNDS4 (9, 1);
+  SHANI_ROUNDS4 (10, 2);
+  SHANI_ROUNDS4 (11, 2);
+  SHANI_ROUNDS4 (12, 2);
+  SHANI_ROUNDS4 (13, 2);
+  SHANI_ROUNDS4 (14, 2);
+  SHANI_ROUNDS4 (15, 3);
+  SHANI_ROUNDS4 (16, 3);
+  SHANI_ROUNDS4 (17, 3);
+  SHANI_ROUNDS4 (18, 3);
+  SHANI_ROUNDS4 (19, 3);
+
+  /* Add the working vars back into state[].  */
+  E = _mm_sha1nexte_epu32 (PREV, E_SAVE);
+  ABCD = _mm_add_epi32 (ABCD, ABCD_SAVE);
+  _mm_storeu_si128 ((__m128i *) &state[0], _mm_shuffle_epi32 (ABCD, 0x1b));
+  state[4] = (uint32_t) _mm_extract_epi32 (E, 3);
+}
+#endif
+
+#ifdef HAVE_TARGET_ARMV8_SHA2
+/* Four rounds using the ARMv8 cryptography extensions, with the
+   instruction OP for the round function and the round constant K.  */
+#define ARMV8_ROUNDS4(i, op, k)                                         \
+  do {                                                                  \
+    if ((i) >= 4)                                                       \
+      M[(i) & 3] = vsha1su1q_u32 (                                      \
+        vsha1su0q_u32 (M[(i) & 3], M[((i) + 1) & 3], M[((i) + 2) & 3]), \
+        M[((i) + 3) & 3]);                                              \
+    WK = vaddq_u32 (M[(i) & 3], vdupq_n_u32 (k));                       \
+    E_NEXT = vsha1h_u32 (vgetq_lane_u32 (ABCD, 0));                     \
+    ABCD = op (ABCD, E, WK);                                            \
+    E = E_NEXT;                                                         \
+  } while (0)
+
+/* Hash a single 512-bit block using the ARMv8 cryptography
+   extensions.  */
+__attribute__((target("+sha2")))
+static void
+sha1_do_transform_armv8 (uint32_t state[5], const uint8_t buffer[64])
+{
+  uint32x4_t ABCD, ABCD_SAVE, WK, M[4];
+  uint32_t E, E_NEXT;
+
+  ABCD = ABCD_SAVE = vld1q_u32 (&state[0]);
+  E = state[4];
+
+  M[0] = vreinterpretq_u32_u8 (vrev32q_u8 (vld1q_u8 (&buffer[0])));
+  M[1] = vreinterpretq_u32_u8 (vrev32q_u8 (vld1q_u8 (&buffer[16])));
+  M[2] = vreinterpretq_u32_u8 (vrev32q_u8 (vld1q_u8 (&buffer[32])));
+  M[3] = vreinterpretq_u32_u8 (vrev32q_u8 (vld1q_u8 (&buffer[48])));
+
+  ARMV8_ROUNDS4 (0, vsha1cq_u32, 0x5A827999);
+  ARMV8_ROUNDS4 (1, vsha1cq_u32, 0x5A827999);
+  ARMV8_ROUNDS4 (2, vsha1cq_u32, 0x5A827999);
+  ARMV8_ROUNDS4 (3, vsha1cq_u32, 0x5A827999);
+  ARMV8_ROUNDS4 (4, vsha1cq_u32, 0x5A827999);
+  ARMV8_ROUNDS4 (5, vsha1pq_u32, 0x6ED9EBA1);
+  ARMV8_ROUNDS4 (6, vsha1pq_u32, 0x6ED9EBA1);
+  ARMV8_ROUNDS4 (7, vsha1pq_u32, 0x6ED9EBA1);
+  ARMV8_ROUNDS4 (8, vsha1pq_u32, 0x6ED9EBA1);
+  ARMV8_ROUNDS4 (9, vsha1pq_u32, 0x6ED9EBA1);
+  ARMV8_ROUNDS4 (10, vsha1mq_u32, 0x8F1BBCDC);
+  ARMV8_ROUNDS4 (11, vsha1mq_u32, 0x8F1BBCDC);
+  ARMV8_ROUNDS4 (12, vsha1mq_u32, 0x8F1BBCDC);
+  ARMV8_ROUNDS4 (13, vsha1mq_u32, 0x8F1BBCDC);
+  ARMV8_ROUNDS4 (14, vsha1mq_u32, 0x8F1BBCDC);
+  ARMV8_ROUNDS4 (15, vsha1pq_u32, 0xCA62C1D6);
+  ARMV8_ROUNDS4 (16, vsha1pq_u32, 0xCA62C1D6);
+  ARMV8_ROUNDS4 (17, vsha1pq_u32, 0xCA62C1D6);
+  ARMV8_ROUNDS4 (18, vsha1pq_u32, 0xCA62C1D6);
+  ARMV8_ROUNDS4 (19, vsha1pq_u32, 0xCA62C1D6);
+
+  /* Add the working vars back into state[].  */
+  vst1q_u32 (&state[0], vaddq_u32 (ABCD, ABCD_SAVE));
+  state[4] += E;
+}
+#endif
+
+/* Hash a single 512-bit block, with the CPU's SHA-1 instructions if
+   it has them.  */
+static void
+sha1_do_transform (uint32_t state[5], const uint8_t buffer[64])
+{
+#if defined HAVE_TARGET_SHA_NI || defined HAVE_TARGET_ARMV8_SHA2
+  uint32_t features = get_cpu_features ();
+#endif
+
+#ifdef HAVE_TARGET_SHA_NI
+  if (features & CPU_FEATURE_SHA)
+    {
+      sha1_do_transform_shani (state, buffer);
+      return;
+    }
+#endif
+#ifdef HAVE_TARGET_ARMV8_SHA2
+  if (features & CPU_FEATURE_ARM_SHA1)
+    {
+      sha1_do_transform_armv8 (state, buffer);
+      return;
+    }
+#endif
+
+  sha1_do_transform_generic (state, buffer);
+}
+
+
+void
+sha1_process_block (uint32_t state[5], const uint8_t block[64])
+{
+  sha1_do_transform (state, block);
+}
+
 
 /* SHA1Init - Initialize new context */
 void
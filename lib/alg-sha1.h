@@ -31,4 +31,9 @@ extern void sha1_process_bytes (const void *buffer, struct sha1_ctx *ctx, size_t
    data written to CTX is erased before returning from the function.  */
 extern void *sha1_finish_ctx (struct sha1_ctx *ctx, void *resbuf);
 
+/* Run one 64-byte BLOCK through the compression function, updating
+   the intermediate hash value STATE.  This is for callers that do their
+   own padding, such as HMAC with a precomputed key.  */
+extern void sha1_process_block (uint32_t state[5], const uint8_t block[64]);
+
 #endif
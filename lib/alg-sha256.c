@@ -33,6 +33,13 @@
 #include "alg-sha256.h"
 #include "byteorder.h"
 
+#ifdef HAVE_TARGET_SHA_NI
+#include <immintrin.h>
+#endif
+#ifdef HAVE_TARGET_ARMV8_SHA2
+#include <arm_neon.h>
+#endif
+
 #ifdef __ICC
 /* Miscompile with icc 14.0.0 (at least), so don't use restrict there */
 #define restrict
@@ -99,10 +106,11 @@ static const uint32_t Krnd[64] = {
 
 /*
  * SHA256 block compression function.  The 256-bit state is transformed via
- * the 512-bit input block to produce a new state.
+ * the 512-bit input block to produce a new state.  This is the portable
+ * implementation; see SHA256_Transform below.
  */
 static void
-SHA256_Transform(uint32_t state[static restrict 8],
+SHA256_Transform_generic(uint32_t state[static restrict 8],
     const uint8_t block[static restrict 64],
     uint32_t W[static restrict 64], uint32_t S[static restrict 8])
 {
@@ -166,6 +174,156 @@ SHA256_Transform(uint32_t state[static restrict 8],
 	state[7] += S[7];
 }
 
+#ifdef HAVE_TARGET_SHA_NI
+/* Four rounds, and the message schedule for four more words. */
+#define SHANI_QRND(m, i)						\
+	MSG = _mm_add_epi32(m,						\
+	    _mm_loadu_si128((const __m128i *)&Krnd[4 * (i)]));	\
+	STATE1 = _mm_sha256rnds2_epu32(STATE1, STATE0, MSG);		\
+	STATE0 = _mm_sha256rnds2_epu32(STATE0, STATE1,			\
+	    _mm_shuffle_epi32(MSG, 0x0e));
+#define SHANI_MSCH(m0, m1, m2, m3)					\
+	m0 = _mm_sha256msg2_epu32(_mm_add_epi32(			\
+	    _mm_sha256msg1_epu32(m0, m1), _mm_alignr_epi8(m3, m2, 4)), m3);
+
+/*
+ * SHA256 block compression function using the x86 SHA extensions.
+ */
+__attribute__((target("sha,sse4.1")))
+static void
+SHA256_Transform_shani(uint32_t state[static restrict 8],
+    const uint8_t block[static restrict 64])
+{
+	const __m128i BSWAP = _mm_set_epi64x(0x0c0d0e0f08090a0bLL,
+	    0x0405060700010203LL);
+	__m128i STATE0, STATE1, ABEF, CDGH, MSG, TMP, M0, M1, M2, M3;
+	int i;
+
+	/* The instructions want the state as ABEF and CDGH. */
+	TMP = _mm_shuffle_epi32(
+	    _mm_loadu_si128((const __m128i *)&state[0]), 0xb1);
+	STATE1 = _mm_shuffle_epi32(
+	    _mm_loadu_si128((const __m128i *)&state[4]), 0x1b);
+	STATE0 = ABEF = _mm_alignr_epi8(TMP, STATE1, 8);
+	STATE1 = CDGH = _mm_blend_epi16(STATE1, TMP, 0xf0);
+
+	M0 = _mm_shuffle_epi8(
+	    _mm_loadu_si128((const __m128i *)&block[0]), BSWAP);
+	M1 = _mm_shuffle_epi8(
+	    _mm_loadu_si128((const __m128i *)&block[16]), BSWAP);
+	M2 = _mm_shuffle_epi8(
+	    _mm_loadu_si128((const __m128i *)&block[32]), BSWAP);
+	M3 = _mm_shuffle_epi8(
+	    _mm_loadu_si128((const __m128i *)&block[48]), BSWAP);
+
+	SHANI_QRND(M0, 0);
+	SHANI_QRND(M1, 1);
+	SHANI_QRND(M2, 2);
+	SHANI_QRND(M3, 3);
+	for (i = 4; i < 16; i += 4) {
+		SHANI_MSCH(M0, M1, M2, M3);
+		SHANI_QRND(M0, i);
+		SHANI_MSCH(M1, M2, M3, M0);
+		SHANI_QRND(M1, i + 1);
+		SHANI_MSCH(M2, M3, M0, M1);
+		SHANI_QRND(M2, i + 2);
+		SHANI_MSCH(M3, M0, M1, M2);
+		SHANI_QRND(M3, i + 3);
+	}
+
+	STATE0 = _mm_add_epi32(STATE0, ABEF);
+	STATE1 = _mm_add_epi32(STATE1, CDGH);
+
+	/* Back to ABCD and EFGH. */
+	TMP = _mm_shuffle_epi32(STATE0, 0x1b);
+	STATE1 = _mm_shuffle_epi32(STATE1, 0xb1);
+	_mm_storeu_si128((__m128i *)&state[0],
+	    _mm_blend_epi16(TMP, STATE1, 0xf0));
+	_mm_storeu_si128((__m128i *)&state[4],
+	    _mm_alignr_epi8(STATE1, TMP, 8));
+}
+#endif
+
+#ifdef HAVE_TARGET_ARMV8_SHA2
+/* Four rounds, and the message schedule for four more words. */
+#define ARMV8_QRND(m, i)						\
+	MSG = vaddq_u32(m, vld1q_u32(&Krnd[4 * (i)]));			\
+	TMP = STATE0;							\
+	STATE0 = vsha256hq_u32(STATE0, STATE1, MSG);			\
+	STATE1 = vsha256h2q_u32(STATE1, TMP, MSG);
+#define ARMV8_MSCH(m0, m1, m2, m3)					\
+	m0 = vsha256su1q_u32(vsha256su0q_u32(m0, m1), m2, m3);
+
+/*
+ * SHA256 block compression function using the ARMv8 cryptography
+ * extensions.
+ */
+__attribute__((target("+sha2")))
+static void
+SHA256_Transform_armv8(uint32_t state[static restrict 8],
+    const uint8_t block[static restrict 64])
+{
+	uint32x4_t STATE0, STATE1, ABCD, EFGH, MSG, TMP, M0, M1, M2, M3;
+	int i;
+
+	STATE0 = ABCD = vld1q_u32(&state[0]);
+	STATE1 = EFGH = vld1q_u32(&state[4]);
+
+	M0 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(&block[0])));
+	M1 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(&block[16])));
+	M2 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(&block[32])));
+	M3 = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(&block[48])));
+
+	ARMV8_QRND(M0, 0);
+	ARMV8_QRND(M1, 1);
+	ARMV8_QRND(M2, 2);
+	ARMV8_QRND(M3, 3);
+	for (i = 4; i < 16; i += 4) {
+		ARMV8_MSCH(M0, M1, M2, M3);
+		ARMV8_QRND(M0, i);
+		ARMV8_MSCH(M1, M2, M3, M0);
+		ARMV8_QRND(M1, i + 1);
+		ARMV8_MSCH(M2, M3, M0, M1);
+		ARMV8_QRND(M2, i + 2);
+		ARMV8_MSCH(M3, M0, M1, M2);
+		ARMV8_QRND(M3, i + 3);
+	}
+
+	vst1q_u32(&state[0], vaddq_u32(STATE0, ABCD));
+	vst1q_u32(&state[4], vaddq_u32(STATE1, EFGH));
+}
+#endif
+
+/*
+ * SHA256 block compression function.  Use the CPU's SHA-256 instructions
+ * if it has them; otherwise use the portable code, which needs W and S as
+ * scratch space.
+ */
+static void
+SHA256_Transform(uint32_t state[static restrict 8],
+    const uint8_t block[static restrict 64],
+    uint32_t W[static restrict 64], uint32_t S[static restrict 8])
+{
+#if defined HAVE_TARGET_SHA_NI || defined HAVE_TARGET_ARMV8_SHA2
+	uint32_t features = get_cpu_features();
+#endif
+
+#ifdef HAVE_TARGET_SHA_NI
+	if (features & CPU_FEATURE_SHA) {
+		SHA256_Transform_shani(state, block);
+		return;
+	}
+#endif
+#ifdef HAVE_TARGET_ARMV8_SHA2
+	if (features & CPU_FEATURE_ARM_SHA2) {
+		SHA256_Transform_armv8(state, block);
+		return;
+	}
+#endif
+
+	SHA256_Transform_generic(state, block, W, S);
+}
+
 static const uint8_t PAD[64] = {
 	0x80, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
 	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
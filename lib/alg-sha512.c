@@ -33,6 +33,10 @@
 #include "alg-sha512.h"
 #include "byteorder.h"
 
+#if defined HAVE_TARGET_AVX2 || defined HAVE_TARGET_AVX512F
+#include <immintrin.h>
+#endif
+
 /* SHA512 round constants. */
 static const uint64_t K[80] = {
 	0x428a2f98d728ae22ULL, 0x7137449123ef65cdULL,
@@ -212,6 +216,14 @@ SHA512_Pad(SHA512_CTX * ctx)
 	SHA512_Transform(ctx->state, ctx->buf);
 }
 
+/* Magic initialization constants. */
+static const uint64_t initial_state[8] = {
+	0x6a09e667f3bcc908ULL, 0xbb67ae8584caa73bULL,
+	0x3c6ef372fe94f82bULL, 0xa54ff53a5f1d36f1ULL,
+	0x510e527fade682d1ULL, 0x9b05688c2b3e6c1fULL,
+	0x1f83d9abfb41bd6bULL, 0x5be0cd19137e2179ULL
+};
+
 /* SHA-512 initialization.  Begins a SHA-512 operation. */
 void
 SHA512_Init(SHA512_CTX * ctx)
@@ -221,14 +233,7 @@ SHA512_Init(SHA512_CTX * ctx)
 	ctx->count[0] = ctx->count[1] = 0;
 
 	/* Magic initialization constants */
-	ctx->state[0] = 0x6a09e667f3bcc908ULL;
-	ctx->state[1] = 0xbb67ae8584caa73bULL;
-	ctx->state[2] = 0x3c6ef372fe94f82bULL;
-	ctx->state[3] = 0xa54ff53a5f1d36f1ULL;
-	ctx->state[4] = 0x510e527fade682d1ULL;
-	ctx->state[5] = 0x9b05688c2b3e6c1fULL;
-	ctx->state[6] = 0x1f83d9abfb41bd6bULL;
-	ctx->state[7] = 0x5be0cd19137e2179ULL;
+	memcpy(ctx->state, initial_state, sizeof(initial_state));
 }
 
 /* Add bytes into the hash */
@@ -308,4 +313,264 @@ SHA512_Buf(const void * in, size_t len,
         SHA512_Final(digest, &ctx);
 }
 
+/*
+ * Multi-buffer SHA512.  Several independent messages are hashed at once,
+ * each one in its own 64-bit lane of a vector register.  The state and
+ * message schedule are kept transposed (word-major, one column per lane)
+ * so that each SHA512 operation becomes a single vector instruction.
+ * Lanes whose message has fewer blocks than the longest one in the group
+ * keep running on zero blocks, but their state is left untouched.
+ */
+typedef uint64_t SHA512_MB_WORDS[SHA512_MB_LANES];
+
+typedef void SHA512_MB_Transform_fn(SHA512_MB_WORDS[8],
+    const SHA512_MB_WORDS[16], const SHA512_MB_WORDS);
+
+/* Vectorized SHA512 round and message schedule, parameterized by the
+ * prefix V of a set of macros implementing the elementary operations. */
+#define MB_RND(V, a, b, c, d, e, f, g, h, k, w)			\
+	T1 = V##_ADD(V##_ADD(h, V##_S1(e)),			\
+	    V##_ADD(V##_CH(e, f, g), V##_ADD(k, w)));		\
+	d = V##_ADD(d, T1);					\
+	h = V##_ADD(T1, V##_ADD(V##_S0(a), V##_MAJ(a, b, c)));
+
+#define MB_RNDr(V, S, W, j, i)					\
+	MB_RND(V, S[(80 - j) % 8], S[(81 - j) % 8],		\
+	    S[(82 - j) % 8], S[(83 - j) % 8],			\
+	    S[(84 - j) % 8], S[(85 - j) % 8],			\
+	    S[(86 - j) % 8], S[(87 - j) % 8],			\
+	    V##_SET1(K[i + j]), W[j])
+
+#define MB_MSCH(V, W, j)					\
+	W[j] = V##_ADD(V##_ADD(V##_s1(W[(j + 14) & 15]), W[(j + 9) & 15]), \
+	    V##_ADD(V##_s0(W[(j + 1) & 15]), W[j]));
+
+#define MB_TRANSFORM_BODY(V, vec)				\
+	vec W[16], S[8], T1;					\
+	int i;							\
+								\
+	for (i = 0; i < 16; i++)				\
+		W[i] = V##_LOAD(block[i]);			\
+	for (i = 0; i < 8; i++)					\
+		S[i] = V##_LOAD(state[i]);			\
+								\
+	for (i = 0; i < 80; i += 16) {				\
+		if (i) {					\
+			MB_MSCH(V, W, 0) MB_MSCH(V, W, 1)	\
+			MB_MSCH(V, W, 2) MB_MSCH(V, W, 3)	\
+			MB_MSCH(V, W, 4) MB_MSCH(V, W, 5)	\
+			MB_MSCH(V, W, 6) MB_MSCH(V, W, 7)	\
+			MB_MSCH(V, W, 8) MB_MSCH(V, W, 9)	\
+			MB_MSCH(V, W, 10) MB_MSCH(V, W, 11)	\
+			MB_MSCH(V, W, 12) MB_MSCH(V, W, 13)	\
+			MB_MSCH(V, W, 14) MB_MSCH(V, W, 15)	\
+		}						\
+		MB_RNDr(V, S, W, 0, i) MB_RNDr(V, S, W, 1, i)	\
+		MB_RNDr(V, S, W, 2, i) MB_RNDr(V, S, W, 3, i)	\
+		MB_RNDr(V, S, W, 4, i) MB_RNDr(V, S, W, 5, i)	\
+		MB_RNDr(V, S, W, 6, i) MB_RNDr(V, S, W, 7, i)	\
+		MB_RNDr(V, S, W, 8, i) MB_RNDr(V, S, W, 9, i)	\
+		MB_RNDr(V, S, W, 10, i) MB_RNDr(V, S, W, 11, i)	\
+		MB_RNDr(V, S, W, 12, i) MB_RNDr(V, S, W, 13, i)	\
+		MB_RNDr(V, S, W, 14, i) MB_RNDr(V, S, W, 15, i)	\
+	}							\
+								\
+	for (i = 0; i < 8; i++)					\
+		V##_STORE(state[i], V##_ADD(V##_LOAD(state[i]),	\
+		    V##_AND(S[i], V##_LOAD(mask))));
+
+#ifdef HAVE_TARGET_AVX2
+#define V4_LOAD(p)	_mm256_loadu_si256((const __m256i *)(p))
+#define V4_STORE(p, x)	_mm256_storeu_si256((__m256i *)(p), x)
+#define V4_SET1(k)	_mm256_set1_epi64x((long long)(k))
+#define V4_ADD(x, y)	_mm256_add_epi64(x, y)
+#define V4_AND(x, y)	_mm256_and_si256(x, y)
+#define V4_XOR(x, y)	_mm256_xor_si256(x, y)
+#define V4_XOR3(x, y, z) V4_XOR(V4_XOR(x, y), z)
+#define V4_ROTR(x, n)	_mm256_or_si256(_mm256_srli_epi64(x, n),	\
+			    _mm256_slli_epi64(x, 64 - (n)))
+#define V4_CH(x, y, z)	V4_XOR(V4_AND(x, V4_XOR(y, z)), z)
+#define V4_MAJ(x, y, z)	_mm256_or_si256(V4_AND(x, y),		\
+			    V4_AND(z, _mm256_or_si256(x, y)))
+#define V4_S0(x)	V4_XOR3(V4_ROTR(x, 28), V4_ROTR(x, 34), V4_ROTR(x, 39))
+#define V4_S1(x)	V4_XOR3(V4_ROTR(x, 14), V4_ROTR(x, 18), V4_ROTR(x, 41))
+#define V4_s0(x)	V4_XOR3(V4_ROTR(x, 1), V4_ROTR(x, 8),	\
+			    _mm256_srli_epi64(x, 7))
+#define V4_s1(x)	V4_XOR3(V4_ROTR(x, 19), V4_ROTR(x, 61),	\
+			    _mm256_srli_epi64(x, 6))
+
+/* SHA512 block compression function for 4 lanes, using AVX2. */
+__attribute__((target("avx2")))
+static void
+SHA512_MB_Transform_avx2(SHA512_MB_WORDS state[8],
+    const SHA512_MB_WORDS block[16], const SHA512_MB_WORDS mask)
+{
+	MB_TRANSFORM_BODY(V4, __m256i)
+}
+#endif
+
+#ifdef HAVE_TARGET_AVX512F
+#define V8_LOAD(p)	_mm512_loadu_si512((const void *)(p))
+#define V8_STORE(p, x)	_mm512_storeu_si512((void *)(p), x)
+#define V8_SET1(k)	_mm512_set1_epi64((long long)(k))
+#define V8_ADD(x, y)	_mm512_add_epi64(x, y)
+#define V8_AND(x, y)	_mm512_and_si512(x, y)
+#define V8_XOR3(x, y, z) _mm512_ternarylogic_epi64(x, y, z, 0x96)
+#define V8_ROTR(x, n)	_mm512_ror_epi64(x, n)
+#define V8_CH(x, y, z)	_mm512_ternarylogic_epi64(x, y, z, 0xca)
+#define V8_MAJ(x, y, z)	_mm512_ternarylogic_epi64(x, y, z, 0xe8)
+#define V8_S0(x)	V8_XOR3(V8_ROTR(x, 28), V8_ROTR(x, 34), V8_ROTR(x, 39))
+#define V8_S1(x)	V8_XOR3(V8_ROTR(x, 14), V8_ROTR(x, 18), V8_ROTR(x, 41))
+#define V8_s0(x)	V8_XOR3(V8_ROTR(x, 1), V8_ROTR(x, 8),	\
+			    _mm512_srli_epi64(x, 7))
+#define V8_s1(x)	V8_XOR3(V8_ROTR(x, 19), V8_ROTR(x, 61),	\
+			    _mm512_srli_epi64(x, 6))
+
+/* SHA512 block compression function for 8 lanes, using AVX-512. */
+__attribute__((target("avx512f")))
+static void
+SHA512_MB_Transform_avx512(SHA512_MB_WORDS state[8],
+    const SHA512_MB_WORDS block[16], const SHA512_MB_WORDS mask)
+{
+	MB_TRANSFORM_BODY(V8, __m512i)
+}
+#endif
+
+/*
+ * Pick the widest multi-buffer implementation the CPU supports.  Return
+ * the number of lanes it processes, or 1 if there is none.
+ */
+static size_t
+SHA512_MB_Select(SHA512_MB_Transform_fn ** transform)
+{
+	uint32_t features = get_cpu_features();
+
+#ifdef HAVE_TARGET_AVX512F
+	if (features & CPU_FEATURE_AVX512F) {
+		*transform = SHA512_MB_Transform_avx512;
+		return 8;
+	}
+#endif
+#ifdef HAVE_TARGET_AVX2
+	if (features & CPU_FEATURE_AVX2) {
+		*transform = SHA512_MB_Transform_avx2;
+		return 4;
+	}
+#endif
+
+	(void)features;
+	*transform = NULL;
+	return 1;
+}
+
+/* Hash ${n} <= ${lanes} messages in parallel using ${transform}. */
+static void
+SHA512_MB_Group(SHA512_MB_Transform_fn * transform, size_t lanes,
+    const void * const in[], const size_t len[],
+    unsigned char * const digest[], size_t n)
+{
+	SHA512_MB_WORDS state[8];
+	SHA512_MB_WORDS W[16];
+	SHA512_MB_WORDS mask;
+	uint8_t tail[SHA512_MB_LANES][2 * SHA512_BLOCK_LENGTH];
+	size_t nfull[SHA512_MB_LANES], nblocks[SHA512_MB_LANES];
+	size_t maxblocks = 0;
+	size_t i, j, b;
+
+	for (i = 0; i < n; i++) {
+		size_t r = len[i] % SHA512_BLOCK_LENGTH;
+		size_t ntail = (r < 112) ? 1 : 2;
+		uint8_t *t = tail[i];
+
+		nfull[i] = len[i] / SHA512_BLOCK_LENGTH;
+		nblocks[i] = nfull[i] + ntail;
+		if (nblocks[i] > maxblocks)
+			maxblocks = nblocks[i];
+
+		/* Copy the partial last block and add padding and length. */
+		memcpy(t, (const uint8_t *)in[i] + len[i] - r, r);
+		memcpy(&t[r], PAD, ntail * SHA512_BLOCK_LENGTH - 16 - r);
+		be64enc(&t[ntail * SHA512_BLOCK_LENGTH - 16],
+		    (uint64_t)len[i] >> 61);
+		be64enc(&t[ntail * SHA512_BLOCK_LENGTH - 8],
+		    (uint64_t)len[i] << 3);
+	}
+	for (i = n; i < lanes; i++)
+		nblocks[i] = nfull[i] = 0;
+
+	for (j = 0; j < 8; j++)
+		for (i = 0; i < lanes; i++)
+			state[j][i] = initial_state[j];
+
+	for (b = 0; b < maxblocks; b++) {
+		for (i = 0; i < lanes; i++) {
+			const uint8_t *block;
+
+			if (b >= nblocks[i]) {
+				mask[i] = 0;
+				for (j = 0; j < 16; j++)
+					W[j][i] = 0;
+				continue;
+			}
+			if (b < nfull[i])
+				block = (const uint8_t *)in[i] +
+				    b * SHA512_BLOCK_LENGTH;
+			else
+				block = tail[i] +
+				    (b - nfull[i]) * SHA512_BLOCK_LENGTH;
+			mask[i] = UINT64_MAX;
+			for (j = 0; j < 16; j++)
+				W[j][i] = be64dec(&block[8 * j]);
+		}
+		transform(state, (const SHA512_MB_WORDS *)W, mask);
+	}
+
+	for (i = 0; i < n; i++)
+		for (j = 0; j < 8; j++)
+			be64enc(&digest[i][8 * j], state[j][i]);
+
+	/* Clean the stack. */
+	explicit_bzero(state, sizeof(state));
+	explicit_bzero(W, sizeof(W));
+	explicit_bzero(tail, sizeof(tail));
+}
+
+/**
+ * SHA512_MB_Lanes():
+ * Return the number of messages SHA512_MB_Buf can hash in parallel on
+ * this CPU, or 1 if it has no faster way than hashing them one by one.
+ */
+size_t
+SHA512_MB_Lanes(void)
+{
+	SHA512_MB_Transform_fn *transform;
+
+	return SHA512_MB_Select(&transform);
+}
+
+/**
+ * SHA512_MB_Buf(in, len, digest, n):
+ * Compute the SHA512 hashes of ${n} independent messages; the ${i}-th
+ * message consists of ${len}[${i}] bytes from ${in}[${i}], and its hash
+ * is written to ${digest}[${i}].
+ */
+void
+SHA512_MB_Buf(const void * const in[], const size_t len[],
+	unsigned char * const digest[], size_t n)
+{
+	SHA512_MB_Transform_fn *transform;
+	size_t lanes = SHA512_MB_Select(&transform);
+	size_t i;
+
+	if (lanes == 1) {
+		for (i = 0; i < n; i++)
+			SHA512_Buf(in[i], len[i], digest[i]);
+		return;
+	}
+
+	for (i = 0; i < n; i += lanes)
+		SHA512_MB_Group(transform, lanes, &in[i], &len[i], &digest[i],
+		    MIN(lanes, n - i));
+}
+
 #endif
@@ -38,12 +38,17 @@
 #define SHA512_Update libcperciva_SHA512_Update
 #define SHA512_Final libcperciva_SHA512_Final
 #define SHA512_Buf libcperciva_SHA512_Buf
+#define SHA512_MB_Buf libcperciva_SHA512_MB_Buf
+#define SHA512_MB_Lanes libcperciva_SHA512_MB_Lanes
 #define SHA512_CTX libcperciva_SHA512_CTX
 
 /* Common constants. */
 #define SHA512_BLOCK_LENGTH 128
 #define SHA512_DIGEST_LENGTH 64
 
+/* Maximum number of messages hashed in parallel by SHA512_MB_Buf. */
+#define SHA512_MB_LANES 8
+
 /* Context structure for SHA512 operations. */
 typedef struct {
 	uint64_t state[8];
@@ -78,4 +83,21 @@ extern void SHA512_Final(unsigned char[MIN_SIZE(SHA512_DIGEST_LENGTH)],
 extern void SHA512_Buf(const void *, size_t,
     unsigned char[MIN_SIZE(SHA512_DIGEST_LENGTH)]);
 
+/**
+ * SHA512_MB_Lanes():
+ * Return the number of messages SHA512_MB_Buf can hash in parallel on
+ * this CPU, or 1 if it has no faster way than hashing them one by one.
+ */
+extern size_t SHA512_MB_Lanes(void);
+
+/**
+ * SHA512_MB_Buf(in, len, digest, n):
+ * Compute the SHA512 hashes of ${n} independent messages; the ${i}-th
+ * message consists of ${len}[${i}] bytes from ${in}[${i}], and its hash
+ * is written to ${digest}[${i}].  Up to SHA512_MB_Lanes() messages are
+ * processed together, using SIMD instructions if the CPU supports them.
+ */
+extern void SHA512_MB_Buf(const void * const [], const size_t [],
+    unsigned char * const [], size_t);
+
 #endif /* !_SHA512_H_ */
@@ -60,4 +60,37 @@ extern void sm3_hash(const void *, size_t, uint8_t[32], sm3_ctx *);
  * Compute the SM3 hash of ${len} bytes from ${in} and write it to ${digest}.
  */
 extern void sm3_buf(const void *, size_t, uint8_t[32]);
+
+/* Maximum number of messages hashed in parallel by sm3_mb_hash. */
+#define SM3_MB_LANES 16
+
+/* Maximum number of pieces a message given to sm3_mb_hash may be made of. */
+#define SM3_MB_PARTS 4
+
+/*
+ * A message for sm3_mb_hash: the concatenation of size[0] bytes from
+ * data[0], size[1] bytes from data[1], and so on.  Unused parts must have
+ * a size of zero.
+ */
+typedef struct
+{
+  const void *data[SM3_MB_PARTS];
+  size_t size[SM3_MB_PARTS];
+} sm3_mb_msg;
+
+/**
+ * sm3_mb_lanes():
+ * Return the number of messages sm3_mb_hash can hash in parallel on this
+ * CPU, or 1 if it has no faster way than hashing them one by one.
+ */
+extern size_t sm3_mb_lanes(void);
+
+/**
+ * sm3_mb_hash(msg, digest, n):
+ * Compute the SM3 hashes of ${n} independent messages, writing the hash of
+ * ${msg}[i] to ${digest}[i].  A digest may overlap the message it is the
+ * hash of.  Up to sm3_mb_lanes() messages are processed together, using
+ * SIMD instructions if the CPU supports them.
+ */
+extern void sm3_mb_hash(const sm3_mb_msg[], uint8_t *const[], size_t);
 #endif /* _CRYPT_ALG_SM3_H */
@@ -321,17 +321,13 @@ static void yescrypt_sha256_cipher(unsigned char *data, size_t datalen,
 	explicit_bzero(f, sizeof(f));
 }
 
-uint8_t *yescrypt_r(const yescrypt_shared_t *shared, yescrypt_local_t *local,
-    const uint8_t *passwd, size_t passwdlen,
-    const uint8_t *setting,
-    const yescrypt_binary_t *key,
-    uint8_t *buf, size_t buflen)
+const uint8_t *yescrypt_decode_params(yescrypt_params_t *params,
+    const uint8_t *setting)
 {
-	unsigned char saltbin[64], hashbin[32];
-	const uint8_t *src, *saltstr, *salt;
-	uint8_t *dst;
-	size_t need, prefixlen, saltstrlen, saltlen;
-	yescrypt_params_t params = { .p = 1 };
+	const uint8_t *src;
+
+	memset(params, 0, sizeof(*params));
+	params->p = 1;
 
 	if (setting[0] != '$' ||
 	    (setting[1] != '7' && setting[1] != 'y') ||
@@ -343,18 +339,15 @@ uint8_t *yescrypt_r(const yescrypt_shared_t *shared, yescrypt_local_t *local,
 		uint32_t N_log2 = atoi64(*src++);
 		if (N_log2 < 1 || N_log2 > 63)
 			return NULL;
-		params.N = (uint64_t)1 << N_log2;
+		params->N = (uint64_t)1 << N_log2;
 
-		src = decode64_uint32_fixed(&params.r, 30, src);
+		src = decode64_uint32_fixed(&params->r, 30, src);
 		if (!src)
 			return NULL;
 
-		src = decode64_uint32_fixed(&params.p, 30, src);
+		src = decode64_uint32_fixed(&params->p, 30, src);
 		if (!src)
 			return NULL;
-
-		if (key)
-			return NULL;
 	} else {
 		uint32_t flavor, N_log2;
 
@@ -363,9 +356,9 @@ uint8_t *yescrypt_r(const yescrypt_shared_t *shared, yescrypt_local_t *local,
 			return NULL;
 
 		if (flavor < YESCRYPT_RW) {
-			params.flags = flavor;
+			params->flags = flavor;
 		} else if (flavor <= YESCRYPT_RW + (YESCRYPT_RW_FLAVOR_MASK >> 2)) {
-			params.flags = YESCRYPT_RW + ((flavor - YESCRYPT_RW) << 2);
+			params->flags = YESCRYPT_RW + ((flavor - YESCRYPT_RW) << 2);
 		} else {
 			return NULL;
 		}
@@ -373,9 +366,9 @@ uint8_t *yescrypt_r(const yescrypt_shared_t *shared, yescrypt_local_t *local,
 		src = decode64_uint32(&N_log2, src, 1);
 		if (!src || N_log2 > 63)
 			return NULL;
-		params.N = (uint64_t)1 << N_log2;
+		params->N = (uint64_t)1 << N_log2;
 
-		src = decode64_uint32(&params.r, src, 1);
+		src = decode64_uint32(&params->r, src, 1);
 		if (!src)
 			return NULL;
 
@@ -387,19 +380,19 @@ uint8_t *yescrypt_r(const yescrypt_shared_t *shared, yescrypt_local_t *local,
 				return NULL;
 
 			if (have & 1) {
-				src = decode64_uint32(&params.p, src, 2);
+				src = decode64_uint32(&params->p, src, 2);
 				if (!src)
 					return NULL;
 			}
 
 			if (have & 2) {
-				src = decode64_uint32(&params.t, src, 1);
+				src = decode64_uint32(&params->t, src, 1);
 				if (!src)
 					return NULL;
 			}
 
 			if (have & 4) {
-				src = decode64_uint32(&params.g, src, 1);
+				src = decode64_uint32(&params->g, src, 1);
 				if (!src)
 					return NULL;
 			}
@@ -409,7 +402,7 @@ uint8_t *yescrypt_r(const yescrypt_shared_t *shared, yescrypt_local_t *local,
 				src = decode64_uint32(&NROM_log2, src, 1);
 				if (!src || NROM_log2 > 63)
 					return NULL;
-				params.NROM = (uint64_t)1 << NROM_log2;
+				params->NROM = (uint64_t)1 << NROM_log2;
 			}
 		}
 
@@ -417,6 +410,29 @@ uint8_t *yescrypt_r(const yescrypt_shared_t *shared, yescrypt_local_t *local,
 			return NULL;
 	}
 
+	return src;
+}
+
+uint8_t *yescrypt_r(const yescrypt_shared_t *shared, yescrypt_local_t *local,
+    const uint8_t *passwd, size_t passwdlen,
+    const uint8_t *setting,
+    const yescrypt_binary_t *key,
+    uint8_t *buf, size_t buflen)
+{
+	unsigned char saltbin[64], hashbin[32];
+	const uint8_t *src, *saltstr, *salt;
+	uint8_t *dst;
+	size_t need, prefixlen, saltstrlen, saltlen;
+	yescrypt_params_t params;
+
+	src = yescrypt_decode_params(&params, setting);
+	if (!src || (setting[1] == '7' && key))
+		return NULL;
+
+	/* A ROM is only used by hashes whose setting asks for one. */
+	if (!params.NROM)
+		shared = NULL;
+
 	prefixlen = src - setting;
 
 	saltstr = src;
@@ -0,0 +1,33 @@
+/* The yescrypt kernels (see alg-yescrypt-kernels.c) compiled for
+ * AVX, for alg-yescrypt-opt.c to use on CPUs that support it.
+ *
+ * To the extent possible under law, the author(s) have waived all
+ * copyright and related or neighboring rights to this work.
+ *
+ * See https://creativecommons.org/publicdomain/zero/1.0/ for further
+ * details.
+ */
+
+#include "crypt-port.h"
+
+#if (INCLUDE_yescrypt || INCLUDE_scrypt || INCLUDE_gost_yescrypt || \
+     INCLUDE_sm3_yescrypt) && defined HAVE_PRAGMA_TARGET_AVX
+
+#pragma GCC diagnostic ignored "-Wcast-align"
+#pragma GCC diagnostic ignored "-Wconversion"
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "byteorder.h"
+
+#define YESCRYPT_INTERNAL
+#include "alg-yescrypt.h"
+
+#pragma GCC target ("avx")
+
+#define YESCRYPT_KERNELS yescrypt_kernels_avx
+#include "alg-yescrypt-kernels.c"
+
+#endif
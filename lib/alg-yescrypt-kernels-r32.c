@@ -0,0 +1,33 @@
+/* The yescrypt kernels (see alg-yescrypt-kernels.c) compiled for
+ * r = 32 only, for alg-yescrypt-opt.c to use for YESCRYPT_RW hashes with
+ * that block size.
+ *
+ * To the extent possible under law, the author(s) have waived all
+ * copyright and related or neighboring rights to this work.
+ *
+ * See https://creativecommons.org/publicdomain/zero/1.0/ for further
+ * details.
+ */
+
+#include "crypt-port.h"
+
+#if INCLUDE_yescrypt || INCLUDE_scrypt || INCLUDE_gost_yescrypt || \
+    INCLUDE_sm3_yescrypt
+
+#pragma GCC diagnostic ignored "-Wcast-align"
+#pragma GCC diagnostic ignored "-Wconversion"
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "byteorder.h"
+
+#define YESCRYPT_INTERNAL
+#include "alg-yescrypt.h"
+
+#define YESCRYPT_FIXED_R 32
+#define YESCRYPT_KERNELS yescrypt_kernels_r32
+#include "alg-yescrypt-kernels.c"
+
+#endif
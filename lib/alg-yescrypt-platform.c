@@ -27,12 +27,292 @@
 
 #define HUGEPAGE_THRESHOLD		(32 * 1024 * 1024)
 
-#ifdef __x86_64__
+/*
+ * Regions at least this large are worth rounding up to whole huge pages
+ * when they are taken from the huge page pool, or worth aligning to a huge
+ * page boundary so that the kernel can back them with transparent huge
+ * pages.  Typical yescrypt hashes need 16 MiB or more.
+ */
+#define HUGEPAGE_MIN_REGION		(4 * 1024 * 1024)
+
+#if defined(__x86_64__) || defined(__aarch64__)
 #define HUGEPAGE_SIZE			(2 * 1024 * 1024)
 #else
 #undef HUGEPAGE_SIZE
 #endif
 
+#if defined(MAP_ANON) && defined(MAP_HUGETLB) && defined(MAP_HUGE_2MB) && \
+    defined(HUGEPAGE_SIZE) && YESCRYPT_HUGETLB
+#define USE_HUGETLB 1
+#endif
+
+#if defined(MAP_ANON) && defined(MADV_HUGEPAGE) && defined(HUGEPAGE_SIZE) && \
+    YESCRYPT_THP
+#define USE_THP 1
+#endif
+
+#if defined(USE_HUGETLB) && defined(MADV_DONTFORK) && \
+    YESCRYPT_HUGEPAGE_POOL_MB * 1024 * 1024 >= HUGEPAGE_SIZE
+#define USE_HUGEPAGE_POOL 1
+#include <pthread.h>
+#endif
+
+/*
+ * Counters behind yescrypt_get_region_stats().  They are only statistics,
+ * so relaxed atomics (or, without C11 atomics, plain racy increments) will
+ * do.
+ */
+#if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L && \
+    !defined(__STDC_NO_ATOMICS__)
+#include <stdatomic.h>
+typedef atomic_ulong region_counter_t;
+#define COUNT_REGION(counter) \
+	atomic_fetch_add_explicit(&region_counters.counter, 1, \
+	    memory_order_relaxed)
+#define READ_COUNTER(counter) \
+	atomic_load_explicit(&region_counters.counter, memory_order_relaxed)
+#else
+typedef unsigned long region_counter_t;
+#define COUNT_REGION(counter)	(region_counters.counter++)
+#define READ_COUNTER(counter)	(region_counters.counter)
+#endif
+
+static struct {
+	region_counter_t pool, hugetlb, thp, small;
+} region_counters;
+
+/*
+ * Bytes held in regions right now, and the most ever held at once, behind
+ * yescrypt_get_memory_usage().  With --enable-yescrypt-memory-limit, they are
+ * kept under a lock together with a process-wide budget set with
+ * yescrypt_set_memory_limit(), and a region that would take usage over the
+ * budget waits or is refused before any memory is mapped for it.
+ */
+#if ENABLE_YESCRYPT_MEMORY_LIMIT
+#include <pthread.h>
+
+static struct {
+	pthread_mutex_t lock;
+	pthread_cond_t cv; /* memory was released, or the budget changed */
+	size_t limit; /* 0 for none */
+	int policy;
+	size_t current, peak;
+	/*
+	 * With YESCRYPT_MEMORY_QUEUE, regions are let through in the order
+	 * they asked: each takes a ticket, and only the holder of the ticket
+	 * being served may go ahead.
+	 */
+	unsigned long next_ticket, serving;
+} budget = {
+	PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER,
+	0, YESCRYPT_MEMORY_FAIL, 0, 0, 0, 0
+};
+
+static int charge_region(size_t size)
+{
+	int queued = 0, ok = 1;
+	unsigned long ticket = 0;
+
+	pthread_mutex_lock(&budget.lock);
+	if (budget.limit && budget.policy == YESCRYPT_MEMORY_QUEUE) {
+		queued = 1;
+		ticket = budget.next_ticket++;
+	}
+	for (;;) {
+/*
+ * Even a region that gives up must wait for its turn to leave the queue, so
+ * that the ticket being served always belongs to someone.
+ */
+		if (queued && ticket != budget.serving) {
+			pthread_cond_wait(&budget.cv, &budget.lock);
+			continue;
+		}
+		if (!budget.limit || budget.current + size <= budget.limit)
+			break;
+		if (size > budget.limit ||
+		    budget.policy == YESCRYPT_MEMORY_FAIL) {
+			ok = 0;
+			break;
+		}
+		pthread_cond_wait(&budget.cv, &budget.lock);
+	}
+	if (ok) {
+		budget.current += size;
+		if (budget.peak < budget.current)
+			budget.peak = budget.current;
+	}
+	if (queued) {
+		budget.serving++;
+		pthread_cond_broadcast(&budget.cv);
+	}
+	pthread_mutex_unlock(&budget.lock);
+
+	if (!ok) {
+		errno = EAGAIN;
+		return -1;
+	}
+	return 0;
+}
+
+static void uncharge_region(size_t size)
+{
+	pthread_mutex_lock(&budget.lock);
+	budget.current -= size;
+	pthread_cond_broadcast(&budget.cv);
+	pthread_mutex_unlock(&budget.lock);
+}
+#elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L && \
+    !defined(__STDC_NO_ATOMICS__)
+static struct {
+	atomic_size_t current, peak;
+} budget;
+
+static int charge_region(size_t size)
+{
+	size_t current = atomic_fetch_add_explicit(&budget.current, size,
+	    memory_order_relaxed) + size;
+	size_t peak = atomic_load_explicit(&budget.peak, memory_order_relaxed);
+	while (peak < current &&
+	    !atomic_compare_exchange_weak_explicit(&budget.peak, &peak,
+	    current, memory_order_relaxed, memory_order_relaxed))
+		;
+	return 0;
+}
+
+static void uncharge_region(size_t size)
+{
+	atomic_fetch_sub_explicit(&budget.current, size,
+	    memory_order_relaxed);
+}
+#else
+static struct {
+	size_t current, peak;
+} budget;
+
+static int charge_region(size_t size)
+{
+	budget.current += size;
+	if (budget.peak < budget.current)
+		budget.peak = budget.current;
+	return 0;
+}
+
+static void uncharge_region(size_t size)
+{
+	budget.current -= size;
+}
+#endif
+
+#ifdef USE_HUGEPAGE_POOL
+/*
+ * A pool of explicit huge pages, mapped the first time a large region is
+ * needed and then shared by all threads of the process.  Regions taken
+ * from it are whole runs of huge pages, found first-fit.  The pool is not
+ * inherited across fork(), since the child could be killed with SIGBUS if
+ * it ran out of huge pages to copy it into; the child just does without.
+ */
+#define POOL_PAGES \
+	((size_t)YESCRYPT_HUGEPAGE_POOL_MB * 1024 * 1024 / HUGEPAGE_SIZE)
+
+static struct {
+	pthread_mutex_t lock;
+	uint8_t *base; /* NULL if the pool could not be set up */
+	unsigned char used[POOL_PAGES];
+} pool = { PTHREAD_MUTEX_INITIALIZER, NULL, { 0 } };
+
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+
+static void pool_atfork_prepare(void)
+{
+	pthread_mutex_lock(&pool.lock);
+}
+
+static void pool_atfork_parent(void)
+{
+	pthread_mutex_unlock(&pool.lock);
+}
+
+static void pool_atfork_child(void)
+{
+	pool.base = NULL;
+	pthread_mutex_unlock(&pool.lock);
+}
+
+static void pool_init(void)
+{
+	size_t size = POOL_PAGES * HUGEPAGE_SIZE;
+	int saved_errno = errno;
+	void *base = mmap(NULL, size, PROT_READ | PROT_WRITE,
+	    MAP_ANON | MAP_PRIVATE | MAP_HUGETLB | MAP_HUGE_2MB, -1, 0);
+
+	if (base != MAP_FAILED) {
+		if (madvise(base, size, MADV_DONTFORK) ||
+		    pthread_atfork(pool_atfork_prepare, pool_atfork_parent,
+		    pool_atfork_child))
+			munmap(base, size);
+		else
+			pool.base = base;
+	}
+	errno = saved_errno;
+}
+
+static void *pool_alloc(size_t size, size_t *base_size)
+{
+	size_t npages = size / HUGEPAGE_SIZE + (size % HUGEPAGE_SIZE != 0);
+	size_t i, run = 0;
+	uint8_t *base = NULL;
+
+	if (pthread_once(&pool_once, pool_init))
+		return NULL;
+
+	pthread_mutex_lock(&pool.lock);
+	if (pool.base && npages <= POOL_PAGES) {
+		for (i = 0; i < POOL_PAGES; i++) {
+			run = pool.used[i] ? 0 : run + 1;
+			if (run == npages) {
+				i -= npages - 1;
+				memset(&pool.used[i], 1, npages);
+				base = pool.base + i * HUGEPAGE_SIZE;
+				*base_size = npages * HUGEPAGE_SIZE;
+				break;
+			}
+		}
+	}
+	pthread_mutex_unlock(&pool.lock);
+
+	return base;
+}
+
+static int pool_contains(const void *p)
+{
+	const uint8_t *base = pool.base;
+	return base && (const uint8_t *)p >= base &&
+	    (const uint8_t *)p < base + POOL_PAGES * HUGEPAGE_SIZE;
+}
+
+/*
+ * Erase a region that came from the pool, since its next user might be
+ * another thread, and give its pages back.
+ */
+static void pool_free(yescrypt_region_t *region)
+{
+	size_t first = (size_t)((uint8_t *)region->base - pool.base) /
+	    HUGEPAGE_SIZE;
+
+	explicit_bzero(region->base, region->base_size);
+
+	pthread_mutex_lock(&pool.lock);
+	memset(&pool.used[first], 0, region->base_size / HUGEPAGE_SIZE);
+	pthread_mutex_unlock(&pool.lock);
+}
+#endif
+
+static inline void init_region(yescrypt_region_t *region)
+{
+	region->base = region->aligned = NULL;
+	region->base_size = region->aligned_size = 0;
+}
+
 static void *alloc_region(yescrypt_region_t *region, size_t size)
 {
 	size_t base_size = size;
@@ -43,41 +323,93 @@ static void *alloc_region(yescrypt_region_t *region, size_t size)
 	    MAP_NOCORE |
 #endif
 	    MAP_ANON | MAP_PRIVATE;
-#if defined(MAP_HUGETLB) && defined(MAP_HUGE_2MB) && defined(HUGEPAGE_SIZE)
-	size_t new_size = size;
+#if defined(USE_HUGETLB) || defined(USE_THP)
 	const size_t hugepage_mask = (size_t)HUGEPAGE_SIZE - 1;
-	if (size >= HUGEPAGE_THRESHOLD && size + hugepage_mask >= size) {
-		flags |= MAP_HUGETLB | MAP_HUGE_2MB;
+#endif
+
+	if (charge_region(size)) {
+		init_region(region);
+		return NULL;
+	}
+
+	base = MAP_FAILED;
+#ifdef USE_HUGEPAGE_POOL
+	if (size >= HUGEPAGE_MIN_REGION && size + hugepage_mask >= size) {
+		base = pool_alloc(size, &base_size);
+		if (base) {
+			COUNT_REGION(pool);
+		} else {
+			base = MAP_FAILED;
+			base_size = size;
+		}
+	}
+#endif
+#ifdef USE_HUGETLB
+	if (base == MAP_FAILED &&
+	    size >= HUGEPAGE_THRESHOLD && size + hugepage_mask >= size) {
 /*
  * Linux's munmap() fails on MAP_HUGETLB mappings if size is not a multiple of
  * huge page size, so let's round up to huge page size here.
  */
-		new_size = size + hugepage_mask;
+		size_t new_size = size + hugepage_mask;
 		new_size &= ~hugepage_mask;
+		base = mmap(NULL, new_size, PROT_READ | PROT_WRITE,
+		    (int)(flags | MAP_HUGETLB | MAP_HUGE_2MB), -1, 0);
+		if (base != MAP_FAILED) {
+			base_size = new_size;
+			COUNT_REGION(hugetlb);
+		}
 	}
-	base = mmap(NULL, new_size, PROT_READ | PROT_WRITE, (int)flags, -1, 0);
-	if (base != MAP_FAILED) {
-		base_size = new_size;
-	} else if (flags & MAP_HUGETLB) {
-		flags &= ~(unsigned int)(MAP_HUGETLB | MAP_HUGE_2MB);
-		base = mmap(NULL, size, PROT_READ | PROT_WRITE, (int)flags, -1, 0);
+#endif
+	aligned = base;
+#ifdef USE_THP
+/*
+ * Map an extra huge page's worth, so that the region can start on a huge page
+ * boundary, and ask for it to be backed by transparent huge pages.  The pages
+ * beyond the region are never touched, so they cost address space only.
+ */
+	if (base == MAP_FAILED &&
+	    size >= HUGEPAGE_MIN_REGION && size + hugepage_mask >= size) {
+		base_size = size + hugepage_mask;
+		base = mmap(NULL, base_size, PROT_READ | PROT_WRITE, (int)flags,
+		    -1, 0);
+		if (base != MAP_FAILED) {
+			aligned = base + (-(uintptr_t)base & hugepage_mask);
+			if (madvise(aligned, size, MADV_HUGEPAGE))
+				COUNT_REGION(small);
+			else
+				COUNT_REGION(thp);
+		} else {
+			base_size = size;
+		}
 	}
-
-#else
-	base = mmap(NULL, size, PROT_READ | PROT_WRITE, (int)flags, -1, 0);
 #endif
+	if (base == MAP_FAILED) {
+		base = mmap(NULL, size, PROT_READ | PROT_WRITE, (int)flags,
+		    -1, 0);
+		aligned = base;
+		if (base != MAP_FAILED)
+			COUNT_REGION(small);
+	}
 	if (base == MAP_FAILED)
-		base = NULL;
-	aligned = base;
+		base = aligned = NULL;
 #else /* mmap not available */
+	if (charge_region(size)) {
+		init_region(region);
+		return NULL;
+	}
+
 	base = aligned = NULL;
 	if (size + 63 < size) {
 		errno = ENOMEM;
 	} else if ((base = malloc(size + 63)) != NULL) {
 		aligned = base + 63;
 		aligned -= (uintptr_t)aligned & 63;
+		COUNT_REGION(small);
 	}
 #endif
+	if (!base)
+		uncharge_region(size);
 	region->base = base;
 	region->aligned = aligned;
 	region->base_size = base ? base_size : 0;
@@ -85,21 +417,28 @@ static void *alloc_region(yescrypt_region_t *region, size_t size)
 	return aligned;
 }
 
-static inline void init_region(yescrypt_region_t *region)
-{
-	region->base = region->aligned = NULL;
-	region->base_size = region->aligned_size = 0;
-}
-
 static int free_region(yescrypt_region_t *region)
 {
 	if (region->base) {
+#ifdef USE_HUGEPAGE_POOL
+		if (pool_contains(region->base))
+			pool_free(region);
+		else
+#endif
 #ifdef MAP_ANON
-		if (munmap(region->base, region->base_size))
+		if (munmap(region->base, region->base_size)) {
+			/* Stop counting the region anyway, or its bytes
+			 * would stay charged against the memory budget for
+			 * good.  It has nothing left to uncharge should the
+			 * caller try to free it again. */
+			uncharge_region(region->aligned_size);
+			region->aligned_size = 0;
 			return -1;
+		}
 #else
 		free(region->base);
 #endif
+		uncharge_region(region->aligned_size);
 	}
 	init_region(region);
 	return 0;
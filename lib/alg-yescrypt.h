@@ -70,6 +70,19 @@ typedef struct {
 typedef yescrypt_region_t yescrypt_shared_t;
 typedef yescrypt_region_t yescrypt_local_t;
 
+/**
+ * Number of memory regions allocated each way since the process started, as
+ * reported by yescrypt_get_region_stats().  Which ways are tried depends on
+ * the --enable-yescrypt-hugepages and --enable-yescrypt-hugepage-pool
+ * configure options, the size of the region, and what the system allows.
+ */
+typedef struct {
+	unsigned long pool; /* huge pages from the process-wide pool */
+	unsigned long hugetlb; /* huge pages mapped for this region alone */
+	unsigned long thp; /* ordinary pages, marked for transparent huge pages */
+	unsigned long small; /* ordinary pages */
+} yescrypt_region_stats_t;
+
 /**
  * Two 64-bit tags placed 48 bytes to the end of a ROM in host byte endianness
  * (and followed by 32 bytes of the ROM digest).
@@ -214,6 +227,67 @@ extern int yescrypt_init_local(yescrypt_local_t *local);
  */
 extern int yescrypt_free_local(yescrypt_local_t *local);
 
+/**
+ * yescrypt_region_pooled(region):
+ * Return nonzero if region's memory came from the process-wide huge page
+ * pool, and should therefore be freed promptly rather than kept for reuse by
+ * one thread.
+ *
+ * MT-safe.
+ */
+extern int yescrypt_region_pooled(const yescrypt_region_t *region);
+
+/**
+ * yescrypt_get_region_stats(stats):
+ * Fill in stats with the number of memory regions allocated each way so far.
+ *
+ * MT-safe.
+ */
+extern void yescrypt_get_region_stats(yescrypt_region_stats_t *stats);
+
+/**
+ * What a region does when allocating it would take the memory held in all
+ * regions over the limit set with yescrypt_set_memory_limit(): fail with
+ * EAGAIN, wait until enough memory has been freed, or wait in line behind
+ * the regions that asked before it.  These are the same values as the
+ * CRYPT_YESCRYPT_MEMORY_* constants in <crypt.h>.
+ */
+#define YESCRYPT_MEMORY_FAIL		0
+#define YESCRYPT_MEMORY_BLOCK		1
+#define YESCRYPT_MEMORY_QUEUE		2
+
+/**
+ * yescrypt_set_memory_limit(limit, policy):
+ * Limit the memory held in all regions of the process at once to limit bytes,
+ * or remove the limit if limit is 0, and set what happens to regions that
+ * would exceed it.  A region larger than the limit always fails.  Memory
+ * already held is not affected.
+ *
+ * Return 0 on success; or -1 on error, with errno set to EINVAL for an
+ * unknown policy, or to ENOSYS if libxcrypt was configured without
+ * --enable-yescrypt-memory-limit.
+ *
+ * MT-safe.
+ */
+extern int yescrypt_set_memory_limit(size_t limit, int policy);
+
+/**
+ * yescrypt_memory_limited():
+ * Return nonzero if a limit set with yescrypt_set_memory_limit() is in force.
+ *
+ * MT-safe.
+ */
+extern int yescrypt_memory_limited(void);
+
+/**
+ * yescrypt_get_memory_usage(current, peak):
+ * Report the number of bytes held in regions right now, and the most ever
+ * held at once since the process started.
+ *
+ * MT-safe.
+ */
+extern void yescrypt_get_memory_usage(size_t *current, size_t *peak);
+
 /**
  * yescrypt_kdf(shared, local, passwd, passwdlen, salt, saltlen, params,
  *     buf, buflen):
@@ -313,6 +387,19 @@ extern uint8_t *yescrypt_reencrypt(uint8_t *hash,
     const yescrypt_binary_t *from_key,
     const yescrypt_binary_t *to_key);
 
+/**
+ * yescrypt_decode_params(params, setting):
+ * Decode the parameters from a "$y$" or "$7$" setting string, as produced by
+ * yescrypt_encode_params_r(), into params.
+ *
+ * Return a pointer to the start of the salt in setting on success; or NULL
+ * if the parameters are malformed.
+ *
+ * MT-safe.
+ */
+extern const uint8_t *yescrypt_decode_params(yescrypt_params_t *params,
+    const uint8_t *setting);
+
 /**
  * yescrypt_encode_params_r(params, src, srclen, buf, buflen):
  * Generate a setting string for use with yescrypt_r() and yescrypt() by
@@ -341,6 +428,51 @@ extern uint8_t *yescrypt_encode_params_r(const yescrypt_params_t *params,
 extern uint8_t *yescrypt_encode_params(const yescrypt_params_t *params,
     const uint8_t *src, size_t srclen);
 
+/**
+ * acquire_yescrypt_local(fallback):
+ * Get a thread-local (RAM) data structure for computing one hash.  If
+ * libxcrypt was configured with --enable-yescrypt-cache, this is the calling
+ * thread's cached one, whose memory may still be mapped from a previous call;
+ * otherwise it is fallback, freshly initialized.
+ *
+ * Return the data structure on success; or NULL on error.
+ *
+ * MT-safe.
+ */
+extern yescrypt_local_t *acquire_yescrypt_local(yescrypt_local_t *fallback);
+
+/**
+ * release_yescrypt_local(local):
+ * Release a data structure obtained from acquire_yescrypt_local().  Cached
+ * memory is erased, and kept mapped if it is no larger than the configured
+ * limit; other memory is freed.
+ *
+ * Return 0 on success; or -1 on error.
+ *
+ * MT-safe as long as local came from acquire_yescrypt_local() in this thread.
+ */
+extern int release_yescrypt_local(yescrypt_local_t *local);
+
+/**
+ * acquire_yescrypt_rom():
+ * Get the ROM loaded into this process with crypt_yescrypt_rom_load(), if
+ * any.  It stays mapped until the matching release_yescrypt_rom() call, even
+ * if it is unloaded or replaced in the meantime.
+ *
+ * Return the ROM; or NULL if none is loaded.
+ *
+ * MT-safe.
+ */
+extern yescrypt_shared_t *acquire_yescrypt_rom(void);
+
+/**
+ * release_yescrypt_rom(shared):
+ * Release a ROM obtained from acquire_yescrypt_rom().  shared may be NULL.
+ *
+ * MT-safe.
+ */
+extern void release_yescrypt_rom(yescrypt_shared_t *shared);
+
 #ifdef YESCRYPT_INTERNAL
 
 #define decode64 yescrypt_decode64
@@ -716,9 +716,14 @@ static_assert (sizeof (struct BF_buffer) <= ALG_SPECIFIC_SIZE,
                "ALG_SPECIFIC_SIZE is too small for bcrypt");
 
 
+/* Subroutine of BF_crypt and BF_batch: check SETTING, and initialize
+   DATA for hashing KEY with it, up to the start of the expensive key
+   schedule.  Store the number of iterations of the expensive key
+   schedule in *COUNTP.  Returns false and sets errno if SETTING is
+   invalid or asks for fewer than MIN iterations.  */
 static bool
-BF_crypt (const char *key, const char *setting, unsigned char *output,
-          struct BF_data *data, BF_word min)
+BF_crypt_prepare (const char *key, const char *setting,
+                  struct BF_data *data, BF_word min, BF_word *countp)
 {
   BF_word L, R;
   BF_word tmp1, tmp2, tmp3, tmp4;
@@ -781,6 +786,20 @@ BF_crypt (const char *key, const char *setting, unsigned char *output,
     }
   while (ptr < &data->ctx.S[3][0xFF]);
 
+  *countp = count;
+  return true;
+}
+
+/* Subroutine of BF_crypt and BF_batch: run COUNT iterations of the
+   expensive key schedule on DATA.  */
+static void
+BF_expensive (struct BF_data *data, BF_word count)
+{
+  BF_word L, R;
+  BF_word tmp1, tmp2, tmp3, tmp4;
+  BF_word *ptr;
+  int i;
+
   do
     {
       int done;
@@ -816,6 +835,19 @@ BF_crypt (const char *key, const char *setting, unsigned char *output,
       while (1);
     }
   while (--count);
+}
+
+/* Subroutine of BF_crypt and BF_batch: encrypt the magic IV with the
+   final key schedule in DATA, and write the complete hash string for
+   SETTING to OUTPUT, which must be at least BF_HASH_LENGTH bytes.  */
+static void
+BF_crypt_finish (const char *setting, unsigned char *output,
+                 struct BF_data *data)
+{
+  BF_word L, R;
+  BF_word tmp1, tmp2, tmp3, tmp4;
+  BF_word count;
+  int i;
 
   for (i = 0; i < 6; i += 2)
     {
@@ -844,7 +876,18 @@ BF_crypt (const char *key, const char *setting, unsigned char *output,
   BF_swap (data->binary.output, 6);
   BF_encode (&output[BF_SETTING_LENGTH], data->binary.output, 23);
   output[BF_HASH_LENGTH - 1] = '\0';
+}
+
+static bool
+BF_crypt (const char *key, const char *setting, unsigned char *output,
+          struct BF_data *data, BF_word min)
+{
+  BF_word count;
 
+  if (!BF_crypt_prepare (key, setting, data, min, &count))
+    return false;
+  BF_expensive (data, count);
+  BF_crypt_finish (setting, output, data);
   return true;
 }
 
@@ -868,32 +911,9 @@ BF_crypt (const char *key, const char *setting, unsigned char *output,
  * The performance cost of this quick self-test is around 0.6% at the "$2a$08"
  * setting.
  */
-static void
-BF_full_crypt (const char *phrase, const char *setting,
-               uint8_t *output, size_t out_size,
-               void *scratch, size_t scr_size)
+static bool
+BF_self_test (char subtype, struct BF_buffer *buffer)
 {
-  /* This shouldn't ever happen, but...  */
-  if (out_size < BF_HASH_LENGTH || scr_size < sizeof (struct BF_buffer))
-    {
-      errno = ERANGE;
-      return;
-    }
-  struct BF_buffer *buffer = scratch;
-
-  /* Hash the supplied password */
-  if (!BF_crypt (phrase, setting, buffer->re_output, &buffer->data, 16))
-    return; /* errno has already been set */
-
-  /* Save and restore the current value of errno around the self-test.  */
-  int save_errno = errno;
-
-  /* Do a quick self-test.  It is important that we make both calls to
-     BF_crypt() from the same scope such that they likely use the same
-     stack locations, which makes the second call overwrite the first
-     call's sensitive data on the stack and makes it more likely that
-     any alignment related issues would be detected by the self-test.  */
-
   static const char test_key[] = "8b \xd0\xc1\xd2\xcf\xcc\xd8";
   static const char test_setting_init[] = "$2a$00$abcdefghijklmnopqrstuu";
   static const char *const test_hashes[2] =
@@ -904,12 +924,12 @@ BF_full_crypt (const char *phrase, const char *setting,
   const char *test_hash = test_hashes[0];
   char test_setting[BF_SETTING_LENGTH];
   unsigned int flags = flags_by_subtype[(unsigned int) (unsigned char)
-                                                       setting[2] - 'a'];
+                                                       subtype - 'a'];
   bool ok;
 
   memcpy (test_setting, test_setting_init, BF_SETTING_LENGTH);
   test_hash = test_hashes[flags & 1];
-  test_setting[2] = setting[2];
+  test_setting[2] = subtype;
 
   memset (buffer->st_output, 0x55, sizeof buffer->st_output);
 
@@ -929,7 +949,35 @@ BF_full_crypt (const char *phrase, const char *setting,
          !memcmp (ae, ye, sizeof (ae)) && !memcmp (ai, yi, sizeof (ai));
   }
 
-  if (!ok)
+  return ok;
+}
+
+static void
+BF_full_crypt (const char *phrase, const char *setting,
+               uint8_t *output, size_t out_size,
+               void *scratch, size_t scr_size)
+{
+  /* This shouldn't ever happen, but...  */
+  if (out_size < BF_HASH_LENGTH || scr_size < sizeof (struct BF_buffer))
+    {
+      errno = ERANGE;
+      return;
+    }
+  struct BF_buffer *buffer = scratch;
+
+  /* Hash the supplied password */
+  if (!BF_crypt (phrase, setting, buffer->re_output, &buffer->data, 16))
+    return; /* errno has already been set */
+
+  /* Save and restore the current value of errno around the self-test.  */
+  int save_errno = errno;
+
+  /* Do a quick self-test.  It is important that we make both calls to
+     BF_crypt() from the same scope such that they likely use the same
+     stack locations, which makes the second call overwrite the first
+     call's sensitive data on the stack and makes it more likely that
+     any alignment related issues would be detected by the self-test.  */
+  if (!BF_self_test (setting[2], buffer))
     {
       /* Self-test failed; pretend we don't support this hash type.  */
       errno = EINVAL;
@@ -941,6 +989,201 @@ BF_full_crypt (const char *phrase, const char *setting,
   memcpy (output, buffer->re_output, BF_HASH_LENGTH);
   errno = save_errno;
 }
+
+/*
+ * The expensive key schedule is a long chain of dependent S-box
+ * lookups, so a single hash leaves most of the CPU's load units idle.
+ * BF_batch runs the key schedules of BF_LANES hashes with the same cost
+ * in lockstep, interleaving their instructions so that the loads of
+ * one hash overlap with those of the others.  (Gathering the lookups of
+ * several hashes into SIMD registers would be the other way to do
+ * this, but on current x86 CPUs vector gathers are slower than the
+ * same number of scalar loads.)
+ */
+#define BF_LANES 2
+#define BF_FOR_LANES(m, ...) m (0, __VA_ARGS__) m (1, __VA_ARGS__)
+
+#define BF_LANE_ROUND(l, A, B, N) \
+        B[l] ^= D[l]->ctx.P[N + 1] ^ \
+          (((D[l]->ctx.S[0][A[l] >> 24] + \
+             D[l]->ctx.S[1][(A[l] >> 16) & 0xFF]) ^ \
+            D[l]->ctx.S[2][(A[l] >> 8) & 0xFF]) + \
+           D[l]->ctx.S[3][A[l] & 0xFF]);
+#define BF_LANE_START(l, unused) \
+        L[l] ^= D[l]->ctx.P[0];
+#define BF_LANE_SWAP(l, unused) \
+        tmp[l] = R[l]; \
+        R[l] = L[l]; \
+        L[l] = tmp[l] ^ D[l]->ctx.P[BF_N + 1];
+#define BF_LANE_ZERO(l, unused) \
+        L[l] = R[l] = 0;
+#define BF_LANE_STORE_P(l, j) \
+        D[l]->ctx.P[j] = L[l]; \
+        D[l]->ctx.P[j + 1] = R[l];
+#define BF_LANE_STORE_S(l, j) \
+        D[l]->ctx.S[j >> 8][j & 0xFF] = L[l]; \
+        D[l]->ctx.S[j >> 8][(j & 0xFF) + 1] = R[l];
+#define BF_LANE_XOR_KEY(l, i) \
+        D[l]->ctx.P[i] ^= D[l]->expanded_key[i];
+#define BF_LANE_XOR_SALT(l, i) \
+        D[l]->ctx.P[i] ^= D[l]->binary.salt[i & 3];
+
+#define BF_LANES_ENCRYPT \
+        BF_FOR_LANES (BF_LANE_START, 0) \
+        BF_FOR_LANES (BF_LANE_ROUND, L, R, 0) \
+        BF_FOR_LANES (BF_LANE_ROUND, R, L, 1) \
+        BF_FOR_LANES (BF_LANE_ROUND, L, R, 2) \
+        BF_FOR_LANES (BF_LANE_ROUND, R, L, 3) \
+        BF_FOR_LANES (BF_LANE_ROUND, L, R, 4) \
+        BF_FOR_LANES (BF_LANE_ROUND, R, L, 5) \
+        BF_FOR_LANES (BF_LANE_ROUND, L, R, 6) \
+        BF_FOR_LANES (BF_LANE_ROUND, R, L, 7) \
+        BF_FOR_LANES (BF_LANE_ROUND, L, R, 8) \
+        BF_FOR_LANES (BF_LANE_ROUND, R, L, 9) \
+        BF_FOR_LANES (BF_LANE_ROUND, L, R, 10) \
+        BF_FOR_LANES (BF_LANE_ROUND, R, L, 11) \
+        BF_FOR_LANES (BF_LANE_ROUND, L, R, 12) \
+        BF_FOR_LANES (BF_LANE_ROUND, R, L, 13) \
+        BF_FOR_LANES (BF_LANE_ROUND, L, R, 14) \
+        BF_FOR_LANES (BF_LANE_ROUND, R, L, 15) \
+        BF_FOR_LANES (BF_LANE_SWAP, 0)
+
+#define BF_LANES_BODY() \
+        BF_FOR_LANES (BF_LANE_ZERO, 0) \
+        for (j = 0; j < BF_N + 2; j += 2) \
+          { \
+            BF_LANES_ENCRYPT \
+            BF_FOR_LANES (BF_LANE_STORE_P, j) \
+          } \
+        for (j = 0; j < 4 * 0x100; j += 2) \
+          { \
+            BF_LANES_ENCRYPT \
+            BF_FOR_LANES (BF_LANE_STORE_S, j) \
+          }
+
+/* Run COUNT iterations of the expensive key schedule on each of the
+   BF_LANES elements of D at once.  This is BF_expensive, interleaved.  */
+static void
+BF_expensive_lanes (struct BF_data *const D[BF_LANES], BF_word count)
+{
+  BF_word L[BF_LANES], R[BF_LANES], tmp[BF_LANES];
+  unsigned int i, j;
+
+  do
+    {
+      for (i = 0; i < BF_N + 2; i++)
+        {
+          BF_FOR_LANES (BF_LANE_XOR_KEY, i)
+        }
+      BF_LANES_BODY ();
+
+      for (i = 0; i < BF_N + 2; i++)
+        {
+          BF_FOR_LANES (BF_LANE_XOR_SALT, i)
+        }
+      BF_LANES_BODY ();
+    }
+  while (--count);
+}
+
+/* Scratch space for BF_batch.  */
+struct BF_batch_buffer
+{
+  struct BF_data data[BF_LANES];
+  struct crypt_batch_item *items[BF_LANES];
+  unsigned char output[BF_LANES][BF_HASH_LENGTH];
+  struct BF_buffer self_test;
+};
+
+static_assert (sizeof (struct BF_batch_buffer) <= ALG_BATCH_SPECIFIC_SIZE,
+               "ALG_BATCH_SPECIFIC_SIZE is too small for bcrypt");
+
+/* Subroutine of BF_batch: finish the first N hashes that have been
+   set up in BUF, which all take COUNT iterations.  */
+static void
+BF_batch_flush (struct BF_batch_buffer *buf, size_t n, BF_word count)
+{
+  struct BF_data *lanes[BF_LANES];
+  size_t i;
+
+  if (n == BF_LANES)
+    {
+      for (i = 0; i < BF_LANES; i++)
+        lanes[i] = &buf->data[i];
+      BF_expensive_lanes (lanes, count);
+    }
+  else
+    for (i = 0; i < n; i++)
+      BF_expensive (&buf->data[i], count);
+
+  for (i = 0; i < n; i++)
+    BF_crypt_finish (buf->items[i]->setting, buf->output[i],
+                     &buf->data[i]);
+
+  /* As in BF_full_crypt; the self-test also overwrites the key
+     schedules left on the stack by BF_crypt_finish.  */
+  int save_errno = errno;
+  for (i = 0; i < n; i++)
+    if (!BF_self_test (buf->items[i]->setting[2], &buf->self_test))
+      {
+        errno = EINVAL;
+        return;
+      }
+  errno = save_errno;
+
+  for (i = 0; i < n; i++)
+    memcpy (buf->items[i]->output, buf->output[i], BF_HASH_LENGTH);
+}
+
+/* Compute several bcrypt hashes, BF_LANES at a time.  Hashes are only
+   interleaved with others of the same cost; callers should sort the
+   items by cost to get the most out of this.  */
+static void
+BF_batch (struct crypt_batch_item *items, size_t nitems,
+          void *scratch, size_t scr_size)
+{
+  if (scr_size < sizeof (struct BF_batch_buffer))
+    {
+      errno = ERANGE;
+      return;
+    }
+
+  struct BF_batch_buffer *buf = scratch;
+  BF_word count, lane_count = 0;
+  size_t i, n = 0;
+
+  for (i = 0; i < nitems; i++)
+    {
+      struct crypt_batch_item *item = &items[i];
+
+      if (item->out_size < BF_HASH_LENGTH)
+        {
+          errno = ERANGE;
+          continue;
+        }
+      if (n > 0 && (item->set_size < 6 ||
+                    item->setting[4] != buf->items[0]->setting[4] ||
+                    item->setting[5] != buf->items[0]->setting[5]))
+        {
+          BF_batch_flush (buf, n, lane_count);
+          n = 0;
+        }
+      if (!BF_crypt_prepare (item->phrase, item->setting, &buf->data[n],
+                             16, &count))
+        continue;
+
+      buf->items[n] = item;
+      lane_count = count;
+      if (++n == BF_LANES)
+        {
+          BF_batch_flush (buf, n, lane_count);
+          n = 0;
+        }
+    }
+
+  if (n > 0)
+    BF_batch_flush (buf, n, lane_count);
+}
 #endif
 
 #if INCLUDE_bcrypt || INCLUDE_bcrypt_a || INCLUDE_bcrypt_y
@@ -981,6 +1224,8 @@ BF_gensalt (char subtype, unsigned long count,
 #endif
 
 #if INCLUDE_bcrypt
+const size_t footprint_bcrypt_rn = sizeof (struct BF_buffer);
+
 void
 crypt_bcrypt_rn (const char *phrase, size_t ARG_UNUSED (phr_size),
                  const char *setting, size_t ARG_UNUSED (set_size),
@@ -990,6 +1235,13 @@ crypt_bcrypt_rn (const char *phrase, size_t ARG_UNUSED (phr_size),
   BF_full_crypt (phrase, setting, output, out_size, scratch, scr_size);
 }
 
+void
+crypt_bcrypt_batch_rn (struct crypt_batch_item *items, size_t nitems,
+                       void *scratch, size_t scr_size)
+{
+  BF_batch (items, nitems, scratch, scr_size);
+}
+
 void
 gensalt_bcrypt_rn (unsigned long count,
                    const uint8_t *rbytes, size_t nrbytes,
@@ -1000,6 +1252,8 @@ gensalt_bcrypt_rn (unsigned long count,
 #endif
 
 #if INCLUDE_bcrypt_a
+const size_t footprint_bcrypt_a_rn = sizeof (struct BF_buffer);
+
 void
 crypt_bcrypt_a_rn (const char *phrase, size_t ARG_UNUSED (phr_size),
                    const char *setting, size_t ARG_UNUSED (set_size),
@@ -1009,6 +1263,13 @@ crypt_bcrypt_a_rn (const char *phrase, size_t ARG_UNUSED (phr_size),
   BF_full_crypt (phrase, setting, output, out_size, scratch, scr_size);
 }
 
+void
+crypt_bcrypt_a_batch_rn (struct crypt_batch_item *items, size_t nitems,
+                         void *scratch, size_t scr_size)
+{
+  BF_batch (items, nitems, scratch, scr_size);
+}
+
 void
 gensalt_bcrypt_a_rn (unsigned long count,
                      const uint8_t *rbytes, size_t nrbytes,
@@ -1019,6 +1280,8 @@ gensalt_bcrypt_a_rn (unsigned long count,
 #endif
 
 #if INCLUDE_bcrypt_x
+const size_t footprint_bcrypt_x_rn = sizeof (struct BF_buffer);
+
 void
 crypt_bcrypt_x_rn (const char *phrase, size_t ARG_UNUSED (phr_size),
                    const char *setting, size_t ARG_UNUSED (set_size),
@@ -1028,6 +1291,13 @@ crypt_bcrypt_x_rn (const char *phrase, size_t ARG_UNUSED (phr_size),
   BF_full_crypt (phrase, setting, output, out_size, scratch, scr_size);
 }
 
+void
+crypt_bcrypt_x_batch_rn (struct crypt_batch_item *items, size_t nitems,
+                         void *scratch, size_t scr_size)
+{
+  BF_batch (items, nitems, scratch, scr_size);
+}
+
 void
 gensalt_bcrypt_x_rn (ARG_UNUSED(unsigned long count),
                      ARG_UNUSED(const uint8_t *rbytes),
@@ -1042,6 +1312,8 @@ gensalt_bcrypt_x_rn (ARG_UNUSED(unsigned long count),
 #endif
 
 #if INCLUDE_bcrypt_y
+const size_t footprint_bcrypt_y_rn = sizeof (struct BF_buffer);
+
 void
 crypt_bcrypt_y_rn (const char *phrase, size_t ARG_UNUSED (phr_size),
                    const char *setting, size_t ARG_UNUSED (set_size),
@@ -1051,6 +1323,13 @@ crypt_bcrypt_y_rn (const char *phrase, size_t ARG_UNUSED (phr_size),
   BF_full_crypt (phrase, setting, output, out_size, scratch, scr_size);
 }
 
+void
+crypt_bcrypt_y_batch_rn (struct crypt_batch_item *items, size_t nitems,
+                         void *scratch, size_t scr_size)
+{
+  BF_batch (items, nitems, scratch, scr_size);
+}
+
 void
 gensalt_bcrypt_y_rn (unsigned long count,
                      const uint8_t *rbytes, size_t nrbytes,
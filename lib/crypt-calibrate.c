@@ -0,0 +1,283 @@
+/* Choosing the cost of new hashes by timing them on this machine.
+
+   For each hashing method with a tunable cost, crypt_gensalt_calibrate
+   times crypt_rn on settings from crypt_gensalt_rn with increasing
+   values of COUNT, and picks the largest COUNT whose hashes take no
+   longer than the caller asks for and use no more memory.  Timings
+   are remembered for the life of the process, so only the first call
+   for each method is slow.
+
+   To the extent possible under law, the author(s) have waived all
+   copyright and related or neighboring rights to this work.
+
+   See https://creativecommons.org/publicdomain/zero/1.0/ for further
+   details.  */
+
+#include "crypt-port.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <time.h>
+
+#if INCLUDE_crypt_gensalt_calibrate
+
+#ifdef CLOCK_MONOTONIC
+#define CALIBRATE_CLOCK CLOCK_MONOTONIC
+#else
+#define CALIBRATE_CLOCK CLOCK_REALTIME
+#endif
+
+/* Hashes that take less time than this are repeated, and the fastest
+   run is used, to keep timer resolution and interruptions from
+   skewing the result.  */
+#define CHEAP_NS 10000000ULL
+#define CHEAP_RUNS 5
+
+/* A number of rounds is timed on a count that takes at least this
+   long, and scaled from there.  */
+#define LINEAR_SAMPLE_NS 2000000ULL
+
+/* How COUNT translates into cost for one method.  If LINEAR, COUNT is
+   a number of rounds and the time taken is proportional to it;
+   otherwise, each step of COUNT doubles the time.  MEMORY gives the
+   memory used by a hash with a given COUNT, or is null if that is
+   small enough not to matter.  NS caches timings: for a linear
+   method, NS[0] is the time for ROUND_UNIT rounds; otherwise NS[i] is
+   the time for COUNT i.  Zero means not measured yet.  */
+struct calibration
+{
+  const char *prefix;
+  unsigned long min_count;
+  unsigned long max_count;
+  bool linear;
+  unsigned long (*memory) (unsigned long count);
+  uint64_t ns[32];
+};
+
+/* Rounds for linear methods are chosen in multiples of this.  */
+#define ROUND_UNIT 1000
+
+#if INCLUDE_yescrypt || INCLUDE_gost_yescrypt || INCLUDE_sm3_yescrypt
+/* Mirrors gensalt_yescrypt_rn: 1 KiB blocks for counts 1 and 2,
+   4 KiB blocks from 3 on, and twice as many blocks for every step.  */
+static unsigned long
+yescrypt_memory (unsigned long count)
+{
+  if (count < 3)
+    return (1UL << 20) << (count - 1);
+  return (4UL << 20) << (count - 3);
+}
+#endif
+
+#if INCLUDE_scrypt
+/* Mirrors gensalt_scrypt_rn: N = 2^(count + 7) blocks of 4 KiB.  */
+static unsigned long
+scrypt_memory (unsigned long count)
+{
+  return (4096UL << 7) << count;
+}
+#endif
+
+static struct calibration calibrations[] =
+{
+#if INCLUDE_yescrypt
+  { "$y$", 1, 11, false, yescrypt_memory, { 0 } },
+#endif
+#if INCLUDE_gost_yescrypt
+  { "$gy$", 1, 11, false, yescrypt_memory, { 0 } },
+#endif
+#if INCLUDE_sm3_yescrypt
+  { "$sm3y$", 1, 11, false, yescrypt_memory, { 0 } },
+#endif
+#if INCLUDE_scrypt
+  { "$7$", 6, 11, false, scrypt_memory, { 0 } },
+#endif
+#if INCLUDE_bcrypt
+  { "$2b$", 4, 31, false, 0, { 0 } },
+#endif
+#if INCLUDE_bcrypt_y
+  { "$2y$", 4, 31, false, 0, { 0 } },
+#endif
+#if INCLUDE_bcrypt_a
+  { "$2a$", 4, 31, false, 0, { 0 } },
+#endif
+#if INCLUDE_sha512crypt
+  { "$6$", 1000, 999999999, true, 0, { 0 } },
+#endif
+#if INCLUDE_sha256crypt
+  { "$5$", 1000, 999999999, true, 0, { 0 } },
+#endif
+#if INCLUDE_sm3crypt
+  { "$sm3$", 1000, 999999999, true, 0, { 0 } },
+#endif
+};
+
+static uint64_t
+now_ns (void)
+{
+  struct timespec ts;
+  clock_gettime (CALIBRATE_CLOCK, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+/* Return how long it takes to hash a passphrase with COUNT for method
+   C, or 0 on failure, with errno set.  */
+static uint64_t
+time_count (const struct calibration *c, unsigned long count,
+            struct crypt_data *data)
+{
+  static const char rbytes[UCHAR_MAX];
+  char setting[CRYPT_GENSALT_OUTPUT_SIZE];
+  uint64_t best = UINT64_MAX, total = 0;
+  int runs;
+
+  /* The salt does not affect the time taken, so there is no need to
+     spend random bytes on it.  */
+  if (!crypt_gensalt_rn (c->prefix, count, rbytes, sizeof rbytes,
+                         setting, sizeof setting))
+    return 0;
+
+  for (runs = 0; runs < CHEAP_RUNS && total < CHEAP_NS; runs++)
+    {
+      uint64_t start = now_ns ();
+      if (!crypt_rn ("calibrate", setting, data, (int) sizeof *data))
+        return 0;
+      uint64_t elapsed = now_ns () - start;
+      best = MIN (best, elapsed);
+      total += elapsed;
+    }
+  /* Zero means not measured.  */
+  return best ? best : 1;
+}
+
+/* Look up, or measure and remember, the time for COUNT.  */
+static uint64_t
+cached_time (struct calibration *c, unsigned long count,
+             struct crypt_data *data)
+{
+  uint64_t ns = __atomic_load_n (&c->ns[count], __ATOMIC_RELAXED);
+  if (!ns)
+    {
+      ns = time_count (c, count, data);
+      if (ns)
+        __atomic_store_n (&c->ns[count], ns, __ATOMIC_RELAXED);
+    }
+  return ns;
+}
+
+/* Time for ROUND_UNIT rounds of linear method C.  */
+static uint64_t
+unit_time (struct calibration *c, struct crypt_data *data)
+{
+  uint64_t ns = __atomic_load_n (&c->ns[0], __ATOMIC_RELAXED);
+  if (ns)
+    return ns;
+
+  /* The time for the minimum number of rounds is mostly overhead on
+     fast machines, so keep increasing the rounds until the time is
+     long enough to scale from.  */
+  unsigned long rounds = c->min_count;
+  for (;;)
+    {
+      ns = time_count (c, rounds, data);
+      if (!ns)
+        return 0;
+      if (ns >= LINEAR_SAMPLE_NS || rounds > c->max_count / 4)
+        break;
+      rounds *= 4;
+    }
+  ns = MAX (ns * ROUND_UNIT / rounds, 1);
+  __atomic_store_n (&c->ns[0], ns, __ATOMIC_RELAXED);
+  return ns;
+}
+
+/* Choose COUNT for method C.  Returns 0 on failure, with errno set.  */
+static unsigned long
+calibrate_count (struct calibration *c, uint64_t target_ns,
+                 unsigned long max_mem, struct crypt_data *data)
+{
+  if (c->linear)
+    {
+      uint64_t ns = unit_time (c, data);
+      if (!ns)
+        return 0;
+      uint64_t units = target_ns / ns;
+      if (units > c->max_count / ROUND_UNIT)
+        return c->max_count;
+      return MAX ((unsigned long) units * ROUND_UNIT, c->min_count);
+    }
+
+  unsigned long count = c->min_count;
+  if (c->memory && max_mem && c->memory (count) > max_mem)
+    {
+      errno = EINVAL;
+      return 0;
+    }
+  uint64_t ns = cached_time (c, count, data);
+  if (!ns)
+    return 0;
+
+  /* Never time a count that is expected to take much longer than the
+     target: each step doubles the time, so stop as soon as the next
+     one is predicted to be too slow.  */
+  while (count < c->max_count
+         && !(c->memory && max_mem && c->memory (count + 1) > max_mem))
+    {
+      uint64_t next = __atomic_load_n (&c->ns[count + 1], __ATOMIC_RELAXED);
+      if (next ? next > target_ns : ns * 2 > target_ns)
+        break;
+      next = cached_time (c, count + 1, data);
+      if (!next)
+        return 0;
+      if (next > target_ns)
+        break;
+      count++;
+      ns = next;
+    }
+  return count;
+}
+
+char *
+crypt_gensalt_calibrate (const char *prefix, unsigned int target_ms,
+                         unsigned long max_mem, char *output, int output_size)
+{
+  if (output_size < 3)
+    {
+      errno = ERANGE;
+      make_failure_token (prefix, output, output_size);
+      return 0;
+    }
+  make_failure_token (prefix, output, output_size);
+
+  if (!prefix)
+    prefix = crypt_preferred_method ();
+
+  struct calibration *c = 0;
+  size_t i;
+  for (i = 0; prefix && i < ARRAY_SIZE (calibrations); i++)
+    if (!strcmp (prefix, calibrations[i].prefix))
+      {
+        c = &calibrations[i];
+        break;
+      }
+  if (!c || target_ms == 0)
+    {
+      errno = EINVAL;
+      return 0;
+    }
+
+  struct crypt_data *data = malloc (sizeof *data);
+  if (!data)
+    return 0;
+  unsigned long count = calibrate_count (c, (uint64_t) target_ms * 1000000,
+                                         max_mem, data);
+  free (data);
+  if (!count)
+    return 0;
+
+  return crypt_gensalt_rn (prefix, count, 0, 0, output, output_size);
+}
+SYMVER_crypt_gensalt_calibrate;
+
+#endif /* INCLUDE_crypt_gensalt_calibrate */
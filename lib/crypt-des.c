@@ -45,6 +45,7 @@
 
 #include "crypt-port.h"
 #include "alg-des.h"
+#include "byteorder.h"
 
 #include <errno.h>
 
@@ -92,19 +93,11 @@ ascii_to_bin(char ch)
   return -1;
 }
 
-/* Generate an 11-character DES password hash into the buffer at
-   OUTPUT, and nul-terminate it.  The salt and key have already been
-   set.  The plaintext is 64 bits of zeroes, and the raw ciphertext is
-   written to cbuf[].  */
+/* Encode the raw DES ciphertext in cbuf[] as an 11-character password
+   hash into the buffer at OUTPUT, and nul-terminate it.  */
 static void
-des_gen_hash (struct des_ctx *ctx, uint32_t count, uint8_t *output,
-              uint8_t cbuf[8])
+des_encode_hash (uint8_t *output, const uint8_t cbuf[8])
 {
-  uint8_t plaintext[8];
-  memset (plaintext, 0, 8);
-  des_crypt_block (ctx, cbuf, plaintext, count, false);
-
-  /* Now encode the result.  */
   const uint8_t *sptr = cbuf;
   const uint8_t *end = sptr + 8;
   unsigned int c1, c2;
@@ -138,9 +131,25 @@ des_gen_hash (struct des_ctx *ctx, uint32_t count, uint8_t *output,
   while (end - sptr > 0);
   *output = '\0';
 }
+
+/* Generate an 11-character DES password hash into the buffer at
+   OUTPUT, and nul-terminate it.  The salt and key have already been
+   set.  The plaintext is 64 bits of zeroes, and the raw ciphertext is
+   written to cbuf[].  */
+static void
+des_gen_hash (struct des_ctx *ctx, uint32_t count, uint8_t *output,
+              uint8_t cbuf[8])
+{
+  uint8_t plaintext[8];
+  memset (plaintext, 0, 8);
+  des_crypt_block (ctx, cbuf, plaintext, count, false);
+  des_encode_hash (output, cbuf);
+}
 #endif
 
 #if INCLUDE_descrypt
+const size_t footprint_descrypt_rn = sizeof (struct des_buffer);
+
 /* The original UNIX DES-based password hash, no extensions.  */
 void
 crypt_descrypt_rn (const char *phrase, size_t ARG_UNUSED (phr_size),
@@ -204,6 +213,8 @@ crypt_descrypt_rn (const char *phrase, size_t ARG_UNUSED (phr_size),
 #endif
 
 #if INCLUDE_bigcrypt
+const size_t footprint_bigcrypt_rn = sizeof (struct des_buffer);
+
 /* This algorithm is algorithm 0 (default) shipped with the C2 secure
    implementation of Digital UNIX.
 
@@ -306,37 +317,20 @@ crypt_bigcrypt_rn (const char *phrase, size_t phr_size,
 #endif
 
 #if INCLUDE_bsdicrypt
-/* crypt_rn() entry point for BSD-style extended DES hashes.  These
-   permit long passwords and have more salt and a controllable iteration
-   count, but are still unacceptably weak by modern standards.  */
-void
-crypt_bsdicrypt_rn (const char *phrase, size_t ARG_UNUSED (phr_size),
-                    const char *setting, size_t set_size,
-                    uint8_t *output, size_t out_size,
-                    void *scratch, size_t scr_size)
+/* Subroutine of crypt_bsdicrypt_rn and crypt_bsdicrypt_batch_rn:
+   decode the iteration count and salt from a BSD-style SETTING.
+   Returns false if it is malformed.  */
+static bool
+bsdicrypt_parse_setting (const char *setting, size_t set_size,
+                         uint32_t *countp, uint32_t *saltp)
 {
-  /* This shouldn't ever happen, but...  */
-  if (out_size < DES_EXT_OUTPUT_LEN || scr_size < sizeof (struct des_buffer))
-    {
-      errno = ERANGE;
-      return;
-    }
-
-  /* If this is true, this function shouldn't have been called.
-     Setting must be at least 9 bytes long, byte 10+ is ignored.  */
-  if (*setting != '_' || set_size < 9)
-    {
-      errno = EINVAL;
-      return;
-    }
-
-  struct des_buffer *buf = scratch;
-  struct des_ctx *ctx = &buf->ctx;
   uint32_t count = 0, salt = 0;
-  uint8_t *keybuf = buf->keybuf, *pkbuf = buf->pkbuf;
-  uint8_t *cp = output;
   int i, x;
 
+  /* Setting must be at least 9 bytes long, byte 10+ is ignored.  */
+  if (*setting != '_' || set_size < 9)
+    return false;
+
   /* "new"-style DES hash:
    	setting - underscore, 4 bytes of count, 4 bytes of salt
    	phrase - unlimited characters
@@ -345,10 +339,7 @@ crypt_bsdicrypt_rn (const char *phrase, size_t ARG_UNUSED (phr_size),
     {
       x = ascii_to_bin(setting[i]);
       if (x < 0)
-        {
-          errno = EINVAL;
-          return;
-        }
+        return false;
       count |= (unsigned int)x << ((i - 1) * 6);
     }
 
@@ -356,22 +347,32 @@ crypt_bsdicrypt_rn (const char *phrase, size_t ARG_UNUSED (phr_size),
     {
       x = ascii_to_bin(setting[i]);
       if (x < 0)
-        {
-          errno = EINVAL;
-          return;
-        }
+        return false;
       salt |= (unsigned int)x << ((i - 5) * 6);
     }
 
-  memcpy (cp, setting, 9);
-  cp += 9;
+  *countp = count;
+  *saltp = salt;
+  return true;
+}
+
+/* Subroutine of crypt_bsdicrypt_rn and crypt_bsdicrypt_batch_rn:
+   fold PHRASE into a single DES key in BUF->keybuf, and set it as the
+   key of BUF->ctx.
+
+   Passwords longer than 8 bytes are folded using a procedure similar
+   to a Merkle-Dåmgard hash construction.  Each block is shifted and
+   padded, as for the traditional hash, then XORed with the output of
+   the previous round (IV all bits zero), set as the DES key, and
+   encrypted to produce the round output.  The salt is zero throughout
+   this procedure.  */
+static void
+bsdicrypt_fold_key (struct des_buffer *buf, const char *phrase)
+{
+  struct des_ctx *ctx = &buf->ctx;
+  uint8_t *keybuf = buf->keybuf, *pkbuf = buf->pkbuf;
+  int i;
 
-  /* Fold passwords longer than 8 bytes into a single DES key using a
-     procedure similar to a Merkle-Dåmgard hash construction.  Each
-     block is shifted and padded, as for the traditional hash, then
-     XORed with the output of the previous round (IV all bits zero),
-     set as the DES key, and encrypted to produce the round output.
-     The salt is zero throughout this procedure.  */
   des_set_salt (ctx, 0);
   memset (pkbuf, 0, 8);
   for (;;)
@@ -387,10 +388,375 @@ crypt_bsdicrypt_rn (const char *phrase, size_t ARG_UNUSED (phr_size),
         break;
       des_crypt_block (ctx, pkbuf, keybuf, 1, false);
     }
+}
+
+const size_t footprint_bsdicrypt_rn = sizeof (struct des_buffer);
+
+/* crypt_rn() entry point for BSD-style extended DES hashes.  These
+   permit long passwords and have more salt and a controllable iteration
+   count, but are still unacceptably weak by modern standards.  */
+void
+crypt_bsdicrypt_rn (const char *phrase, size_t ARG_UNUSED (phr_size),
+                    const char *setting, size_t set_size,
+                    uint8_t *output, size_t out_size,
+                    void *scratch, size_t scr_size)
+{
+  /* This shouldn't ever happen, but...  */
+  if (out_size < DES_EXT_OUTPUT_LEN || scr_size < sizeof (struct des_buffer))
+    {
+      errno = ERANGE;
+      return;
+    }
+
+  struct des_buffer *buf = scratch;
+  uint32_t count, salt;
+
+  /* If this fails, this function shouldn't have been called.  */
+  if (!bsdicrypt_parse_setting (setting, set_size, &count, &salt))
+    {
+      errno = EINVAL;
+      return;
+    }
+
+  memcpy (output, setting, 9);
 
   /* Proceed as for the traditional DES hash.  */
-  des_set_salt (ctx, salt);
-  des_gen_hash (ctx, count, cp, pkbuf);
+  bsdicrypt_fold_key (buf, phrase);
+  des_set_salt (&buf->ctx, salt);
+  des_gen_hash (&buf->ctx, count, output + 9, buf->pkbuf);
+}
+#endif
+
+#if INCLUDE_descrypt || INCLUDE_bsdicrypt || INCLUDE_bigcrypt
+/* Below this many hashes with the same iteration count, hashing them
+   one at a time with des_crypt_block is faster than the bitsliced DES,
+   which costs as much for one block as for 64.  */
+#define DES_BATCH_MIN_LANES 16
+
+/* Intermediate data for the batch entry points.  Lane I computes the
+   hash of segment SEGS[I] of ITEMS[I]; KEYS and SALTS hold the keys
+   (as big-endian numbers) and salts of the lanes in the group of 64
+   being filled in, until it is loaded into BS.  */
+struct des_batch_buffer
+{
+  struct des_bs_ctx bs;
+  uint64_t keys[64];
+  uint64_t salts[64];
+  struct crypt_batch_item *items[DES_BS_LANES_MAX];
+  uint8_t segs[DES_BS_LANES_MAX];
+  struct des_buffer des;
+};
+
+static_assert (sizeof (struct des_batch_buffer) <= ALG_BATCH_SPECIFIC_SIZE,
+               "ALG_BATCH_SPECIFIC_SIZE is too small for DES");
+
+/* Subroutine of des_batch_add and des_batch_finish: load the group of
+   lanes ending with LANE into the bitsliced DES.  */
+static void
+des_batch_load (struct des_batch_buffer *buf, size_t lane)
+{
+  size_t i;
+  unsigned int j;
+
+  for (i = 0; i < 64; i++)
+    {
+      uint64_t salt = buf->salts[i], bits = 0;
+      for (j = 0; j < 24; j++)
+        if (salt & (1u << j))
+          bits |= (uint64_t) 1 << (63 - j);
+      buf->salts[i] = bits;
+    }
+  des_bs_load (&buf->bs, lane / 64, buf->keys, buf->salts);
+}
+
+/* Set up lane LANE of BUF to hash segment SEG of ITEM, with the key in
+   KEYBUF and SALT.  */
+static void
+des_batch_add (struct des_batch_buffer *buf, size_t lane,
+               struct crypt_batch_item *item, unsigned int seg,
+               const uint8_t keybuf[8], uint32_t salt)
+{
+  buf->keys[lane % 64] = be64_to_cpu (keybuf);
+  buf->salts[lane % 64] = salt;
+  buf->items[lane] = item;
+  buf->segs[lane] = (uint8_t) seg;
+  if (lane % 64 == 63)
+    des_batch_load (buf, lane);
+}
+
+/* Subroutine of des_batch_finish: write the hash in BUF->des.pkbuf for
+   lane LANE of BUF to its item's output.  PREFIX bytes of the setting
+   come before the first segment's hash in the output, and each further
+   segment's hash follows the one before.  */
+static void
+des_batch_output (struct des_batch_buffer *buf, size_t lane, size_t prefix)
+{
+  struct crypt_batch_item *item = buf->items[lane];
+  unsigned int seg = buf->segs[lane];
+
+  /* The setting is canonical here: its salt characters were all
+     accepted by ascii_to_bin.  */
+  if (seg == 0)
+    memcpy (item->output, item->setting, prefix);
+  des_encode_hash (item->output + prefix + 11 * seg, buf->des.pkbuf);
+}
+
+/* Compute the hashes of the first NLANES lanes of BUF, all with COUNT
+   iterations, and write them out as des_batch_output does.  */
+static void
+des_batch_finish (struct des_batch_buffer *buf, size_t nlanes,
+                  uint32_t count, size_t prefix)
+{
+  size_t lane;
+
+  if (nlanes < DES_BATCH_MIN_LANES)
+    {
+      for (lane = 0; lane < nlanes; lane++)
+        {
+          cpu_to_be64 (buf->des.keybuf, buf->keys[lane]);
+          des_set_key (&buf->des.ctx, buf->des.keybuf);
+          des_set_salt (&buf->des.ctx, (uint32_t) buf->salts[lane]);
+          memset (buf->des.pkbuf, 0, 8);
+          des_crypt_block (&buf->des.ctx, buf->des.pkbuf, buf->des.pkbuf,
+                           count, false);
+          des_batch_output (buf, lane, prefix);
+        }
+      return;
+    }
+
+  if (nlanes % 64 != 0)
+    {
+      for (lane = nlanes % 64; lane < 64; lane++)
+        buf->keys[lane] = buf->salts[lane] = 0;
+      des_batch_load (buf, nlanes - 1);
+    }
+
+  des_bs_crypt_zero (&buf->bs, (nlanes + 63) / 64, count);
+
+  for (lane = 0; lane < nlanes; lane++)
+    {
+      if (lane % 64 == 0)
+        des_bs_store (&buf->bs, lane / 64, buf->keys);
+      cpu_to_be64 (buf->des.pkbuf, buf->keys[lane % 64]);
+      des_batch_output (buf, lane, prefix);
+    }
+}
+#endif
+
+#if INCLUDE_descrypt || INCLUDE_bigcrypt
+/* Subroutine of crypt_descrypt_batch_rn and crypt_bigcrypt_batch_rn:
+   decode the two salt characters at S.  Returns false if they are not
+   both valid.  */
+static bool
+des_parse_salt (const char *s, uint32_t *saltp)
+{
+  int lo = ascii_to_bin (s[0]);
+  if (lo < 0)
+    return false;
+  int hi = ascii_to_bin (s[1]);
+  if (hi < 0)
+    return false;
+  *saltp = (uint32_t) lo | ((uint32_t) hi << 6);
+  return true;
+}
+
+/* Subroutine of crypt_descrypt_batch_rn and crypt_bigcrypt_batch_rn:
+   copy up to 8 characters of PHRASE into KEYBUF, shifting each
+   character up by 1 bit and padding on the right with zeroes.  */
+static void
+des_trd_key (uint8_t keybuf[8], const char *phrase)
+{
+  int i;
+  for (i = 0; i < 8; i++)
+    {
+      keybuf[i] = (uint8_t)(*phrase << 1);
+      if (*phrase)
+        phrase++;
+    }
+}
+#endif
+
+#if INCLUDE_descrypt
+/* Compute several descrypt hashes at once, with the bitsliced DES.  */
+void
+crypt_descrypt_batch_rn (struct crypt_batch_item *items, size_t nitems,
+                         void *scratch, size_t scr_size)
+{
+  /* This shouldn't ever happen, but...  */
+  if (scr_size < sizeof (struct des_batch_buffer))
+    {
+      errno = ERANGE;
+      return;
+    }
+
+  struct des_batch_buffer *buf = scratch;
+  size_t i, nlanes = 0;
+  uint32_t salt;
+
+  for (i = 0; i < nitems; i++)
+    {
+      struct crypt_batch_item *item = &items[i];
+
+      if (item->out_size < DES_TRD_OUTPUT_LEN)
+        {
+          errno = ERANGE;
+          continue;
+        }
+      if (!des_parse_salt (item->setting, &salt))
+        {
+          errno = EINVAL;
+          continue;
+        }
+
+      des_trd_key (buf->des.keybuf, item->phrase);
+      des_batch_add (buf, nlanes, item, 0, buf->des.keybuf, salt);
+      if (++nlanes == DES_BS_LANES_MAX)
+        {
+          des_batch_finish (buf, nlanes, 25, 2);
+          nlanes = 0;
+        }
+    }
+  if (nlanes > 0)
+    des_batch_finish (buf, nlanes, 25, 2);
+}
+#endif
+
+#if INCLUDE_bigcrypt
+/* Compute several bigcrypt hashes at once, with the bitsliced DES.
+   The salt for each segment of a hash comes from the one before, so
+   the first segments of all the hashes are computed together, then
+   all the second segments, and so on.  */
+void
+crypt_bigcrypt_batch_rn (struct crypt_batch_item *items, size_t nitems,
+                         void *scratch, size_t scr_size)
+{
+  /* This shouldn't ever happen, but...  */
+  if (scr_size < sizeof (struct des_batch_buffer))
+    {
+      errno = ERANGE;
+      return;
+    }
+
+  struct des_batch_buffer *buf = scratch;
+  size_t i, nlanes = 0, nsegs, out_min;
+  unsigned int seg, max_segs = 1;
+  uint32_t salt;
+
+  for (seg = 0; seg < max_segs; seg++)
+    {
+      for (i = 0; i < nitems; i++)
+        {
+          struct crypt_batch_item *item = &items[i];
+          const char *salt_chars = item->setting;
+
+          /* As in crypt_bigcrypt_rn, a long phrase with a short setting
+             is hashed as descrypt would, if that is enabled.  */
+          if (item->phr_size > 8 && item->set_size <= 13)
+            {
+#if INCLUDE_descrypt
+              nsegs = 1;
+              out_min = DES_TRD_OUTPUT_LEN;
+#else
+              if (seg == 0)
+                errno = EINVAL;
+              continue;
+#endif
+            }
+          else
+            {
+              nsegs = MIN ((MAX (item->phr_size, (size_t) 1) + 7) / 8, 16);
+              out_min = DES_BIG_OUTPUT_LEN;
+            }
+          if (seg >= nsegs)
+            continue;
+
+          /* Items that fail these checks fail them for the first
+             segment, and are skipped from then on.  Later segments
+             take their salt from the hash of the one before.  */
+          if (item->out_size < out_min)
+            {
+              if (seg == 0)
+                errno = ERANGE;
+              continue;
+            }
+          if (seg > 0)
+            salt_chars = (const char *) item->output + 2 + 11 * (seg - 1);
+          if (!des_parse_salt (item->setting, &salt)
+              || !des_parse_salt (salt_chars, &salt))
+            {
+              if (seg == 0)
+                errno = EINVAL;
+              continue;
+            }
+
+          max_segs = MAX (max_segs, (unsigned int) nsegs);
+          des_trd_key (buf->des.keybuf, item->phrase + 8 * seg);
+          des_batch_add (buf, nlanes, item, seg, buf->des.keybuf, salt);
+          if (++nlanes == DES_BS_LANES_MAX)
+            {
+              des_batch_finish (buf, nlanes, 25, 2);
+              nlanes = 0;
+            }
+        }
+      if (nlanes > 0)
+        des_batch_finish (buf, nlanes, 25, 2);
+      nlanes = 0;
+    }
+}
+#endif
+
+#if INCLUDE_bsdicrypt
+/* Compute several bsdicrypt hashes at once, with the bitsliced DES.
+   Hashes with the same iteration count run together; crypt_batch_rn
+   sorts the items by setting, which puts those next to each other.  */
+void
+crypt_bsdicrypt_batch_rn (struct crypt_batch_item *items, size_t nitems,
+                          void *scratch, size_t scr_size)
+{
+  /* This shouldn't ever happen, but...  */
+  if (scr_size < sizeof (struct des_batch_buffer))
+    {
+      errno = ERANGE;
+      return;
+    }
+
+  struct des_batch_buffer *buf = scratch;
+  size_t i, nlanes = 0;
+  uint32_t count, salt, lane_count = 0;
+
+  for (i = 0; i < nitems; i++)
+    {
+      struct crypt_batch_item *item = &items[i];
+
+      if (item->out_size < DES_EXT_OUTPUT_LEN)
+        {
+          errno = ERANGE;
+          continue;
+        }
+      if (!bsdicrypt_parse_setting (item->setting, item->set_size,
+                                    &count, &salt))
+        {
+          errno = EINVAL;
+          continue;
+        }
+
+      if (nlanes > 0 && count != lane_count)
+        {
+          des_batch_finish (buf, nlanes, lane_count, 9);
+          nlanes = 0;
+        }
+      lane_count = count;
+
+      bsdicrypt_fold_key (&buf->des, item->phrase);
+      des_batch_add (buf, nlanes, item, 0, buf->des.keybuf, salt);
+      if (++nlanes == DES_BS_LANES_MAX)
+        {
+          des_batch_finish (buf, nlanes, lane_count, 9);
+          nlanes = 0;
+        }
+    }
+  if (nlanes > 0)
+    des_batch_finish (buf, nlanes, lane_count, 9);
 }
 #endif
 
@@ -21,14 +21,68 @@
    will not have the state objects in its data segment.  */
 
 #if INCLUDE_crypt_gensalt
+
+#if ENABLE_THREAD_LOCAL_CRYPT
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+
+/* Each thread's output buffer is allocated the first time the thread
+   calls crypt_gensalt, and freed when the thread exits.  */
+static pthread_key_t gensalt_output_key;
+static pthread_once_t gensalt_output_once = PTHREAD_ONCE_INIT;
+static bool gensalt_output_ok;
+
+static void
+gensalt_output_init (void)
+{
+  gensalt_output_ok = !pthread_key_create (&gensalt_output_key, free);
+}
+
+static char *
+gensalt_output_get (void)
+{
+  char *output;
+
+  if (pthread_once (&gensalt_output_once, gensalt_output_init)
+      || !gensalt_output_ok)
+    return NULL;
+  output = pthread_getspecific (gensalt_output_key);
+  if (output)
+    return output;
+
+  output = malloc (CRYPT_GENSALT_OUTPUT_SIZE);
+  if (!output)
+    return NULL;
+  if (pthread_setspecific (gensalt_output_key, output))
+    {
+      free (output);
+      return NULL;
+    }
+  return output;
+}
+#endif
+
 char *
 crypt_gensalt (const char *prefix, unsigned long count,
                const char *rbytes, int nrbytes)
 {
+#if ENABLE_THREAD_LOCAL_CRYPT
+  char *output = gensalt_output_get ();
+  if (!output)
+    {
+      errno = ENOMEM;
+      return 0;
+    }
+
+  return crypt_gensalt_rn (prefix, count, rbytes, nrbytes,
+                           output, CRYPT_GENSALT_OUTPUT_SIZE);
+#else
   static char output[CRYPT_GENSALT_OUTPUT_SIZE];
 
   return crypt_gensalt_rn (prefix, count,
                            rbytes, nrbytes, output, sizeof (output));
+#endif
 }
 SYMVER_crypt_gensalt;
 #endif
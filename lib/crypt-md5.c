@@ -53,30 +53,18 @@ struct md5_buffer
 static_assert (sizeof (struct md5_buffer) <= ALG_SPECIFIC_SIZE,
                "ALG_SPECIFIC_SIZE is too small for MD5");
 
+const size_t footprint_md5crypt_rn = sizeof (struct md5_buffer);
 
-/* This entry point is equivalent to the `crypt' function in Unix
-   libcs.  */
-void
-crypt_md5crypt_rn (const char *phrase, size_t phr_size,
-                   const char *setting, size_t ARG_UNUSED (set_size),
-                   uint8_t *output, size_t out_size,
-                   void *scratch, size_t scr_size)
-{
-  /* This shouldn't ever happen, but...  */
-  if (out_size < MD5_HASH_LENGTH || scr_size < sizeof (struct md5_buffer))
-    {
-      errno = ERANGE;
-      return;
-    }
 
-  struct md5_buffer *buf = scratch;
-  MD5_CTX *ctx = &buf->ctx;
-  uint8_t *result = buf->result;
-  char *cp = (char *)output;
+/* Subroutine of crypt_md5crypt_rn and crypt_md5crypt_batch_rn: Parse
+   SETTING, storing the start and length of the salt in *SALTP and
+   *SALT_SIZEP.  Returns false and sets errno if SETTING is invalid.  */
+static bool
+md5crypt_parse_setting (const char *setting, const char **saltp,
+                        size_t *salt_sizep)
+{
   const char *salt = setting;
-
   size_t salt_size;
-  size_t cnt;
 
   /* Find beginning of salt string.  The prefix should normally always
      be present.  Just in case it is not.  */
@@ -93,13 +81,27 @@ crypt_md5crypt_rn (const char *phrase, size_t phr_size,
   if (!(salt[salt_size] == '$' || !salt[salt_size]))
     {
       errno = EINVAL;
-      return;
+      return false;
     }
 
   /* Ensure we do not use more salt than SALT_LEN_MAX. */
   if (salt_size > SALT_LEN_MAX)
     salt_size = SALT_LEN_MAX;
 
+  *saltp = salt;
+  *salt_sizep = salt_size;
+  return true;
+}
+
+/* Subroutine of crypt_md5crypt_rn and crypt_md5crypt_batch_rn:
+   Compute the intermediate RESULT that the main loop starts from.  */
+static void
+md5crypt_prepare (const char *phrase, size_t phr_size,
+                  const char *salt, size_t salt_size,
+                  MD5_CTX *ctx, uint8_t result[16])
+{
+  size_t cnt;
+
   /* Compute alternate MD5 sum with input PHRASE, SALT, and PHRASE.  The
      final result will be added to the first context.  */
   MD5_Init (ctx);
@@ -149,6 +151,75 @@ crypt_md5crypt_rn (const char *phrase, size_t phr_size,
 
   /* Create intermediate result.  */
   MD5_Final (result, ctx);
+}
+
+/* Subroutine of crypt_md5crypt_rn and crypt_md5crypt_batch_rn: Write
+   the hash for SALT and the final RESULT to OUTPUT.  */
+static void
+md5crypt_format (uint8_t *output, const char *salt, size_t salt_size,
+                 const uint8_t result[16])
+{
+  char *cp = (char *)output;
+
+  /* Now we can construct the result string.  It consists of three
+     parts.  We already know that there is enough space at CP.  */
+  memcpy (cp, md5_salt_prefix, sizeof (md5_salt_prefix) - 1);
+  cp += sizeof (md5_salt_prefix) - 1;
+
+  memcpy (cp, salt, salt_size);
+  cp += salt_size;
+  *cp++ = '$';
+
+#define b64_from_24bit(B2, B1, B0, N)                   \
+  do {                                                  \
+    unsigned int w = ((((unsigned int)(B2)) << 16) |    \
+                      (((unsigned int)(B1)) << 8) |     \
+                      ((unsigned int)(B0)));            \
+    int n = (N);                                        \
+    while (n-- > 0)                                     \
+      {                                                 \
+        *cp++ = b64t[w & 0x3f];                         \
+        w >>= 6;                                        \
+      }                                                 \
+  } while (0)
+
+
+  b64_from_24bit (result[0], result[6], result[12], 4);
+  b64_from_24bit (result[1], result[7], result[13], 4);
+  b64_from_24bit (result[2], result[8], result[14], 4);
+  b64_from_24bit (result[3], result[9], result[15], 4);
+  b64_from_24bit (result[4], result[10], result[5], 4);
+  b64_from_24bit (0, 0, result[11], 2);
+
+  *cp = '\0';
+}
+
+/* This entry point is equivalent to the `crypt' function in Unix
+   libcs.  */
+void
+crypt_md5crypt_rn (const char *phrase, size_t phr_size,
+                   const char *setting, size_t ARG_UNUSED (set_size),
+                   uint8_t *output, size_t out_size,
+                   void *scratch, size_t scr_size)
+{
+  /* This shouldn't ever happen, but...  */
+  if (out_size < MD5_HASH_LENGTH || scr_size < sizeof (struct md5_buffer))
+    {
+      errno = ERANGE;
+      return;
+    }
+
+  struct md5_buffer *buf = scratch;
+  MD5_CTX *ctx = &buf->ctx;
+  uint8_t *result = buf->result;
+  const char *salt;
+  size_t salt_size;
+  size_t cnt;
+
+  if (!md5crypt_parse_setting (setting, &salt, &salt_size))
+    return;
+
+  md5crypt_prepare (phrase, phr_size, salt, salt_size, ctx, result);
 
   /* Now comes another weirdness.  In fear of password crackers here
      comes a quite long loop which just processes the output of the
@@ -182,37 +253,235 @@ crypt_md5crypt_rn (const char *phrase, size_t phr_size,
       MD5_Final (result, ctx);
     }
 
-  /* Now we can construct the result string.  It consists of three
-     parts.  We already know that there is enough space at CP.  */
-  memcpy (cp, md5_salt_prefix, sizeof (md5_salt_prefix) - 1);
-  cp += sizeof (md5_salt_prefix) - 1;
+  md5crypt_format (output, salt, salt_size, result);
+}
 
-  memcpy (cp, salt, salt_size);
-  cp += salt_size;
-  *cp++ = '$';
+/* Which of the pieces of a message the main loop of md5crypt hashes in
+   round CNT depends only on CNT modulo 2, 3 and 7, so there are eight
+   different layouts.  */
+#define MD5_LAYOUTS 8
 
-#define b64_from_24bit(B2, B1, B0, N)                   \
-  do {                                                  \
-    unsigned int w = ((((unsigned int)(B2)) << 16) |    \
-                      (((unsigned int)(B1)) << 8) |     \
-                      ((unsigned int)(B0)));            \
-    int n = (N);                                        \
-    while (n-- > 0)                                     \
-      {                                                 \
-        *cp++ = b64t[w & 0x3f];                         \
-        w >>= 6;                                        \
-      }                                                 \
-  } while (0)
+static inline unsigned int
+md5crypt_layout (size_t cnt)
+{
+  return ((cnt & 1) != 0) << 2 | (cnt % 3 != 0) << 1 | (cnt % 7 != 0);
+}
 
+/* Intermediate data for one lane of crypt_md5crypt_batch_rn.  For
+   each layout, the lane's message is kept ready, padded, in MSG; only
+   the previous result, at offset RESULT_POS, changes from one round
+   with that layout to the next.  */
+struct md5_batch_lane
+{
+  struct crypt_batch_item *item;
+  const char *salt;
+  size_t salt_size;
+  uint8_t result[16];
+  uint8_t *msg[MD5_LAYOUTS];
+  size_t nblocks[MD5_LAYOUTS];
+  size_t result_pos[MD5_LAYOUTS];
+};
 
-  b64_from_24bit (result[0], result[6], result[12], 4);
-  b64_from_24bit (result[1], result[7], result[13], 4);
-  b64_from_24bit (result[2], result[8], result[14], 4);
-  b64_from_24bit (result[3], result[9], result[15], 4);
-  b64_from_24bit (result[4], result[10], result[5], 4);
-  b64_from_24bit (0, 0, result[11], 2);
+/* The messages of all the lanes are carved out of ARENA, which takes
+   up the rest of the scratch area.  */
+struct md5_batch_buffer
+{
+  MD5_CTX ctx;
+  struct md5_batch_lane lanes[MD5_MB_LANES];
+  uint8_t arena[];
+};
 
-  *cp = '\0';
+/* The most arena space one lane can need: every layout holding the
+   phrase twice.  */
+#define MD5_LANE_ARENA_MAX \
+  (MD5_LAYOUTS * MD5_MB_PADDED_SIZE (16 + SALT_LEN_MAX \
+                                     + 2 * (CRYPT_MAX_PASSPHRASE_SIZE - 1)))
+
+static_assert (sizeof (struct md5_batch_buffer) + MD5_LANE_ARENA_MAX
+               <= ALG_BATCH_SPECIFIC_SIZE,
+               "ALG_BATCH_SPECIFIC_SIZE is too small for MD5");
+
+/* Subroutine of crypt_md5crypt_batch_rn: Return the arena space a
+   lane for a phrase of PHR_SIZE bytes and a salt of SALT_SIZE bytes
+   needs.  */
+static size_t
+md5crypt_lane_arena_size (size_t phr_size, size_t salt_size)
+{
+  size_t size = 0;
+  unsigned int c;
+
+  for (c = 0; c < MD5_LAYOUTS; c++)
+    size += MD5_MB_PADDED_SIZE (16 + phr_size
+                                + ((c & 2) ? salt_size : 0)
+                                + ((c & 1) ? phr_size : 0));
+  return size;
+}
+
+/* Subroutine of crypt_md5crypt_batch_rn: Lay out the messages for
+   every layout of lane L in the arena space at P.  */
+static void
+md5crypt_lane_layout (struct md5_batch_lane *l, uint8_t *p)
+{
+  const char *phrase = l->item->phrase;
+  size_t phr_size = l->item->phr_size;
+  unsigned int c;
+
+  for (c = 0; c < MD5_LAYOUTS; c++)
+    {
+      uint8_t *q = p;
+
+      /* The same sequence as in crypt_md5crypt_rn, with room for the
+         previous result.  */
+      if (c & 4)
+        {
+          memcpy (q, phrase, phr_size);
+          q += phr_size;
+        }
+      else
+        {
+          l->result_pos[c] = 0;
+          q += 16;
+        }
+      if (c & 2)
+        {
+          memcpy (q, l->salt, l->salt_size);
+          q += l->salt_size;
+        }
+      if (c & 1)
+        {
+          memcpy (q, phrase, phr_size);
+          q += phr_size;
+        }
+      if (c & 4)
+        {
+          l->result_pos[c] = (size_t) (q - p);
+          q += 16;
+        }
+      else
+        {
+          memcpy (q, phrase, phr_size);
+          q += phr_size;
+        }
+
+      l->msg[c] = p;
+      l->nblocks[c] = MD5_MB_Pad (p, (size_t) (q - p));
+      p += l->nblocks[c] * 64;
+    }
+}
+
+/* Subroutine of crypt_md5crypt_batch_rn: Run the main loop for the
+   first NLANES lanes of BUF at once, then write out their hashes.  */
+static void
+md5crypt_batch_finish (struct md5_batch_buffer *buf, size_t nlanes)
+{
+  const uint8_t *msgs[MD5_MB_LANES];
+  size_t nblocks[MD5_MB_LANES];
+  uint8_t *digests[MD5_MB_LANES];
+  size_t cnt, i;
+
+  for (i = 0; i < nlanes; i++)
+    digests[i] = buf->lanes[i].result;
+
+  for (cnt = 0; cnt < 1000; ++cnt)
+    {
+      unsigned int c = md5crypt_layout (cnt);
+
+      for (i = 0; i < nlanes; i++)
+        {
+          struct md5_batch_lane *l = &buf->lanes[i];
+
+          memcpy (l->msg[c] + l->result_pos[c], l->result, 16);
+          msgs[i] = l->msg[c];
+          nblocks[i] = l->nblocks[c];
+        }
+
+      MD5_MB_Hash_Padded (msgs, nblocks, digests, nlanes);
+    }
+
+  for (i = 0; i < nlanes; i++)
+    {
+      struct md5_batch_lane *l = &buf->lanes[i];
+      md5crypt_format (l->item->output, l->salt, l->salt_size, l->result);
+    }
+}
+
+/* Compute several md5crypt hashes at once.  Up to MD5_MB_Lanes()
+   hashes run in parallel, in the lanes of the vector registers, as
+   many at a time as there is room for their messages in the scratch
+   area.  */
+void
+crypt_md5crypt_batch_rn (struct crypt_batch_item *items, size_t nitems,
+                         void *scratch, size_t scr_size)
+{
+  size_t lanes = MD5_MB_Lanes ();
+  size_t i, nlanes, used, arena_size;
+
+  /* Without vector support, the batch would only be slower than
+     hashing each item by itself.  */
+  if (lanes == 1)
+    {
+      for (i = 0; i < nitems; i++)
+        crypt_md5crypt_rn (items[i].phrase, items[i].phr_size,
+                           items[i].setting, items[i].set_size,
+                           items[i].output, items[i].out_size,
+                           scratch, scr_size);
+      return;
+    }
+
+  /* This shouldn't ever happen, but...  */
+  if (scr_size < sizeof (struct md5_batch_buffer) + MD5_LANE_ARENA_MAX)
+    {
+      errno = ERANGE;
+      return;
+    }
+
+  struct md5_batch_buffer *buf = scratch;
+  arena_size = scr_size - sizeof (struct md5_batch_buffer);
+
+  for (i = 0, nlanes = 0, used = 0; i < nitems; i++)
+    {
+      struct crypt_batch_item *item = &items[i];
+      struct md5_batch_lane *l = &buf->lanes[nlanes];
+      size_t need;
+
+      if (item->out_size < MD5_HASH_LENGTH
+          || item->phr_size >= CRYPT_MAX_PASSPHRASE_SIZE)
+        {
+          errno = ERANGE;
+          continue;
+        }
+      if (!md5crypt_parse_setting (item->setting, &l->salt, &l->salt_size))
+        continue;
+
+      need = md5crypt_lane_arena_size (item->phr_size, l->salt_size);
+      if (used + need > arena_size)
+        {
+          /* Start over with this item in the first lane.  */
+          const char *salt = l->salt;
+          size_t salt_size = l->salt_size;
+
+          md5crypt_batch_finish (buf, nlanes);
+          nlanes = used = 0;
+          l = &buf->lanes[0];
+          l->salt = salt;
+          l->salt_size = salt_size;
+        }
+
+      l->item = item;
+      md5crypt_prepare (item->phrase, item->phr_size, l->salt, l->salt_size,
+                        &buf->ctx, l->result);
+      md5crypt_lane_layout (l, buf->arena + used);
+      used += need;
+
+      if (++nlanes == lanes)
+        {
+          md5crypt_batch_finish (buf, nlanes);
+          nlanes = used = 0;
+        }
+    }
+
+  if (nlanes > 0)
+    md5crypt_batch_finish (buf, nlanes);
 }
 
 void
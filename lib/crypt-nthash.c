@@ -49,6 +49,8 @@ typedef struct
 static_assert (sizeof (crypt_nt_internal_t) <= ALG_SPECIFIC_SIZE,
                "ALG_SPECIFIC_SIZE is too small for NTHASH.");
 
+const size_t footprint_nt_rn = sizeof (crypt_nt_internal_t);
+
 /*
  * NT HASH = md4(str2unicode(phrase))
  */
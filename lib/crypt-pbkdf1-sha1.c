@@ -54,6 +54,15 @@
 #define SHA1_SIZE 20         /* size of raw SHA1 digest, 160 bits */
 #define SHA1_OUTPUT_SIZE 28  /* size of base64-ed output string */
 
+/* Everything derived from the phrase lives in the scratch area.  */
+struct sha1crypt_buffer
+{
+  uint8_t hmac_buf[SHA1_SIZE];
+  struct hmac_sha1_ctx hmac_key;
+};
+
+const size_t footprint_sha1crypt_rn = sizeof (struct sha1crypt_buffer);
+
 static inline void
 to64 (uint8_t *s, unsigned long v, int n)
 {
@@ -98,7 +107,7 @@ crypt_sha1crypt_rn (const char *phrase, size_t phr_size,
 
   if ((out_size < (strlen (magic) + 2 + 10 + CRYPT_SHA1_SALT_LENGTH +
                    SHA1_OUTPUT_SIZE)) ||
-      scr_size < SHA1_SIZE)
+      scr_size < sizeof (struct sha1crypt_buffer))
     {
       errno = ERANGE;
       return;
@@ -114,7 +123,8 @@ crypt_sha1crypt_rn (const char *phrase, size_t phr_size,
   unsigned long i;
   /* XXX silence -Wpointer-sign (would be nice to fix this some other way) */
   const uint8_t *pwu = (const uint8_t *)phrase;
-  uint8_t *hmac_buf = scratch;
+  struct sha1crypt_buffer *buf = scratch;
+  uint8_t *hmac_buf = buf->hmac_buf;
 
   /*
    * Salt format is
@@ -157,12 +167,15 @@ crypt_sha1crypt_rn (const char *phrase, size_t phr_size,
                  (int)sl, setting, magic, iterations);
   /*
    * Then hmac using <phrase> as key, and repeat...
+   * The key is the same every time, so its padded blocks are only
+   * hashed once.
    */
-  hmac_sha1_process_data ((const unsigned char *)output, (size_t)dl,
-                          pwu, pl, hmac_buf);
+  hmac_sha1_init_ctx (&buf->hmac_key, pwu, pl);
+  hmac_sha1_process_ctx (&buf->hmac_key, (const unsigned char *)output,
+                         (size_t)dl, hmac_buf);
   for (i = 1; i < iterations; ++i)
     {
-      hmac_sha1_process_data (hmac_buf, SHA1_SIZE, pwu, pl, hmac_buf);
+      hmac_sha1_process_ctx (&buf->hmac_key, hmac_buf, SHA1_SIZE, hmac_buf);
     }
   /* Now output... */
   pl = (size_t)snprintf ((char *)output, out_size, "%s%lu$%.*s$",
@@ -187,7 +200,7 @@ crypt_sha1crypt_rn (const char *phrase, size_t phr_size,
   *ep = '\0';
 
   /* Don't leave anything around in vm they could use. */
-  explicit_bzero (scratch, scr_size);
+  explicit_bzero (buf, sizeof *buf);
 }
 
 /* Modified excerpt from:
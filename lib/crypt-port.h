@@ -321,10 +321,26 @@ extern size_t strcpy_or_abort (void *dst, size_t d_size, const void *src);
    test-symbols.sh.  */
 
 #define ascii64                  _crypt_ascii64
+#define get_cpu_features         _crypt_get_cpu_features
 #define get_random_bytes         _crypt_get_random_bytes
 #define make_failure_token       _crypt_make_failure_token
+#define restrict_cpu_features    _crypt_restrict_cpu_features
+
+#if ENABLE_RANDOM_POOL
+#define chacha20_keystream       _crypt_chacha20_keystream
+#define get_random_bytes_pooled  _crypt_get_random_bytes_pooled
+#endif
+
+#if ENABLE_YESCRYPT_THREADS
+#define thread_pool_run          _crypt_thread_pool_run
+#define thread_pool_size         _crypt_thread_pool_size
+#endif
 
 #if INCLUDE_descrypt || INCLUDE_bsdicrypt || INCLUDE_bigcrypt
+#define des_bs_crypt_zero        _crypt_des_bs_crypt_zero
+#define des_bs_lanes             _crypt_des_bs_lanes
+#define des_bs_load              _crypt_des_bs_load
+#define des_bs_store             _crypt_des_bs_store
 #define des_crypt_block          _crypt_des_crypt_block
 #define des_set_key              _crypt_des_set_key
 #define des_set_salt             _crypt_des_set_salt
@@ -350,20 +366,60 @@ extern size_t strcpy_or_abort (void *dst, size_t d_size, const void *src);
 #define MD5_Init   _crypt_MD5_Init
 #define MD5_Update _crypt_MD5_Update
 #define MD5_Final  _crypt_MD5_Final
+#define MD5_MB_Hash  _crypt_MD5_MB_Hash
+#define MD5_MB_Hash_Padded _crypt_MD5_MB_Hash_Padded
+#define MD5_MB_Lanes _crypt_MD5_MB_Lanes
+#define MD5_MB_Pad   _crypt_MD5_MB_Pad
+#endif
+
+#if INCLUDE_md5crypt
+#define crypt_md5crypt_batch_rn _crypt_crypt_md5crypt_batch_rn
+#endif
+#if INCLUDE_sunmd5
+#define crypt_sunmd5_batch_rn _crypt_crypt_sunmd5_batch_rn
 #endif
 
 #if INCLUDE_sha1crypt
+#define hmac_sha1_init_ctx       _crypt_hmac_sha1_init_ctx
+#define hmac_sha1_process_ctx    _crypt_hmac_sha1_process_ctx
 #define hmac_sha1_process_data   _crypt_hmac_sha1_process_data
 #define sha1_finish_ctx          _crypt_sha1_finish_ctx
 #define sha1_init_ctx            _crypt_sha1_init_ctx
+#define sha1_process_block       _crypt_sha1_process_block
 #define sha1_process_bytes       _crypt_sha1_process_bytes
 #endif
 
+#if INCLUDE_descrypt
+#define crypt_descrypt_batch_rn _crypt_crypt_descrypt_batch_rn
+#endif
+#if INCLUDE_bigcrypt
+#define crypt_bigcrypt_batch_rn _crypt_crypt_bigcrypt_batch_rn
+#endif
+#if INCLUDE_bsdicrypt
+#define crypt_bsdicrypt_batch_rn _crypt_crypt_bsdicrypt_batch_rn
+#endif
+
+#if INCLUDE_bcrypt
+#define crypt_bcrypt_batch_rn _crypt_crypt_bcrypt_batch_rn
+#endif
+#if INCLUDE_bcrypt_a
+#define crypt_bcrypt_a_batch_rn _crypt_crypt_bcrypt_a_batch_rn
+#endif
+#if INCLUDE_bcrypt_x
+#define crypt_bcrypt_x_batch_rn _crypt_crypt_bcrypt_x_batch_rn
+#endif
+#if INCLUDE_bcrypt_y
+#define crypt_bcrypt_y_batch_rn _crypt_crypt_bcrypt_y_batch_rn
+#endif
+
 #if INCLUDE_sha512crypt
 #define libcperciva_SHA512_Init   _crypt_SHA512_Init
 #define libcperciva_SHA512_Update _crypt_SHA512_Update
 #define libcperciva_SHA512_Final  _crypt_SHA512_Final
 #define libcperciva_SHA512_Buf    _crypt_SHA512_Buf
+#define libcperciva_SHA512_MB_Buf _crypt_SHA512_MB_Buf
+#define libcperciva_SHA512_MB_Lanes _crypt_SHA512_MB_Lanes
+#define crypt_sha512crypt_batch_rn _crypt_crypt_sha512crypt_batch_rn
 #endif
 
 #if INCLUDE_md5crypt || INCLUDE_sha256crypt || INCLUDE_sha512crypt || \
@@ -374,20 +430,41 @@ extern size_t strcpy_or_abort (void *dst, size_t d_size, const void *src);
 #if INCLUDE_yescrypt || INCLUDE_scrypt || INCLUDE_gost_yescrypt || \
     INCLUDE_sm3_yescrypt
 #define PBKDF2_SHA256            _crypt_PBKDF2_SHA256
+#define acquire_yescrypt_local   _crypt_acquire_yescrypt_local
+#define acquire_yescrypt_rom     _crypt_acquire_yescrypt_rom
 #define crypto_scrypt            _crypt_crypto_scrypt
+#define release_yescrypt_local   _crypt_release_yescrypt_local
+#define release_yescrypt_rom     _crypt_release_yescrypt_rom
 #define yescrypt                 _crypt_yescrypt
 #define yescrypt_decode64        _crypt_yescrypt_decode64
+#define yescrypt_decode_params   _crypt_yescrypt_decode_params
 #define yescrypt_digest_shared   _crypt_yescrypt_digest_shared
 #define yescrypt_encode64        _crypt_yescrypt_encode64
 #define yescrypt_encode_params   _crypt_yescrypt_encode_params
 #define yescrypt_encode_params_r _crypt_yescrypt_encode_params_r
 #define yescrypt_free_local      _crypt_yescrypt_free_local
 #define yescrypt_free_shared     _crypt_yescrypt_free_shared
+#define yescrypt_get_memory_usage _crypt_yescrypt_get_memory_usage
+#define yescrypt_get_region_stats _crypt_yescrypt_get_region_stats
 #define yescrypt_init_local      _crypt_yescrypt_init_local
 #define yescrypt_init_shared     _crypt_yescrypt_init_shared
 #define yescrypt_kdf             _crypt_yescrypt_kdf
+#ifdef HAVE_PRAGMA_TARGET_AVX
+#define yescrypt_kernels_avx     _crypt_yescrypt_kernels_avx
+#endif
+#ifdef HAVE_PRAGMA_TARGET_AVX512VL
+#define yescrypt_kernels_avx512vl _crypt_yescrypt_kernels_avx512vl
+#endif
+#ifdef HAVE_PRAGMA_TARGET_XOP
+#define yescrypt_kernels_xop     _crypt_yescrypt_kernels_xop
+#endif
+#define yescrypt_kernels_r32     _crypt_yescrypt_kernels_r32
+#define yescrypt_kernels_r8      _crypt_yescrypt_kernels_r8
+#define yescrypt_memory_limited  _crypt_yescrypt_memory_limited
 #define yescrypt_r               _crypt_yescrypt_r
+#define yescrypt_region_pooled   _crypt_yescrypt_region_pooled
 #define yescrypt_reencrypt       _crypt_yescrypt_reencrypt
+#define yescrypt_set_memory_limit _crypt_yescrypt_set_memory_limit
 
 #define libcperciva_HMAC_SHA256_Init _crypt_HMAC_SHA256_Init
 #define libcperciva_HMAC_SHA256_Update _crypt_HMAC_SHA256_Update
@@ -409,6 +486,12 @@ extern size_t strcpy_or_abort (void *dst, size_t d_size, const void *src);
 #define sm3_final  _crypt_sm3_final
 #define sm3_hash   _crypt_sm3_hash
 #define sm3_buf    _crypt_sm3_buf
+#define sm3_mb_hash  _crypt_sm3_mb_hash
+#define sm3_mb_lanes _crypt_sm3_mb_lanes
+#endif
+
+#if INCLUDE_sm3crypt
+#define crypt_sm3crypt_batch_rn _crypt_crypt_sm3crypt_batch_rn
 #endif
 
 #if INCLUDE_gost_yescrypt
@@ -464,6 +547,53 @@ extern char *fcrypt (const char *key, const char *setting);
    sets errno when it returns false.  Can block.  */
 extern bool get_random_bytes (void *buf, size_t buflen);
 
+#if ENABLE_RANDOM_POOL
+/* Like get_random_bytes, but take the bytes from a pool kept by the
+   calling thread, which is seeded from get_random_bytes and refilled
+   with ChaCha20.  Usually needs no system call.  */
+extern bool get_random_bytes_pooled (void *buf, size_t buflen);
+#endif
+
+/* Optional instruction set extensions that some hashing methods can
+   take advantage of.  Code using them is compiled regardless of the
+   compiler's baseline target (see xcrypt_CHECK_TARGET_ISA in
+   configure.ac) and must only be called if get_cpu_features() reports
+   that the CPU we are running on supports them.  */
+#define CPU_FEATURE_DETECTED  0x00000001u
+#define CPU_FEATURE_AVX2      0x00000002u
+#define CPU_FEATURE_AVX512F   0x00000004u
+#define CPU_FEATURE_SHA       0x00000008u /* x86 SHA extensions + SSE4.1 */
+#define CPU_FEATURE_ARM_SHA2  0x00000010u /* ARMv8 SHA-256 instructions */
+#define CPU_FEATURE_AVX       0x00000020u
+#define CPU_FEATURE_AVX512VL  0x00000040u /* AVX-512F + AVX-512VL */
+#define CPU_FEATURE_XOP       0x00000080u /* AMD XOP, with AVX state */
+#define CPU_FEATURE_ARM_SHA1  0x00000100u /* ARMv8 SHA-1 instructions */
+#define CPU_FEATURE_SSE2      0x00000200u /* part of the x86-64 baseline */
+
+/* Return the set of CPU_FEATURE_* bits supported by this CPU and
+   operating system.  Detection happens on the first call; later calls
+   are cheap enough to make on every hash.  */
+extern uint32_t get_cpu_features (void);
+
+/* Make get_cpu_features() report at most the features in MASK from
+   now on.  This exists so that the testsuite can exercise fallback
+   code paths on machines that support faster ones.  */
+extern void restrict_cpu_features (uint32_t mask);
+
+#if ENABLE_YESCRYPT_THREADS
+/* Call FN (ARG, i) for each i from 0 to N - 1, spreading the calls
+   over a pool of worker threads and the calling thread, and return
+   once all of them have finished.  The calls may happen in any order,
+   so they must be independent of each other.  If the pool is busy with
+   another thread's work, the calls are made serially instead.  */
+typedef void (*thread_pool_fn) (void *arg, uint32_t i);
+extern void thread_pool_run (thread_pool_fn fn, void *arg, uint32_t n);
+
+/* Return the largest number of threads, including the calling thread,
+   that thread_pool_run will use.  Starts the pool on first call.  */
+extern uint32_t thread_pool_size (void);
+#endif
+
 /* Generate a setting string in the format common to md5crypt,
    sha256crypt, and sha512crypt.  */
 extern void gensalt_sha_rn (const char *tag, size_t maxsalt, unsigned long defcount,
@@ -509,6 +639,81 @@ extern const unsigned char ascii64[65];
    this big.  */
 #define ALG_SPECIFIC_SIZE 8192
 
+/* Hashing methods that can compute several hashes faster together
+   than one at a time provide a batch entry point, which takes an
+   array of these.  Each item's OUTPUT has already been filled in with
+   a failure token, and is only overwritten if that item is hashed
+   successfully.  Batch entry points set errno as the individual
+   methods' crypt functions do, for the last item that failed.  */
+struct crypt_batch_item
+{
+  const char *phrase;
+  size_t phr_size;
+  const char *setting;
+  size_t set_size;
+  uint8_t *output;
+  size_t out_size;
+};
+
+/* The "scratch" area passed to batch entry points is this big.  */
+#define ALG_BATCH_SPECIFIC_SIZE 16384
+
+#if INCLUDE_descrypt
+extern void crypt_descrypt_batch_rn (struct crypt_batch_item *items,
+                                     size_t nitems,
+                                     void *scratch, size_t scr_size);
+#endif
+#if INCLUDE_bigcrypt
+extern void crypt_bigcrypt_batch_rn (struct crypt_batch_item *items,
+                                     size_t nitems,
+                                     void *scratch, size_t scr_size);
+#endif
+#if INCLUDE_bsdicrypt
+extern void crypt_bsdicrypt_batch_rn (struct crypt_batch_item *items,
+                                      size_t nitems,
+                                      void *scratch, size_t scr_size);
+#endif
+#if INCLUDE_bcrypt
+extern void crypt_bcrypt_batch_rn (struct crypt_batch_item *items,
+                                   size_t nitems,
+                                   void *scratch, size_t scr_size);
+#endif
+#if INCLUDE_bcrypt_a
+extern void crypt_bcrypt_a_batch_rn (struct crypt_batch_item *items,
+                                     size_t nitems,
+                                     void *scratch, size_t scr_size);
+#endif
+#if INCLUDE_bcrypt_x
+extern void crypt_bcrypt_x_batch_rn (struct crypt_batch_item *items,
+                                     size_t nitems,
+                                     void *scratch, size_t scr_size);
+#endif
+#if INCLUDE_bcrypt_y
+extern void crypt_bcrypt_y_batch_rn (struct crypt_batch_item *items,
+                                     size_t nitems,
+                                     void *scratch, size_t scr_size);
+#endif
+#if INCLUDE_md5crypt
+extern void crypt_md5crypt_batch_rn (struct crypt_batch_item *items,
+                                     size_t nitems,
+                                     void *scratch, size_t scr_size);
+#endif
+#if INCLUDE_sunmd5
+extern void crypt_sunmd5_batch_rn (struct crypt_batch_item *items,
+                                   size_t nitems,
+                                   void *scratch, size_t scr_size);
+#endif
+#if INCLUDE_sha512crypt
+extern void crypt_sha512crypt_batch_rn (struct crypt_batch_item *items,
+                                        size_t nitems,
+                                        void *scratch, size_t scr_size);
+#endif
+#if INCLUDE_sm3crypt
+extern void crypt_sm3crypt_batch_rn (struct crypt_batch_item *items,
+                                     size_t nitems,
+                                     void *scratch, size_t scr_size);
+#endif
+
 #include "crypt.h"
 
 #endif /* crypt-port.h */
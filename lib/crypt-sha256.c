@@ -67,6 +67,8 @@ struct sha256_buffer
 static_assert (sizeof (struct sha256_buffer) <= ALG_SPECIFIC_SIZE,
                "ALG_SPECIFIC_SIZE is too small for SHA256");
 
+const size_t footprint_sha256crypt_rn = sizeof (struct sha256_buffer);
+
 
 /* Feed CTX with LEN bytes of a virtual byte sequence consisting of
    BLOCK repeated over and over indefinitely.  */
@@ -67,6 +67,8 @@ struct sha512_buffer
 static_assert (sizeof (struct sha512_buffer) <= ALG_SPECIFIC_SIZE,
                "ALG_SPECIFIC_SIZE is too small for SHA512");
 
+const size_t footprint_sha512crypt_rn = sizeof (struct sha512_buffer);
+
 
 /* Subroutine of _xcrypt_crypt_sha512crypt_rn: Feed CTX with LEN bytes of a
    virtual byte sequence consisting of BLOCK repeated over and over
@@ -81,30 +83,18 @@ sha512_process_recycled_bytes (unsigned char block[64], size_t len,
   SHA512_Update (ctx, block, cnt);
 }
 
-void
-crypt_sha512crypt_rn (const char *phrase, size_t phr_size,
-                      const char *setting, size_t ARG_UNUSED (set_size),
-                      uint8_t *output, size_t out_size,
-                      void *scratch, size_t scr_size)
+/* Subroutine of crypt_sha512crypt_rn and crypt_sha512crypt_batch_rn:
+   Parse SETTING, storing the start and length of the salt in *SALTP
+   and *SALT_SIZEP, the number of rounds in *ROUNDSP, and whether the
+   number of rounds was given explicitly in *ROUNDS_CUSTOMP.  Returns
+   false and sets errno if SETTING is invalid.  */
+static bool
+sha512crypt_parse_setting (const char *setting, const char **saltp,
+                           size_t *salt_sizep, size_t *roundsp,
+                           bool *rounds_customp)
 {
-  /* This shouldn't ever happen, but...  */
-  if (out_size < SHA512_HASH_LENGTH
-      || scr_size < sizeof (struct sha512_buffer))
-    {
-      errno = ERANGE;
-      return;
-    }
-
-  struct sha512_buffer *buf = scratch;
-  SHA512_CTX *ctx = &buf->ctx;
-  uint8_t *result = buf->result;
-  uint8_t *p_bytes = buf->p_bytes;
-  uint8_t *s_bytes = buf->s_bytes;
-  char *cp = (char *)output;
   const char *salt = setting;
-
   size_t salt_size;
-  size_t cnt;
   /* Default number of rounds.  */
   size_t rounds = ROUNDS_DEFAULT;
   bool rounds_custom = false;
@@ -124,7 +114,7 @@ crypt_sha512crypt_rn (const char *phrase, size_t phr_size,
       if (!(*num >= '1' && *num <= '9'))
         {
           errno = EINVAL;
-          return;
+          return false;
         }
 
       errno = 0;
@@ -136,7 +126,7 @@ crypt_sha512crypt_rn (const char *phrase, size_t phr_size,
           || errno)
         {
           errno = EINVAL;
-          return;
+          return false;
         }
       salt = endp + 1;
       rounds_custom = true;
@@ -150,13 +140,31 @@ crypt_sha512crypt_rn (const char *phrase, size_t phr_size,
   if (!(salt[salt_size] == '$' || !salt[salt_size]))
     {
       errno = EINVAL;
-      return;
+      return false;
     }
 
   /* Ensure we do not use more salt than SALT_LEN_MAX. */
   if (salt_size > SALT_LEN_MAX)
     salt_size = SALT_LEN_MAX;
 
+  *saltp = salt;
+  *salt_sizep = salt_size;
+  *roundsp = rounds;
+  *rounds_customp = rounds_custom;
+  return true;
+}
+
+/* Subroutine of crypt_sha512crypt_rn and crypt_sha512crypt_batch_rn:
+   Compute the initial RESULT and the P and S byte sequences that the
+   main loop mixes together.  */
+static void
+sha512crypt_prepare (const char *phrase, size_t phr_size,
+                     const char *salt, size_t salt_size,
+                     SHA512_CTX *ctx, uint8_t result[64],
+                     uint8_t p_bytes[64], uint8_t s_bytes[64])
+{
+  size_t cnt;
+
   /* Compute alternate SHA512 sum with input PHRASE, SALT, and PHRASE.  The
      final result will be added to the first context.  */
   SHA512_Init (ctx);
@@ -220,37 +228,17 @@ crypt_sha512crypt_rn (const char *phrase, size_t phr_size,
 
   /* Finish the digest.  */
   SHA512_Final (s_bytes, ctx);
+}
 
-  /* Repeatedly run the collected hash value through SHA512 to burn
-     CPU cycles.  */
-  for (cnt = 0; cnt < rounds; ++cnt)
-    {
-      /* New context.  */
-      SHA512_Init (ctx);
-
-      /* Add phrase or last result.  */
-      if ((cnt & 1) != 0)
-        sha512_process_recycled_bytes (p_bytes, phr_size, ctx);
-      else
-        SHA512_Update (ctx, result, 64);
-
-      /* Add salt for numbers not divisible by 3.  */
-      if (cnt % 3 != 0)
-        sha512_process_recycled_bytes (s_bytes, salt_size, ctx);
-
-      /* Add phrase for numbers not divisible by 7.  */
-      if (cnt % 7 != 0)
-        sha512_process_recycled_bytes (p_bytes, phr_size, ctx);
-
-      /* Add phrase or last result.  */
-      if ((cnt & 1) != 0)
-        SHA512_Update (ctx, result, 64);
-      else
-        sha512_process_recycled_bytes (p_bytes, phr_size, ctx);
-
-      /* Create intermediate result.  */
-      SHA512_Final (result, ctx);
-    }
+/* Subroutine of crypt_sha512crypt_rn and crypt_sha512crypt_batch_rn:
+   Write the complete hash string for RESULT to OUTPUT, which must be
+   at least SHA512_HASH_LENGTH bytes long.  */
+static void
+sha512crypt_format (uint8_t *output, const char *salt, size_t salt_size,
+                    size_t rounds, bool rounds_custom,
+                    const uint8_t result[64])
+{
+  char *cp = (char *)output;
 
   /* Now we can construct the result string.  It consists of four
      parts, one of which is optional.  We already know that buflen is
@@ -311,6 +299,237 @@ crypt_sha512crypt_rn (const char *phrase, size_t phr_size,
   *cp = '\0';
 }
 
+void
+crypt_sha512crypt_rn (const char *phrase, size_t phr_size,
+                      const char *setting, size_t ARG_UNUSED (set_size),
+                      uint8_t *output, size_t out_size,
+                      void *scratch, size_t scr_size)
+{
+  /* This shouldn't ever happen, but...  */
+  if (out_size < SHA512_HASH_LENGTH
+      || scr_size < sizeof (struct sha512_buffer))
+    {
+      errno = ERANGE;
+      return;
+    }
+
+  struct sha512_buffer *buf = scratch;
+  SHA512_CTX *ctx = &buf->ctx;
+  uint8_t *result = buf->result;
+  uint8_t *p_bytes = buf->p_bytes;
+  uint8_t *s_bytes = buf->s_bytes;
+  const char *salt;
+  size_t salt_size;
+  size_t cnt;
+  size_t rounds;
+  bool rounds_custom;
+
+  if (!sha512crypt_parse_setting (setting, &salt, &salt_size,
+                                  &rounds, &rounds_custom))
+    return;
+
+  sha512crypt_prepare (phrase, phr_size, salt, salt_size,
+                       ctx, result, p_bytes, s_bytes);
+
+  /* Repeatedly run the collected hash value through SHA512 to burn
+     CPU cycles.  */
+  for (cnt = 0; cnt < rounds; ++cnt)
+    {
+      /* New context.  */
+      SHA512_Init (ctx);
+
+      /* Add phrase or last result.  */
+      if ((cnt & 1) != 0)
+        sha512_process_recycled_bytes (p_bytes, phr_size, ctx);
+      else
+        SHA512_Update (ctx, result, 64);
+
+      /* Add salt for numbers not divisible by 3.  */
+      if (cnt % 3 != 0)
+        sha512_process_recycled_bytes (s_bytes, salt_size, ctx);
+
+      /* Add phrase for numbers not divisible by 7.  */
+      if (cnt % 7 != 0)
+        sha512_process_recycled_bytes (p_bytes, phr_size, ctx);
+
+      /* Add phrase or last result.  */
+      if ((cnt & 1) != 0)
+        SHA512_Update (ctx, result, 64);
+      else
+        sha512_process_recycled_bytes (p_bytes, phr_size, ctx);
+
+      /* Create intermediate result.  */
+      SHA512_Final (result, ctx);
+    }
+
+  sha512crypt_format (output, salt, salt_size, rounds, rounds_custom, result);
+}
+
+/* The longest message hashed by one round of the main loop: the
+   previous result, the salt, and the phrase twice.  */
+#define SHA512_ROUND_MSG_MAX \
+  (64 + SALT_LEN_MAX + 2 * (CRYPT_MAX_PASSPHRASE_SIZE - 1))
+
+/* Intermediate data for one lane of crypt_sha512crypt_batch_rn.  */
+struct sha512_batch_lane
+{
+  struct crypt_batch_item *item;
+  const char *salt;
+  size_t salt_size;
+  size_t rounds;
+  bool rounds_custom;
+  uint8_t result[64];
+  uint8_t p_bytes[64];
+  uint8_t s_bytes[64];
+  uint8_t msg[SHA512_ROUND_MSG_MAX];
+};
+
+struct sha512_batch_buffer
+{
+  SHA512_CTX ctx;
+  struct sha512_batch_lane lanes[SHA512_MB_LANES];
+};
+
+static_assert (sizeof (struct sha512_batch_buffer) <= ALG_BATCH_SPECIFIC_SIZE,
+               "ALG_BATCH_SPECIFIC_SIZE is too small for SHA512");
+
+/* Subroutine of crypt_sha512crypt_batch_rn: Append LEN bytes of BLOCK
+   repeated over and over indefinitely to DST; return the new end of
+   DST.  This is sha512_process_recycled_bytes for a flat buffer.  */
+static uint8_t *
+sha512_append_recycled_bytes (uint8_t *dst, const uint8_t block[64],
+                              size_t len)
+{
+  for (; len >= 64; len -= 64, dst += 64)
+    memcpy (dst, block, 64);
+  memcpy (dst, block, len);
+  return dst + len;
+}
+
+/* Subroutine of crypt_sha512crypt_batch_rn: Run the main loop for the
+   first NLANES lanes of BUF at once, feeding the messages for every
+   round of all the lanes still running to SHA512_MB_Buf together,
+   then write out their hashes.  */
+static void
+sha512crypt_batch_finish (struct sha512_batch_buffer *buf, size_t nlanes)
+{
+  const void *msgs[SHA512_MB_LANES];
+  size_t lens[SHA512_MB_LANES];
+  unsigned char *digests[SHA512_MB_LANES];
+  size_t max_rounds = 0;
+  size_t cnt, i, n;
+
+  for (i = 0; i < nlanes; i++)
+    max_rounds = MAX (max_rounds, buf->lanes[i].rounds);
+
+  for (cnt = 0; cnt < max_rounds; ++cnt)
+    {
+      for (i = 0, n = 0; i < nlanes; i++)
+        {
+          struct sha512_batch_lane *l = &buf->lanes[i];
+          size_t phr_size = l->item->phr_size;
+          uint8_t *p = l->msg;
+
+          /* Lanes with fewer rounds than the others drop out early.  */
+          if (cnt >= l->rounds)
+            continue;
+
+          /* The same sequence as in crypt_sha512crypt_rn.  */
+          if ((cnt & 1) != 0)
+            p = sha512_append_recycled_bytes (p, l->p_bytes, phr_size);
+          else
+            p = sha512_append_recycled_bytes (p, l->result, 64);
+
+          if (cnt % 3 != 0)
+            p = sha512_append_recycled_bytes (p, l->s_bytes, l->salt_size);
+
+          if (cnt % 7 != 0)
+            p = sha512_append_recycled_bytes (p, l->p_bytes, phr_size);
+
+          if ((cnt & 1) != 0)
+            p = sha512_append_recycled_bytes (p, l->result, 64);
+          else
+            p = sha512_append_recycled_bytes (p, l->p_bytes, phr_size);
+
+          msgs[n] = l->msg;
+          lens[n] = (size_t) (p - l->msg);
+          digests[n] = l->result;
+          n++;
+        }
+
+      SHA512_MB_Buf (msgs, lens, digests, n);
+    }
+
+  for (i = 0; i < nlanes; i++)
+    {
+      struct sha512_batch_lane *l = &buf->lanes[i];
+      sha512crypt_format (l->item->output, l->salt, l->salt_size,
+                          l->rounds, l->rounds_custom, l->result);
+    }
+}
+
+/* Compute several sha512crypt hashes at once.  Up to SHA512_MB_Lanes()
+   hashes run in parallel, in the lanes of the vector registers; hashes
+   with different numbers of rounds can share a batch.  */
+void
+crypt_sha512crypt_batch_rn (struct crypt_batch_item *items, size_t nitems,
+                            void *scratch, size_t scr_size)
+{
+  size_t lanes = SHA512_MB_Lanes ();
+  size_t i, nlanes;
+
+  /* Without vector support, the batch would only be slower than
+     hashing each item by itself.  */
+  if (lanes == 1)
+    {
+      for (i = 0; i < nitems; i++)
+        crypt_sha512crypt_rn (items[i].phrase, items[i].phr_size,
+                              items[i].setting, items[i].set_size,
+                              items[i].output, items[i].out_size,
+                              scratch, scr_size);
+      return;
+    }
+
+  /* This shouldn't ever happen, but...  */
+  if (scr_size < sizeof (struct sha512_batch_buffer))
+    {
+      errno = ERANGE;
+      return;
+    }
+
+  struct sha512_batch_buffer *buf = scratch;
+
+  for (i = 0, nlanes = 0; i < nitems; i++)
+    {
+      struct crypt_batch_item *item = &items[i];
+      struct sha512_batch_lane *l = &buf->lanes[nlanes];
+
+      if (item->out_size < SHA512_HASH_LENGTH
+          || item->phr_size >= CRYPT_MAX_PASSPHRASE_SIZE)
+        {
+          errno = ERANGE;
+          continue;
+        }
+      if (!sha512crypt_parse_setting (item->setting, &l->salt, &l->salt_size,
+                                      &l->rounds, &l->rounds_custom))
+        continue;
+
+      l->item = item;
+      sha512crypt_prepare (item->phrase, item->phr_size,
+                           l->salt, l->salt_size, &buf->ctx,
+                           l->result, l->p_bytes, l->s_bytes);
+
+      if (++nlanes == lanes)
+        {
+          sha512crypt_batch_finish (buf, nlanes);
+          nlanes = 0;
+        }
+    }
+
+  if (nlanes > 0)
+    sha512crypt_batch_finish (buf, nlanes);
+}
+
 void
 gensalt_sha512crypt_rn (unsigned long count,
                         const uint8_t *rbytes, size_t nrbytes,
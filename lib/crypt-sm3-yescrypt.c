@@ -49,6 +49,9 @@ typedef struct
 static_assert (sizeof (crypt_sm3_yescrypt_internal_t) <= ALG_SPECIFIC_SIZE,
                "ALG_SPECIFIC_SIZE is too small for SM3-YESCRYPT.");
 
+const size_t footprint_sm3_yescrypt_rn =
+  sizeof (crypt_sm3_yescrypt_internal_t);
+
 /*
  * As OUTPUT is initialized with a failure token before gensalt_yescrypt_rn
  * is called, in case of an error we could just set an appropriate errno
@@ -110,7 +113,9 @@ crypt_sm3_yescrypt_rn (const char *phrase, size_t phr_size,
 
   crypt_sm3_yescrypt_internal_t *intbuf = scratch;
 
-  if (yescrypt_init_local (&intbuf->local))
+  yescrypt_local_t *local = acquire_yescrypt_local (&intbuf->local);
+
+  if (!local)
     return;
 
   /* convert gost setting to yescrypt setting */
@@ -119,15 +124,25 @@ crypt_sm3_yescrypt_rn (const char *phrase, size_t phr_size,
   intbuf->sm3setting[2] = '$';
   strcpy_or_abort (&intbuf->sm3setting[3], set_size - 3, setting + 6);
 
-  intbuf->retval = yescrypt_r (NULL, &intbuf->local,
+  /* EAGAIN is passed on, as in crypt_yescrypt_rn.  */
+  int saved_errno = errno;
+  errno = 0;
+  yescrypt_shared_t *rom = acquire_yescrypt_rom ();
+  intbuf->retval = yescrypt_r (rom, local,
                                (const uint8_t *) phrase, phr_size,
                                intbuf->sm3setting, NULL,
                                intbuf->outbuf + 3, o_size - 3);
+  release_yescrypt_rom (rom);
 
   if (!intbuf->retval)
-    errno = EINVAL;
+    {
+      if (errno != EAGAIN)
+        errno = EINVAL;
+    }
+  else
+    errno = saved_errno;
 
-  if (yescrypt_free_local (&intbuf->local) || !intbuf->retval)
+  if (release_yescrypt_local (local) || !intbuf->retval)
     return;
 
   intbuf->outbuf[0] = '$';
@@ -68,6 +68,8 @@ struct sm3_buffer
 static_assert (sizeof (struct sm3_buffer) <= ALG_SPECIFIC_SIZE,
                "ALG_SPECIFIC_SIZE is too small for SM3crypt");
 
+const size_t footprint_sm3crypt_rn = sizeof (struct sm3_buffer);
+
 
 /* Feed CTX with LEN bytes of a virtual byte sequence consisting of
    BLOCK repeated over and over indefinitely.  */
@@ -81,30 +83,18 @@ sm3_update_recycled (sm3_ctx *ctx,
   sm3_update (ctx, block, cnt);
 }
 
-void
-crypt_sm3crypt_rn (const char *phrase, size_t phr_size,
-                   const char *setting, size_t ARG_UNUSED (set_size),
-                   uint8_t *output, size_t out_size,
-                   void *scratch, size_t scr_size)
+/* Subroutine of crypt_sm3crypt_rn and crypt_sm3crypt_batch_rn:
+   Parse SETTING, storing the start and length of the salt in *SALTP
+   and *SALT_SIZEP, the number of rounds in *ROUNDSP, and whether the
+   number of rounds was given explicitly in *ROUNDS_CUSTOMP.  Returns
+   false and sets errno if SETTING is invalid.  */
+static bool
+sm3crypt_parse_setting (const char *setting, const char **saltp,
+                        size_t *salt_sizep, size_t *roundsp,
+                        bool *rounds_customp)
 {
-  /* This shouldn't ever happen, but...  */
-  if (out_size < SM3_HASH_LENGTH
-      || scr_size < sizeof (struct sm3_buffer))
-    {
-      errno = ERANGE;
-      return;
-    }
-
-  struct sm3_buffer *buf = scratch;
-  sm3_ctx *ctx = &buf->ctx;
-  uint8_t *result = buf->result;
-  uint8_t *p_bytes = buf->p_bytes;
-  uint8_t *s_bytes = buf->s_bytes;
-  char *cp = (char *)output;
   const char *salt = setting;
-
   size_t salt_size;
-  size_t cnt;
   /* Default number of rounds.  */
   size_t rounds = ROUNDS_DEFAULT;
   bool rounds_custom = false;
@@ -124,7 +114,7 @@ crypt_sm3crypt_rn (const char *phrase, size_t phr_size,
       if (!(*num >= '1' && *num <= '9'))
         {
           errno = EINVAL;
-          return;
+          return false;
         }
 
       errno = 0;
@@ -136,7 +126,7 @@ crypt_sm3crypt_rn (const char *phrase, size_t phr_size,
           || errno)
         {
           errno = EINVAL;
-          return;
+          return false;
         }
       salt = endp + 1;
       rounds_custom = true;
@@ -150,13 +140,31 @@ crypt_sm3crypt_rn (const char *phrase, size_t phr_size,
   if (!(salt[salt_size] == '$' || !salt[salt_size]))
     {
       errno = EINVAL;
-      return;
+      return false;
     }
 
   /* Ensure we do not use more salt than SALT_LEN_MAX. */
   if (salt_size > SALT_LEN_MAX)
     salt_size = SALT_LEN_MAX;
 
+  *saltp = salt;
+  *salt_sizep = salt_size;
+  *roundsp = rounds;
+  *rounds_customp = rounds_custom;
+  return true;
+}
+
+/* Subroutine of crypt_sm3crypt_rn and crypt_sm3crypt_batch_rn:
+   Compute the initial RESULT and the P and S byte sequences that the
+   main loop mixes together.  */
+static void
+sm3crypt_prepare (const char *phrase, size_t phr_size,
+                  const char *salt, size_t salt_size,
+                  sm3_ctx *ctx, uint8_t result[32],
+                  uint8_t p_bytes[32], uint8_t s_bytes[32])
+{
+  size_t cnt;
+
   /* Compute alternate SM3 sum with input PHRASE, SALT, and PHRASE.  The
      final result will be added to the first context.  */
   sm3_init (ctx);
@@ -219,37 +227,17 @@ crypt_sm3crypt_rn (const char *phrase, size_t phr_size,
 
   /* Finish the digest.  */
   sm3_final (s_bytes, ctx);
+}
 
-  /* Repeatedly run the collected hash value through SM3 to burn
-     CPU cycles.  */
-  for (cnt = 0; cnt < rounds; ++cnt)
-    {
-      /* New context.  */
-      sm3_init (ctx);
-
-      /* Add phrase or last result.  */
-      if ((cnt & 1) != 0)
-        sm3_update_recycled (ctx, p_bytes, phr_size);
-      else
-        sm3_update (ctx, result, 32);
-
-      /* Add salt for numbers not divisible by 3.  */
-      if (cnt % 3 != 0)
-        sm3_update_recycled (ctx, s_bytes, salt_size);
-
-      /* Add phrase for numbers not divisible by 7.  */
-      if (cnt % 7 != 0)
-        sm3_update_recycled (ctx, p_bytes, phr_size);
-
-      /* Add phrase or last result.  */
-      if ((cnt & 1) != 0)
-        sm3_update (ctx, result, 32);
-      else
-        sm3_update_recycled (ctx, p_bytes, phr_size);
-
-      /* Create intermediate result.  */
-      sm3_final (result, ctx);
-    }
+/* Subroutine of crypt_sm3crypt_rn and crypt_sm3crypt_batch_rn:
+   Write the complete hash string for RESULT to OUTPUT, which must be
+   at least SM3_HASH_LENGTH bytes long.  */
+static void
+sm3crypt_format (uint8_t *output, const char *salt, size_t salt_size,
+                 size_t rounds, bool rounds_custom,
+                 const uint8_t result[32])
+{
+  char *cp = (char *)output;
 
   /* Now we can construct the result string.  It consists of four
      parts, one of which is optional.  We already know that there
@@ -296,6 +284,234 @@ crypt_sm3crypt_rn (const char *phrase, size_t phr_size,
   *cp = '\0';
 }
 
+void
+crypt_sm3crypt_rn (const char *phrase, size_t phr_size,
+                   const char *setting, size_t ARG_UNUSED (set_size),
+                   uint8_t *output, size_t out_size,
+                   void *scratch, size_t scr_size)
+{
+  /* This shouldn't ever happen, but...  */
+  if (out_size < SM3_HASH_LENGTH
+      || scr_size < sizeof (struct sm3_buffer))
+    {
+      errno = ERANGE;
+      return;
+    }
+
+  struct sm3_buffer *buf = scratch;
+  sm3_ctx *ctx = &buf->ctx;
+  uint8_t *result = buf->result;
+  uint8_t *p_bytes = buf->p_bytes;
+  uint8_t *s_bytes = buf->s_bytes;
+  const char *salt;
+  size_t salt_size;
+  size_t cnt;
+  size_t rounds;
+  bool rounds_custom;
+
+  if (!sm3crypt_parse_setting (setting, &salt, &salt_size,
+                               &rounds, &rounds_custom))
+    return;
+
+  sm3crypt_prepare (phrase, phr_size, salt, salt_size,
+                    ctx, result, p_bytes, s_bytes);
+
+  /* Repeatedly run the collected hash value through SM3 to burn
+     CPU cycles.  */
+  for (cnt = 0; cnt < rounds; ++cnt)
+    {
+      /* New context.  */
+      sm3_init (ctx);
+
+      /* Add phrase or last result.  */
+      if ((cnt & 1) != 0)
+        sm3_update_recycled (ctx, p_bytes, phr_size);
+      else
+        sm3_update (ctx, result, 32);
+
+      /* Add salt for numbers not divisible by 3.  */
+      if (cnt % 3 != 0)
+        sm3_update_recycled (ctx, s_bytes, salt_size);
+
+      /* Add phrase for numbers not divisible by 7.  */
+      if (cnt % 7 != 0)
+        sm3_update_recycled (ctx, p_bytes, phr_size);
+
+      /* Add phrase or last result.  */
+      if ((cnt & 1) != 0)
+        sm3_update (ctx, result, 32);
+      else
+        sm3_update_recycled (ctx, p_bytes, phr_size);
+
+      /* Create intermediate result.  */
+      sm3_final (result, ctx);
+    }
+
+  sm3crypt_format (output, salt, salt_size, rounds, rounds_custom, result);
+}
+
+/* Intermediate data for one lane of crypt_sm3crypt_batch_rn.  */
+struct sm3_batch_lane
+{
+  struct crypt_batch_item *item;
+  const char *salt;
+  size_t salt_size;
+  size_t rounds;
+  bool rounds_custom;
+  uint8_t result[32];
+  uint8_t s_bytes[32];
+  /* The P byte sequence, repeated out to the length of the phrase, so
+     that every round's message is made of at most four pieces.  */
+  uint8_t p_bytes[CRYPT_MAX_PASSPHRASE_SIZE];
+};
+
+struct sm3_batch_buffer
+{
+  sm3_ctx ctx;
+  struct sm3_batch_lane lanes[SM3_MB_LANES];
+};
+
+static_assert (sizeof (struct sm3_batch_buffer) <= ALG_BATCH_SPECIFIC_SIZE,
+               "ALG_BATCH_SPECIFIC_SIZE is too small for SM3crypt");
+
+/* Subroutine of crypt_sm3crypt_batch_rn: Append SIZE bytes from DATA
+   to MSG as its next piece.  */
+static void
+sm3_batch_add_part (sm3_mb_msg *msg, size_t *nparts,
+                    const void *data, size_t size)
+{
+  msg->data[*nparts] = data;
+  msg->size[*nparts] = size;
+  ++*nparts;
+}
+
+/* Subroutine of crypt_sm3crypt_batch_rn: Run the main loop for the
+   first NLANES lanes of BUF at once, feeding the messages for every
+   round of all the lanes still running to sm3_mb_hash together, then
+   write out their hashes.  */
+static void
+sm3crypt_batch_finish (struct sm3_batch_buffer *buf, size_t nlanes)
+{
+  sm3_mb_msg msgs[SM3_MB_LANES];
+  uint8_t *digests[SM3_MB_LANES];
+  size_t max_rounds = 0;
+  size_t cnt, i, n;
+
+  for (i = 0; i < nlanes; i++)
+    max_rounds = MAX (max_rounds, buf->lanes[i].rounds);
+
+  for (cnt = 0; cnt < max_rounds; ++cnt)
+    {
+      for (i = 0, n = 0; i < nlanes; i++)
+        {
+          struct sm3_batch_lane *l = &buf->lanes[i];
+          size_t phr_size = l->item->phr_size;
+          sm3_mb_msg *m = &msgs[n];
+          size_t k = 0;
+
+          /* Lanes with fewer rounds than the others drop out early.  */
+          if (cnt >= l->rounds)
+            continue;
+
+          /* The same sequence as in crypt_sm3crypt_rn.  */
+          if ((cnt & 1) != 0)
+            sm3_batch_add_part (m, &k, l->p_bytes, phr_size);
+          else
+            sm3_batch_add_part (m, &k, l->result, 32);
+
+          if (cnt % 3 != 0)
+            sm3_batch_add_part (m, &k, l->s_bytes, l->salt_size);
+
+          if (cnt % 7 != 0)
+            sm3_batch_add_part (m, &k, l->p_bytes, phr_size);
+
+          if ((cnt & 1) != 0)
+            sm3_batch_add_part (m, &k, l->result, 32);
+          else
+            sm3_batch_add_part (m, &k, l->p_bytes, phr_size);
+
+          while (k < SM3_MB_PARTS)
+            sm3_batch_add_part (m, &k, 0, 0);
+
+          digests[n] = l->result;
+          n++;
+        }
+
+      sm3_mb_hash (msgs, digests, n);
+    }
+
+  for (i = 0; i < nlanes; i++)
+    {
+      struct sm3_batch_lane *l = &buf->lanes[i];
+      sm3crypt_format (l->item->output, l->salt, l->salt_size,
+                       l->rounds, l->rounds_custom, l->result);
+    }
+}
+
+/* Compute several sm3crypt hashes at once.  Up to sm3_mb_lanes()
+   hashes run in parallel, in the lanes of the vector registers; hashes
+   with different numbers of rounds can share a batch.  */
+void
+crypt_sm3crypt_batch_rn (struct crypt_batch_item *items, size_t nitems,
+                         void *scratch, size_t scr_size)
+{
+  size_t lanes = sm3_mb_lanes ();
+  size_t i, j, nlanes;
+
+  /* Without vector support, the batch would only be slower than
+     hashing each item by itself.  */
+  if (lanes == 1)
+    {
+      for (i = 0; i < nitems; i++)
+        crypt_sm3crypt_rn (items[i].phrase, items[i].phr_size,
+                           items[i].setting, items[i].set_size,
+                           items[i].output, items[i].out_size,
+                           scratch, scr_size);
+      return;
+    }
+
+  /* This shouldn't ever happen, but...  */
+  if (scr_size < sizeof (struct sm3_batch_buffer))
+    {
+      errno = ERANGE;
+      return;
+    }
+
+  struct sm3_batch_buffer *buf = scratch;
+
+  for (i = 0, nlanes = 0; i < nitems; i++)
+    {
+      struct crypt_batch_item *item = &items[i];
+      struct sm3_batch_lane *l = &buf->lanes[nlanes];
+
+      if (item->out_size < SM3_HASH_LENGTH
+          || item->phr_size >= CRYPT_MAX_PASSPHRASE_SIZE)
+        {
+          errno = ERANGE;
+          continue;
+        }
+      if (!sm3crypt_parse_setting (item->setting, &l->salt, &l->salt_size,
+                                   &l->rounds, &l->rounds_custom))
+        continue;
+
+      l->item = item;
+      sm3crypt_prepare (item->phrase, item->phr_size,
+                        l->salt, l->salt_size, &buf->ctx,
+                        l->result, l->p_bytes, l->s_bytes);
+      for (j = 32; j < item->phr_size; j++)
+        l->p_bytes[j] = l->p_bytes[j - 32];
+
+      if (++nlanes == lanes)
+        {
+          sm3crypt_batch_finish (buf, nlanes);
+          nlanes = 0;
+        }
+    }
+
+  if (nlanes > 0)
+    sm3crypt_batch_finish (buf, nlanes);
+}
+
 void
 gensalt_sm3crypt_rn (unsigned long count,
                      const uint8_t *rbytes, size_t nrbytes,
@@ -22,11 +22,81 @@
    will not have the state objects in its data segment.  */
 
 #if INCLUDE_crypt
+
+#if ENABLE_THREAD_LOCAL_CRYPT
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+
+/* Each thread's struct crypt_data is allocated the first time the
+   thread calls crypt, and erased and freed when the thread exits.  */
+static pthread_key_t crypt_data_key;
+static pthread_once_t crypt_data_once = PTHREAD_ONCE_INIT;
+static bool crypt_data_ok;
+
+static void
+crypt_data_destroy (void *arg)
+{
+  explicit_bzero (arg, sizeof (struct crypt_data));
+  free (arg);
+}
+
+static void
+crypt_data_init (void)
+{
+  crypt_data_ok = !pthread_key_create (&crypt_data_key, crypt_data_destroy);
+}
+
+static struct crypt_data *
+crypt_data_get (void)
+{
+  struct crypt_data *data;
+
+  if (pthread_once (&crypt_data_once, crypt_data_init) || !crypt_data_ok)
+    return NULL;
+  data = pthread_getspecific (crypt_data_key);
+  if (data)
+    return data;
+
+  /* Like a static object, the buffer must start out zeroed.  */
+  data = calloc (1, sizeof *data);
+  if (!data)
+    return NULL;
+  if (pthread_setspecific (crypt_data_key, data))
+    {
+      free (data);
+      return NULL;
+    }
+  return data;
+}
+#endif
+
 char *
 crypt (const char *key, const char *setting)
 {
+#if ENABLE_THREAD_LOCAL_CRYPT
+  struct crypt_data *data = crypt_data_get ();
+  if (!data)
+    {
+      errno = ENOMEM;
+#if ENABLE_FAILURE_TOKENS
+      /* There is no buffer to write the failure token to, so pick one
+         of the two possible tokens from read-only storage, shared by
+         all threads.  make_failure_token decides which, since SETTING
+         may be null.  */
+      static const char failure_tokens[2][3] = { "*0", "*1" };
+      char token[3];
+      make_failure_token (setting, token, (int) sizeof token);
+      return (char *) (uintptr_t) failure_tokens[token[1] == '1'];
+#else
+      return 0;
+#endif
+    }
+  return crypt_r (key, setting, data);
+#else
   static struct crypt_data nr_crypt_ctx;
   return crypt_r (key, setting, &nr_crypt_ctx);
+#endif
 }
 SYMVER_crypt;
 #endif
@@ -150,21 +150,22 @@ write_itoa64_2 (uint8_t *output,
   output[1] = itoa64[(value >> 6) & 0x3f];
 }
 
-/* Module entry points.  */
-
-void
-crypt_sunmd5_rn (const char *phrase, size_t phr_size,
-                 const char *setting, size_t ARG_UNUSED (set_size),
-                 uint8_t *output, size_t out_size,
-                 void *scratch, size_t scr_size)
+struct crypt_sunmd5_scratch
+{
+  MD5_CTX ctx;
+  uint8_t dg[16];
+  char    rn[16];
+};
+
+/* Subroutine of crypt_sunmd5_rn and crypt_sunmd5_batch_rn: Parse
+   SETTING, storing the number of stretching rounds in *NROUNDSP and
+   the length of the part of SETTING that is hashed along with the
+   phrase in *SALTLENP.  Returns false and sets errno if SETTING is
+   invalid.  */
+static bool
+sunmd5_parse_setting (const char *setting, unsigned int *nroundsp,
+                      size_t *saltlenp)
 {
-  struct crypt_sunmd5_scratch
-  {
-    MD5_CTX ctx;
-    uint8_t dg[16];
-    char    rn[16];
-  };
-
   /* If 'setting' doesn't start with the prefix, we should not have
      been called in the first place.  */
   if (strncmp (setting, SUNMD5_PREFIX, SUNMD5_PREFIX_LEN)
@@ -172,7 +173,7 @@ crypt_sunmd5_rn (const char *phrase, size_t phr_size,
           && setting[SUNMD5_PREFIX_LEN] != ','))
     {
       errno = EINVAL;
-      return;
+      return false;
     }
 
   /* For bug-compatibility with the original implementation, we allow
@@ -187,7 +188,7 @@ crypt_sunmd5_rn (const char *phrase, size_t phr_size,
       if (!(*p >= '1' && *p <= '9'))
         {
           errno = EINVAL;
-          return;
+          return false;
         }
 
       errno = 0;
@@ -196,14 +197,14 @@ crypt_sunmd5_rn (const char *phrase, size_t phr_size,
       if (endp == p || arounds > SUNMD5_MAX_ROUNDS || errno)
         {
           errno = EINVAL;
-          return;
+          return false;
         }
       nrounds += (unsigned int)arounds;
       p = endp;
       if (*p != '$')
         {
           errno = EINVAL;
-          return;
+          return false;
         }
       p += 1;
     }
@@ -213,7 +214,7 @@ crypt_sunmd5_rn (const char *phrase, size_t phr_size,
   if (*p != '\0' && *p != '$')
     {
       errno = EINVAL;
-      return;
+      return false;
     }
   /* For bug-compatibility with the original implementation, if p
      points to a '$' and the following character is either another '$'
@@ -221,7 +222,46 @@ crypt_sunmd5_rn (const char *phrase, size_t phr_size,
   if (p[0] == '$' && (p[1] == '$' || p[1] == '\0'))
     p += 1;
 
-  size_t saltlen = (size_t) (p - setting);
+  *nroundsp = nrounds;
+  *saltlenp = (size_t) (p - setting);
+  return true;
+}
+
+/* Subroutine of crypt_sunmd5_rn and crypt_sunmd5_batch_rn: Write the
+   hash for the first SALTLEN characters of SETTING and the final
+   digest DG to OUTPUT.  */
+static void
+sunmd5_format (uint8_t *output, const char *setting, size_t saltlen,
+               const uint8_t dg[16])
+{
+  memcpy (output, setting, saltlen);
+  *(output + saltlen + 0) = '$';
+  /* This is the same permuted order used by BSD md5-crypt ($1$).  */
+  write_itoa64_4 (output + saltlen +  1, dg[12], dg[ 6], dg[0]);
+  write_itoa64_4 (output + saltlen +  5, dg[13], dg[ 7], dg[1]);
+  write_itoa64_4 (output + saltlen +  9, dg[14], dg[ 8], dg[2]);
+  write_itoa64_4 (output + saltlen + 13, dg[15], dg[ 9], dg[3]);
+  write_itoa64_4 (output + saltlen + 17, dg[ 5], dg[10], dg[4]);
+  write_itoa64_2 (output + saltlen + 21, dg[11], 0, 0);
+  *(output + saltlen + 23) = '\0';
+}
+
+/* Module entry points.  */
+
+const size_t footprint_sunmd5_rn = sizeof (struct crypt_sunmd5_scratch);
+
+void
+crypt_sunmd5_rn (const char *phrase, size_t phr_size,
+                 const char *setting, size_t ARG_UNUSED (set_size),
+                 uint8_t *output, size_t out_size,
+                 void *scratch, size_t scr_size)
+{
+  unsigned int nrounds;
+  size_t saltlen;
+
+  if (!sunmd5_parse_setting (setting, &nrounds, &saltlen))
+    return;
+
   /* Do we have enough space?  */
   if (scr_size < sizeof (struct crypt_sunmd5_scratch)
       || out_size < saltlen + SUNMD5_BARE_OUTPUT_LEN + 2)
@@ -256,16 +296,138 @@ crypt_sunmd5_rn (const char *phrase, size_t phr_size,
       MD5_Final (s->dg, &s->ctx);
     }
 
-  memcpy (output, setting, saltlen);
-  *(output + saltlen + 0) = '$';
-  /* This is the same permuted order used by BSD md5-crypt ($1$).  */
-  write_itoa64_4 (output + saltlen +  1, s->dg[12], s->dg[ 6], s->dg[0]);
-  write_itoa64_4 (output + saltlen +  5, s->dg[13], s->dg[ 7], s->dg[1]);
-  write_itoa64_4 (output + saltlen +  9, s->dg[14], s->dg[ 8], s->dg[2]);
-  write_itoa64_4 (output + saltlen + 13, s->dg[15], s->dg[ 9], s->dg[3]);
-  write_itoa64_4 (output + saltlen + 17, s->dg[ 5], s->dg[10], s->dg[4]);
-  write_itoa64_2 (output + saltlen + 21, s->dg[11], 0, 0);
-  *(output + saltlen + 23) = '\0';
+  sunmd5_format (output, setting, saltlen, s->dg);
+}
+
+/* Intermediate data for one lane of crypt_sunmd5_batch_rn.  */
+struct sunmd5_batch_lane
+{
+  struct crypt_batch_item *item;
+  unsigned int nrounds;
+  size_t saltlen;
+  uint8_t dg[16];
+};
+
+struct sunmd5_batch_buffer
+{
+  MD5_CTX ctx;
+  char rn[16];
+  MD5_MB_MSG msgs[MD5_MB_LANES];
+  struct sunmd5_batch_lane lanes[MD5_MB_LANES];
+};
+
+static_assert (sizeof (struct sunmd5_batch_buffer) <= ALG_BATCH_SPECIFIC_SIZE,
+               "ALG_BATCH_SPECIFIC_SIZE is too small for SunMD5");
+
+/* Subroutine of crypt_sunmd5_batch_rn: Run the stretching rounds for
+   the first NLANES lanes of BUF at once, then write out their hashes.
+   Every lane hashes the same round number in the same round, so it is
+   only formatted once; lanes with fewer rounds than the others drop
+   out early.  */
+static void
+sunmd5_batch_finish (struct sunmd5_batch_buffer *buf, size_t nlanes)
+{
+  uint8_t *digests[MD5_MB_LANES];
+  unsigned int max_rounds = 0;
+  size_t i, n;
+
+  for (i = 0; i < nlanes; i++)
+    max_rounds = MAX (max_rounds, buf->lanes[i].nrounds);
+
+  for (unsigned int r = 0; r < max_rounds; r++)
+    {
+      int nwritten = snprintf (buf->rn, sizeof buf->rn, "%u", r);
+      assert (nwritten >= 1 && (unsigned int)nwritten + 1 <= sizeof buf->rn);
+
+      for (i = 0, n = 0; i < nlanes; i++)
+        {
+          struct sunmd5_batch_lane *l = &buf->lanes[i];
+          MD5_MB_MSG *m = &buf->msgs[n];
+
+          if (r >= l->nrounds)
+            continue;
+
+          /* The same sequence as in crypt_sunmd5_rn.  */
+          m->data[0] = l->dg;
+          m->size[0] = sizeof l->dg;
+          m->data[1] = hamlet_quotation;
+          m->size[1] = muffet_coin_toss (l->dg, r) ? sizeof hamlet_quotation : 0;
+          m->data[2] = buf->rn;
+          m->size[2] = (size_t) nwritten;
+          m->data[3] = NULL;
+          m->size[3] = 0;
+          digests[n++] = l->dg;
+        }
+
+      MD5_MB_Hash (buf->msgs, digests, n);
+    }
+
+  for (i = 0; i < nlanes; i++)
+    {
+      struct sunmd5_batch_lane *l = &buf->lanes[i];
+      sunmd5_format (l->item->output, l->item->setting, l->saltlen, l->dg);
+    }
+}
+
+/* Compute several SunMD5 hashes at once.  Up to MD5_MB_Lanes() hashes
+   run in parallel, in the lanes of the vector registers.  */
+void
+crypt_sunmd5_batch_rn (struct crypt_batch_item *items, size_t nitems,
+                       void *scratch, size_t scr_size)
+{
+  size_t lanes = MD5_MB_Lanes ();
+  size_t i, nlanes;
+
+  /* Without vector support, the batch would only be slower than
+     hashing each item by itself.  */
+  if (lanes == 1)
+    {
+      for (i = 0; i < nitems; i++)
+        crypt_sunmd5_rn (items[i].phrase, items[i].phr_size,
+                         items[i].setting, items[i].set_size,
+                         items[i].output, items[i].out_size,
+                         scratch, scr_size);
+      return;
+    }
+
+  /* This shouldn't ever happen, but...  */
+  if (scr_size < sizeof (struct sunmd5_batch_buffer))
+    {
+      errno = ERANGE;
+      return;
+    }
+
+  struct sunmd5_batch_buffer *buf = scratch;
+
+  for (i = 0, nlanes = 0; i < nitems; i++)
+    {
+      struct crypt_batch_item *item = &items[i];
+      struct sunmd5_batch_lane *l = &buf->lanes[nlanes];
+
+      if (!sunmd5_parse_setting (item->setting, &l->nrounds, &l->saltlen))
+        continue;
+      if (item->out_size < l->saltlen + SUNMD5_BARE_OUTPUT_LEN + 2)
+        {
+          errno = ERANGE;
+          continue;
+        }
+
+      /* Initial round.  */
+      l->item = item;
+      MD5_Init (&buf->ctx);
+      MD5_Update (&buf->ctx, item->phrase, item->phr_size);
+      MD5_Update (&buf->ctx, item->setting, l->saltlen);
+      MD5_Final (l->dg, &buf->ctx);
+
+      if (++nlanes == lanes)
+        {
+          sunmd5_batch_finish (buf, nlanes);
+          nlanes = 0;
+        }
+    }
+
+  if (nlanes > 0)
+    sunmd5_batch_finish (buf, nlanes);
 }
 
 void
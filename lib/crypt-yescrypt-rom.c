@@ -0,0 +1,360 @@
+/* Loading yescrypt ROMs from files, for use by crypt.
+
+   A ROM is a large read-only table that yescrypt hashes can be made to
+   depend on, built once from a seed with yescrypt_init_shared.  Hashes
+   whose setting names a ROM (NROM) can only be computed by a process
+   that has it, which makes offline attacks on stolen hashes expensive.
+   The file holds the ROM exactly as yescrypt_init_shared left it in
+   memory, including the tag in its last 48 bytes, so it is specific to
+   the byte order of the machine that built it.  Every process that
+   loads the same file maps the same page cache pages.
+
+   To the extent possible under law, the author(s) have waived all
+   copyright and related or neighboring rights to this work.
+
+   See https://creativecommons.org/publicdomain/zero/1.0/ for further
+   details.  */
+
+#include "crypt-port.h"
+#include "alg-yescrypt.h"
+
+#include <errno.h>
+
+#if INCLUDE_yescrypt || INCLUDE_scrypt || INCLUDE_gost_yescrypt || \
+    INCLUDE_sm3_yescrypt
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#ifdef __unix__
+#include <sys/mman.h>
+#endif
+#endif
+
+/* If we have O_CLOEXEC, we use it, but if we don't, we don't worry
+   about it.  */
+#ifndef O_CLOEXEC
+#define O_CLOEXEC 0
+#endif
+
+#if (INCLUDE_yescrypt || INCLUDE_scrypt || INCLUDE_gost_yescrypt || \
+     INCLUDE_sm3_yescrypt) && defined MAP_SHARED
+#define HAVE_YESCRYPT_ROM 1
+
+/* Sizes of ROM accepted by crypt_yescrypt_rom_build, as powers of 2.
+   The largest is bounded by what a 32-bit process could map.  */
+#define ROM_LOG2_MIN 20
+#if SIZE_MAX > UINT32_MAX
+#define ROM_LOG2_MAX 40
+#else
+#define ROM_LOG2_MAX 30
+#endif
+
+/* A ROM mapped by crypt_yescrypt_rom_load.  REFS counts one reference
+   for being the current ROM and one for each hash being computed with
+   it; whoever drops it to zero unmaps the ROM, so neither unloading
+   nor replacing a ROM has to wait for the hashes still using it.  A
+   reference is only ever added to a nonzero count, so the ROM is
+   unmapped exactly once.  The structures are not freed but kept on a
+   free list for the next load, so that a hash that raced with the
+   unload can still safely find out that it has to look again.  */
+struct loaded_rom
+{
+  yescrypt_shared_t shared;
+  unsigned long refs;
+  struct loaded_rom *next_free;
+};
+
+static struct loaded_rom *current_rom;
+
+/* Unmapped ROMs' structures, and a spinlock for the list; it is only
+   held for a couple of pointer moves.  */
+static struct loaded_rom *free_roms;
+static bool free_roms_lock;
+
+static void
+lock_free_roms (void)
+{
+  while (__atomic_test_and_set (&free_roms_lock, __ATOMIC_ACQUIRE))
+    ;
+}
+
+static void
+unlock_free_roms (void)
+{
+  __atomic_clear (&free_roms_lock, __ATOMIC_RELEASE);
+}
+
+/* Drop a reference to ROM, and unmap it if that was the last one.  */
+static void
+put_rom (struct loaded_rom *rom)
+{
+  if (__atomic_sub_fetch (&rom->refs, 1, __ATOMIC_ACQ_REL))
+    return;
+
+  /* Nobody is left to tell if this fails, and the caller may be in
+     the middle of a hash, so keep its errno.  */
+  int saved_errno = errno;
+  munmap (rom->shared.base, rom->shared.base_size);
+  errno = saved_errno;
+
+  lock_free_roms ();
+  rom->next_free = free_roms;
+  free_roms = rom;
+  unlock_free_roms ();
+}
+
+/* Get the ROM loaded into this process, if any.  It stays mapped until
+   the matching release_yescrypt_rom call.  */
+yescrypt_shared_t *
+acquire_yescrypt_rom (void)
+{
+  for (;;)
+    {
+      struct loaded_rom *rom = __atomic_load_n (&current_rom,
+                                                __ATOMIC_SEQ_CST);
+      if (!rom)
+        return NULL;
+
+      unsigned long refs = __atomic_load_n (&rom->refs, __ATOMIC_RELAXED);
+      while (refs != 0
+             && !__atomic_compare_exchange_n (&rom->refs, &refs, refs + 1,
+                                              true, __ATOMIC_SEQ_CST,
+                                              __ATOMIC_RELAXED))
+        ;
+      /* Already unmapped; current_rom has moved on.  */
+      if (refs == 0)
+        continue;
+
+      /* If it is still current after we counted ourselves, it stays
+         mapped until we let go of it.  */
+      if (rom == __atomic_load_n (&current_rom, __ATOMIC_SEQ_CST))
+        return &rom->shared;
+      put_rom (rom);
+    }
+}
+
+/* Finish with a ROM obtained from acquire_yescrypt_rom.  */
+void
+release_yescrypt_rom (yescrypt_shared_t *shared)
+{
+  if (shared)
+    put_rom ((struct loaded_rom *) shared);
+}
+
+/* Make ROM the current one, or none if it is NULL.  The one it
+   replaces is unmapped by whoever finishes with it last.  */
+static void
+replace_rom (struct loaded_rom *rom)
+{
+  struct loaded_rom *old = __atomic_exchange_n (&current_rom, rom,
+                                                __ATOMIC_SEQ_CST);
+  if (old)
+    put_rom (old);
+}
+
+#elif INCLUDE_yescrypt || INCLUDE_scrypt || INCLUDE_gost_yescrypt || \
+      INCLUDE_sm3_yescrypt
+
+/* Without mmap, no ROM can ever be loaded.  */
+yescrypt_shared_t *
+acquire_yescrypt_rom (void)
+{
+  return NULL;
+}
+
+void
+release_yescrypt_rom (yescrypt_shared_t *shared)
+{
+  (void) shared;
+}
+
+#endif
+
+#if INCLUDE_crypt_yescrypt_rom_build
+int
+crypt_yescrypt_rom_build (const char *path, const char *seed, int seed_size,
+                          unsigned int size_log2)
+{
+#ifdef HAVE_YESCRYPT_ROM
+  if (!path || seed_size < 0 || (!seed && seed_size > 0) ||
+      size_log2 < ROM_LOG2_MIN || size_log2 > ROM_LOG2_MAX)
+    {
+      errno = EINVAL;
+      return -1;
+    }
+
+  /* With 4 KiB blocks, the same as the largest hashes crypt_gensalt
+     asks for.  */
+  yescrypt_params_t params =
+  {
+    .flags = YESCRYPT_DEFAULTS,
+    .r = 32,
+    .p = 1,
+    .NROM = (uint64_t) 1 << (size_log2 - 12),
+  };
+  yescrypt_shared_t shared;
+
+  if (yescrypt_init_shared (&shared, (const uint8_t *) seed,
+                            (size_t) seed_size, &params))
+    {
+      if (!errno)
+        errno = ENOMEM;
+      return -1;
+    }
+
+  int retval = -1;
+  int fd = open (path, O_WRONLY|O_CREAT|O_EXCL|O_CLOEXEC, 0644);
+  if (fd != -1)
+    {
+      const uint8_t *p = shared.aligned;
+      size_t left = shared.aligned_size;
+      while (left > 0)
+        {
+          ssize_t n = write (fd, p, left);
+          if (n < 0)
+            {
+              if (errno == EINTR)
+                continue;
+              break;
+            }
+          p += n;
+          left -= (size_t) n;
+        }
+      if (left == 0 && fsync (fd) == 0)
+        retval = 0;
+      if (close (fd) && retval == 0)
+        retval = -1;
+      if (retval)
+        {
+          int saved_errno = errno;
+          unlink (path);
+          errno = saved_errno;
+        }
+    }
+
+  int saved_errno = errno;
+  yescrypt_free_shared (&shared);
+  errno = saved_errno;
+  return retval;
+#else
+  (void) path;
+  (void) seed;
+  (void) seed_size;
+  (void) size_log2;
+  errno = ENOSYS;
+  return -1;
+#endif
+}
+SYMVER_crypt_yescrypt_rom_build;
+#endif
+
+#if INCLUDE_crypt_yescrypt_rom_load
+int
+crypt_yescrypt_rom_load (const char *path)
+{
+#ifdef HAVE_YESCRYPT_ROM
+  if (!path)
+    {
+      errno = EINVAL;
+      return -1;
+    }
+
+  int fd = open (path, O_RDONLY|O_CLOEXEC);
+  if (fd == -1)
+    return -1;
+
+  struct stat st;
+  if (fstat (fd, &st))
+    {
+      int saved_errno = errno;
+      close (fd);
+      errno = saved_errno;
+      return -1;
+    }
+
+  /* crypt_gensalt derives NROM, which must be a power of 2, from the
+     size of the ROM.  */
+  uint64_t size = (uint64_t) st.st_size;
+  if (st.st_size <= 0 || (size & (size - 1)) != 0 ||
+      size < (uint64_t) 1 << ROM_LOG2_MIN ||
+      size > (uint64_t) 1 << ROM_LOG2_MAX)
+    {
+      close (fd);
+      errno = EINVAL;
+      return -1;
+    }
+
+  void *base = mmap (NULL, (size_t) size, PROT_READ, MAP_SHARED, fd, 0);
+  int saved_errno = errno;
+  close (fd);
+  if (base == MAP_FAILED)
+    {
+      errno = saved_errno;
+      return -1;
+    }
+
+  const uint64_t *tag = (const uint64_t *)
+    ((const uint8_t *) base + size - 48);
+  if (tag[0] != YESCRYPT_ROM_TAG1 || tag[1] != YESCRYPT_ROM_TAG2)
+    {
+      munmap (base, (size_t) size);
+      errno = EINVAL;
+      return -1;
+    }
+
+  lock_free_roms ();
+  struct loaded_rom *rom = free_roms;
+  if (rom)
+    free_roms = rom->next_free;
+  unlock_free_roms ();
+  if (!rom)
+    rom = malloc (sizeof *rom);
+  if (!rom)
+    {
+      munmap (base, (size_t) size);
+      errno = ENOMEM;
+      return -1;
+    }
+  rom->shared.base = rom->shared.aligned = base;
+  rom->shared.base_size = rom->shared.aligned_size = (size_t) size;
+  rom->next_free = NULL;
+
+  /* Every hash reads from all over the ROM; fault it in now rather
+     than one page at a time.  Failure only costs speed.  */
+  saved_errno = errno;
+#ifdef MADV_WILLNEED
+  madvise (base, (size_t) size, MADV_WILLNEED);
+#endif
+#if YESCRYPT_THP && defined MADV_HUGEPAGE
+  madvise (base, (size_t) size, MADV_HUGEPAGE);
+#endif
+  errno = saved_errno;
+
+  /* Only now can hashes find it and take references.  */
+  __atomic_store_n (&rom->refs, 1, __ATOMIC_RELEASE);
+  replace_rom (rom);
+  return 0;
+#else
+  (void) path;
+  errno = ENOSYS;
+  return -1;
+#endif
+}
+SYMVER_crypt_yescrypt_rom_load;
+#endif
+
+#if INCLUDE_crypt_yescrypt_rom_unload
+int
+crypt_yescrypt_rom_unload (void)
+{
+#ifdef HAVE_YESCRYPT_ROM
+  replace_rom (NULL);
+  return 0;
+#else
+  errno = ENOSYS;
+  return -1;
+#endif
+}
+SYMVER_crypt_yescrypt_rom_unload;
+#endif
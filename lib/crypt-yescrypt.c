@@ -21,6 +21,128 @@
 
 #include <errno.h>
 
+#if ENABLE_YESCRYPT_CACHE
+#include <pthread.h>
+#include <stdlib.h>
+#ifdef __unix__
+#include <sys/mman.h>
+#endif
+#endif
+
+#if INCLUDE_yescrypt || INCLUDE_scrypt || INCLUDE_gost_yescrypt || \
+    INCLUDE_sm3_yescrypt
+
+#if ENABLE_YESCRYPT_CACHE
+
+/* Each thread that computes a yescrypt-family hash keeps the
+   yescrypt_local_t it used, so the next hash of the same size or
+   smaller can reuse the mapping instead of faulting in a fresh one.
+   The key's destructor releases it when the thread exits.  */
+static pthread_key_t local_cache_key;
+static pthread_once_t local_cache_once = PTHREAD_ONCE_INIT;
+static bool local_cache_ok;
+
+static void
+local_cache_destroy (void *arg)
+{
+  yescrypt_local_t *local = arg;
+  yescrypt_free_local (local);
+  free (local);
+}
+
+static void
+local_cache_init (void)
+{
+  local_cache_ok = !pthread_key_create (&local_cache_key,
+                                        local_cache_destroy);
+}
+
+static yescrypt_local_t *
+local_cache_get (void)
+{
+  yescrypt_local_t *local;
+
+  if (pthread_once (&local_cache_once, local_cache_init) || !local_cache_ok)
+    return NULL;
+  local = pthread_getspecific (local_cache_key);
+  if (local)
+    return local;
+
+  local = malloc (sizeof *local);
+  if (!local)
+    return NULL;
+  if (yescrypt_init_local (local) ||
+      pthread_setspecific (local_cache_key, local))
+    {
+      free (local);
+      return NULL;
+    }
+  return local;
+}
+
+#endif /* ENABLE_YESCRYPT_CACHE */
+
+/* Get a yescrypt_local_t for computing one hash.  FALLBACK is storage
+   in the caller's scratch area; it is used when there is no cached
+   yescrypt_local_t for this thread.  Returns NULL on failure.  */
+yescrypt_local_t *
+acquire_yescrypt_local (yescrypt_local_t *fallback)
+{
+#if ENABLE_YESCRYPT_CACHE
+  /* Failure to set up the cache is not fatal.  */
+  int saved_errno = errno;
+  yescrypt_local_t *local = local_cache_get ();
+  errno = saved_errno;
+  /* While the memory of all hashes is limited, memory kept by idle
+     threads would count against the limit, so none is kept.  */
+  if (local && !yescrypt_memory_limited ())
+    return local;
+  if (local && yescrypt_free_local (local))
+    return NULL;
+#endif
+  if (yescrypt_init_local (fallback))
+    return NULL;
+  return fallback;
+}
+
+/* Finish with a yescrypt_local_t obtained from acquire_yescrypt_local.
+   The memory it holds is either unmapped, or erased and kept for the
+   next hash computed by this thread.  Returns 0 on success, or -1 on
+   error, like yescrypt_free_local.  */
+int
+release_yescrypt_local (yescrypt_local_t *local)
+{
+#if ENABLE_YESCRYPT_CACHE
+  if (local_cache_ok && local == pthread_getspecific (local_cache_key))
+    {
+      /* Memory from the huge page pool is shared with other threads,
+         so it goes straight back.  So does everything while the
+         memory of all hashes is limited.  */
+      if (local->aligned_size > YESCRYPT_CACHE_MAX ||
+          yescrypt_region_pooled (local) || yescrypt_memory_limited ())
+        return yescrypt_free_local (local);
+
+      explicit_bzero (local->aligned, local->aligned_size);
+#if defined MAP_ANON && defined MADV_FREE
+      /* Let the kernel reclaim the pages under memory pressure.  They
+         have just been erased, so whatever it hands back is just as
+         good.  Failure only means they stay resident.  */
+      if (local->base)
+        {
+          int saved_errno = errno;
+          madvise (local->base, local->base_size, MADV_FREE);
+          errno = saved_errno;
+        }
+#endif
+      return 0;
+    }
+#endif
+  return yescrypt_free_local (local);
+}
+
+#endif /* INCLUDE_yescrypt || INCLUDE_scrypt || INCLUDE_gost_yescrypt ||
+          INCLUDE_sm3_yescrypt */
+
 #if INCLUDE_yescrypt || INCLUDE_scrypt
 
 /* For use in scratch space by crypt_yescrypt_rn().  */
@@ -34,6 +156,14 @@ typedef struct
 static_assert (sizeof (crypt_yescrypt_internal_t) <= ALG_SPECIFIC_SIZE,
                "ALG_SPECIFIC_SIZE is too small for YESCRYPT.");
 
+#if INCLUDE_yescrypt
+const size_t footprint_yescrypt_rn = sizeof (crypt_yescrypt_internal_t);
+#endif
+#if INCLUDE_scrypt
+/* crypt_scrypt_rn hands its scratch area on to crypt_yescrypt_rn.  */
+const size_t footprint_scrypt_rn = sizeof (crypt_yescrypt_internal_t);
+#endif
+
 void
 crypt_yescrypt_rn (const char *phrase, size_t phr_size,
                    const char *setting, size_t set_size,
@@ -71,19 +201,31 @@ crypt_yescrypt_rn (const char *phrase, size_t phr_size,
     }
 
   crypt_yescrypt_internal_t *intbuf = scratch;
+  yescrypt_local_t *local = acquire_yescrypt_local (&intbuf->local);
 
-  if (yescrypt_init_local (&intbuf->local))
+  if (!local)
     return;
 
-  intbuf->retval = yescrypt_r (NULL, &intbuf->local,
+  /* Report running out of budget under crypt_yescrypt_memory_limit
+     as such; every other failure is reported as EINVAL.  */
+  int saved_errno = errno;
+  errno = 0;
+  yescrypt_shared_t *rom = acquire_yescrypt_rom ();
+  intbuf->retval = yescrypt_r (rom, local,
                                (const uint8_t *)phrase, phr_size,
                                (const uint8_t *)setting, NULL,
                                intbuf->outbuf, o_size);
+  release_yescrypt_rom (rom);
 
   if (!intbuf->retval)
-    errno = EINVAL;
+    {
+      if (errno != EAGAIN)
+        errno = EINVAL;
+    }
+  else
+    errno = saved_errno;
 
-  if (yescrypt_free_local (&intbuf->local) || !intbuf->retval)
+  if (release_yescrypt_local (local) || !intbuf->retval)
     return;
 
   strcpy_or_abort (output, o_size, intbuf->outbuf);
@@ -164,6 +306,16 @@ gensalt_yescrypt_rn (unsigned long count,
       params.N = 1ULL << (count + 7); // 3 -> 1024, 4 -> 2048, ... 11 -> 262144
     }
 
+  /* New hashes use all of the ROM loaded into this process, if any.
+     The ROM must then stay the same size for as long as they are in
+     use, since the setting records how many blocks it has.  */
+  yescrypt_shared_t *rom = acquire_yescrypt_rom ();
+  if (rom)
+    {
+      params.NROM = rom->aligned_size / ((uint64_t) 128 * params.r);
+      release_yescrypt_rom (rom);
+    }
+
   if (!yescrypt_encode_params_r (&params, rbytes, nrbytes, outbuf, o_size))
     {
       errno = ERANGE;
@@ -175,3 +327,43 @@ gensalt_yescrypt_rn (unsigned long count,
 }
 
 #endif /* INCLUDE_gost_yescrypt || INCLUDE_yescrypt || INCLUDE_sm3_yescrypt */
+
+#if INCLUDE_crypt_yescrypt_memory_limit
+int
+crypt_yescrypt_memory_limit (unsigned long max_bytes, int policy)
+{
+#if INCLUDE_yescrypt || INCLUDE_scrypt || INCLUDE_gost_yescrypt || \
+    INCLUDE_sm3_yescrypt
+  return yescrypt_set_memory_limit (max_bytes, policy);
+#else
+  (void) max_bytes;
+  (void) policy;
+  errno = ENOSYS;
+  return -1;
+#endif
+}
+SYMVER_crypt_yescrypt_memory_limit;
+#endif
+
+#if INCLUDE_crypt_yescrypt_memory_usage
+int
+crypt_yescrypt_memory_usage (unsigned long *current, unsigned long *peak)
+{
+#if INCLUDE_yescrypt || INCLUDE_scrypt || INCLUDE_gost_yescrypt || \
+    INCLUDE_sm3_yescrypt
+  size_t c, p;
+  yescrypt_get_memory_usage (&c, &p);
+  if (current)
+    *current = (unsigned long) c;
+  if (peak)
+    *peak = (unsigned long) p;
+  return 0;
+#else
+  (void) current;
+  (void) peak;
+  errno = ENOSYS;
+  return -1;
+#endif
+}
+SYMVER_crypt_yescrypt_memory_usage;
+#endif
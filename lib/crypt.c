@@ -22,6 +22,12 @@
 #include <errno.h>
 #include <stdlib.h>
 
+#if INCLUDE_crypt_verify_and_upgrade \
+  && (INCLUDE_yescrypt || INCLUDE_scrypt || INCLUDE_gost_yescrypt \
+      || INCLUDE_sm3_yescrypt)
+#include "alg-yescrypt.h"
+#endif
+
 /* The internal storage area within struct crypt_data is used as
    follows.  We don't know what alignment the algorithm modules will
    need for their scratch data, so give it the maximum natural
@@ -68,6 +74,9 @@ struct hashfn
   size_t plen;
   crypt_fn crypt;
   gensalt_fn gensalt;
+  /* How many bytes at the beginning of the scratch area CRYPT may
+     write to; only these need to be erased afterward.  */
+  const size_t *footprint;
   /* The type of this field is unsigned char to ensure that it cannot
      be set larger than the size of an internal buffer in crypt_gensalt_rn.  */
   unsigned char nrbytes;
@@ -93,24 +102,18 @@ is_des_salt_char (char c)
 static const struct hashfn *
 get_hashfn (const char *setting)
 {
-  const struct hashfn *h;
-  for (h = hash_algorithms; h->prefix; h++)
-    {
-      if (h->plen > 0)
-        {
-          if (!strncmp (setting, h->prefix, h->plen))
-            return h;
-        }
+  int i = hash_algorithm_index (setting);
+  if (i < 0)
+    return 0;
+
+  const struct hashfn *h = &hash_algorithms[i];
 #if INCLUDE_descrypt || INCLUDE_bigcrypt
-      else
-        {
-          if (setting[0] == '\0' ||
-              (is_des_salt_char (setting[0]) && is_des_salt_char (setting[1])))
-            return h;
-        }
+  if (h->plen == 0
+      && !(setting[0] == '\0' ||
+           (is_des_salt_char (setting[0]) && is_des_salt_char (setting[1]))))
+    return 0;
 #endif
-    }
-  return 0;
+  return h;
 }
 
 /* Check a setting string for generic validity, according to the rule
@@ -146,17 +149,20 @@ check_badsalt_chars (const char *setting)
   return strcspn (setting, "!*:;\\") != i;
 }
 
-static void
-do_crypt (const char *phrase, const char *setting, struct crypt_data *data)
+/* Hash PHRASE according to SETTING, leaving the result (or a failure
+   token) in CINT->output.  Returns the number of bytes at the
+   beginning of CINT->alg_specific that may have been written to.  */
+static size_t
+do_crypt_internal (const char *phrase, const char *setting,
+                   struct crypt_internal *cint)
 {
-  struct crypt_internal *cint = get_internal (data);
   memset (cint->output, 0, sizeof cint->output);
   make_failure_token (setting, cint->output, sizeof cint->output);
 
   if (!phrase || !setting)
     {
       errno = EINVAL;
-      goto out;
+      return 0;
     }
   /* Do these strlen() calls before reading prefixes of either
      'phrase' or 'setting', so we get a predictable crash if they are
@@ -166,12 +172,12 @@ do_crypt (const char *phrase, const char *setting, struct crypt_data *data)
   if (phr_size >= CRYPT_MAX_PASSPHRASE_SIZE)
     {
       errno = ERANGE;
-      goto out;
+      return 0;
     }
   if (check_badsalt_chars (setting))
     {
       errno = EINVAL;
-      goto out;
+      return 0;
     }
 
   const struct hashfn *h = get_hashfn (setting);
@@ -179,17 +185,26 @@ do_crypt (const char *phrase, const char *setting, struct crypt_data *data)
     {
       /* Unrecognized hash algorithm */
       errno = EINVAL;
-      goto out;
+      return 0;
     }
 
   h->crypt (phrase, phr_size, setting, set_size,
             (unsigned char *) cint->output, sizeof cint->output,
             cint->alg_specific, sizeof cint->alg_specific);
+  return *h->footprint;
+}
 
-out:
+static void
+do_crypt (const char *phrase, const char *setting, struct crypt_data *data)
+{
+  struct crypt_internal *cint = get_internal (data);
+  size_t used = do_crypt_internal (phrase, setting, cint);
   strcpy_or_abort (data->output, sizeof data->output, cint->output);
-  explicit_bzero (data->internal, sizeof data->internal);
-  explicit_bzero (data->reserved, sizeof data->reserved);
+  /* Nothing else in DATA is written to, so erasing what the hashing
+     method may have used is enough; erasing all of data->internal
+     would cost more than hashing with the faster methods.  */
+  explicit_bzero (cint->alg_specific, used);
+  explicit_bzero (cint->output, sizeof cint->output);
   data->initialized = 0;
 }
 
@@ -211,6 +226,280 @@ crypt_rn (const char *phrase, const char *setting, void *data, int size)
 SYMVER_crypt_rn;
 #endif
 
+#if INCLUDE_crypt_verify || INCLUDE_crypt_verify_and_upgrade
+/* Compare the NUL-terminated strings A and B, taking time that depends
+   only on their lengths and not on where they differ.  */
+static bool
+hash_strings_equal (const char *a, const char *b)
+{
+  size_t alen = strlen (a), blen = strlen (b), i;
+  unsigned char diff = alen != blen;
+
+  for (i = 0; i < MIN (alen, blen); i++)
+    diff |= (unsigned char) (a[i] ^ b[i]);
+  return diff == 0;
+}
+#endif
+
+#if INCLUDE_crypt_verify
+int
+crypt_verify (const char *phrase, const char *hash)
+{
+  /* Only the scratch area and the output buffer are needed, so there
+     is no point making the caller supply a whole struct crypt_data.  */
+  struct crypt_internal cint;
+  int result;
+
+  size_t used = do_crypt_internal (phrase, hash, &cint);
+  if (cint.output[0] == '*')
+    result = -1;
+  else
+    result = hash_strings_equal (cint.output, hash);
+
+  explicit_bzero (cint.alg_specific, used);
+  explicit_bzero (cint.output, sizeof cint.output);
+  return result;
+}
+SYMVER_crypt_verify;
+#endif
+
+#if INCLUDE_crypt_batch_rn
+typedef void (*batch_fn) (struct crypt_batch_item *items, size_t nitems,
+                          void *scratch, size_t scr_size);
+
+/* Hashing methods that have a batch entry point, identified by their
+   ordinary crypt_fn.  Methods not listed here are still accepted by
+   crypt_batch_rn, which hashes their items one at a time.  */
+static const struct
+{
+  crypt_fn crypt;
+  batch_fn batch;
+} batch_algorithms[] =
+{
+#if INCLUDE_descrypt
+  { crypt_descrypt_rn, crypt_descrypt_batch_rn },
+#endif
+#if INCLUDE_bigcrypt
+  { crypt_bigcrypt_rn, crypt_bigcrypt_batch_rn },
+#endif
+#if INCLUDE_bsdicrypt
+  { crypt_bsdicrypt_rn, crypt_bsdicrypt_batch_rn },
+#endif
+#if INCLUDE_bcrypt
+  { crypt_bcrypt_rn, crypt_bcrypt_batch_rn },
+#endif
+#if INCLUDE_bcrypt_a
+  { crypt_bcrypt_a_rn, crypt_bcrypt_a_batch_rn },
+#endif
+#if INCLUDE_bcrypt_x
+  { crypt_bcrypt_x_rn, crypt_bcrypt_x_batch_rn },
+#endif
+#if INCLUDE_bcrypt_y
+  { crypt_bcrypt_y_rn, crypt_bcrypt_y_batch_rn },
+#endif
+#if INCLUDE_md5crypt
+  { crypt_md5crypt_rn, crypt_md5crypt_batch_rn },
+#endif
+#if INCLUDE_sunmd5
+  { crypt_sunmd5_rn, crypt_sunmd5_batch_rn },
+#endif
+#if INCLUDE_sha512crypt
+  { crypt_sha512crypt_rn, crypt_sha512crypt_batch_rn },
+#endif
+#if INCLUDE_sm3crypt
+  { crypt_sm3crypt_rn, crypt_sm3crypt_batch_rn },
+#endif
+  { 0, 0 }
+};
+
+/* Items with batch entry points are collected this many at a time.  */
+#define BATCH_PENDING_MAX 256
+
+/* Layout of crypt_data.internal for crypt_batch_rn.  */
+struct crypt_batch_internal
+{
+  char alignas (alignof (max_align_t)) alg_specific[ALG_BATCH_SPECIFIC_SIZE];
+  struct crypt_batch_item pending[BATCH_PENDING_MAX];
+  /* The index in batch_algorithms of each pending item's method.  */
+  unsigned char pending_alg[BATCH_PENDING_MAX];
+};
+
+static_assert(ARRAY_SIZE (batch_algorithms) - 1 <= UCHAR_MAX + 1,
+              "too many batch algorithms for pending_alg");
+
+static_assert(sizeof (struct crypt_batch_internal)
+              + alignof (struct crypt_batch_internal)
+              <= CRYPT_DATA_INTERNAL_SIZE,
+              "crypt_data.internal is too small for crypt_batch_internal");
+
+static inline struct crypt_batch_internal *
+get_batch_internal (struct crypt_data *data)
+{
+  uintptr_t internalp = (uintptr_t) data->internal;
+  const uintptr_t align = alignof (struct crypt_batch_internal);
+  internalp = (internalp + align - 1) & ~(align - 1);
+  return (struct crypt_batch_internal *)internalp;
+}
+
+/* Return the index in batch_algorithms of the method H, or -1 if it
+   has no batch entry point.  */
+static int
+get_batch_alg (const struct hashfn *h)
+{
+  int i;
+  for (i = 0; batch_algorithms[i].crypt; i++)
+    if (batch_algorithms[i].crypt == h->crypt)
+      return i;
+  return -1;
+}
+
+/* Subroutine of crypt_batch_rn: apply the same checks as do_crypt to
+   ITEM, and look up its hashing method.  Returns 0 and sets errno if
+   ITEM cannot be hashed.  */
+static const struct hashfn *
+check_batch_item (const struct crypt_batch *item,
+                  size_t *phr_sizep, size_t *set_sizep)
+{
+  if (!item->phrase || !item->setting)
+    {
+      errno = EINVAL;
+      return 0;
+    }
+  *phr_sizep = strlen (item->phrase);
+  *set_sizep = strlen (item->setting);
+  if (*phr_sizep >= CRYPT_MAX_PASSPHRASE_SIZE)
+    {
+      errno = ERANGE;
+      return 0;
+    }
+  if (check_badsalt_chars (item->setting))
+    {
+      errno = EINVAL;
+      return 0;
+    }
+
+  const struct hashfn *h = get_hashfn (item->setting);
+  if (!h)
+    errno = EINVAL;
+  return h;
+}
+
+/* Sort pending items by setting string, so that items with the same
+   cost parameters end up next to each other.  (All of the methods
+   with batch entry points put the cost parameters before the salt.)  */
+static int
+compare_batch_items (const void *a, const void *b)
+{
+  const struct crypt_batch_item *ia = a;
+  const struct crypt_batch_item *ib = b;
+  return strcmp (ia->setting, ib->setting);
+}
+
+/* Hash the first NPENDING pending items, handing each method's items
+   to its batch entry point all at once.  */
+static void
+flush_batch (struct crypt_batch_internal *cint, size_t npending)
+{
+  struct crypt_batch_item *pending = cint->pending;
+  unsigned char *pending_alg = cint->pending_alg;
+  size_t start, end, k;
+
+  for (start = 0; start < npending; start = end)
+    {
+      unsigned char alg = pending_alg[start];
+
+      /* Move the other items for the same method up behind this one.  */
+      for (end = start + 1, k = end; k < npending; k++)
+        if (pending_alg[k] == alg)
+          {
+            struct crypt_batch_item tmp = pending[k];
+            pending[k] = pending[end];
+            pending[end] = tmp;
+            pending_alg[k] = pending_alg[end];
+            pending_alg[end] = alg;
+            end++;
+          }
+
+      qsort (&pending[start], end - start, sizeof pending[0],
+             compare_batch_items);
+      batch_algorithms[alg].batch (&pending[start], end - start,
+                                   cint->alg_specific,
+                                   sizeof cint->alg_specific);
+    }
+}
+
+int
+crypt_batch_rn (struct crypt_batch *items, int nitems, void *data, int size)
+{
+  if (size < (int) sizeof (struct crypt_data))
+    {
+      errno = ERANGE;
+      return -1;
+    }
+  if (nitems < 0 || (nitems > 0 && !items))
+    {
+      errno = EINVAL;
+      return -1;
+    }
+
+  struct crypt_data *p = data;
+  struct crypt_batch_internal *cint = get_batch_internal (p);
+  const struct hashfn *h;
+  size_t phr_size, set_size, i, npending = 0;
+  int alg, nok = 0;
+
+  /* Check each item and look up its method once.  Items whose method
+     has no batch entry point are hashed right away; the others are
+     collected, and hashed by method whenever the pending list fills
+     up.  */
+  for (i = 0; i < (size_t) nitems; i++)
+    {
+      struct crypt_batch *item = &items[i];
+      memset (item->output, 0, sizeof item->output);
+      make_failure_token (item->setting, item->output, sizeof item->output);
+
+      h = check_batch_item (item, &phr_size, &set_size);
+      if (!h)
+        continue;
+      alg = get_batch_alg (h);
+      if (alg < 0)
+        {
+          h->crypt (item->phrase, phr_size, item->setting, set_size,
+                    (unsigned char *) item->output, sizeof item->output,
+                    cint->alg_specific, sizeof cint->alg_specific);
+          continue;
+        }
+
+      struct crypt_batch_item *pi = &cint->pending[npending];
+      pi->phrase = item->phrase;
+      pi->phr_size = phr_size;
+      pi->setting = item->setting;
+      pi->set_size = set_size;
+      pi->output = (unsigned char *) item->output;
+      pi->out_size = sizeof item->output;
+      cint->pending_alg[npending] = (unsigned char) alg;
+
+      if (++npending == BATCH_PENDING_MAX)
+        {
+          flush_batch (cint, npending);
+          npending = 0;
+        }
+    }
+  if (npending > 0)
+    flush_batch (cint, npending);
+
+  for (i = 0; i < (size_t) nitems; i++)
+    if (items[i].output[0] != '*')
+      nok++;
+
+  explicit_bzero (p->internal, sizeof p->internal);
+  explicit_bzero (p->reserved, sizeof p->reserved);
+  p->initialized = 0;
+  return nok;
+}
+SYMVER_crypt_batch_rn;
+#endif
+
 #if INCLUDE_crypt_ra
 char *
 crypt_ra (const char *phrase, const char *setting, void **data, int *size)
@@ -321,8 +610,13 @@ crypt_gensalt_rn (const char *prefix, unsigned long count,
      possible.  */
   if (!rbytes)
     {
+#if ENABLE_RANDOM_POOL
+      if (!get_random_bytes_pooled (internal_rbytes, h->nrbytes))
+        goto out;
+#else
       if (!get_random_bytes (internal_rbytes, h->nrbytes))
         goto out;
+#endif
 
       rbytes = internal_rbytes;
       nrbytes = internal_nrbytes = h->nrbytes;
@@ -419,3 +713,232 @@ crypt_preferred_method (void)
 }
 SYMVER_crypt_preferred_method;
 #endif
+
+#if INCLUDE_crypt_verify_and_upgrade
+/* The most cost parameters any method has: yescrypt's N, r, p, t
+   and g.  */
+#define HASH_COST_MAX 5
+
+/* The parameters of a hash or setting.  */
+struct hash_cost
+{
+  /* Parameters that select a variant of the method rather than how
+     costly it is, such as yescrypt's flags and ROM size.  */
+  uint64_t variant[2];
+  /* Parameters that make a hash more costly the bigger they are.  */
+  uint64_t cost[HASH_COST_MAX];
+};
+
+/* Parse the decimal number at P, which must be followed by '$' or the
+   end of the string.  */
+static bool
+parse_cost_number (const char *p, uint64_t *value)
+{
+  if (!(*p >= '0' && *p <= '9'))
+    return false;
+  errno = 0;
+  char *endp;
+  unsigned long long v = strtoull (p, &endp, 10);
+  if (errno || (*endp != '$' && *endp != '\0'))
+    return false;
+  *value = v;
+  return true;
+}
+
+#if INCLUDE_bsdicrypt
+static int
+bsdi_char_value (char c)
+{
+  const char *p = strchr ((const char *) ascii64, c);
+  return c && p ? (int) (p - (const char *) ascii64) : -1;
+}
+#endif
+
+/* Decode the parameters of SETTING, which was made with method H, into
+   COST.  Methods without any parameters all decode to zeroes.  Returns
+   false if SETTING is malformed.  */
+static bool
+get_hash_cost (const struct hashfn *h, const char *setting,
+               struct hash_cost *cost)
+{
+  const char *p = setting + h->plen;
+
+  memset (cost, 0, sizeof *cost);
+
+  if (h->prefix[0] == '$' && h->prefix[1] == '2')
+    {
+      /* bcrypt: "$2b$NN$", with NN the base-2 log of the rounds.  */
+      if (!(p[0] >= '0' && p[0] <= '9' && p[1] >= '0' && p[1] <= '9'))
+        return false;
+      cost->cost[0] = (uint64_t) ((p[0] - '0') * 10 + (p[1] - '0'));
+      return true;
+    }
+
+  if (!strcmp (h->prefix, "$5$") || !strcmp (h->prefix, "$6$")
+      || !strcmp (h->prefix, "$sm3$"))
+    {
+      /* SHA-crypt: "rounds=N$" is optional, with a default of 5000.  */
+      if (strncmp (p, "rounds=", sizeof "rounds=" - 1))
+        {
+          cost->cost[0] = 5000;
+          return true;
+        }
+      return parse_cost_number (p + sizeof "rounds=" - 1, &cost->cost[0]);
+    }
+
+  if (!strcmp (h->prefix, "$sha1"))
+    /* "$sha1$N$", with N the number of iterations.  */
+    return *p == '$' && parse_cost_number (p + 1, &cost->cost[0]);
+
+  if (!strcmp (h->prefix, "$md5"))
+    {
+      /* SunMD5: "$md5,rounds=N$" or "$md5$rounds=N$", with N the
+         number of rounds on top of the basic 4096, or neither.  */
+      if ((*p != ',' && *p != '$')
+          || strncmp (p + 1, "rounds=", sizeof "rounds=" - 1))
+        return true;
+      return parse_cost_number (p + sizeof ",rounds=" - 1, &cost->cost[0]);
+    }
+
+#if INCLUDE_bsdicrypt
+  if (!strcmp (h->prefix, "_"))
+    {
+      /* "_CCCC", with the number of rounds in four base-64 digits,
+         least significant first.  */
+      int i;
+      for (i = 3; i >= 0; i--)
+        {
+          int v = bsdi_char_value (p[i]);
+          if (v < 0)
+            return false;
+          cost->cost[0] = (cost->cost[0] << 6) | (uint64_t) v;
+        }
+      return true;
+    }
+#endif
+
+#if INCLUDE_yescrypt || INCLUDE_scrypt || INCLUDE_gost_yescrypt \
+  || INCLUDE_sm3_yescrypt
+  if (!strcmp (h->prefix, "$7$") || !strcmp (h->prefix, "$y$")
+      || !strcmp (h->prefix, "$gy$") || !strcmp (h->prefix, "$sm3y$"))
+    {
+      /* The yescrypt-based methods share their parameter encoding with
+         "$y$", and scrypt's is recognized by the same decoder.  */
+      char ysetting[CRYPT_OUTPUT_SIZE];
+      yescrypt_params_t params;
+
+      if (strlen (p) + 4 > sizeof ysetting)
+        return false;
+      ysetting[0] = '$';
+      ysetting[1] = h->prefix[1] == '7' ? '7' : 'y';
+      ysetting[2] = '$';
+      strcpy (ysetting + 3, p);
+      if (!yescrypt_decode_params (&params, (const uint8_t *) ysetting))
+        return false;
+
+      cost->variant[0] = params.flags;
+      cost->variant[1] = params.NROM;
+      cost->cost[0] = params.N;
+      cost->cost[1] = params.r;
+      cost->cost[2] = params.p;
+      cost->cost[3] = params.t;
+      cost->cost[4] = params.g;
+      return true;
+    }
+#endif
+
+  return true;
+}
+
+/* Report whether HASH should be replaced by a hash made from POLICY, a
+   setting string from crypt_gensalt_rn.  That is so if HASH uses a
+   different method, unless it would move HASH from a strong method to
+   a legacy one, or if it uses the same method with a lower cost in any
+   parameter.  A hash that is costlier than POLICY is left alone, and
+   so is one whose only difference from POLICY is its salt.  */
+static bool
+hash_needs_upgrade (const char *hash, const char *policy)
+{
+  const struct hashfn *h = get_hashfn (hash);
+  struct hash_cost hcost, pcost;
+  size_t i;
+
+  if (h != get_hashfn (policy))
+    return !(crypt_checksalt (policy) == CRYPT_SALT_METHOD_LEGACY
+             && crypt_checksalt (hash) == CRYPT_SALT_OK);
+
+  if (!get_hash_cost (h, hash, &hcost) || !get_hash_cost (h, policy, &pcost))
+    return true;
+
+  /* crypt_gensalt_rn takes up to a quarter off the count of sha1crypt
+     at random, so a hash made for POLICY may have that much less.  */
+  if (!strcmp (h->prefix, "$sha1"))
+    pcost.cost[0] -= pcost.cost[0] / 4;
+
+  for (i = 0; i < ARRAY_SIZE (hcost.variant); i++)
+    if (hcost.variant[i] != pcost.variant[i])
+      return true;
+  for (i = 0; i < ARRAY_SIZE (hcost.cost); i++)
+    if (hcost.cost[i] < pcost.cost[i])
+      return true;
+  return false;
+}
+
+int
+crypt_verify_and_upgrade (const char *phrase, const char *hash,
+                          const char *prefix, unsigned long count,
+                          char *newhash, int newhash_size)
+{
+  static const char zero_rbytes[UCHAR_MAX];
+  char policy[CRYPT_GENSALT_OUTPUT_SIZE];
+  char setting[CRYPT_GENSALT_OUTPUT_SIZE];
+  struct crypt_internal cint;
+  int result;
+
+  if (!newhash || newhash_size < CRYPT_OUTPUT_SIZE)
+    {
+      errno = ERANGE;
+      return -1;
+    }
+  newhash[0] = '\0';
+
+  /* Resolve the policy first, so that a bad PREFIX or COUNT is
+     reported whether or not PHRASE matches.  The salt of POLICY is
+     never used, so it is made from fixed bytes rather than spending
+     random bytes on every call.  */
+  if (!prefix)
+    prefix = crypt_preferred_method ();
+  const struct hashfn *h = prefix ? get_hashfn (prefix) : 0;
+  if (!h)
+    {
+      errno = EINVAL;
+      return -1;
+    }
+  if (!crypt_gensalt_rn (prefix, count, zero_rbytes, h->nrbytes,
+                         policy, sizeof policy))
+    return -1;
+
+  size_t used = do_crypt_internal (phrase, hash, &cint);
+  if (cint.output[0] == '*')
+    result = -1;
+  else
+    result = hash_strings_equal (cint.output, hash);
+
+  /* The new hash reuses the scratch area of the old one, so only one
+     area has to be erased, however big the two methods' footprints.  */
+  if (result == 1 && hash_needs_upgrade (hash, policy)
+      && crypt_gensalt_rn (prefix, count, 0, 0, setting, sizeof setting))
+    {
+      size_t used2 = do_crypt_internal (phrase, setting, &cint);
+      used = MAX (used, used2);
+      if (cint.output[0] != '*')
+        strcpy_or_abort (newhash, (size_t) newhash_size, cint.output);
+    }
+
+  explicit_bzero (cint.alg_specific, used);
+  explicit_bzero (cint.output, sizeof cint.output);
+  explicit_bzero (setting, sizeof setting);
+  return result;
+}
+SYMVER_crypt_verify_and_upgrade;
+#endif
@@ -0,0 +1,431 @@
+/* Generate alg-des-bitslice-tables.h: the DES S-boxes as circuits of
+   bitwise operations, and the key schedule, for alg-des-bitslice.c.
+
+   Each S-box output bit is a function of six input bits.  It is built
+   as a reduced binary decision diagram: split on one input at a time,
+   until what is left is a single input, and join the two halves with
+   the cheapest operation that fits them.  Subfunctions that turn up
+   more than once, within one output bit or across the four, are only
+   computed once.  For each S-box, every order of splitting the inputs
+   is tried, and the one giving the fewest operations is kept.
+
+   This program is preserved as documentation, like gen-des-tables.c;
+   it is not run at build time.
+
+   To the extent possible under law, the author(s) have waived all
+   copyright and related or neighboring rights to this work.
+
+   See https://creativecommons.org/publicdomain/zero/1.0/ for further
+   details.  */
+
+#include "crypt-port.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static const uint8_t sbox[8][64] =
+{
+  {
+    14,  4, 13,  1,  2, 15, 11,  8,  3, 10,  6, 12,  5,  9,  0,  7,
+     0, 15,  7,  4, 14,  2, 13,  1, 10,  6, 12, 11,  9,  5,  3,  8,
+     4,  1, 14,  8, 13,  6,  2, 11, 15, 12,  9,  7,  3, 10,  5,  0,
+    15, 12,  8,  2,  4,  9,  1,  7,  5, 11,  3, 14, 10,  0,  6, 13
+  },
+  {
+    15,  1,  8, 14,  6, 11,  3,  4,  9,  7,  2, 13, 12,  0,  5, 10,
+     3, 13,  4,  7, 15,  2,  8, 14, 12,  0,  1, 10,  6,  9, 11,  5,
+     0, 14,  7, 11, 10,  4, 13,  1,  5,  8, 12,  6,  9,  3,  2, 15,
+    13,  8, 10,  1,  3, 15,  4,  2, 11,  6,  7, 12,  0,  5, 14,  9
+  },
+  {
+    10,  0,  9, 14,  6,  3, 15,  5,  1, 13, 12,  7, 11,  4,  2,  8,
+    13,  7,  0,  9,  3,  4,  6, 10,  2,  8,  5, 14, 12, 11, 15,  1,
+    13,  6,  4,  9,  8, 15,  3,  0, 11,  1,  2, 12,  5, 10, 14,  7,
+     1, 10, 13,  0,  6,  9,  8,  7,  4, 15, 14,  3, 11,  5,  2, 12
+  },
+  {
+     7, 13, 14,  3,  0,  6,  9, 10,  1,  2,  8,  5, 11, 12,  4, 15,
+    13,  8, 11,  5,  6, 15,  0,  3,  4,  7,  2, 12,  1, 10, 14,  9,
+    10,  6,  9,  0, 12, 11,  7, 13, 15,  1,  3, 14,  5,  2,  8,  4,
+     3, 15,  0,  6, 10,  1, 13,  8,  9,  4,  5, 11, 12,  7,  2, 14
+  },
+  {
+     2, 12,  4,  1,  7, 10, 11,  6,  8,  5,  3, 15, 13,  0, 14,  9,
+    14, 11,  2, 12,  4,  7, 13,  1,  5,  0, 15, 10,  3,  9,  8,  6,
+     4,  2,  1, 11, 10, 13,  7,  8, 15,  9, 12,  5,  6,  3,  0, 14,
+    11,  8, 12,  7,  1, 14,  2, 13,  6, 15,  0,  9, 10,  4,  5,  3
+  },
+  {
+    12,  1, 10, 15,  9,  2,  6,  8,  0, 13,  3,  4, 14,  7,  5, 11,
+    10, 15,  4,  2,  7, 12,  9,  5,  6,  1, 13, 14,  0, 11,  3,  8,
+     9, 14, 15,  5,  2,  8, 12,  3,  7,  0,  4, 10,  1, 13, 11,  6,
+     4,  3,  2, 12,  9,  5, 15, 10, 11, 14,  1,  7,  6,  0,  8, 13
+  },
+  {
+     4, 11,  2, 14, 15,  0,  8, 13,  3, 12,  9,  7,  5, 10,  6,  1,
+    13,  0, 11,  7,  4,  9,  1, 10, 14,  3,  5, 12,  2, 15,  8,  6,
+     1,  4, 11, 13, 12,  3,  7, 14, 10, 15,  6,  8,  0,  5,  9,  2,
+     6, 11, 13,  8,  1,  4, 10,  7,  9,  5,  0, 15, 14,  2,  3, 12
+  },
+  {
+    13,  2,  8,  4,  6, 15, 11,  1, 10,  9,  3, 14,  5,  0, 12,  7,
+     1, 15, 13,  8, 10,  3,  7,  4, 12,  5,  6, 11,  0, 14,  9,  2,
+     7, 11,  4,  1,  9, 12, 14,  2,  0,  6, 10, 13, 15,  3,  5,  8,
+     2,  1, 14,  7,  4, 10,  8, 13, 15, 12,  9,  0,  3,  5,  6, 11
+  }
+};
+
+static const uint8_t pbox[32] =
+{
+  16,  7, 20, 21, 29, 12, 28, 17,  1, 15, 23, 26,  5, 18, 31, 10,
+   2,  8, 24, 14, 32, 27,  3,  9, 19, 13, 30,  6, 22, 11,  4, 25
+};
+
+static const uint8_t key_perm[56] =
+{
+  57, 49, 41, 33, 25, 17,  9,  1, 58, 50, 42, 34, 26, 18,
+  10,  2, 59, 51, 43, 35, 27, 19, 11,  3, 60, 52, 44, 36,
+  63, 55, 47, 39, 31, 23, 15,  7, 62, 54, 46, 38, 30, 22,
+  14,  6, 61, 53, 45, 37, 29, 21, 13,  5, 28, 20, 12,  4
+};
+
+static const uint8_t comp_perm[48] =
+{
+  14, 17, 11, 24,  1,  5,  3, 28, 15,  6, 21, 10,
+  23, 19, 12,  4, 26,  8, 16,  7, 27, 20, 13,  2,
+  41, 52, 31, 37, 47, 55, 30, 40, 51, 45, 33, 48,
+  44, 49, 39, 56, 34, 53, 46, 42, 50, 36, 29, 32
+};
+
+static const uint8_t key_shifts[16] =
+{
+  1, 1, 2, 2, 2, 2, 2, 2, 1, 2, 2, 2, 2, 2, 2, 1
+};
+
+/* Functions of the six S-box inputs are represented by their truth
+   tables: bit X is the value for the input bits X, with the first
+   input as the most significant bit.  */
+#define ALL_ONES UINT64_MAX
+
+enum op { OP_INPUT, OP_AND, OP_ANDN, OP_OR, OP_XOR, OP_NOT, OP_SEL };
+
+/* What each operation costs.  A selection takes three operations
+   unless the instruction set has one for it.  */
+static const unsigned int op_cost[] = { 0, 1, 1, 1, 1, 1, 3 };
+
+static const char *const op_name[] =
+{ "", "AND", "ANDN", "OR", "XOR", "NOT", "SEL" };
+
+#define MAX_NODES 200
+
+struct circuit
+{
+  unsigned int nnodes;
+  unsigned int cost;
+  uint64_t fn[MAX_NODES];
+  enum op op[MAX_NODES];
+  unsigned int arg[MAX_NODES][3];
+};
+
+static uint64_t input_fn[6];
+
+static void
+init_inputs (void)
+{
+  unsigned int i, x;
+  for (i = 0; i < 6; i++)
+    for (x = 0; x < 64; x++)
+      if (x & (0x20u >> i))
+        input_fn[i] |= (uint64_t) 1 << x;
+}
+
+/* Split F on input V: F0 is F with V false, F1 with V true, both as
+   functions that do not depend on V.  */
+static void
+cofactors (uint64_t f, unsigned int v, uint64_t *f0, uint64_t *f1)
+{
+  unsigned int shift = 0x20u >> v;
+  uint64_t hi = f & input_fn[v];
+  uint64_t lo = f & ~input_fn[v];
+  *f1 = hi | (hi >> shift);
+  *f0 = lo | (lo << shift);
+}
+
+static int
+find_node (const struct circuit *c, uint64_t f)
+{
+  unsigned int i;
+  for (i = 0; i < c->nnodes; i++)
+    if (c->fn[i] == f)
+      return (int) i;
+  return -1;
+}
+
+static unsigned int
+add_node (struct circuit *c, uint64_t f, enum op op,
+          unsigned int a, unsigned int b, unsigned int s)
+{
+  if (c->nnodes == MAX_NODES)
+    {
+      fputs ("gen-des-bitslice: too many nodes\n", stderr);
+      exit (1);
+    }
+  c->fn[c->nnodes] = f;
+  c->op[c->nnodes] = op;
+  c->arg[c->nnodes][0] = a;
+  c->arg[c->nnodes][1] = b;
+  c->arg[c->nnodes][2] = s;
+  c->cost += op_cost[op];
+  return c->nnodes++;
+}
+
+/* Add nodes to C computing F, splitting on inputs in ORDER, and return
+   the node that has it.  */
+static unsigned int
+synth (struct circuit *c, uint64_t f, const unsigned int order[6])
+{
+  uint64_t f0 = 0, f1 = 0;
+  unsigned int i, v = 0, n0, n1, g;
+  int found;
+
+  found = find_node (c, f);
+  if (found >= 0)
+    return (unsigned int) found;
+  if (f == 0 || f == ALL_ONES)
+    {
+      fputs ("gen-des-bitslice: constant subfunction\n", stderr);
+      exit (1);
+    }
+  found = find_node (c, ~f);
+  if (found >= 0)
+    return add_node (c, f, OP_NOT, (unsigned int) found, 0, 0);
+
+  for (i = 0; i < 6; i++)
+    {
+      v = order[i];
+      cofactors (f, v, &f0, &f1);
+      if (f0 != f1)
+        break;
+    }
+
+  if (f0 == 0)
+    return add_node (c, f, OP_AND, v, synth (c, f1, order), 0);
+  if (f1 == 0)
+    return add_node (c, f, OP_ANDN, synth (c, f0, order), v, 0);
+  if (f1 == ALL_ONES)
+    return add_node (c, f, OP_OR, v, synth (c, f0, order), 0);
+  if (f0 == ALL_ONES)
+    {
+      n1 = synth (c, f1, order);
+      return add_node (c, f, OP_NOT,
+                       add_node (c, input_fn[v] & ~f1, OP_ANDN, v, n1, 0),
+                       0, 0);
+    }
+  if (f1 == ~f0)
+    return add_node (c, f, OP_XOR, v, synth (c, f0, order), 0);
+
+  /* In general, either select between the two halves, or compute one
+     of them and flip it where they differ.  Keep whichever is
+     cheapest.  */
+  struct circuit *best = malloc (sizeof *best);
+  struct circuit *alt = malloc (sizeof *alt);
+  if (!best || !alt)
+    {
+      perror ("gen-des-bitslice");
+      exit (1);
+    }
+
+  *best = *c;
+  n0 = synth (best, f0, order);
+  n1 = synth (best, f1, order);
+  add_node (best, f, OP_SEL, n0, n1, v);
+
+  *alt = *c;
+  n0 = synth (alt, f0, order);
+  g = synth (alt, f0 ^ f1, order);
+  add_node (alt, f, OP_XOR, n0,
+            add_node (alt, input_fn[v] & (f0 ^ f1), OP_AND, v, g, 0), 0);
+  if (alt->cost < best->cost)
+    *best = *alt;
+
+  *alt = *c;
+  n1 = synth (alt, f1, order);
+  g = synth (alt, f0 ^ f1, order);
+  add_node (alt, f, OP_XOR, n1,
+            add_node (alt, ~input_fn[v] & (f0 ^ f1), OP_ANDN, g, v, 0), 0);
+  if (alt->cost < best->cost)
+    *best = *alt;
+
+  *c = *best;
+  free (best);
+  free (alt);
+  return c->nnodes - 1;
+}
+
+static uint64_t
+sbox_output (unsigned int s, unsigned int bit)
+{
+  uint64_t f = 0;
+  unsigned int x;
+  for (x = 0; x < 64; x++)
+    {
+      unsigned int row = ((x >> 4) & 2) | (x & 1);
+      unsigned int col = (x >> 1) & 15;
+      if ((sbox[s][row * 16 + col] >> (3 - bit)) & 1)
+        f |= (uint64_t) 1 << x;
+    }
+  return f;
+}
+
+static void
+print_operand (const struct circuit *c, unsigned int n)
+{
+  if (c->op[n] == OP_INPUT)
+    printf ("a%u", n + 1);
+  else
+    printf ("t%u", n - 5);
+}
+
+static void
+print_sbox (unsigned int s)
+{
+  struct circuit best, c;
+  unsigned int order[6], outputs[4], perm, i, j, bit;
+
+  best.nnodes = 0;
+  best.cost = UINT32_MAX;
+  for (perm = 0; perm < 720; perm++)
+    {
+      /* Decode PERM as a permutation of the inputs.  */
+      unsigned int left = perm, used = 0;
+      for (i = 0; i < 6; i++)
+        {
+          unsigned int k = left % (6 - i);
+          left /= 6 - i;
+          for (j = 0; j < 6; j++)
+            if (!(used & (1u << j)) && k-- == 0)
+              break;
+          order[i] = j;
+          used |= 1u << j;
+        }
+
+      c.nnodes = 0;
+      c.cost = 0;
+      for (i = 0; i < 6; i++)
+        add_node (&c, input_fn[i], OP_INPUT, 0, 0, 0);
+      for (bit = 0; bit < 4; bit++)
+        outputs[bit] = synth (&c, sbox_output (s, bit), order);
+      if (c.cost < best.cost)
+        best = c;
+    }
+
+  for (bit = 0; bit < 4; bit++)
+    outputs[bit] = (unsigned int) find_node (&best, sbox_output (s, bit));
+
+  printf ("/* S-box %u: %u operations.  */\n", s + 1, best.cost);
+  printf ("#define DES_BS_S%u(V, vec, a1, a2, a3, a4, a5, a6, "
+          "o1, o2, o3, o4) \\\n", s + 1);
+  printf ("  do \\\n    { \\\n");
+  for (i = 6; i < best.nnodes; i++)
+    {
+      printf ("      vec t%u = V##_%s (", i - 5, op_name[best.op[i]]);
+      print_operand (&best, best.arg[i][0]);
+      if (best.op[i] != OP_NOT)
+        {
+          printf (", ");
+          print_operand (&best, best.arg[i][1]);
+        }
+      if (best.op[i] == OP_SEL)
+        {
+          printf (", ");
+          print_operand (&best, best.arg[i][2]);
+        }
+      printf ("); \\\n");
+    }
+  for (bit = 0; bit < 4; bit++)
+    {
+      printf ("      o%u = V##_XOR (o%u, ", bit + 1, bit + 1);
+      print_operand (&best, outputs[bit]);
+      printf ("); \\\n");
+    }
+  printf ("    } \\\n  while (0)\n\n");
+}
+
+int
+main (void)
+{
+  unsigned int s, i, bit, round, shift;
+
+  init_inputs ();
+
+  printf ("/* This file is generated by gen-des-bitslice.c.  "
+          "Do not edit.\n\n"
+          "   To the extent possible under law, the author(s) have "
+          "waived all\n"
+          "   copyright and related or neighboring rights to this work.\n\n"
+          "   See https://creativecommons.org/publicdomain/zero/1.0/ for "
+          "further\n"
+          "   details.  */\n\n");
+
+  printf ("/* The DES S-boxes as circuits.  DES_BS_Sn (V, vec, a1, ..., "
+          "a6, o1, ..., o4)\n"
+          "   XORs the four outputs of S-box n for the inputs a1 to a6 "
+          "(a1 being the\n"
+          "   most significant) into o1 to o4 (o1 being the most "
+          "significant).  The\n"
+          "   operations are V##_AND, V##_ANDN (x & ~y), V##_OR, "
+          "V##_XOR, V##_NOT and\n"
+          "   V##_SEL (z ? y : x), on values of type vec.  */\n\n");
+
+  for (s = 0; s < 8; s++)
+    print_sbox (s);
+
+  /* The S-boxes for one round: X holds the 48 inputs, and the outputs
+     are XORed into L after the P-box permutation.  */
+  printf ("/* One round's S-boxes, from the 48 inputs in X, XORed into "
+          "the 32 bits\n"
+          "   in L through the P-box permutation.  */\n");
+  printf ("#define DES_BS_SBOXES(V, vec, x, l) \\\n");
+  for (s = 0; s < 8; s++)
+    {
+      unsigned int out[4];
+      for (bit = 0; bit < 4; bit++)
+        for (i = 0; i < 32; i++)
+          if (pbox[i] == s * 4 + bit + 1)
+            out[bit] = i;
+      printf ("  DES_BS_S%u (V, vec, x[%u], x[%u], x[%u], x[%u], x[%u], "
+              "x[%u], \\\n             l[%u], l[%u], l[%u], l[%u])%s\n",
+              s + 1, s * 6, s * 6 + 1, s * 6 + 2, s * 6 + 3, s * 6 + 4,
+              s * 6 + 5, out[0], out[1], out[2], out[3],
+              s < 7 ? "; \\" : "");
+    }
+
+  /* For each round, which bit of the 64-bit key, counting from the
+     most significant bit of its first byte, goes into each bit of the
+     round key.  */
+  printf ("\n/* The bits of the key, counting from the most significant "
+          "bit of its\n"
+          "   first byte, that make up each bit of the key for each "
+          "round.  */\n");
+  printf ("static const uint8_t des_bs_key_bits[16][48] =\n{\n");
+  shift = 0;
+  for (round = 0; round < 16; round++)
+    {
+      shift += key_shifts[round];
+      printf ("  {");
+      for (i = 0; i < 48; i++)
+        {
+          unsigned int p = comp_perm[i] - 1u;
+          if (p < 28)
+            p = (p + shift) % 28;
+          else
+            p = 28 + (p - 28 + shift) % 28;
+          printf ("%s%2u", i % 12 ? ", " : i ? ",\n    " : " ",
+                  key_perm[p] - 1u);
+        }
+      printf (" }%s\n", round < 15 ? "," : "");
+    }
+  printf ("};\n");
+  return 0;
+}
@@ -0,0 +1,145 @@
+/* Runtime detection of optional CPU instruction set extensions.
+ *
+ * To the extent possible under law, the author(s) have waived all
+ * copyright and related or neighboring rights to this work.
+ *
+ * See https://creativecommons.org/publicdomain/zero/1.0/ for further
+ * details.
+ */
+
+#include "crypt-port.h"
+
+#if defined HAVE_CPUID_H && (defined __x86_64__ || defined __i386__)
+#include <cpuid.h>
+#define DETECT_X86 1
+/* Older versions of cpuid.h lack some of the bits we need.  */
+#ifndef bit_AVX512VL
+#define bit_AVX512VL (1u << 31)
+#endif
+#ifndef bit_XOP
+#define bit_XOP (1 << 11)
+#endif
+#endif
+
+#if defined HAVE_SYS_AUXV_H && defined HAVE_GETAUXVAL && defined __aarch64__
+#include <sys/auxv.h>
+#define DETECT_AARCH64 1
+#ifndef HWCAP_SHA1
+#define HWCAP_SHA1 (1 << 5)
+#endif
+#ifndef HWCAP_SHA2
+#define HWCAP_SHA2 (1 << 6)
+#endif
+#endif
+
+/* Feature bits detected so far, or 0 if detection hasn't happened yet.
+   CPU_FEATURE_DETECTED is always set once it has, so a CPU with none
+   of the optional extensions doesn't cause detection to be rerun on
+   every call.  Concurrent first calls may both run the detection; they
+   will store the same value.  */
+static uint32_t cpu_features;
+
+/* Mask applied to the detected features; see restrict_cpu_features.  */
+static uint32_t cpu_features_mask = UINT32_MAX;
+
+#ifdef DETECT_X86
+/* Read extended control register 0, which tells us which register
+   sets the operating system saves on context switch.  The xgetbv
+   instruction is only present if CPUID says OSXSAVE is set.  */
+static uint64_t
+read_xcr0 (void)
+{
+  uint32_t eax, edx;
+  __asm__ ("xgetbv" : "=a" (eax), "=d" (edx) : "c" (0));
+  return ((uint64_t) edx << 32) | eax;
+}
+
+/* XCR0 bits for the SSE, AVX, and AVX-512 register state.  */
+#define XCR0_AVX_STATE    0x06u
+#define XCR0_AVX512_STATE 0xe0u
+#endif
+
+static uint32_t
+detect_cpu_features (void)
+{
+  uint32_t features = CPU_FEATURE_DETECTED;
+
+#ifdef DETECT_X86
+  unsigned int eax, ebx, ecx, edx;
+  unsigned int max_leaf = __get_cpuid_max (0, 0);
+  uint64_t xcr0 = 0;
+
+  if (max_leaf < 1)
+    return features;
+
+  __cpuid (1, eax, ebx, ecx, edx);
+  if (edx & bit_SSE2)
+    features |= CPU_FEATURE_SSE2;
+  if ((ecx & bit_OSXSAVE) && (ecx & bit_AVX))
+    xcr0 = read_xcr0 ();
+  /* The SHA-1 and SHA-256 code also uses SSSE3 and SSE4.1
+     instructions, which every CPU with the SHA extensions has, but
+     check anyway.  */
+  bool have_sse41 = (ecx & bit_SSSE3) && (ecx & bit_SSE4_1);
+
+  bool have_avx = (xcr0 & XCR0_AVX_STATE) == XCR0_AVX_STATE;
+  if (have_avx)
+    features |= CPU_FEATURE_AVX;
+
+  if (max_leaf >= 7)
+    {
+      __cpuid_count (7, 0, eax, ebx, ecx, edx);
+      if (have_avx)
+        {
+          if (ebx & bit_AVX2)
+            features |= CPU_FEATURE_AVX2;
+          if ((xcr0 & XCR0_AVX512_STATE) == XCR0_AVX512_STATE
+              && (ebx & bit_AVX512F))
+            {
+              features |= CPU_FEATURE_AVX512F;
+              if (ebx & bit_AVX512VL)
+                features |= CPU_FEATURE_AVX512VL;
+            }
+        }
+      if (have_sse41 && (ebx & bit_SHA))
+        features |= CPU_FEATURE_SHA;
+    }
+
+  /* XOP is an AMD extension, reported in an extended leaf.  */
+  if (have_avx && __get_cpuid_max (0x80000000, 0) >= 0x80000001)
+    {
+      __cpuid (0x80000001, eax, ebx, ecx, edx);
+      if (ecx & bit_XOP)
+        features |= CPU_FEATURE_XOP;
+    }
+#endif
+
+#ifdef DETECT_AARCH64
+  unsigned long hwcap = getauxval (AT_HWCAP);
+  if (hwcap & HWCAP_SHA1)
+    features |= CPU_FEATURE_ARM_SHA1;
+  if (hwcap & HWCAP_SHA2)
+    features |= CPU_FEATURE_ARM_SHA2;
+#endif
+
+  return features;
+}
+
+uint32_t
+get_cpu_features (void)
+{
+  uint32_t features = __atomic_load_n (&cpu_features, __ATOMIC_RELAXED);
+  if (!features)
+    {
+      features = detect_cpu_features ();
+      __atomic_store_n (&cpu_features, features, __ATOMIC_RELAXED);
+    }
+  return features & __atomic_load_n (&cpu_features_mask, __ATOMIC_RELAXED);
+}
+
+void
+restrict_cpu_features (uint32_t mask)
+{
+  __atomic_store_n (&cpu_features_mask, mask | CPU_FEATURE_DETECTED,
+                    __ATOMIC_RELAXED);
+}
@@ -0,0 +1,213 @@
+/* A per-thread pool of random bytes for crypt_gensalt, so that
+ * generating a salt does not need a system call every time.
+ *
+ * To the extent possible under law, the author(s) have waived all
+ * copyright and related or neighboring rights to this work.
+ *
+ * See https://creativecommons.org/publicdomain/zero/1.0/ for further
+ * details.
+ */
+
+#include "crypt-port.h"
+
+#if ENABLE_RANDOM_POOL
+
+#include "alg-chacha20.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#ifdef __unix__
+#include <sys/mman.h>
+#endif
+
+/* Each thread's pool is the output of ChaCha20 keyed with a secret
+   seed from get_random_bytes.  Whenever the pool runs dry, a fresh
+   run of keystream is generated; its first CHACHA20_KEY_SIZE bytes
+   become the key for the next run, and the rest are handed out.
+   Bytes are erased as soon as they have been handed out, so the state
+   of a pool says nothing about the bytes it produced earlier.  */
+#define RANDOM_POOL_BLOCKS 16
+#define RANDOM_POOL_SIZE (RANDOM_POOL_BLOCKS * CHACHA20_BLOCK_SIZE)
+
+/* Mix new bytes from the operating system into the key after this
+   many bytes have been handed out.  */
+#define RANDOM_POOL_RESEED_INTERVAL (1024 * 1024)
+
+struct random_pool
+{
+  /* Nonzero once the key has been seeded.  Where the operating system
+     supports MADV_WIPEONFORK, the pool lives in memory that reads as
+     zeroes in a child process, so this is how a child notices it must
+     not reuse its parent's pool.  */
+  uint32_t seeded;
+  /* The value of random_pool_forks when the key was seeded, for
+     systems without MADV_WIPEONFORK.  */
+  unsigned long forks;
+  size_t until_reseed;
+  /* stream[0 .. CHACHA20_KEY_SIZE) is the key; stream[pos ..
+     RANDOM_POOL_SIZE) is what is left to hand out.  */
+  size_t pos;
+  uint8_t stream[RANDOM_POOL_SIZE];
+};
+
+static pthread_key_t pool_key;
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+static bool pool_ok;
+
+/* Incremented in the child after every fork.  */
+static volatile unsigned long random_pool_forks;
+
+static void
+pool_atfork_child (void)
+{
+  random_pool_forks++;
+}
+
+#if defined __unix__ && defined MAP_ANON && defined MADV_WIPEONFORK
+#define USE_WIPEONFORK 1
+#else
+#define USE_WIPEONFORK 0
+#endif
+
+static void
+pool_free (struct random_pool *pool)
+{
+  explicit_bzero (pool, sizeof *pool);
+#if USE_WIPEONFORK
+  munmap (pool, sizeof *pool);
+#else
+  free (pool);
+#endif
+}
+
+static void
+pool_destroy (void *arg)
+{
+  pool_free (arg);
+}
+
+static void
+pool_init (void)
+{
+  pool_ok = !pthread_atfork (NULL, NULL, pool_atfork_child)
+            && !pthread_key_create (&pool_key, pool_destroy);
+}
+
+static struct random_pool *
+pool_alloc (void)
+{
+  struct random_pool *pool;
+#if USE_WIPEONFORK
+  pool = mmap (NULL, sizeof *pool, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANON, -1, 0);
+  if (pool == MAP_FAILED)
+    return NULL;
+  /* Kernels older than 4.14 don't know MADV_WIPEONFORK; the fork
+     counter still protects us there, as long as the process forks by
+     calling fork.  */
+  madvise (pool, sizeof *pool, MADV_WIPEONFORK);
+#else
+  pool = calloc (1, sizeof *pool);
+#endif
+  return pool;
+}
+
+static struct random_pool *
+pool_get (void)
+{
+  struct random_pool *pool;
+
+  if (pthread_once (&pool_once, pool_init) || !pool_ok)
+    return NULL;
+  pool = pthread_getspecific (pool_key);
+  if (pool)
+    return pool;
+
+  pool = pool_alloc ();
+  if (!pool)
+    return NULL;
+  if (pthread_setspecific (pool_key, pool))
+    {
+      pool_free (pool);
+      return NULL;
+    }
+  return pool;
+}
+
+/* Replace the contents of POOL with a fresh run of keystream.  */
+static void
+pool_refill (struct random_pool *pool)
+{
+  static const uint8_t nonce[CHACHA20_NONCE_SIZE];
+  chacha20_keystream (pool->stream, RANDOM_POOL_BLOCKS,
+                      pool->stream, nonce, 0);
+  pool->pos = CHACHA20_KEY_SIZE;
+}
+
+/* Mix a new seed from the operating system into the key of POOL, and
+   refill it.  */
+static bool
+pool_reseed (struct random_pool *pool)
+{
+  uint8_t seed[CHACHA20_KEY_SIZE];
+  size_t i;
+
+  if (!get_random_bytes (seed, sizeof seed))
+    return false;
+  for (i = 0; i < sizeof seed; i++)
+    pool->stream[i] ^= seed[i];
+  explicit_bzero (seed, sizeof seed);
+
+  pool_refill (pool);
+  pool->seeded = 1;
+  pool->forks = random_pool_forks;
+  pool->until_reseed = RANDOM_POOL_RESEED_INTERVAL;
+  return true;
+}
+
+bool
+get_random_bytes_pooled (void *buf, size_t buflen)
+{
+  uint8_t *out = buf;
+
+  /* Same constraints as get_random_bytes.  */
+  if (buflen == 0)
+    return true;
+  if (buflen > 256)
+    {
+      errno = EIO;
+      return false;
+    }
+
+  /* If there is no pool for this thread and one can't be made, fall
+     back to asking the operating system every time.  */
+  int saved_errno = errno;
+  struct random_pool *pool = pool_get ();
+  errno = saved_errno;
+  if (!pool)
+    return get_random_bytes (buf, buflen);
+
+  if (!pool->seeded || pool->forks != random_pool_forks
+      || pool->until_reseed < buflen)
+    {
+      if (!pool_reseed (pool))
+        return false;
+    }
+  pool->until_reseed -= buflen;
+
+  while (buflen > 0)
+    {
+      if (pool->pos == RANDOM_POOL_SIZE)
+        pool_refill (pool);
+      size_t n = MIN (buflen, RANDOM_POOL_SIZE - pool->pos);
+      memcpy (out, pool->stream + pool->pos, n);
+      explicit_bzero (pool->stream + pool->pos, n);
+      pool->pos += n;
+      out += n;
+      buflen -= n;
+    }
+  return true;
+}
+
+#endif /* ENABLE_RANDOM_POOL */
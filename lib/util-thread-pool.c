@@ -0,0 +1,216 @@
+/* A pool of worker threads for computing the independent lanes of a
+ * yescrypt or scrypt hash in parallel.
+ *
+ * To the extent possible under law, the author(s) have waived all
+ * copyright and related or neighboring rights to this work.
+ *
+ * See https://creativecommons.org/publicdomain/zero/1.0/ for further
+ * details.
+ */
+
+#include "crypt-port.h"
+
+#if ENABLE_YESCRYPT_THREADS
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/* No matter what the environment says, never use more threads than
+   this for one hash.  */
+#define THREAD_POOL_LIMIT 64
+
+/* The pool runs one job at a time.  A job is a call to
+   thread_pool_run; its N calls to FN are handed out one index at a
+   time to whichever thread asks next, the caller included.  A second
+   thread that calls thread_pool_run while a job is in progress does
+   its own work serially instead of waiting for the pool.  */
+static struct
+{
+  pthread_mutex_t lock;
+  pthread_cond_t work_cv;   /* a new job has been posted */
+  pthread_cond_t done_cv;   /* the last call of a job has finished */
+  uint32_t nthreads;        /* including the caller; 1 if no workers */
+  bool busy;                /* a job is in progress */
+  unsigned long generation; /* incremented each time a job is posted */
+  thread_pool_fn fn;
+  void *arg;
+  uint32_t next;            /* next index to hand out */
+  uint32_t n;               /* number of indices in the job */
+  uint32_t remaining;       /* calls not yet finished */
+} pool =
+{
+  PTHREAD_MUTEX_INITIALIZER,
+  PTHREAD_COND_INITIALIZER,
+  PTHREAD_COND_INITIALIZER,
+  1, false, 0, NULL, NULL, 0, 0, 0
+};
+
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+
+/* Hand out indices of the current job and run them until there are
+   none left.  Called, and returns, with pool.lock held.  */
+static void
+work_on_job (void)
+{
+  while (pool.next < pool.n)
+    {
+      thread_pool_fn fn = pool.fn;
+      void *arg = pool.arg;
+      uint32_t i = pool.next++;
+
+      pthread_mutex_unlock (&pool.lock);
+      fn (arg, i);
+      pthread_mutex_lock (&pool.lock);
+
+      if (--pool.remaining == 0)
+        pthread_cond_signal (&pool.done_cv);
+    }
+}
+
+static void *
+worker_main (void *ARG_UNUSED (unused))
+{
+  unsigned long seen = 0;
+
+  pthread_mutex_lock (&pool.lock);
+  for (;;)
+    {
+      while (pool.generation == seen)
+        pthread_cond_wait (&pool.work_cv, &pool.lock);
+      seen = pool.generation;
+      work_on_job ();
+    }
+  return NULL;
+}
+
+/* After fork, only the forking thread exists in the child; any workers
+   are gone, and a job another thread had in progress will never
+   finish.  Start over without workers.  */
+static void
+pool_atfork_child (void)
+{
+  pthread_mutex_init (&pool.lock, NULL);
+  pthread_cond_init (&pool.work_cv, NULL);
+  pthread_cond_init (&pool.done_cv, NULL);
+  pool.nthreads = 1;
+  pool.busy = false;
+}
+
+/* Decide how many threads to use, and start the workers.  */
+static void
+pool_init (void)
+{
+  long want = YESCRYPT_THREADS_MAX;
+  bool requested = false;
+
+#ifdef HAVE_SECURE_GETENV
+  const char *env = secure_getenv ("LIBXCRYPT_YESCRYPT_THREADS");
+  if (env && *env)
+    {
+      char *end;
+      long val = strtol (env, &end, 10);
+      if (*end == '\0' && val >= 1)
+        {
+          want = val;
+          requested = true;
+        }
+    }
+#endif
+
+  /* Without an explicit request, don't start more threads than there
+     are CPUs to run them.  */
+#ifdef _SC_NPROCESSORS_ONLN
+  if (!requested)
+    {
+      long ncpus = sysconf (_SC_NPROCESSORS_ONLN);
+      if (ncpus >= 1 && ncpus < want)
+        want = ncpus;
+    }
+#endif
+  if (want > THREAD_POOL_LIMIT)
+    want = THREAD_POOL_LIMIT;
+  if (want <= 1)
+    return;
+
+  if (pthread_atfork (NULL, NULL, pool_atfork_child))
+    return;
+
+  /* The workers should never handle signals meant for the
+     application; they inherit this mask.  */
+  sigset_t all, saved;
+  pthread_attr_t attr;
+  sigfillset (&all);
+  if (pthread_attr_init (&attr))
+    return;
+  pthread_attr_setdetachstate (&attr, PTHREAD_CREATE_DETACHED);
+  pthread_sigmask (SIG_SETMASK, &all, &saved);
+
+  uint32_t nthreads = 1;
+  while (nthreads < (uint32_t) want)
+    {
+      pthread_t thread;
+      if (pthread_create (&thread, &attr, worker_main, NULL))
+        break;
+      nthreads++;
+    }
+
+  pthread_sigmask (SIG_SETMASK, &saved, NULL);
+  pthread_attr_destroy (&attr);
+
+  pthread_mutex_lock (&pool.lock);
+  pool.nthreads = nthreads;
+  pthread_mutex_unlock (&pool.lock);
+}
+
+uint32_t
+thread_pool_size (void)
+{
+  uint32_t nthreads;
+
+  pthread_once (&pool_once, pool_init);
+  pthread_mutex_lock (&pool.lock);
+  nthreads = pool.nthreads;
+  pthread_mutex_unlock (&pool.lock);
+  return nthreads;
+}
+
+void
+thread_pool_run (thread_pool_fn fn, void *arg, uint32_t n)
+{
+  uint32_t i;
+
+  if (n > 1)
+    {
+      pthread_once (&pool_once, pool_init);
+      pthread_mutex_lock (&pool.lock);
+      if (pool.nthreads > 1 && !pool.busy)
+        {
+          pool.busy = true;
+          pool.fn = fn;
+          pool.arg = arg;
+          pool.next = 0;
+          pool.n = n;
+          pool.remaining = n;
+          pool.generation++;
+          pthread_cond_broadcast (&pool.work_cv);
+
+          work_on_job ();
+          while (pool.remaining > 0)
+            pthread_cond_wait (&pool.done_cv, &pool.lock);
+
+          pool.busy = false;
+          pool.fn = NULL;
+          pool.arg = NULL;
+          pthread_mutex_unlock (&pool.lock);
+          return;
+        }
+      pthread_mutex_unlock (&pool.lock);
+    }
+
+  for (i = 0; i < n; i++)
+    fn (arg, i);
+}
+
+#endif /* ENABLE_YESCRYPT_THREADS */
@@ -0,0 +1,132 @@
+/* Test the ChaCha20 keystream generator used by the random pool.
+
+   To the extent possible under law, the author(s) have waived all
+   copyright and related or neighboring rights to this work.
+
+   See https://creativecommons.org/publicdomain/zero/1.0/ for further
+   details.  */
+
+#include "crypt-port.h"
+#include "alg-chacha20.h"
+
+#include <stdio.h>
+
+#if ENABLE_RANDOM_POOL
+
+static const struct
+{
+  const char *tag;
+  uint8_t key[CHACHA20_KEY_SIZE];
+  uint8_t nonce[CHACHA20_NONCE_SIZE];
+  uint32_t counter;
+  size_t nblocks;
+  uint8_t expected[2 * CHACHA20_BLOCK_SIZE];
+} tests[] =
+{
+  /* RFC 8439, appendix A.1, test vectors 1 and 2, which are the first
+     two blocks of the same keystream.  */
+  {
+    "RFC 8439 A.1 #1-2",
+    { 0 }, { 0 }, 0, 2,
+    {
+      0x76, 0xb8, 0xe0, 0xad, 0xa0, 0xf1, 0x3d, 0x90,
+      0x40, 0x5d, 0x6a, 0xe5, 0x53, 0x86, 0xbd, 0x28,
+      0xbd, 0xd2, 0x19, 0xb8, 0xa0, 0x8d, 0xed, 0x1a,
+      0xa8, 0x36, 0xef, 0xcc, 0x8b, 0x77, 0x0d, 0xc7,
+      0xda, 0x41, 0x59, 0x7c, 0x51, 0x57, 0x48, 0x8d,
+      0x77, 0x24, 0xe0, 0x3f, 0xb8, 0xd8, 0x4a, 0x37,
+      0x6a, 0x43, 0xb8, 0xf4, 0x15, 0x18, 0xa1, 0x1c,
+      0xc3, 0x87, 0xb6, 0x69, 0xb2, 0xee, 0x65, 0x86,
+      0x9f, 0x07, 0xe7, 0xbe, 0x55, 0x51, 0x38, 0x7a,
+      0x98, 0xba, 0x97, 0x7c, 0x73, 0x2d, 0x08, 0x0d,
+      0xcb, 0x0f, 0x29, 0xa0, 0x48, 0xe3, 0x65, 0x69,
+      0x12, 0xc6, 0x53, 0x3e, 0x32, 0xee, 0x7a, 0xed,
+      0x29, 0xb7, 0x21, 0x76, 0x9c, 0xe6, 0x4e, 0x43,
+      0xd5, 0x71, 0x33, 0xb0, 0x74, 0xd8, 0x39, 0xd5,
+      0x31, 0xed, 0x1f, 0x28, 0x51, 0x0a, 0xfb, 0x45,
+      0xac, 0xe1, 0x0a, 0x1f, 0x4b, 0x79, 0x4d, 0x6f,
+    }
+  },
+  /* RFC 8439, section 2.3.2.  */
+  {
+    "RFC 8439 2.3.2",
+    {
+      0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+      0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f,
+      0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17,
+      0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f,
+    },
+    {
+      0x00, 0x00, 0x00, 0x09, 0x00, 0x00, 0x00, 0x4a,
+      0x00, 0x00, 0x00, 0x00,
+    },
+    1, 1,
+    {
+      0x10, 0xf1, 0xe7, 0xe4, 0xd1, 0x3b, 0x59, 0x15,
+      0x50, 0x0f, 0xdd, 0x1f, 0xa3, 0x20, 0x71, 0xc4,
+      0xc7, 0xd1, 0xf4, 0xc7, 0x33, 0xc0, 0x68, 0x03,
+      0x04, 0x22, 0xaa, 0x9a, 0xc3, 0xd4, 0x6c, 0x4e,
+      0xd2, 0x82, 0x64, 0x46, 0x07, 0x9f, 0xaa, 0x09,
+      0x14, 0xc2, 0xd7, 0x05, 0xd9, 0x8b, 0x02, 0xa2,
+      0xb5, 0x12, 0x9c, 0xd1, 0xde, 0x16, 0x4e, 0xb9,
+      0xcb, 0xd0, 0x83, 0xe8, 0xa2, 0x50, 0x3c, 0x4e,
+    }
+  },
+};
+
+static int
+check (const char *tag, const char *how, const uint8_t *expected,
+       const uint8_t *actual, size_t len)
+{
+  size_t i;
+
+  if (!memcmp (expected, actual, len))
+    return 0;
+
+  printf ("FAIL: %s (%s):\n  exp:", tag, how);
+  for (i = 0; i < len; i++)
+    printf ("%s%02x", i % 32 ? "" : "\n    ", expected[i]);
+  printf ("\n  got:");
+  for (i = 0; i < len; i++)
+    printf ("%s%02x", i % 32 ? "" : "\n    ", actual[i]);
+  printf ("\n");
+  return 1;
+}
+
+int
+main (void)
+{
+  uint8_t out[2 * CHACHA20_BLOCK_SIZE];
+  int result = 0;
+  size_t i;
+
+  for (i = 0; i < ARRAY_SIZE (tests); i++)
+    {
+      size_t len = tests[i].nblocks * CHACHA20_BLOCK_SIZE;
+
+      chacha20_keystream (out, tests[i].nblocks, tests[i].key,
+                          tests[i].nonce, tests[i].counter);
+      result |= check (tests[i].tag, "separate", tests[i].expected,
+                       out, len);
+
+      /* The random pool generates the keystream over its own key.  */
+      memset (out, 0, sizeof out);
+      memcpy (out, tests[i].key, CHACHA20_KEY_SIZE);
+      chacha20_keystream (out, tests[i].nblocks, out,
+                          tests[i].nonce, tests[i].counter);
+      result |= check (tests[i].tag, "in place", tests[i].expected,
+                       out, len);
+    }
+
+  return result;
+}
+
+#else
+
+int
+main (void)
+{
+  return 77; /* UNSUPPORTED */
+}
+
+#endif
@@ -173,6 +173,35 @@ main (void)
           fputs ("\n", stdout);
         }
     }
+
+  /*
+   * A context set up once must give the same results, HMAC after
+   * HMAC, as setting up the key every time, like the PBKDF1 loop
+   * of sha1crypt does with it.
+   */
+  {
+    static const uint8_t key[] = "a passphrase used as the key";
+    struct hmac_sha1_ctx ctx;
+    uint8_t chained[HASH_LENGTH], expected[HASH_LENGTH];
+    int i;
+
+    hmac_sha1_init_ctx (&ctx, key, sizeof key - 1);
+    hmac_sha1_process_ctx (&ctx, key, sizeof key - 1, chained);
+    hmac_sha1_process_data (key, sizeof key - 1, key, sizeof key - 1,
+                            expected);
+    for (i = 0; i < 100; i++)
+      {
+        if (memcmp (chained, expected, HASH_LENGTH))
+          {
+            printf ("\nhmac_sha1_process_ctx differs at iteration %d\n", i);
+            n = 1;
+            break;
+          }
+        hmac_sha1_process_ctx (&ctx, chained, HASH_LENGTH, chained);
+        hmac_sha1_process_data (expected, HASH_LENGTH, key, sizeof key - 1,
+                                expected);
+      }
+  }
   return n;
 }
 
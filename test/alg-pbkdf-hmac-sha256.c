@@ -255,6 +255,12 @@ main (void)
   int status = 0;
   status |= test_hmac_sha256 ();
   status |= test_pbkdf2_hmac_sha256 ();
+
+  /* Again with the portable SHA256_Transform, in case the first pass
+     used the CPU's SHA-256 instructions.  */
+  restrict_cpu_features (0);
+  status |= test_hmac_sha256 ();
+  status |= test_pbkdf2_hmac_sha256 ();
   return status;
 }
 
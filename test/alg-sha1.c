@@ -39,8 +39,8 @@ bin_to_hex (uint8_t *digest, char *output)
 }
 
 
-int
-main (void)
+static int
+test_sha1 (const char *impl)
 {
   int k;
   struct sha1_ctx ctx;
@@ -57,7 +57,7 @@ main (void)
 
       if (strcmp(output, test_results[k]))
         {
-          fprintf(stdout, "FAIL\n");
+          fprintf(stdout, "FAIL (%s)\n", impl);
           fprintf(stderr,"* hash of \"%s\" incorrect:\n", test_data[k]);
           fprintf(stderr,"\t%s returned\n", output);
           fprintf(stderr,"\t%s is correct\n", test_results[k]);
@@ -72,7 +72,7 @@ main (void)
   bin_to_hex(digest, output);
   if (strcmp(output, test_results[2]))
     {
-      fprintf(stdout, "FAIL\n");
+      fprintf(stdout, "FAIL (%s)\n", impl);
       fprintf(stderr,"* hash of \"%s\" incorrect:\n", test_data[2]);
       fprintf(stderr,"\t%s returned\n", output);
       fprintf(stderr,"\t%s is correct\n", test_results[2]);
@@ -89,7 +89,7 @@ main (void)
   bin_to_hex(digest, output);
   if (strcmp(output, test_results[2]))
     {
-      fprintf(stdout, "FAIL\n");
+      fprintf(stdout, "FAIL (%s)\n", impl);
       fprintf(stderr,"* hash of \"%s\" incorrect:\n", test_data[2]);
       fprintf(stderr,"\t%s returned\n", output);
       fprintf(stderr,"\t%s is correct\n", test_results[2]);
@@ -100,6 +100,32 @@ main (void)
   return retval;
 }
 
+int
+main (void)
+{
+  /* Test the SHA-1 instructions if the CPU has them, and then the
+     portable code.  */
+  static const struct
+  {
+    uint32_t features;
+    const char *impl;
+  } variants[] =
+  {
+    { UINT32_MAX, "default" },
+    { 0, "portable" },
+  };
+  int result = 0;
+  size_t i;
+
+  for (i = 0; i < ARRAY_SIZE (variants); i++)
+    {
+      restrict_cpu_features (variants[i].features);
+      result |= test_sha1 (variants[i].impl);
+    }
+
+  return result;
+}
+
 #else
 
 int
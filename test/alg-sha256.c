@@ -60,11 +60,11 @@ static const struct
 
 
 static void
-report_failure(int n, const char *tag,
+report_failure(int n, const char *impl, const char *tag,
                const char expected[32], uint8_t actual[32])
 {
   int i;
-  printf ("FAIL: test %d (%s):\n  exp:", n, tag);
+  printf ("FAIL: test %d (%s, %s):\n  exp:", n, impl, tag);
   for (i = 0; i < 32; i++)
     {
       if (i % 4 == 0)
@@ -82,8 +82,8 @@ report_failure(int n, const char *tag,
   putchar ('\n');
 }
 
-int
-main (void)
+static int
+test_sha256 (const char *impl)
 {
   SHA256_CTX ctx;
   uint8_t sum[32];
@@ -96,7 +96,7 @@ main (void)
       SHA256_Buf (tests[cnt].input, strlen (tests[cnt].input), sum);
       if (memcmp (tests[cnt].result, sum, 32) != 0)
         {
-          report_failure (cnt, "all at once", tests[cnt].result, sum);
+          report_failure (cnt, impl, "all at once", tests[cnt].result, sum);
           result = 1;
         }
 
@@ -106,7 +106,7 @@ main (void)
       SHA256_Final (sum, &ctx);
       if (memcmp (tests[cnt].result, sum, 32) != 0)
         {
-          report_failure (cnt, "byte by byte", tests[cnt].result, sum);
+          report_failure (cnt, impl, "byte by byte", tests[cnt].result, sum);
           result = 1;
         }
     }
@@ -123,13 +123,39 @@ main (void)
     "\xf1\x80\x9a\x48\xa4\x97\x20\x0e\x04\x6d\x39\xcc\xc7\x11\x2c\xd0";
   if (memcmp (expected, sum, 32) != 0)
     {
-      report_failure (cnt, "block by block", expected, sum);
+      report_failure (cnt, impl, "block by block", expected, sum);
       result = 1;
     }
 
   return result;
 }
 
+int
+main (void)
+{
+  /* Test the SHA-256 instructions if the CPU has them, and then the
+     portable code.  */
+  static const struct
+  {
+    uint32_t features;
+    const char *impl;
+  } variants[] =
+  {
+    { UINT32_MAX, "default" },
+    { 0, "portable" },
+  };
+  int result = 0;
+  size_t i;
+
+  for (i = 0; i < ARRAY_SIZE (variants); i++)
+    {
+      restrict_cpu_features (variants[i].features);
+      result |= test_sha256 (variants[i].impl);
+    }
+
+  return result;
+}
+
 #else
 
 int
@@ -2,6 +2,7 @@
 #include "alg-sha512.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 
 #if INCLUDE_sha512crypt
 
@@ -81,6 +82,12 @@ static const struct
   }
 };
 
+/* Test vector from FIPS 180-2: appendix C.3 (one million 'a').  */
+static const char million_a_result[64 + 1] =
+  "\xe7\x18\x48\x3d\x0c\xe7\x69\x64\x4e\x2e\x42\xc7\xbc\x15\xb4\x63"
+  "\x8e\x1f\x98\xb1\x3b\x20\x44\x28\x56\x32\xa8\x03\xaf\xa9\x73\xeb"
+  "\xde\x0f\xf2\x44\x87\x7e\xa6\x0a\x4c\xb0\x43\x2c\xe5\x77\xc3\x1b"
+  "\xeb\x00\x9c\x5c\x2c\x49\xaa\x2e\x4e\xad\xb2\x17\xad\x8c\xc0\x9b";
 
 static void
 report_failure(int n, const char *tag,
@@ -109,6 +116,83 @@ report_failure(int n, const char *tag,
   putchar ('\n');
 }
 
+/* Hash all of the test vectors, plus messages of every length up to
+   three blocks, with SHA512_MB_Buf, so that lanes run out of input
+   at different blocks.  TAG identifies the implementation in use.  */
+static int
+test_multi_buffer (const char *tag)
+{
+  enum { NVEC = ARRAY_SIZE (tests), NLEN = 3 * 128 + 1 };
+  static uint8_t msg[NLEN];
+  static uint8_t sums[NVEC + NLEN][64];
+  const void *in[NVEC + NLEN];
+  size_t len[NVEC + NLEN];
+  unsigned char *digest[NVEC + NLEN];
+  uint8_t sum[64];
+  int result = 0;
+  size_t i;
+
+  for (i = 0; i < NLEN; i++)
+    msg[i] = (uint8_t) (i * 131 + 7);
+
+  for (i = 0; i < NVEC; i++)
+    {
+      in[i] = tests[i].input;
+      len[i] = strlen (tests[i].input);
+      digest[i] = sums[i];
+    }
+  for (i = 0; i < NLEN; i++)
+    {
+      in[NVEC + i] = msg;
+      len[NVEC + i] = i;
+      digest[NVEC + i] = sums[NVEC + i];
+    }
+
+  SHA512_MB_Buf (in, len, digest, NVEC + NLEN);
+
+  for (i = 0; i < NVEC; i++)
+    if (memcmp (tests[i].result, sums[i], 64) != 0)
+      {
+        report_failure ((int) i, tag, tests[i].result, sums[i]);
+        result = 1;
+      }
+  for (i = 0; i < NLEN; i++)
+    {
+      SHA512_Buf (msg, i, sum);
+      if (memcmp (sum, sums[NVEC + i], 64) != 0)
+        {
+          report_failure ((int) (NVEC + i), tag, (const char *) sum,
+                          sums[NVEC + i]);
+          result = 1;
+        }
+    }
+
+  /* A single long message together with short ones.  */
+  uint8_t *big = malloc (1000000);
+  if (!big)
+    {
+      perror ("malloc");
+      return 1;
+    }
+  memset (big, 'a', 1000000);
+  in[0] = big;
+  len[0] = 1000000;
+  SHA512_MB_Buf (in, len, digest, 3);
+  free (big);
+  if (memcmp (million_a_result, sums[0], 64) != 0)
+    {
+      report_failure (0, tag, million_a_result, sums[0]);
+      result = 1;
+    }
+  if (memcmp (tests[2].result, sums[2], 64) != 0)
+    {
+      report_failure (2, tag, tests[2].result, sums[2]);
+      result = 1;
+    }
+
+  return result;
+}
+
 int
 main (void)
 {
@@ -138,24 +222,40 @@ main (void)
         }
     }
 
-  /* Test vector from FIPS 180-2: appendix C.3.  */
   char buf[1000];
   memset (buf, 'a', sizeof (buf));
   SHA512_Init (&ctx);
   for (i = 0; i < 1000; ++i)
     SHA512_Update (&ctx, buf, sizeof (buf));
   SHA512_Final (sum, &ctx);
-  static const char expected[64 + 1] =
-    "\xe7\x18\x48\x3d\x0c\xe7\x69\x64\x4e\x2e\x42\xc7\xbc\x15\xb4\x63"
-    "\x8e\x1f\x98\xb1\x3b\x20\x44\x28\x56\x32\xa8\x03\xaf\xa9\x73\xeb"
-    "\xde\x0f\xf2\x44\x87\x7e\xa6\x0a\x4c\xb0\x43\x2c\xe5\x77\xc3\x1b"
-    "\xeb\x00\x9c\x5c\x2c\x49\xaa\x2e\x4e\xad\xb2\x17\xad\x8c\xc0\x9b";
-  if (memcmp (expected, sum, 64) != 0)
+  if (memcmp (million_a_result, sum, 64) != 0)
     {
-      report_failure (cnt, "block by block", expected, sum);
+      report_failure (cnt, "block by block", million_a_result, sum);
       result = 1;
     }
 
+  /* Exercise each multi-buffer implementation this CPU supports,
+     widest first, down to the one-by-one fallback.  */
+  static const struct
+  {
+    uint32_t features;
+    const char *tag;
+  } mb_variants[] =
+  {
+    { UINT32_MAX, "multi-buffer" },
+    { (uint32_t) ~CPU_FEATURE_AVX512F, "multi-buffer, no AVX-512" },
+    { 0, "multi-buffer, no SIMD" },
+  };
+  size_t last_lanes = 0;
+  for (i = 0; i < (int) ARRAY_SIZE (mb_variants); i++)
+    {
+      restrict_cpu_features (mb_variants[i].features);
+      if (SHA512_MB_Lanes () == last_lanes)
+        continue;
+      last_lanes = SHA512_MB_Lanes ();
+      result |= test_multi_buffer (mb_variants[i].tag);
+    }
+
   return result;
 }
 
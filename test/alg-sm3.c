@@ -31,6 +31,7 @@
 #include "alg-sm3.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 
 #if INCLUDE_sm3crypt
 
@@ -108,6 +109,116 @@ report_failure(int n, const char *tag,
   putchar ('\n');
 }
 
+/* Test vector from FIPS 180-2: appendix B.3.  */
+static const char million_a_result[33] =
+  "\xc8\xaa\xf8\x94\x29\x55\x40\x29\xe2\x31\x94\x1a\x2a\xcc\x0a\xd6"
+  "\x1f\xf2\xa5\xac\xd8\xfa\xdd\x25\x84\x7a\x3a\x73\x2b\x3b\x02\xc3";
+
+/* Hash all of the test vectors, plus messages of every length up to
+   three blocks, with sm3_mb_hash, so that lanes run out of input at
+   different blocks.  The messages are split into pieces at different
+   places, and some pieces are empty.  TAG identifies the
+   implementation in use.  */
+static int
+test_multi_buffer (const char *tag)
+{
+  enum { NVEC = ARRAY_SIZE (tests), NLEN = 3 * 64 + 1 };
+  static uint8_t msg[NLEN];
+  static uint8_t sums[NVEC + NLEN][32];
+  sm3_mb_msg in[NVEC + NLEN];
+  uint8_t *digest[NVEC + NLEN];
+  uint8_t sum[32];
+  int result = 0;
+  size_t i;
+
+  for (i = 0; i < NLEN; i++)
+    msg[i] = (uint8_t) (i * 131 + 7);
+
+  memset (in, 0, sizeof in);
+  for (i = 0; i < NVEC; i++)
+    {
+      in[i].data[0] = tests[i].input;
+      in[i].size[0] = strlen (tests[i].input);
+      digest[i] = sums[i];
+    }
+  for (i = 0; i < NLEN; i++)
+    {
+      size_t cut1 = i / 3, cut2 = i - i / 5;
+      in[NVEC + i].data[0] = msg;
+      in[NVEC + i].size[0] = cut1;
+      in[NVEC + i].data[1] = msg + cut1;
+      in[NVEC + i].size[1] = 0;
+      in[NVEC + i].data[2] = msg + cut1;
+      in[NVEC + i].size[2] = cut2 - cut1;
+      in[NVEC + i].data[3] = msg + cut2;
+      in[NVEC + i].size[3] = i - cut2;
+      digest[NVEC + i] = sums[NVEC + i];
+    }
+
+  sm3_mb_hash (in, digest, NVEC + NLEN);
+
+  for (i = 0; i < NVEC; i++)
+    if (memcmp (tests[i].result, sums[i], 32) != 0)
+      {
+        report_failure ((int) i, tag, tests[i].result, sums[i]);
+        result = 1;
+      }
+  for (i = 0; i < NLEN; i++)
+    {
+      sm3_buf (msg, i, sum);
+      if (memcmp (sum, sums[NVEC + i], 32) != 0)
+        {
+          report_failure ((int) (NVEC + i), tag, (const char *) sum,
+                          sums[NVEC + i]);
+          result = 1;
+        }
+    }
+
+  /* A single long message together with short ones.  */
+  uint8_t *big = malloc (1000000);
+  if (!big)
+    {
+      perror ("malloc");
+      return 1;
+    }
+  memset (big, 'a', 1000000);
+  memset (&in[0], 0, sizeof in[0]);
+  in[0].data[0] = big;
+  in[0].size[0] = 1000000;
+  sm3_mb_hash (in, digest, 3);
+  free (big);
+  if (memcmp (million_a_result, sums[0], 32) != 0)
+    {
+      report_failure (0, tag, million_a_result, sums[0]);
+      result = 1;
+    }
+  if (memcmp (tests[2].result, sums[2], 32) != 0)
+    {
+      report_failure (2, tag, tests[2].result, sums[2]);
+      result = 1;
+    }
+
+  /* A digest may overwrite the message it is the hash of.  */
+  for (i = 0; i < NVEC; i++)
+    {
+      memset (&in[i], 0, sizeof in[i]);
+      memcpy (sums[i], tests[i].result, 32);
+      in[i].data[1] = sums[i];
+      in[i].size[1] = 32;
+    }
+  sm3_mb_hash (in, digest, NVEC);
+  for (i = 0; i < NVEC; i++)
+    {
+      sm3_buf (tests[i].result, 32, sum);
+      if (memcmp (sum, sums[i], 32) != 0)
+        {
+          report_failure ((int) i, tag, (const char *) sum, sums[i]);
+          result = 1;
+        }
+    }
+  return result;
+}
+
 int
 main (void)
 {
@@ -137,23 +248,41 @@ main (void)
         }
     }
 
-  /* Test vector from FIPS 180-2: appendix B.3.  */
   char buf[1000];
   memset (buf, 'a', sizeof (buf));
   sm3_init (&ctx);
   for (i = 0; i < 1000; ++i)
     sm3_update (&ctx, buf, sizeof (buf));
   sm3_final (sum, &ctx);
-  static const char expected[33] =
-    "\xc8\xaa\xf8\x94\x29\x55\x40\x29\xe2\x31\x94\x1a\x2a\xcc\x0a\xd6"
-    "\x1f\xf2\xa5\xac\xd8\xfa\xdd\x25\x84\x7a\x3a\x73\x2b\x3b\x02\xc3";
-
-  if (memcmp (expected, sum, 32) != 0)
+  if (memcmp (million_a_result, sum, 32) != 0)
     {
-      report_failure (cnt, "block by block", expected, sum);
+      report_failure (cnt, "block by block", million_a_result, sum);
       result = 1;
     }
 
+  /* Exercise each multi-buffer implementation this CPU supports,
+     widest first, down to the one-by-one fallback.  */
+  static const struct
+  {
+    uint32_t features;
+    const char *tag;
+  } mb_variants[] =
+  {
+    { UINT32_MAX, "multi-buffer" },
+    { (uint32_t) ~CPU_FEATURE_AVX512F, "multi-buffer, no AVX-512" },
+    { (uint32_t) ~(CPU_FEATURE_AVX512F | CPU_FEATURE_AVX2),
+      "multi-buffer, no AVX" },
+  };
+  size_t last_lanes = 0;
+  for (i = 0; i < (int) ARRAY_SIZE (mb_variants); i++)
+    {
+      restrict_cpu_features (mb_variants[i].features);
+      if (sm3_mb_lanes () == last_lanes)
+        continue;
+      last_lanes = sm3_mb_lanes ();
+      result |= test_multi_buffer (mb_variants[i].tag);
+    }
+
   return result;
 }
 
@@ -0,0 +1,155 @@
+/* Test the different ways yescrypt allocates its memory: that each
+   region is counted under exactly one of them, that regions meant for
+   transparent huge pages are aligned for them, that regions from the
+   huge page pool don't overlap and are reused, and that none of this
+   changes the hashes.
+
+   To the extent possible under law, the author(s) have waived all
+   copyright and related or neighboring rights to this work.
+
+   See https://creativecommons.org/publicdomain/zero/1.0/ for further
+   details.  */
+
+#include "crypt-port.h"
+
+#if INCLUDE_yescrypt || INCLUDE_scrypt || INCLUDE_gost_yescrypt || \
+    INCLUDE_sm3_yescrypt
+
+#include "alg-yescrypt.h"
+
+#include <stdio.h>
+
+#define HUGEPAGE_ALIGN (2 * 1024 * 1024)
+
+static unsigned long
+total (const yescrypt_region_stats_t *s)
+{
+  return s->pool + s->hugetlb + s->thp + s->small;
+}
+
+/* Hash with a fresh LOCAL, which is left allocated, and check that
+   exactly one region was counted for it.  Return the counters from
+   before the hash in BEFORE and after it in AFTER.  */
+static int
+hash_fresh (const char *tag, yescrypt_local_t *local, uint64_t N, uint32_t r,
+            uint8_t dk[32],
+            yescrypt_region_stats_t *before, yescrypt_region_stats_t *after)
+{
+  yescrypt_params_t params = { YESCRYPT_DEFAULTS, N, r, 1, 0, 0, 0 };
+
+  if (yescrypt_init_local (local))
+    {
+      printf ("ERROR: %s: yescrypt_init_local failed\n", tag);
+      return 1;
+    }
+  yescrypt_get_region_stats (before);
+  if (yescrypt_kdf (NULL, local, (const uint8_t *) "password", 8,
+                    (const uint8_t *) "salt", 4, &params, dk, 32))
+    {
+      printf ("FAIL: %s: yescrypt_kdf failed\n", tag);
+      return 1;
+    }
+  yescrypt_get_region_stats (after);
+  if (total (after) != total (before) + 1)
+    {
+      printf ("FAIL: %s: %lu regions counted, expected 1\n",
+              tag, total (after) - total (before));
+      return 1;
+    }
+  return 0;
+}
+
+/* Check that a large region counted in AFTER but not BEFORE has the
+   properties of the way it was allocated.  */
+static int
+check_large (const char *tag, const yescrypt_local_t *local,
+             const yescrypt_region_stats_t *before,
+             const yescrypt_region_stats_t *after)
+{
+  int pooled = yescrypt_region_pooled (local);
+
+  if (pooled != (after->pool != before->pool))
+    {
+      printf ("FAIL: %s: region %s from the pool but counted %s\n", tag,
+              pooled ? "is" : "is not",
+              after->pool != before->pool ? "as pooled" : "otherwise");
+      return 1;
+    }
+  if (after->thp != before->thp
+      && (uintptr_t) local->aligned % HUGEPAGE_ALIGN != 0)
+    {
+      printf ("FAIL: %s: transparent huge page region at %p is not"
+              " aligned\n", tag, local->aligned);
+      return 1;
+    }
+  return 0;
+}
+
+int
+main (void)
+{
+  yescrypt_region_stats_t s0, s1, s2;
+  yescrypt_local_t small, large1, large2;
+  uint8_t dk_small[32], dk1[32], dk2[32], dk3[32];
+  int result = 0;
+
+  /* 16 KiB or so: always ordinary pages.  */
+  if (hash_fresh ("small", &small, 16, 8, dk_small, &s0, &s1))
+    return 1;
+  if (s1.small != s0.small + 1)
+    {
+      printf ("FAIL: small region not counted as ordinary pages\n");
+      result = 1;
+    }
+  yescrypt_free_local (&small);
+
+  /* A little over 4 MiB: eligible for the pool and for transparent
+     huge pages, but not for huge pages mapped per region.  Two at once,
+     so that both can't be the same pages of the pool.  */
+  if (hash_fresh ("large 1", &large1, 4096, 8, dk1, &s0, &s1))
+    return 1;
+  result |= check_large ("large 1", &large1, &s0, &s1);
+  if (hash_fresh ("large 2", &large2, 4096, 8, dk2, &s1, &s2))
+    return 1;
+  result |= check_large ("large 2", &large2, &s1, &s2);
+
+  const uint8_t *a1 = large1.base, *a2 = large2.base;
+  if (a1 < a2 + large2.base_size && a2 < a1 + large1.base_size)
+    {
+      printf ("FAIL: two live regions overlap\n");
+      result = 1;
+    }
+  if (memcmp (dk1, dk2, sizeof dk1))
+    {
+      printf ("FAIL: same hash came out different in two regions\n");
+      result = 1;
+    }
+  yescrypt_free_local (&large2);
+  yescrypt_free_local (&large1);
+
+  /* Pages given back to the pool are erased and reused.  */
+  if (hash_fresh ("large 3", &large1, 4096, 8, dk3, &s0, &s1))
+    return 1;
+  result |= check_large ("large 3", &large1, &s0, &s1);
+  if (memcmp (dk1, dk3, sizeof dk1))
+    {
+      printf ("FAIL: same hash came out different in a reused region\n");
+      result = 1;
+    }
+  yescrypt_free_local (&large1);
+
+  yescrypt_get_region_stats (&s0);
+  printf ("regions: %lu pool, %lu hugetlb, %lu thp, %lu small\n",
+          s0.pool, s0.hugetlb, s0.thp, s0.small);
+  return result;
+}
+
+#else
+
+int
+main (void)
+{
+  return 77; /* UNSUPPORTED */
+}
+
+#endif
@@ -0,0 +1,92 @@
+/* Test that every implementation of the yescrypt kernels that this CPU
+   can run computes the same hashes: scrypt and YESCRYPT_WORM, which
+   use the AVX and AVX-512VL kernels when the CPU has them, and
+   YESCRYPT_RW, which uses XOP or the baseline code, compiled for a
+   fixed r when r is 8 or 32.
+
+   To the extent possible under law, the author(s) have waived all
+   copyright and related or neighboring rights to this work.
+
+   See https://creativecommons.org/publicdomain/zero/1.0/ for further
+   details.  */
+
+#include "crypt-port.h"
+
+#if INCLUDE_yescrypt || INCLUDE_scrypt || INCLUDE_gost_yescrypt || \
+    INCLUDE_sm3_yescrypt
+
+#include "alg-yescrypt.h"
+
+#include <stdio.h>
+
+struct testcase
+{
+  const char *phrase;
+  const char *expected;
+};
+
+static const struct testcase testcases[] =
+{
+  { "", "$y$j75$LdJMENpBABJJ3hIHjB1Bi.$tUlUF19mIl6XpRTpX7LBp5ABKS8KSmDfP1gXFrZ6Sy8" },
+  { "pleaseletmein", "$y$j95..$n34PoBLMgFrQVl4Rn34Po/$7T69RVM9pldc.ZcYkzhcM3L259hBGZNmEFed61GEnM7" },
+  /* r = 32, another r that has no copy of its own, and r = 8, all
+     computed with the generic baseline code.  */
+  { "pleaseletmein", "$y$j7T$n34PoBLMgFrQVl4Rn34Po/$6km1gBvtJFdeo33HTvDMbIUH84d0q9IPL.Fs93tBGw." },
+  { "pleaseletmein", "$y$j7D$n34PoBLMgFrQVl4Rn34Po/$125CnADrx0q.IEbQt4IomX8SK5cAbi/obo2cO1rb9QD" },
+  { "pleaseletmein", "$y$j85$n34PoBLMgFrQVl4Rn34Po/$VScRZlPV36wxewHYxMyfRoirwhd0tC8JdwSmiEevgW8" },
+  /* YESCRYPT_WORM, p = 4.  */
+  { "pleaseletmein", "$y$/75.0$n34PoBLMgFrQVl4Rn34Po/$grJ66yVd3NCNBk6DRz6l42zYvm8/lnr/G2DmegKtr07" },
+  /* Classic scrypt.  */
+  { "", "$7$66..../....SodiumChloride$SpJsFY2pIFcsdECgiLhE7VnInSJAT3kTfdlS6S6xFq9" },
+  { "a", "$7$66..../....unUNunUNunUNun$PFYi7kkAbbFJJo4LO7XenXepvOo0cAH0lqQyEusOru1" },
+  { "password", "$7$86....E....NaCl$xffjQo7Bm/.SKRS4B2EuynbOLjAmXU5AbDbRXhoBl64" },
+};
+
+int
+main (void)
+{
+  /* From the fastest kernels down to the baseline ones.  */
+  static const struct
+  {
+    uint32_t features;
+    const char *impl;
+  } variants[] =
+  {
+    { UINT32_MAX, "default" },
+    { ~CPU_FEATURE_XOP, "no XOP" },
+    { ~(CPU_FEATURE_XOP | CPU_FEATURE_AVX512VL), "no XOP or AVX-512VL" },
+    { 0, "baseline" },
+  };
+  int result = 0;
+  size_t i, j;
+
+  for (i = 0; i < ARRAY_SIZE (variants); i++)
+    {
+      restrict_cpu_features (variants[i].features);
+      for (j = 0; j < ARRAY_SIZE (testcases); j++)
+        {
+          const struct testcase *t = &testcases[j];
+          const char *hash = (const char *)
+            yescrypt ((const uint8_t *) t->phrase,
+                      (const uint8_t *) t->expected);
+          if (!hash || strcmp (hash, t->expected))
+            {
+              printf ("FAIL: %s: \"%s\", %s\n  got: %s\n", variants[i].impl,
+                      t->phrase, t->expected, hash ? hash : "(null)");
+              result = 1;
+            }
+        }
+    }
+
+  return result;
+}
+
+#else
+
+int
+main (void)
+{
+  return 77; /* UNSUPPORTED */
+}
+
+#endif
@@ -0,0 +1,188 @@
+/* Shared code for the tests of the multi-buffer batch entry points:
+   each test lists the methods it covers and calls run_batch_tests,
+   which checks that every batch entry point computes the same hashes
+   as the method's crypt function, with every SIMD implementation the
+   CPU supports and with none at all.
+
+   Define BATCH_MAX_LANES to the number of lanes of the widest
+   implementation before including this file, after crypt-port.h.
+
+   To the extent possible under law, the author(s) have waived all
+   copyright and related or neighboring rights to this work.
+
+   See https://creativecommons.org/publicdomain/zero/1.0/ for further
+   details.  */
+
+#ifndef _CRYPT_TEST_BATCH_COMMON_H
+#define _CRYPT_TEST_BATCH_COMMON_H 1
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef void (*batch_fn) (struct crypt_batch_item *items, size_t nitems,
+                          void *scratch, size_t scr_size);
+typedef void (*crypt_fn) (const char *phrase, size_t phr_size,
+                          const char *setting, size_t set_size,
+                          uint8_t *output, size_t out_size,
+                          void *scratch, size_t scr_size);
+
+struct batch_method
+{
+  const char *name;
+  batch_fn batch;
+  crypt_fn crypt;
+  const char *const *settings;
+  size_t nsettings;
+};
+
+/* Enough items to fill the lanes of the widest implementation twice,
+   with one left over.  */
+#define BATCH_NITEMS (2 * BATCH_MAX_LANES + 1)
+
+static uint8_t scratch[ALG_BATCH_SPECIFIC_SIZE];
+static uint8_t scalar_scratch[ALG_SPECIFIC_SIZE];
+static struct crypt_batch_item items[BATCH_NITEMS];
+static char phrases[BATCH_NITEMS][CRYPT_MAX_PASSPHRASE_SIZE];
+static char outputs[BATCH_NITEMS][CRYPT_OUTPUT_SIZE];
+
+static int
+compare_settings (const void *a, const void *b)
+{
+  const struct crypt_batch_item *ia = a;
+  const struct crypt_batch_item *ib = b;
+  return strcmp (ia->setting, ib->setting);
+}
+
+static int
+test_batch (const struct batch_method *m, const char *tag, size_t nitems)
+{
+  char expected[CRYPT_OUTPUT_SIZE];
+  int result = 0;
+  size_t i, j;
+
+  for (i = 0; i < nitems; i++)
+    {
+      /* Phrase lengths crossing the block sizes of all the hashes and
+         the points where the padding needs a block of its own, plus
+         the longest allowed.  */
+      size_t len = (i * 37) % 300;
+      if (i == nitems - 1)
+        len = CRYPT_MAX_PASSPHRASE_SIZE - 1;
+      for (j = 0; j < len; j++)
+        phrases[i][j] = (char) ('!' + (i + j) % 90);
+      phrases[i][len] = '\0';
+
+      items[i].phrase = phrases[i];
+      items[i].phr_size = len;
+      items[i].setting = m->settings[i % m->nsettings];
+      items[i].set_size = strlen (items[i].setting);
+      items[i].output = (uint8_t *) outputs[i];
+      items[i].out_size = sizeof outputs[i];
+      make_failure_token (items[i].setting, outputs[i],
+                          (int) sizeof outputs[i]);
+    }
+
+  /* As crypt_batch_rn does.  */
+  qsort (items, nitems, sizeof items[0], compare_settings);
+
+  m->batch (items, nitems, scratch, sizeof scratch);
+
+  for (i = 0; i < nitems; i++)
+    {
+      make_failure_token (items[i].setting, expected, (int) sizeof expected);
+      m->crypt (items[i].phrase, items[i].phr_size,
+                items[i].setting, items[i].set_size,
+                (uint8_t *) expected, sizeof expected,
+                scalar_scratch, sizeof scalar_scratch);
+      if (strcmp (expected, (const char *) items[i].output))
+        {
+          printf ("FAIL: %s: %s: item %zu/%zu (phrase length %zu, %s):\n"
+                  "  exp: %s\n  got: %s\n",
+                  m->name, tag, i, nitems, items[i].phr_size,
+                  items[i].setting, expected, items[i].output);
+          result = 1;
+        }
+    }
+  return result;
+}
+
+/* A batch whose scratch area is too small must not produce any
+   output.  */
+static int
+test_short_scratch (const struct batch_method *m)
+{
+  struct crypt_batch_item item;
+  char output[CRYPT_OUTPUT_SIZE];
+
+  item.phrase = "";
+  item.phr_size = 0;
+  item.setting = m->settings[0];
+  item.set_size = strlen (item.setting);
+  item.output = (uint8_t *) output;
+  item.out_size = sizeof output;
+  make_failure_token (item.setting, output, (int) sizeof output);
+  errno = 0;
+  m->batch (&item, 1, scratch, 16);
+  if (errno != ERANGE || output[0] != '*')
+    {
+      printf ("FAIL: %s: short scratch: errno %d, output %s\n",
+              m->name, errno, output);
+      return 1;
+    }
+  return 0;
+}
+
+/* Run the tests for each of the NMETHODS METHODS, whose batch entry
+   points process up to LANES() items at a time.  */
+static int
+run_batch_tests (const struct batch_method *methods, size_t nmethods,
+                 size_t (*lanes) (void))
+{
+  static const struct
+  {
+    uint32_t features;
+    const char *tag;
+  } variants[] =
+  {
+    { UINT32_MAX, "default" },
+    { (uint32_t) ~CPU_FEATURE_AVX512F, "no AVX-512" },
+    { (uint32_t) ~(CPU_FEATURE_AVX512F | CPU_FEATURE_AVX2), "no AVX" },
+    { 0, "no SIMD" },
+  };
+  static const size_t sizes[] =
+  {
+    1, BATCH_MAX_LANES / 2 + 1, BATCH_MAX_LANES + 1, BATCH_NITEMS
+  };
+  size_t last_lanes = 0;
+  int result = 0;
+  size_t i, j, k;
+
+  for (i = 0; i < ARRAY_SIZE (variants); i++)
+    {
+      restrict_cpu_features (variants[i].features);
+      if (lanes () == last_lanes)
+        continue;
+      last_lanes = lanes ();
+      for (j = 0; j < nmethods; j++)
+        for (k = 0; k < ARRAY_SIZE (sizes); k++)
+          result |= test_batch (&methods[j], variants[i].tag, sizes[k]);
+    }
+
+  /* With no features at all, the batch entry points must fall back
+     to hashing one item at a time, or that code goes untested.  */
+  if (last_lanes != 1)
+    {
+      printf ("FAIL: no SIMD: still %zu lanes\n", last_lanes);
+      result = 1;
+    }
+
+  restrict_cpu_features (UINT32_MAX);
+  if (lanes () > 1)
+    for (j = 0; j < nmethods; j++)
+      result |= test_short_scratch (&methods[j]);
+
+  return result;
+}
+
+#endif /* batch-common.h */
@@ -0,0 +1,155 @@
+/* Measure how long it takes to recognize the hashing method of a
+   setting string, for every enabled method, by timing crypt_checksalt,
+   which does little else.  Not run by `make check'; see
+   `make bench-dispatch'.
+
+   Usage: bench-dispatch [-n CALLS]
+
+   To the extent possible under law, the author(s) have waived all
+   copyright and related or neighboring rights to this work.
+
+   See https://creativecommons.org/publicdomain/zero/1.0/ for further
+   details.  */
+
+#include "crypt-port.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Each measurement is repeated this many times, and the fastest
+   kept.  */
+#define REPEATS 5
+
+struct method
+{
+  const char *name;
+  const char *setting;
+};
+
+static const struct method methods[] =
+{
+#if INCLUDE_yescrypt
+  { "yescrypt", "$y$j9T$MJHnaAkegEVYHsFKkmfzJ1" },
+#endif
+#if INCLUDE_gost_yescrypt
+  { "gost_yescrypt", "$gy$j9T$MJHnaAkegEVYHsFKkmfzJ1" },
+#endif
+#if INCLUDE_sm3_yescrypt
+  { "sm3_yescrypt", "$sm3y$j9T$MJHnaAkegEVYHsFKkmfzJ1" },
+#endif
+#if INCLUDE_scrypt
+  { "scrypt", "$7$CU..../....MJHnaAkegEVYHsFKkmfzJ1" },
+#endif
+#if INCLUDE_bcrypt
+  { "bcrypt", "$2b$05$UBVLHeMpJ/QQCv3XqJx8zO" },
+#endif
+#if INCLUDE_bcrypt_y
+  { "bcrypt_y", "$2y$05$UBVLHeMpJ/QQCv3XqJx8zO" },
+#endif
+#if INCLUDE_bcrypt_a
+  { "bcrypt_a", "$2a$05$UBVLHeMpJ/QQCv3XqJx8zO" },
+#endif
+#if INCLUDE_bcrypt_x
+  { "bcrypt_x", "$2x$05$UBVLHeMpJ/QQCv3XqJx8zO" },
+#endif
+#if INCLUDE_sha512crypt
+  { "sha512crypt", "$6$MJHnaAkegEVYHsFK" },
+#endif
+#if INCLUDE_sha256crypt
+  { "sha256crypt", "$5$MJHnaAkegEVYHsFK" },
+#endif
+#if INCLUDE_sm3crypt
+  { "sm3crypt", "$sm3$MJHnaAkegEVYHsFK" },
+#endif
+#if INCLUDE_sha1crypt
+  { "sha1crypt", "$sha1$248488$ggu.H673kaZ5$" },
+#endif
+#if INCLUDE_sunmd5
+  { "sunmd5", "$md5$BPm.fm03$" },
+#endif
+#if INCLUDE_md5crypt
+  { "md5crypt", "$1$MJHnaAke" },
+#endif
+#if INCLUDE_bsdicrypt
+  { "bsdicrypt", "_J9..MJHn" },
+#endif
+#if INCLUDE_nt
+  { "nt", "$3$" },
+#endif
+#if INCLUDE_bigcrypt
+  { "bigcrypt", "Mp............" },
+#endif
+#if INCLUDE_descrypt
+  { "descrypt", "Mp" },
+#endif
+  { "(unknown)", "$9$MJHnaAke" },
+};
+
+static double
+now (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (double) ts.tv_sec + (double) ts.tv_nsec * 1e-9;
+}
+
+/* Nanoseconds per call of crypt_checksalt (SETTING), the fastest of
+   REPEATS runs of NCALLS calls.  */
+static double
+measure (const char *setting, unsigned long ncalls)
+{
+  /* Stops the compiler from hoisting the call out of the loop.  */
+  const char *volatile vsetting = setting;
+  volatile int sink = 0;
+  double best = 0;
+  unsigned long i;
+  int r;
+
+  for (r = 0; r < REPEATS; r++)
+    {
+      double start = now ();
+      for (i = 0; i < ncalls; i++)
+        sink += crypt_checksalt (vsetting);
+      double elapsed = (now () - start) * 1e9 / (double) ncalls;
+      if (r == 0 || elapsed < best)
+        best = elapsed;
+    }
+  (void) sink;
+  return best;
+}
+
+int
+main (int argc, char **argv)
+{
+  unsigned long ncalls = 1000000;
+  double total = 0;
+  size_t i;
+  int opt;
+
+  while ((opt = getopt (argc, argv, "n:")) != -1)
+    switch (opt)
+      {
+      case 'n':
+        ncalls = strtoul (optarg, NULL, 10);
+        if (ncalls > 0)
+          break;
+        /* FALLTHROUGH */
+      default:
+        fprintf (stderr, "Usage: %s [-n CALLS]\n", argv[0]);
+        return 2;
+      }
+
+  printf ("%-14s %-38s %8s\n", "method", "setting", "ns/call");
+  for (i = 0; i < ARRAY_SIZE (methods); i++)
+    {
+      double ns = measure (methods[i].setting, ncalls);
+      total += ns;
+      printf ("%-14s %-38.38s %8.2f\n", methods[i].name,
+              methods[i].setting, ns);
+    }
+  printf ("%-14s %-38s %8.2f\n", "(mean)", "",
+          total / (double) ARRAY_SIZE (methods));
+  return 0;
+}
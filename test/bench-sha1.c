@@ -0,0 +1,149 @@
+/* Measure the SHA-1 compression function and the HMAC-SHA1 iteration
+   of sha1crypt with each implementation this CPU supports: the x86 SHA
+   extensions or the ARMv8 cryptography extensions, and the portable
+   code.  Not run by `make check'; see `make bench-sha1'.
+
+   Usage: bench-sha1 [-n CALLS]
+
+   To the extent possible under law, the author(s) have waived all
+   copyright and related or neighboring rights to this work.
+
+   See https://creativecommons.org/publicdomain/zero/1.0/ for further
+   details.  */
+
+#include "crypt-port.h"
+#include "alg-sha1.h"
+#include "alg-hmac-sha1.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#if INCLUDE_sha1crypt
+
+/* Each measurement is repeated this many times, and the fastest
+   kept.  */
+#define REPEATS 5
+
+/* The default number of iterations of sha1crypt.  */
+#define SHA1CRYPT_ITERATIONS 262144
+
+static double
+now (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (double) ts.tv_sec + (double) ts.tv_nsec * 1e-9;
+}
+
+/* Nanoseconds per call of sha1_process_block, the fastest of REPEATS
+   runs of NCALLS calls.  */
+static double
+measure_block (unsigned long ncalls)
+{
+  uint32_t state[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE,
+                        0x10325476, 0xC3D2E1F0 };
+  uint8_t block[64] = "block";
+  double best = 0;
+  unsigned long i;
+  int r;
+
+  for (r = 0; r < REPEATS; r++)
+    {
+      double start = now ();
+      for (i = 0; i < ncalls; i++)
+        sha1_process_block (state, block);
+      double elapsed = (now () - start) * 1e9 / (double) ncalls;
+      if (r == 0 || elapsed < best)
+        best = elapsed;
+    }
+  /* Stops the compiler from dropping the loop.  */
+  if (state[0] == 0 && state[1] == 0)
+    putchar (' ');
+  return best;
+}
+
+/* Nanoseconds per HMAC of a digest, as in each iteration of
+   sha1crypt, the fastest of REPEATS runs of NCALLS calls.  */
+static double
+measure_hmac (unsigned long ncalls)
+{
+  static const uint8_t key[] = "passphrase";
+  struct hmac_sha1_ctx ctx;
+  uint8_t digest[20] = "digest";
+  double best = 0;
+  unsigned long i;
+  int r;
+
+  hmac_sha1_init_ctx (&ctx, key, sizeof key - 1);
+  for (r = 0; r < REPEATS; r++)
+    {
+      double start = now ();
+      for (i = 0; i < ncalls; i++)
+        hmac_sha1_process_ctx (&ctx, digest, sizeof digest, digest);
+      double elapsed = (now () - start) * 1e9 / (double) ncalls;
+      if (r == 0 || elapsed < best)
+        best = elapsed;
+    }
+  if (digest[0] == 0 && digest[1] == 0)
+    putchar (' ');
+  return best;
+}
+
+int
+main (int argc, char **argv)
+{
+  static const struct
+  {
+    uint32_t features;
+    uint32_t needs;
+    const char *impl;
+  } variants[] =
+  {
+    { UINT32_MAX, CPU_FEATURE_SHA, "x86 SHA" },
+    { UINT32_MAX, CPU_FEATURE_ARM_SHA1, "ARMv8 SHA1" },
+    { 0, 0, "portable" },
+  };
+  unsigned long ncalls = 1000000;
+  size_t i;
+  int opt;
+
+  while ((opt = getopt (argc, argv, "n:")) != -1)
+    switch (opt)
+      {
+      case 'n':
+        ncalls = strtoul (optarg, NULL, 10);
+        if (ncalls > 0)
+          break;
+        /* FALLTHROUGH */
+      default:
+        fprintf (stderr, "Usage: %s [-n CALLS]\n", argv[0]);
+        return 2;
+      }
+
+  printf ("%-12s %10s %10s %12s\n", "impl", "ns/block", "ns/iter",
+          "ms/sha1crypt");
+  for (i = 0; i < ARRAY_SIZE (variants); i++)
+    {
+      if (variants[i].needs && !(get_cpu_features () & variants[i].needs))
+        continue;
+      restrict_cpu_features (variants[i].features);
+      double block = measure_block (ncalls);
+      double iter = measure_hmac (ncalls);
+      printf ("%-12s %10.2f %10.2f %12.2f\n", variants[i].impl, block, iter,
+              iter * SHA1CRYPT_ITERATIONS * 1e-6);
+    }
+  return 0;
+}
+
+#else
+
+int
+main (void)
+{
+  fputs ("sha1crypt is not enabled\n", stderr);
+  return 77; /* UNSUPPORTED */
+}
+
+#endif
@@ -0,0 +1,463 @@
+/* Benchmark every enabled hashing method at a few cost settings and
+   thread counts, reporting throughput, latency percentiles, and peak
+   memory use.  Not run by `make check'; see `make bench'.
+
+   Usage: bench [-d SECONDS] [-t MAXTHREADS] [-m METHOD[,METHOD...]]
+                [-f text|json]
+
+   Each combination of method, cost, and thread count is measured in a
+   child process of its own, so that the peak RSS reported for it is
+   not inflated by whatever ran before.  With -f json, each result is
+   printed as one JSON object per line, for tracking regressions
+   between releases.
+
+   To the extent possible under law, the author(s) have waived all
+   copyright and related or neighboring rights to this work.
+
+   See https://creativecommons.org/publicdomain/zero/1.0/ for further
+   details.  */
+
+#include "crypt-port.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef HAVE_PTHREAD_CREATE
+#include <pthread.h>
+#endif
+
+/* Latencies are sampled from at most this many hashes per thread;
+   after that, later hashes overwrite earlier samples.  */
+#define MAX_SAMPLES 65536
+
+#define MAX_COSTS 3
+
+struct method
+{
+  const char *name;
+  /* Either a prefix for crypt_gensalt, with up to MAX_COSTS values of
+     its count argument (0 means the method's default) ...  */
+  const char *prefix;
+  unsigned long costs[MAX_COSTS];
+  /* ... or, for methods crypt_gensalt doesn't support, a setting.  */
+  const char *setting;
+};
+
+static const struct method methods[] =
+{
+#if INCLUDE_yescrypt
+  { "yescrypt", "$y$", { 3, 5, 7 }, 0 },
+#endif
+#if INCLUDE_gost_yescrypt
+  { "gost_yescrypt", "$gy$", { 5 }, 0 },
+#endif
+#if INCLUDE_sm3_yescrypt
+  { "sm3_yescrypt", "$sm3y$", { 5 }, 0 },
+#endif
+#if INCLUDE_scrypt
+  { "scrypt", "$7$", { 6, 7, 9 }, 0 },
+#endif
+#if INCLUDE_bcrypt
+  { "bcrypt", "$2b$", { 5, 8, 10 }, 0 },
+#endif
+#if INCLUDE_bcrypt_y
+  { "bcrypt_y", "$2y$", { 5 }, 0 },
+#endif
+#if INCLUDE_bcrypt_a
+  { "bcrypt_a", "$2a$", { 5 }, 0 },
+#endif
+#if INCLUDE_bcrypt_x
+  { "bcrypt_x", 0, { 0 }, "$2x$05$CCCCCCCCCCCCCCCCCCCCC." },
+#endif
+#if INCLUDE_sha512crypt
+  { "sha512crypt", "$6$", { 0, 50000, 500000 }, 0 },
+#endif
+#if INCLUDE_sha256crypt
+  { "sha256crypt", "$5$", { 0, 50000, 500000 }, 0 },
+#endif
+#if INCLUDE_sm3crypt
+  { "sm3crypt", "$sm3$", { 0, 50000 }, 0 },
+#endif
+#if INCLUDE_sha1crypt
+  { "sha1crypt", "$sha1", { 0 }, 0 },
+#endif
+#if INCLUDE_sunmd5
+  { "sunmd5", "$md5", { 0 }, 0 },
+#endif
+#if INCLUDE_md5crypt
+  { "md5crypt", "$1$", { 0 }, 0 },
+#endif
+#if INCLUDE_bsdicrypt
+  { "bsdicrypt", "_", { 0, 7250 }, 0 },
+#endif
+#if INCLUDE_nt
+  { "nt", "$3$", { 0 }, 0 },
+#endif
+#if INCLUDE_bigcrypt
+  { "bigcrypt", 0, { 0 }, "Mp............" },
+#endif
+#if INCLUDE_descrypt
+  { "descrypt", 0, { 0 }, "Mp" },
+#endif
+};
+
+static const char phrase[] = "correct horse battery staple";
+
+struct options
+{
+  double duration;
+  unsigned int max_threads;
+  const char *filter;
+  bool json;
+};
+
+struct worker
+{
+  const char *setting;
+  double deadline;
+  unsigned long ops;
+  bool failed;
+  double samples[MAX_SAMPLES];
+};
+
+static double
+now (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (double) ts.tv_sec + (double) ts.tv_nsec * 1e-9;
+}
+
+static void *
+worker_main (void *arg)
+{
+  struct worker *w = arg;
+  struct crypt_data *data = malloc (sizeof *data);
+  double start, end;
+
+  if (!data)
+    {
+      w->failed = true;
+      return NULL;
+    }
+  memset (data, 0, sizeof *data);
+
+  /* Always do at least one hash, however slow.  */
+  do
+    {
+      start = now ();
+      if (!crypt_rn (phrase, w->setting, data, sizeof *data))
+        {
+          w->failed = true;
+          break;
+        }
+      end = now ();
+      w->samples[w->ops % MAX_SAMPLES] = end - start;
+      w->ops++;
+    }
+  while (end < w->deadline);
+
+  free (data);
+  return NULL;
+}
+
+static int
+compare_doubles (const void *a, const void *b)
+{
+  double x = *(const double *) a, y = *(const double *) b;
+  return (x > y) - (x < y);
+}
+
+/* Return the value below which FRACTION of the N sorted SAMPLES lie.  */
+static double
+percentile (const double *samples, size_t n, double fraction)
+{
+  size_t i = (size_t) (fraction * (double) n);
+  if (i >= n)
+    i = n - 1;
+  return samples[i];
+}
+
+/* Measure SETTING with NTHREADS threads and print one result.  Runs in
+   a child process.  */
+static int
+measure (const struct options *opts, const char *name, const char *setting,
+         unsigned int nthreads)
+{
+  struct worker *workers;
+  double start, elapsed;
+  unsigned int i;
+
+  if (nthreads == 0)
+    return 1;
+  workers = calloc (nthreads, sizeof *workers);
+  if (!workers)
+    {
+      perror ("calloc");
+      return 1;
+    }
+
+  start = now ();
+  for (i = 0; i < nthreads; i++)
+    {
+      workers[i].setting = setting;
+      workers[i].deadline = start + opts->duration;
+    }
+
+#ifdef HAVE_PTHREAD_CREATE
+  pthread_t *threads = calloc (nthreads, sizeof *threads);
+  if (!threads)
+    {
+      perror ("calloc");
+      return 1;
+    }
+  for (i = 1; i < nthreads; i++)
+    if (pthread_create (&threads[i], NULL, worker_main, &workers[i]))
+      {
+        fprintf (stderr, "pthread_create failed\n");
+        return 1;
+      }
+#endif
+  worker_main (&workers[0]);
+#ifdef HAVE_PTHREAD_CREATE
+  for (i = 1; i < nthreads; i++)
+    pthread_join (threads[i], NULL);
+  free (threads);
+#endif
+  elapsed = now () - start;
+
+  unsigned long ops = 0;
+  size_t nsamples = 0;
+  for (i = 0; i < nthreads; i++)
+    {
+      if (workers[i].failed)
+        {
+          fprintf (stderr, "%s: crypt_rn (\"%s\") failed: %s\n",
+                   name, setting, strerror (errno));
+          return 1;
+        }
+      ops += workers[i].ops;
+      nsamples += workers[i].ops < MAX_SAMPLES ? workers[i].ops : MAX_SAMPLES;
+    }
+
+  /* Percentiles are over all threads' samples together.  */
+  double *samples = malloc (nsamples * sizeof *samples);
+  if (!samples)
+    {
+      perror ("malloc");
+      return 1;
+    }
+  size_t n = 0;
+  for (i = 0; i < nthreads; i++)
+    {
+      size_t k = workers[i].ops < MAX_SAMPLES ? workers[i].ops : MAX_SAMPLES;
+      memcpy (samples + n, workers[i].samples, k * sizeof *samples);
+      n += k;
+    }
+  qsort (samples, n, sizeof *samples, compare_doubles);
+
+  struct rusage ru;
+  long maxrss_kib = 0;
+  if (!getrusage (RUSAGE_SELF, &ru))
+    maxrss_kib = ru.ru_maxrss;
+
+  double ops_per_sec = (double) ops / elapsed;
+  double p50_ms = percentile (samples, n, 0.50) * 1e3;
+  double p99_ms = percentile (samples, n, 0.99) * 1e3;
+
+  if (opts->json)
+    printf ("{\"version\":\"%s\",\"method\":\"%s\",\"setting\":\"%s\","
+            "\"threads\":%u,\"ops\":%lu,\"seconds\":%.3f,"
+            "\"ops_per_sec\":%.2f,\"p50_ms\":%.4f,\"p99_ms\":%.4f,"
+            "\"peak_rss_kib\":%ld}\n",
+            XCRYPT_VERSION_STR, name, setting, nthreads, ops, elapsed,
+            ops_per_sec, p50_ms, p99_ms, maxrss_kib);
+  else
+    printf ("%-14s %-34.34s %3u %12.2f %10.3f %10.3f %10ld\n",
+            name, setting, nthreads, ops_per_sec, p50_ms, p99_ms,
+            maxrss_kib);
+
+  free (samples);
+  free (workers);
+  return 0;
+}
+
+/* Run measure() in a child process.  */
+static int
+measure_in_child (const struct options *opts, const char *name,
+                  const char *setting, unsigned int nthreads)
+{
+  fflush (stdout);
+  pid_t pid = fork ();
+  if (pid == -1)
+    {
+      perror ("fork");
+      return 1;
+    }
+  if (pid == 0)
+    {
+      int status = measure (opts, name, setting, nthreads);
+      fflush (stdout);
+      _exit (status);
+    }
+
+  int wstatus;
+  if (waitpid (pid, &wstatus, 0) != pid)
+    {
+      perror ("waitpid");
+      return 1;
+    }
+  return !WIFEXITED (wstatus) || WEXITSTATUS (wstatus) != 0;
+}
+
+/* True if NAME is in the comma-separated list FILTER, or FILTER is
+   null.  */
+static bool
+selected (const char *filter, const char *name)
+{
+  size_t len = strlen (name);
+  const char *p = filter;
+
+  if (!filter)
+    return true;
+  while (*p)
+    {
+      size_t n = strcspn (p, ",");
+      if (n == len && !strncmp (p, name, len))
+        return true;
+      p += n;
+      if (*p == ',')
+        p++;
+    }
+  return false;
+}
+
+static int
+bench_setting (const struct options *opts, const char *name,
+               const char *setting)
+{
+  unsigned int nthreads;
+  int status = 0;
+
+  /* 1, 2, 4, ... threads, and finally the maximum.  */
+  for (nthreads = 1; nthreads < opts->max_threads; nthreads *= 2)
+    status |= measure_in_child (opts, name, setting, nthreads);
+  status |= measure_in_child (opts, name, setting, opts->max_threads);
+  return status;
+}
+
+static void
+usage (const char *argv0)
+{
+  fprintf (stderr,
+           "Usage: %s [-d SECONDS] [-t MAXTHREADS] [-m METHOD[,METHOD...]]"
+           " [-f text|json]\n", argv0);
+}
+
+int
+main (int argc, char **argv)
+{
+  struct options opts = { 1.0, 1, NULL, false };
+  int status = 0;
+  size_t i, j;
+  int opt;
+
+#if defined HAVE_PTHREAD_CREATE && defined _SC_NPROCESSORS_ONLN
+  long ncpus = sysconf (_SC_NPROCESSORS_ONLN);
+  if (ncpus > 1)
+    opts.max_threads = (unsigned int) ncpus;
+#endif
+
+  while ((opt = getopt (argc, argv, "d:t:m:f:")) != -1)
+    switch (opt)
+      {
+      case 'd':
+        opts.duration = strtod (optarg, NULL);
+        if (!(opts.duration > 0))
+          {
+            usage (argv[0]);
+            return 2;
+          }
+        break;
+      case 't':
+        opts.max_threads = (unsigned int) strtoul (optarg, NULL, 10);
+        if (opts.max_threads < 1)
+          {
+            usage (argv[0]);
+            return 2;
+          }
+#ifndef HAVE_PTHREAD_CREATE
+        if (opts.max_threads > 1)
+          {
+            fprintf (stderr, "%s: built without thread support\n", argv[0]);
+            return 2;
+          }
+#endif
+        break;
+      case 'm':
+        opts.filter = optarg;
+        break;
+      case 'f':
+        if (!strcmp (optarg, "json"))
+          opts.json = true;
+        else if (!strcmp (optarg, "text"))
+          opts.json = false;
+        else
+          {
+            usage (argv[0]);
+            return 2;
+          }
+        break;
+      default:
+        usage (argv[0]);
+        return 2;
+      }
+
+  if (!opts.json)
+    printf ("%-14s %-34s %3s %12s %10s %10s %10s\n",
+            "method", "setting", "thr", "ops/s", "p50 ms", "p99 ms",
+            "RSS KiB");
+
+  for (i = 0; i < ARRAY_SIZE (methods); i++)
+    {
+      const struct method *m = &methods[i];
+      if (!selected (opts.filter, m->name))
+        continue;
+
+      if (m->setting)
+        {
+          status |= bench_setting (&opts, m->name, m->setting);
+          continue;
+        }
+
+      for (j = 0; j < MAX_COSTS; j++)
+        {
+          char setting[CRYPT_GENSALT_OUTPUT_SIZE];
+          /* Fixed "random" bytes, so that every run uses the same
+             settings.  */
+          static const char rbytes[] =
+            "\x58\x35\xcd\x26\x03\xab\x2c\x14\x92\x13\x1e\x59\xb0\xbc\xfe\xd5";
+
+          if (j > 0 && m->costs[j] == 0)
+            break;
+          if (!crypt_gensalt_rn (m->prefix, m->costs[j],
+                                 rbytes, (int) sizeof rbytes - 1,
+                                 setting, (int) sizeof setting))
+            {
+              fprintf (stderr, "%s: crypt_gensalt_rn (\"%s\", %lu)"
+                       " failed: %s\n", m->name, m->prefix, m->costs[j],
+                       strerror (errno));
+              status = 1;
+              continue;
+            }
+          status |= bench_setting (&opts, m->name, setting);
+        }
+    }
+
+  return status;
+}
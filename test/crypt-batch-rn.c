@@ -0,0 +1,94 @@
+/* Test that crypt_batch_rn gives every item the same output as
+   crypt_rn, when the batch interleaves items for several methods with
+   and without batch entry points, and invalid items, and has more
+   items than fit on its pending list at once.
+
+   To the extent possible under law, the author(s) have waived all
+   copyright and related or neighboring rights to this work.
+
+   See https://creativecommons.org/publicdomain/zero/1.0/ for further
+   details.  */
+
+#include "crypt-port.h"
+
+#include <stdio.h>
+
+static const char *const settings[] =
+{
+#if INCLUDE_descrypt
+  "Mp",
+#endif
+#if INCLUDE_bsdicrypt
+  "_J9..MJHn",
+#endif
+#if INCLUDE_md5crypt
+  "$1$MJHnaAke",
+#endif
+#if INCLUDE_bcrypt
+  "$2b$04$UBVLHeMpJ/QQCv3XqJx8zO",
+#endif
+#if INCLUDE_sha256crypt
+  "$5$rounds=1000$MJHnaAkegEVYHsFK",
+#endif
+#if INCLUDE_sha512crypt
+  "$6$rounds=1000$MJHnaAkegEVYHsFK",
+  "$6$rounds=1001$MJHnaAkegEVYHsFK",
+#endif
+#if INCLUDE_sm3crypt
+  "$sm3$rounds=1000$MJHnaAkegEVYHsFK",
+#endif
+#if INCLUDE_nt
+  "$3$",
+#endif
+  /* Items that can't be hashed must not disturb the others.  */
+  "$unknown$salt",
+  "M:",
+};
+
+/* More than twice the pending list of crypt_batch_rn.  */
+#define NITEMS 600
+
+static struct crypt_batch items[NITEMS];
+static char phrases[NITEMS][16];
+
+int
+main (void)
+{
+  struct crypt_data data, expected;
+  int result = 0, nexpected = 0;
+  size_t i;
+
+  for (i = 0; i < NITEMS; i++)
+    {
+      snprintf (phrases[i], sizeof phrases[i], "phrase %zu", i);
+      items[i].phrase = phrases[i];
+      items[i].setting = settings[i % ARRAY_SIZE (settings)];
+    }
+  /* And one with no phrase at all.  */
+  items[NITEMS - 1].phrase = 0;
+
+  int nok = crypt_batch_rn (items, NITEMS, &data, (int) sizeof data);
+
+  for (i = 0; i < NITEMS; i++)
+    {
+      /* crypt_rn leaves a failure token in OUTPUT when it fails.  */
+      crypt_rn (items[i].phrase, items[i].setting,
+                &expected, (int) sizeof expected);
+      if (expected.output[0] != '*')
+        nexpected++;
+      if (strcmp (items[i].output, expected.output))
+        {
+          printf ("FAIL: item %zu (%s, %s):\n  exp: %s\n  got: %s\n",
+                  i, items[i].phrase ? items[i].phrase : "(null)",
+                  items[i].setting, expected.output, items[i].output);
+          result = 1;
+        }
+    }
+  if (nok != nexpected)
+    {
+      printf ("FAIL: crypt_batch_rn returned %d, expected %d\n",
+              nok, nexpected);
+      result = 1;
+    }
+  return result;
+}
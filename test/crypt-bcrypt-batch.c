@@ -0,0 +1,133 @@
+/* Test that the bcrypt batch entry points compute the same hashes as
+   the ordinary ones, for batches that fill the interleaved lanes
+   exactly, leave some of them empty, and mix costs and subtypes.
+
+   To the extent possible under law, the author(s) have waived all
+   copyright and related or neighboring rights to this work.
+
+   See https://creativecommons.org/publicdomain/zero/1.0/ for further
+   details.  */
+
+#include "crypt-port.h"
+
+#include <errno.h>
+#include <stdio.h>
+
+#if INCLUDE_bcrypt
+
+#define NITEMS 11
+
+static const char *const settings[] =
+{
+  "$2b$05$CCCCCCCCCCCCCCCCCCCCC.",
+  "$2b$05$abcdefghijklmnopqrstuu",
+  "$2b$04$XXXXXXXXXXXXXXXXXXXXXO",
+  "$2b$05$./0123456789ABCDEFGHIJ",
+  /* Invalid settings must not disturb the other items.  */
+  "$2b$03$CCCCCCCCCCCCCCCCCCCCC.",
+  "$2b$05$CCCCCCCCCCCCCCCCCCCCC",
+  "$2b$05$XXXXXXXXXXXXXXXXXXXXXO",
+};
+
+static uint8_t scratch[ALG_BATCH_SPECIFIC_SIZE];
+static uint8_t scalar_scratch[ALG_SPECIFIC_SIZE];
+
+static int
+test_batch (size_t nitems, size_t stride)
+{
+  struct crypt_batch_item items[NITEMS];
+  char phrases[NITEMS][80];
+  char outputs[NITEMS][CRYPT_OUTPUT_SIZE];
+  char expected[CRYPT_OUTPUT_SIZE];
+  int result = 0;
+  size_t i, j;
+
+  for (i = 0; i < nitems; i++)
+    {
+      /* Phrase lengths on both sides of the 72-byte limit, including
+         characters with the high bit set.  */
+      size_t len = (i * 13) % (sizeof phrases[i] - 1);
+      for (j = 0; j < len; j++)
+        phrases[i][j] = (char) (0x21 + (i * 7 + j * 31) % 0xD0);
+      phrases[i][len] = '\0';
+
+      items[i].phrase = phrases[i];
+      items[i].phr_size = len;
+      items[i].setting = settings[(i * stride) % ARRAY_SIZE (settings)];
+      items[i].set_size = strlen (items[i].setting);
+      items[i].output = (uint8_t *) outputs[i];
+      items[i].out_size = sizeof outputs[i];
+      make_failure_token (items[i].setting, outputs[i],
+                          (int) sizeof outputs[i]);
+    }
+
+  crypt_bcrypt_batch_rn (items, nitems, scratch, sizeof scratch);
+
+  for (i = 0; i < nitems; i++)
+    {
+      make_failure_token (items[i].setting, expected, (int) sizeof expected);
+      crypt_bcrypt_rn (items[i].phrase, items[i].phr_size,
+                       items[i].setting, items[i].set_size,
+                       (uint8_t *) expected, sizeof expected,
+                       scalar_scratch, sizeof scalar_scratch);
+      if (strcmp (expected, outputs[i]))
+        {
+          printf ("FAIL: item %zu/%zu (stride %zu, %s):\n"
+                  "  exp: %s\n  got: %s\n",
+                  i, nitems, stride, items[i].setting,
+                  expected, outputs[i]);
+          result = 1;
+        }
+    }
+  return result;
+}
+
+int
+main (void)
+{
+  int result = 0;
+  size_t n;
+
+  /* Stride 0 puts every item in the same group; stride 1 changes the
+     cost or validity of nearly every item.  */
+  for (n = 1; n <= NITEMS; n++)
+    {
+      result |= test_batch (n, 0);
+      result |= test_batch (n, 1);
+    }
+
+  /* A batch whose scratch area is too small must not produce any
+     output.  */
+  {
+    struct crypt_batch_item item;
+    char output[CRYPT_OUTPUT_SIZE];
+
+    item.phrase = "";
+    item.phr_size = 0;
+    item.setting = settings[0];
+    item.set_size = strlen (settings[0]);
+    item.output = (uint8_t *) output;
+    item.out_size = sizeof output;
+    make_failure_token (item.setting, output, (int) sizeof output);
+    errno = 0;
+    crypt_bcrypt_batch_rn (&item, 1, scratch, 16);
+    if (errno != ERANGE || output[0] != '*')
+      {
+        printf ("FAIL: short scratch: errno %d, output %s\n",
+                errno, output);
+        result = 1;
+      }
+  }
+
+  return result;
+}
+
+#else
+
+int
+main (void)
+{
+  return 77; /* UNSUPPORTED */
+}
+
+#endif
@@ -0,0 +1,230 @@
+/* Test that crypt_descrypt_batch_rn, crypt_bigcrypt_batch_rn and
+   crypt_bsdicrypt_batch_rn compute the same hashes as the corresponding
+   crypt_*_rn functions, with every bitsliced DES kernel the CPU
+   supports, and with batches too small to be worth bitslicing.
+
+   To the extent possible under law, the author(s) have waived all
+   copyright and related or neighboring rights to this work.
+
+   See https://creativecommons.org/publicdomain/zero/1.0/ for further
+   details.  */
+
+#include "crypt-port.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#if INCLUDE_descrypt || INCLUDE_bigcrypt || INCLUDE_bsdicrypt
+
+#include "alg-des.h"
+
+/* Enough items to fill all the lanes of the widest kernel, with one
+   left over.  */
+#define NITEMS (DES_BS_LANES_MAX + 1)
+
+typedef void (*batch_fn) (struct crypt_batch_item *items, size_t nitems,
+                          void *scratch, size_t scr_size);
+typedef void (*crypt_fn) (const char *phrase, size_t phr_size,
+                          const char *setting, size_t set_size,
+                          uint8_t *output, size_t out_size,
+                          void *scratch, size_t scr_size);
+
+struct method
+{
+  const char *name;
+  batch_fn batch;
+  crypt_fn crypt;
+  /* The longest phrase worth testing.  */
+  size_t max_phrase;
+  const char *const *settings;
+  size_t nsettings;
+};
+
+#if INCLUDE_descrypt
+static const char *const des_settings[] =
+{
+  "ab", "./", "zz", "Ax", "9.",
+  /* Invalid settings must not disturb the other items.  */
+  "a!",
+};
+#endif
+
+#if INCLUDE_bigcrypt
+static const char *const big_settings[] =
+{
+  "ab............",
+  "./............",
+  "Ax............",
+  /* Phrases longer than 8 characters with a setting this short are
+     hashed as descrypt would.  */
+  "zz",
+  "!b............",
+};
+#endif
+
+#if INCLUDE_bsdicrypt
+/* Hashes with different iteration counts in one batch.  */
+static const char *const bsdi_settings[] =
+{
+  "_/...abcd",
+  "_/...ABCD",
+  "_3...salt",
+  "_3..././.",
+  "_.....zz.",
+  "_5...zzzz",
+  "_3..",
+  "_3...sa!t",
+};
+#endif
+
+static const struct method methods[] =
+{
+#if INCLUDE_descrypt
+  { "descrypt", crypt_descrypt_batch_rn, crypt_descrypt_rn, 12,
+    des_settings, ARRAY_SIZE (des_settings) },
+#endif
+#if INCLUDE_bigcrypt
+  { "bigcrypt", crypt_bigcrypt_batch_rn, crypt_bigcrypt_rn, 140,
+    big_settings, ARRAY_SIZE (big_settings) },
+#endif
+#if INCLUDE_bsdicrypt
+  { "bsdicrypt", crypt_bsdicrypt_batch_rn, crypt_bsdicrypt_rn, 30,
+    bsdi_settings, ARRAY_SIZE (bsdi_settings) },
+#endif
+};
+
+static uint8_t scratch[ALG_BATCH_SPECIFIC_SIZE];
+static uint8_t scalar_scratch[ALG_SPECIFIC_SIZE];
+static struct crypt_batch_item items[NITEMS];
+static char phrases[NITEMS][160];
+static char outputs[NITEMS][CRYPT_OUTPUT_SIZE];
+
+static int
+compare_settings (const void *a, const void *b)
+{
+  const struct crypt_batch_item *ia = a;
+  const struct crypt_batch_item *ib = b;
+  return strcmp (ia->setting, ib->setting);
+}
+
+static int
+test_batch (const struct method *m, const char *tag, size_t nitems)
+{
+  char expected[CRYPT_OUTPUT_SIZE];
+  int result = 0;
+  size_t i, j;
+
+  for (i = 0; i < nitems; i++)
+    {
+      /* Phrase lengths around the 8-character segments, and characters
+         with the high bit set, which DES ignores.  */
+      size_t len = (i * 7) % (m->max_phrase + 1);
+      for (j = 0; j < len; j++)
+        phrases[i][j] = (char) ((i + j) % 5 == 0
+                                ? 0x80 + (i + j) % 127
+                                : '!' + (i * 3 + j) % 90);
+      phrases[i][len] = '\0';
+
+      items[i].phrase = phrases[i];
+      items[i].phr_size = len;
+      items[i].setting = m->settings[i % m->nsettings];
+      items[i].set_size = strlen (items[i].setting);
+      items[i].output = (uint8_t *) outputs[i];
+      items[i].out_size = sizeof outputs[i];
+      make_failure_token (items[i].setting, outputs[i],
+                          (int) sizeof outputs[i]);
+    }
+
+  /* As crypt_batch_rn does.  */
+  qsort (items, nitems, sizeof items[0], compare_settings);
+
+  m->batch (items, nitems, scratch, sizeof scratch);
+
+  for (i = 0; i < nitems; i++)
+    {
+      make_failure_token (items[i].setting, expected, (int) sizeof expected);
+      m->crypt (items[i].phrase, items[i].phr_size,
+                items[i].setting, items[i].set_size,
+                (uint8_t *) expected, sizeof expected,
+                scalar_scratch, sizeof scalar_scratch);
+      if (strcmp (expected, (const char *) items[i].output))
+        {
+          printf ("FAIL: %s: %s: item %zu/%zu (phrase length %zu, %s):\n"
+                  "  exp: %s\n  got: %s\n",
+                  m->name, tag, i, nitems, items[i].phr_size,
+                  items[i].setting, expected, items[i].output);
+          result = 1;
+        }
+    }
+  return result;
+}
+
+int
+main (void)
+{
+  static const struct
+  {
+    uint32_t features;
+    const char *tag;
+  } variants[] =
+  {
+    { UINT32_MAX, "default" },
+    { (uint32_t) ~CPU_FEATURE_AVX512F, "no AVX-512" },
+    { (uint32_t) ~(CPU_FEATURE_AVX512F | CPU_FEATURE_AVX2), "no AVX" },
+  };
+  /* One item, a batch too small to bitslice, and batches that need one
+     to eight groups of 64 lanes, or more.  */
+  static const size_t sizes[] = { 1, 5, 40, 64, 100, 250, 300, NITEMS };
+  size_t last_lanes = 0;
+  int result = 0;
+  size_t i, j, k;
+
+  for (i = 0; i < ARRAY_SIZE (variants); i++)
+    {
+      restrict_cpu_features (variants[i].features);
+      if (des_bs_lanes () == last_lanes)
+        continue;
+      last_lanes = des_bs_lanes ();
+      for (j = 0; j < ARRAY_SIZE (methods); j++)
+        for (k = 0; k < ARRAY_SIZE (sizes); k++)
+          result |= test_batch (&methods[j], variants[i].tag, sizes[k]);
+    }
+
+  /* A batch whose scratch area is too small must not produce any
+     output.  */
+  restrict_cpu_features (UINT32_MAX);
+  for (j = 0; j < ARRAY_SIZE (methods); j++)
+    {
+      struct crypt_batch_item item;
+      char output[CRYPT_OUTPUT_SIZE];
+
+      item.phrase = "";
+      item.phr_size = 0;
+      item.setting = methods[j].settings[0];
+      item.set_size = strlen (item.setting);
+      item.output = (uint8_t *) output;
+      item.out_size = sizeof output;
+      make_failure_token (item.setting, output, (int) sizeof output);
+      errno = 0;
+      methods[j].batch (&item, 1, scratch, 16);
+      if (errno != ERANGE || output[0] != '*')
+        {
+          printf ("FAIL: %s: short scratch: errno %d, output %s\n",
+                  methods[j].name, errno, output);
+          result = 1;
+        }
+    }
+
+  return result;
+}
+
+#else
+
+int
+main (void)
+{
+  return 77; /* UNSUPPORTED */
+}
+
+#endif
@@ -0,0 +1,72 @@
+/* Test that crypt_md5crypt_batch_rn and crypt_sunmd5_batch_rn compute
+   the same hashes as crypt_md5crypt_rn and crypt_sunmd5_rn, with every
+   multi-buffer MD5 implementation the CPU supports, and with the
+   fallback that hashes one item at a time.
+
+   To the extent possible under law, the author(s) have waived all
+   copyright and related or neighboring rights to this work.
+
+   See https://creativecommons.org/publicdomain/zero/1.0/ for further
+   details.  */
+
+#include "crypt-port.h"
+
+#if INCLUDE_md5crypt || INCLUDE_sunmd5
+
+#include "alg-md5.h"
+
+#define BATCH_MAX_LANES MD5_MB_LANES
+#include "batch-common.h"
+
+#if INCLUDE_md5crypt
+static const char *const md5crypt_settings[] =
+{
+  "$1$saltstri",
+  "$1$",
+  "$1$ab$",
+  "$1$longersaltIsTruncated",
+  /* Invalid settings must not disturb the other items.  */
+  "$1$bad:salt",
+};
+#endif
+
+#if INCLUDE_sunmd5
+/* Hashes with different numbers of rounds in one batch.  */
+static const char *const sunmd5_settings[] =
+{
+  "$md5,rounds=1$saltsalt$",
+  "$md5$rounds=300$abcdefgh",
+  "$md5$3ed0.....",
+  "$md5,rounds=5000$.$",
+  "$md5$$",
+  "$md5,rounds=0$zero$",
+};
+#endif
+
+static const struct batch_method methods[] =
+{
+#if INCLUDE_md5crypt
+  { "md5crypt", crypt_md5crypt_batch_rn, crypt_md5crypt_rn,
+    md5crypt_settings, ARRAY_SIZE (md5crypt_settings) },
+#endif
+#if INCLUDE_sunmd5
+  { "sunmd5", crypt_sunmd5_batch_rn, crypt_sunmd5_rn,
+    sunmd5_settings, ARRAY_SIZE (sunmd5_settings) },
+#endif
+};
+
+int
+main (void)
+{
+  return run_batch_tests (methods, ARRAY_SIZE (methods), MD5_MB_Lanes);
+}
+
+#else
+
+int
+main (void)
+{
+  return 77; /* UNSUPPORTED */
+}
+
+#endif
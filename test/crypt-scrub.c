@@ -0,0 +1,138 @@
+/* Test that crypt_rn and crypt_r do not leave any of the data they
+   computed in struct crypt_data, other than the hash itself, now that
+   they only erase the part of the scratch area each hashing method
+   uses.  A byte that was written to and not erased afterward shows up
+   as neither zero nor the value the structure was filled with before
+   the call.
+
+   To the extent possible under law, the author(s) have waived all
+   copyright and related or neighboring rights to this work.
+
+   See https://creativecommons.org/publicdomain/zero/1.0/ for further
+   details.  */
+
+#include "crypt-port.h"
+
+#include <stdio.h>
+
+#define PHRASE "correct horse battery staple"
+
+static const char *const settings[] =
+{
+#if INCLUDE_descrypt
+  "Mp",
+#endif
+#if INCLUDE_bigcrypt
+  "Mp............",
+#endif
+#if INCLUDE_bsdicrypt
+  "_J9..MJHn",
+#endif
+#if INCLUDE_md5crypt
+  "$1$MJHnaAke",
+#endif
+#if INCLUDE_nt
+  "$3$",
+#endif
+#if INCLUDE_sunmd5
+  "$md5$BPm.fm03$",
+#endif
+#if INCLUDE_sm3crypt
+  "$sm3$MJHnaAkegEVYHsFK",
+#endif
+#if INCLUDE_sha1crypt
+  "$sha1$1000$ggu.H673kaZ5$",
+#endif
+#if INCLUDE_sha256crypt
+  "$5$MJHnaAkegEVYHsFK",
+#endif
+#if INCLUDE_sha512crypt
+  "$6$MJHnaAkegEVYHsFK",
+#endif
+#if INCLUDE_bcrypt_a
+  "$2a$05$UBVLHeMpJ/QQCv3XqJx8zO",
+#endif
+#if INCLUDE_bcrypt
+  "$2b$05$UBVLHeMpJ/QQCv3XqJx8zO",
+#endif
+#if INCLUDE_bcrypt_y
+  "$2y$05$UBVLHeMpJ/QQCv3XqJx8zO",
+#endif
+#if INCLUDE_bcrypt_x
+  "$2x$05$UBVLHeMpJ/QQCv3XqJx8zO",
+#endif
+#if INCLUDE_yescrypt
+  "$y$j9T$MJHnaAkegEVYHsFKkmfzJ1",
+#endif
+#if INCLUDE_scrypt
+  "$7$CU..../....MJHnaAkegEVYHsFKkmfzJ1",
+#endif
+#if INCLUDE_gost_yescrypt
+  "$gy$j9T$MJHnaAkegEVYHsFKkmfzJ1",
+#endif
+#if INCLUDE_sm3_yescrypt
+  "$sm3y$j9T$MJHnaAkegEVYHsFKkmfzJ1",
+#endif
+  /* Unrecognized and invalid settings.  */
+  "$!$",
+  "$99$abc",
+};
+
+static struct crypt_data data;
+
+/* Check that every byte of DATA from BEGIN to END is either FILL or
+   zero.  */
+static int
+check_region (const char *tag, const char *setting, const char *name,
+              const char *begin, const char *end, unsigned char fill)
+{
+  const char *p;
+  for (p = begin; p < end; p++)
+    if (*p != 0 && (unsigned char) *p != fill)
+      {
+        printf ("FAIL: %s (%s): data.%s[%zu] = 0x%02x after the call\n",
+                tag, setting, name, (size_t) (p - begin),
+                (unsigned int) (unsigned char) *p);
+        return 1;
+      }
+  return 0;
+}
+
+static int
+check_data (const char *tag, const char *setting, unsigned char fill)
+{
+  int result = 0;
+#define CHECK_FIELD(f) \
+  check_region (tag, setting, #f, (const char *) &data.f, \
+                (const char *) &data.f + sizeof data.f, fill)
+  result |= CHECK_FIELD (setting);
+  result |= CHECK_FIELD (input);
+  result |= CHECK_FIELD (reserved);
+  result |= CHECK_FIELD (internal);
+#undef CHECK_FIELD
+  return result;
+}
+
+int
+main (void)
+{
+  /* Two fills, so that a byte left behind is unlikely to be mistaken
+     for an untouched one in both runs.  */
+  static const unsigned char fills[] = { 0x55, 0xaa };
+  int result = 0;
+  size_t i, j;
+
+  for (i = 0; i < ARRAY_SIZE (settings); i++)
+    for (j = 0; j < ARRAY_SIZE (fills); j++)
+      {
+        memset (&data, fills[j], sizeof data);
+        crypt_rn (PHRASE, settings[i], &data, (int) sizeof data);
+        result |= check_data ("crypt_rn", settings[i], fills[j]);
+
+        memset (&data, fills[j], sizeof data);
+        crypt_r (PHRASE, settings[i], &data);
+        result |= check_data ("crypt_r", settings[i], fills[j]);
+      }
+
+  return result;
+}
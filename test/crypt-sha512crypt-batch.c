@@ -0,0 +1,52 @@
+/* Test that crypt_sha512crypt_batch_rn computes the same hashes as
+   crypt_sha512crypt_rn, with every SIMD implementation the CPU
+   supports, and with the fallback that hashes one item at a time.
+
+   To the extent possible under law, the author(s) have waived all
+   copyright and related or neighboring rights to this work.
+
+   See https://creativecommons.org/publicdomain/zero/1.0/ for further
+   details.  */
+
+#include "crypt-port.h"
+
+#if INCLUDE_sha512crypt
+
+#include "alg-sha512.h"
+
+#define BATCH_MAX_LANES SHA512_MB_LANES
+#include "batch-common.h"
+
+static const char *const settings[] =
+{
+  "$6$saltstring",
+  "$6$rounds=1000$roundsalt",
+  "$6$rounds=1400$longersaltstringisTruncated",
+  "$6$",
+  "$6$rounds=1001$odd",
+  /* Invalid settings must not disturb the other items.  */
+  "$6$rounds=10$tooFewRounds",
+  "$6$bad:salt",
+};
+
+static const struct batch_method methods[] =
+{
+  { "sha512crypt", crypt_sha512crypt_batch_rn, crypt_sha512crypt_rn,
+    settings, ARRAY_SIZE (settings) },
+};
+
+int
+main (void)
+{
+  return run_batch_tests (methods, ARRAY_SIZE (methods), SHA512_MB_Lanes);
+}
+
+#else
+
+int
+main (void)
+{
+  return 77; /* UNSUPPORTED */
+}
+
+#endif
@@ -0,0 +1,52 @@
+/* Test that crypt_sm3crypt_batch_rn computes the same hashes as
+   crypt_sm3crypt_rn, with every multi-buffer SM3 implementation the
+   CPU supports, and with the fallback that hashes one item at a time.
+
+   To the extent possible under law, the author(s) have waived all
+   copyright and related or neighboring rights to this work.
+
+   See https://creativecommons.org/publicdomain/zero/1.0/ for further
+   details.  */
+
+#include "crypt-port.h"
+
+#if INCLUDE_sm3crypt
+
+#include "alg-sm3.h"
+
+#define BATCH_MAX_LANES SM3_MB_LANES
+#include "batch-common.h"
+
+static const char *const settings[] =
+{
+  "$sm3$saltstring",
+  "$sm3$rounds=1000$roundsalt",
+  "$sm3$rounds=1400$longersaltstringisTruncated",
+  "$sm3$",
+  "$sm3$rounds=1001$odd",
+  /* Invalid settings must not disturb the other items.  */
+  "$sm3$rounds=10$tooFewRounds",
+  "$sm3$bad:salt",
+};
+
+static const struct batch_method methods[] =
+{
+  { "sm3crypt", crypt_sm3crypt_batch_rn, crypt_sm3crypt_rn,
+    settings, ARRAY_SIZE (settings) },
+};
+
+int
+main (void)
+{
+  return run_batch_tests (methods, ARRAY_SIZE (methods), sm3_mb_lanes);
+}
+
+#else
+
+int
+main (void)
+{
+  return 77; /* UNSUPPORTED */
+}
+
+#endif
@@ -0,0 +1,272 @@
+/* Test that crypt and crypt_gensalt, built with
+   --enable-thread-local-crypt, give each thread a buffer of its own:
+   threads calling them at the same time must get the same results as
+   crypt_rn and crypt_gensalt_rn, and must never be handed another
+   thread's buffer.  Where ld --wrap is available, also check that a
+   thread whose buffers can't be allocated gets a failure token from
+   crypt, even with a null setting, and a null pointer from
+   crypt_gensalt.
+
+   To the extent possible under law, the author(s) have waived all
+   copyright and related or neighboring rights to this work.
+
+   See https://creativecommons.org/publicdomain/zero/1.0/ for further
+   details.  */
+
+#include "crypt-port.h"
+
+#include <errno.h>
+#include <stdio.h>
+
+#if ENABLE_THREAD_LOCAL_CRYPT \
+  && (INCLUDE_descrypt || INCLUDE_md5crypt || INCLUDE_sha256crypt \
+      || INCLUDE_sha512crypt)
+
+#include <pthread.h>
+
+static const char *const prefixes[] =
+{
+#if INCLUDE_descrypt
+  "",
+#endif
+#if INCLUDE_md5crypt
+  "$1$",
+#endif
+#if INCLUDE_sha256crypt
+  "$5$",
+#endif
+#if INCLUDE_sha512crypt
+  "$6$",
+#endif
+};
+
+#define NTHREADS 4
+#define ITERATIONS 50
+
+struct thread_arg
+{
+  const char *tag;
+  /* The buffers crypt and crypt_gensalt returned in the main thread,
+     which are still in use while the other threads run.  */
+  const char *main_hash;
+  const char *main_setting;
+  int result;
+};
+
+static int
+run_iterations (struct thread_arg *ta)
+{
+  char setting[CRYPT_GENSALT_OUTPUT_SIZE];
+  char phrase[32];
+  struct crypt_data data;
+  const char *first_hash = 0, *first_setting = 0;
+  size_t i;
+
+  for (i = 0; i < ITERATIONS * ARRAY_SIZE (prefixes); i++)
+    {
+      const char *prefix = prefixes[i % ARRAY_SIZE (prefixes)];
+
+      char *s = crypt_gensalt (prefix, 0, NULL, 0);
+      if (!s)
+        {
+          printf ("FAIL: %s: crypt_gensalt(\"%s\") failed\n", ta->tag, prefix);
+          return 1;
+        }
+      strcpy (setting, s);
+
+      snprintf (phrase, sizeof phrase, "%s %zu", ta->tag, i);
+      char *hash = crypt (phrase, setting);
+      char *expected = crypt_rn (phrase, setting, &data, sizeof data);
+      if (!hash || !expected || strcmp (hash, expected))
+        {
+          printf ("FAIL: %s: \"%s\", %s\n  exp: %s\n  got: %s\n", ta->tag,
+                  phrase, setting, expected ? expected : "(null)",
+                  hash ? hash : "(null)");
+          return 1;
+        }
+
+      if (!first_hash)
+        {
+          first_hash = hash;
+          first_setting = s;
+        }
+      if (hash != first_hash || s != first_setting)
+        {
+          printf ("FAIL: %s: buffers moved between calls\n", ta->tag);
+          return 1;
+        }
+      if ((ta->main_hash && hash == ta->main_hash)
+          || (ta->main_setting && s == ta->main_setting))
+        {
+          printf ("FAIL: %s: shares the main thread's buffers\n", ta->tag);
+          return 1;
+        }
+    }
+  return 0;
+}
+
+static void *
+thread_main (void *arg)
+{
+  struct thread_arg *ta = arg;
+  ta->result = run_iterations (ta);
+  return NULL;
+}
+
+#ifdef HAVE_LD_WRAP
+/* Only ever set while a single thread is running.  Volatile, because
+   the compiler may assume that crypt doesn't call back into this
+   file.  */
+static volatile bool alloc_should_fail = false;
+static volatile unsigned int alloc_failures;
+
+extern void *__real_calloc (size_t, size_t);
+extern void *__wrap_calloc (size_t, size_t);
+void *
+__wrap_calloc (size_t nmemb, size_t size)
+{
+  if (alloc_should_fail)
+    {
+      alloc_failures++;
+      errno = ENOMEM;
+      return NULL;
+    }
+  return __real_calloc (nmemb, size);
+}
+
+extern void *__real_malloc (size_t);
+extern void *__wrap_malloc (size_t);
+void *
+__wrap_malloc (size_t size)
+{
+  if (alloc_should_fail)
+    {
+      alloc_failures++;
+      errno = ENOMEM;
+      return NULL;
+    }
+  return __real_malloc (size);
+}
+
+/* Volatile so the compiler can't see that null is passed to crypt.  */
+static const char *volatile null_setting = 0;
+
+static int
+check_failure (const char *tag, const char *setting, const char *expected)
+{
+  errno = 0;
+  char *hash = crypt ("", setting);
+  int err = errno;
+#if ENABLE_FAILURE_TOKENS
+  if (!hash || strcmp (hash, expected) || err != ENOMEM)
+#else
+  (void) expected;
+  if (hash || err != ENOMEM)
+#endif
+    {
+      printf ("FAIL: allocation failure, %s: got %s, errno %d\n", tag,
+              hash ? hash : "(null)", err);
+      return 1;
+    }
+  return 0;
+}
+
+static void *
+alloc_failure_main (void *arg)
+{
+  int *result = arg;
+
+  alloc_should_fail = true;
+  errno = 0;
+  char *hash = crypt ("", null_setting);
+  if (!alloc_failures)
+    {
+      /* libcrypt was linked dynamically, out of reach of ld --wrap.  */
+      alloc_should_fail = false;
+      printf ("SKIP: allocation failure: libcrypt is not linked statically"
+              " (got %s)\n", hash ? hash : "(null)");
+      return NULL;
+    }
+  *result |= check_failure ("null setting", null_setting, "*0");
+  *result |= check_failure ("setting \"*0\"", "*0", "*1");
+  *result |= check_failure ("valid setting", prefixes[0], "*0");
+
+  errno = 0;
+  char *s = crypt_gensalt (prefixes[0], 0, NULL, 0);
+  if (s || errno != ENOMEM)
+    {
+      printf ("FAIL: allocation failure, crypt_gensalt: got %s, errno %d\n",
+              s ? s : "(null)", errno);
+      *result = 1;
+    }
+  alloc_should_fail = false;
+  return NULL;
+}
+#endif
+
+int
+main (void)
+{
+  static const char *const tags[NTHREADS] =
+  {
+    "thread 1", "thread 2", "thread 3", "thread 4",
+  };
+  struct thread_arg main_arg = { "main thread", 0, 0, 0 };
+  struct thread_arg args[NTHREADS];
+  pthread_t threads[NTHREADS];
+  int result = 0;
+  size_t i;
+
+  result |= run_iterations (&main_arg);
+
+  const char *main_setting = crypt_gensalt (prefixes[0], 0, NULL, 0);
+  const char *main_hash = crypt ("", main_setting);
+  for (i = 0; i < NTHREADS; i++)
+    {
+      args[i].tag = tags[i];
+      args[i].main_hash = main_hash;
+      args[i].main_setting = main_setting;
+      args[i].result = 0;
+    }
+  for (i = 0; i < NTHREADS; i++)
+    if (pthread_create (&threads[i], NULL, thread_main, &args[i]))
+      {
+        printf ("ERROR: pthread_create failed\n");
+        return 99;
+      }
+  for (i = 0; i < NTHREADS; i++)
+    {
+      if (pthread_join (threads[i], NULL))
+        {
+          printf ("ERROR: pthread_join failed\n");
+          return 99;
+        }
+      result |= args[i].result;
+    }
+
+#ifdef HAVE_LD_WRAP
+  /* A new thread has no buffers yet, so it must allocate them.  */
+  if (pthread_create (&threads[0], NULL, alloc_failure_main, &result)
+      || pthread_join (threads[0], NULL))
+    {
+      printf ("ERROR: pthread_create or pthread_join failed\n");
+      return 99;
+    }
+#endif
+
+  /* Threads that have exited give their buffers back; the main
+     thread's are still there.  */
+  result |= run_iterations (&main_arg);
+
+  return result;
+}
+
+#else
+
+int
+main (void)
+{
+  return 77; /* UNSUPPORTED */
+}
+
+#endif
@@ -0,0 +1,257 @@
+/* Test crypt_verify_and_upgrade: that it verifies like crypt_verify,
+   that it rehashes exactly when the stored hash uses a different
+   method or is less costly than asked for, and that the new hash
+   verifies.
+
+   To the extent possible under law, the author(s) have waived all
+   copyright and related or neighboring rights to this work.
+
+   See https://creativecommons.org/publicdomain/zero/1.0/ for further
+   details.  */
+
+#include "crypt-port.h"
+
+#include <errno.h>
+#include <stdio.h>
+
+static const char phrase[] = "correct horse battery staple";
+
+struct testcase
+{
+  /* The stored hash is made from a setting from crypt_gensalt_rn with
+     these arguments.  */
+  const char *old_prefix;
+  unsigned long old_count;
+  /* The policy.  */
+  const char *prefix;
+  unsigned long count;
+  /* What the new hash should begin with, or 0 if there should be no
+     new hash.  */
+  const char *upgraded;
+};
+
+static const struct testcase testcases[] =
+{
+#if INCLUDE_md5crypt && INCLUDE_sha512crypt
+  /* A different method.  */
+  { "$1$", 0, "$6$", 0, "$6$" },
+  /* But a strong method is never swapped for a legacy one.  */
+  { "$6$", 0, "$1$", 0, 0 },
+#endif
+#if INCLUDE_sha512crypt
+  { "$6$", 0, "$6$", 0, 0 },
+  { "$6$", 10000, "$6$", 10000, 0 },
+  /* A weaker hash is upgraded, a stronger one is left alone.  */
+  { "$6$", 1000, "$6$", 0, "$6$" },
+  { "$6$", 0, "$6$", 10000, "$6$rounds=10000$" },
+  { "$6$", 20000, "$6$", 10000, 0 },
+  { "$6$", 10000, "$6$", 0, 0 },
+#endif
+#if INCLUDE_bcrypt
+  { "$2b$", 5, "$2b$", 5, 0 },
+  { "$2b$", 5, "$2b$", 6, "$2b$06$" },
+  { "$2b$", 6, "$2b$", 5, 0 },
+#endif
+#if INCLUDE_yescrypt
+  { "$y$", 0, "$y$", 0, 0 },
+  { "$y$", 3, "$y$", 5, "$y$" },
+  { "$y$", 6, "$y$", 0, 0 },
+#endif
+#if INCLUDE_scrypt
+  /* The cost of these three is not separated from the salt by '$'.  */
+  { "$7$", 0, "$7$", 0, 0 },
+  { "$7$", 6, "$7$", 7, "$7$" },
+  { "$7$", 7, "$7$", 6, 0 },
+#endif
+#if INCLUDE_bsdicrypt
+  { "_", 0, "_", 0, 0 },
+  { "_", 301, "_", 0, "_" },
+  { "_", 1001, "_", 0, 0 },
+#endif
+#if INCLUDE_sha1crypt
+  /* crypt_gensalt_rn picks a slightly different count for each of
+     these two at random, which must not count as out of date.  */
+  { "$sha1", 0, "$sha1", 0, 0 },
+  { "$sha1", 1000, "$sha1", 20000, "$sha1$" },
+  { "$sha1", 20000, "$sha1", 1000, 0 },
+#endif
+#if INCLUDE_sunmd5
+  { "$md5", 0, "$md5", 0, 0 },
+  { "$md5", 0, "$md5", 200000, "$md5,rounds=" },
+  { "$md5", 200000, "$md5", 0, 0 },
+#endif
+#if INCLUDE_descrypt && INCLUDE_sha512crypt
+  { "", 0, "$6$", 0, "$6$" },
+#endif
+};
+
+static int
+test_upgrade (const struct testcase *t)
+{
+  char setting[CRYPT_GENSALT_OUTPUT_SIZE];
+  struct crypt_data data;
+  char stored[CRYPT_OUTPUT_SIZE];
+  char newhash[CRYPT_OUTPUT_SIZE];
+
+  if (!crypt_gensalt_rn (t->old_prefix, t->old_count, 0, 0,
+                         setting, sizeof setting)
+      || !crypt_rn (phrase, setting, &data, sizeof data))
+    {
+      printf ("ERROR: %s/%lu: cannot make the stored hash: %s\n",
+              t->old_prefix, t->old_count, strerror (errno));
+      return 1;
+    }
+  strcpy (stored, data.output);
+
+  /* The wrong passphrase never gets a new hash.  */
+  if (crypt_verify_and_upgrade ("wrong", stored, t->prefix, t->count,
+                                newhash, sizeof newhash) != 0
+      || newhash[0] != '\0')
+    {
+      printf ("FAIL: %s against %s/%lu: wrong passphrase accepted\n",
+              stored, t->prefix, t->count);
+      return 1;
+    }
+
+  int result = crypt_verify_and_upgrade (phrase, stored, t->prefix, t->count,
+                                         newhash, sizeof newhash);
+  if (result != 1)
+    {
+      printf ("FAIL: %s against %s/%lu: returned %d (%s)\n",
+              stored, t->prefix, t->count, result, strerror (errno));
+      return 1;
+    }
+  if (!t->upgraded)
+    {
+      if (newhash[0] != '\0')
+        {
+          printf ("FAIL: %s against %s/%lu: unexpected new hash %s\n",
+                  stored, t->prefix, t->count, newhash);
+          return 1;
+        }
+      return 0;
+    }
+
+  if (strncmp (newhash, t->upgraded, strlen (t->upgraded))
+      || (t->upgraded[strlen (t->upgraded) - 1] == '$'
+          && !strncmp (newhash + strlen (t->upgraded), "rounds=", 7))
+      || crypt_verify (phrase, newhash) != 1)
+    {
+      printf ("FAIL: %s against %s/%lu: bad new hash %s\n",
+              stored, t->prefix, t->count, newhash);
+      return 1;
+    }
+
+  /* The new hash is up to date.  */
+  if (crypt_verify_and_upgrade (phrase, newhash, t->prefix, t->count,
+                                stored, sizeof stored) != 1
+      || stored[0] != '\0')
+    {
+      printf ("FAIL: %s against %s/%lu: upgraded twice\n",
+              newhash, t->prefix, t->count);
+      return 1;
+    }
+  return 0;
+}
+
+struct errcase
+{
+  const char *phrase;
+  const char *hash;
+  const char *prefix;
+  unsigned long count;
+  int newhash_size;
+  int expected_errno;
+};
+
+static const struct errcase errcases[] =
+{
+  { "password", 0, "$6$", 0, CRYPT_OUTPUT_SIZE, EINVAL },
+  { 0, "$1$saltstri$", "$6$", 0, CRYPT_OUTPUT_SIZE, EINVAL },
+  { "password", "*", "$6$", 0, CRYPT_OUTPUT_SIZE, EINVAL },
+  { "password", "!!", "$6$", 0, CRYPT_OUTPUT_SIZE, EINVAL },
+  { "password", "$1$saltstri$", "$unknown$", 0, CRYPT_OUTPUT_SIZE, EINVAL },
+#if INCLUDE_bcrypt
+  { "password", "$1$saltstri$", "$2b$", 3, CRYPT_OUTPUT_SIZE, EINVAL },
+#endif
+  { "password", "$1$saltstri$", "$6$", 0, CRYPT_OUTPUT_SIZE - 1, ERANGE },
+};
+
+static int
+test_errors (void)
+{
+  char newhash[CRYPT_OUTPUT_SIZE];
+  int status = 0;
+  size_t i;
+
+  for (i = 0; i < ARRAY_SIZE (errcases); i++)
+    {
+      const struct errcase *e = &errcases[i];
+      errno = 0;
+      int result = crypt_verify_and_upgrade (e->phrase, e->hash, e->prefix,
+                                             e->count, newhash,
+                                             e->newhash_size);
+      if (result != -1 || errno != e->expected_errno)
+        {
+          printf ("FAIL: %s/%s against %s/%lu: expected -1 (%s), "
+                  "got %d (%s)\n",
+                  e->phrase ? e->phrase : "(null)",
+                  e->hash ? e->hash : "(null)", e->prefix, e->count,
+                  strerror (e->expected_errno), result, strerror (errno));
+          status = 1;
+        }
+    }
+  return status;
+}
+
+/* A null prefix means the preferred method.  */
+static int
+test_default_prefix (void)
+{
+  const char *preferred = crypt_preferred_method ();
+  char setting[CRYPT_GENSALT_OUTPUT_SIZE];
+  char newhash[CRYPT_OUTPUT_SIZE];
+  struct crypt_data data;
+
+  if (!preferred)
+    {
+      errno = 0;
+      if (crypt_verify_and_upgrade (phrase, "$1$saltstri$", 0, 0,
+                                    newhash, sizeof newhash) != -1
+          || errno != EINVAL)
+        {
+          printf ("FAIL: null prefix without a preferred method\n");
+          return 1;
+        }
+      return 0;
+    }
+
+  if (!crypt_gensalt_rn (0, 0, 0, 0, setting, sizeof setting)
+      || !crypt_rn (phrase, setting, &data, sizeof data))
+    {
+      printf ("ERROR: cannot make a hash with the preferred method: %s\n",
+              strerror (errno));
+      return 1;
+    }
+  if (crypt_verify_and_upgrade (phrase, data.output, 0, 0,
+                                newhash, sizeof newhash) != 1
+      || newhash[0] != '\0')
+    {
+      printf ("FAIL: %s against the preferred method\n", data.output);
+      return 1;
+    }
+  return 0;
+}
+
+int
+main (void)
+{
+  int status = 0;
+  size_t i;
+
+  for (i = 0; i < ARRAY_SIZE (testcases); i++)
+    status |= test_upgrade (&testcases[i]);
+  status |= test_errors ();
+  status |= test_default_prefix ();
+  return status;
+}
@@ -0,0 +1,88 @@
+/* Test the cases of crypt_verify that the known-answer tests don't
+   cover: arguments that cannot be hashed, and stored hashes that are
+   really locked-account markers or failure tokens.
+
+   To the extent possible under law, the author(s) have waived all
+   copyright and related or neighboring rights to this work.
+
+   See https://creativecommons.org/publicdomain/zero/1.0/ for further
+   details.  */
+
+#include "crypt-port.h"
+
+#include <errno.h>
+#include <stdio.h>
+
+struct testcase
+{
+  const char *phrase;
+  const char *hash;
+  int expected;
+  int expected_errno;
+};
+
+static const struct testcase testcases[] =
+{
+  /* Null pointers.  */
+  { 0, "$6$saltstring", -1, EINVAL },
+  { "password", 0, -1, EINVAL },
+  /* Markers used in shadow files in place of a hash.  */
+  { "password", "", -1, EINVAL },
+  { "password", "*", -1, EINVAL },
+  { "password", "!", -1, EINVAL },
+  { "password", "!!", -1, EINVAL },
+  { "password", "*LK*", -1, EINVAL },
+  /* Failure tokens must never verify, even against themselves.  */
+  { "password", "*0", -1, EINVAL },
+  { "password", "*1", -1, EINVAL },
+  /* Unknown method.  */
+  { "password", "$unknown$salt$hash", -1, EINVAL },
+#if INCLUDE_sha512crypt
+  /* A setting with no hash part never matches.  */
+  { "Hello world!", "$6$saltstring", 0, 0 },
+  { "Hello world!", "$6$saltstring$svn8UoSVapNtMuq1ukKS4tPQd8iKwSMHWjl/O817G3uBnIFNjnQJuesI68u4OTLiBFdcbYEdFCoEOfaS35inz1", 1, 0 },
+  /* Trailing garbage after the hash.  */
+  { "Hello world!", "$6$saltstring$svn8UoSVapNtMuq1ukKS4tPQd8iKwSMHWjl/O817G3uBnIFNjnQJuesI68u4OTLiBFdcbYEdFCoEOfaS35inz1x", 0, 0 },
+#endif
+};
+
+int
+main (void)
+{
+  int status = 0;
+  size_t i;
+
+  for (i = 0; i < ARRAY_SIZE (testcases); i++)
+    {
+      const struct testcase *t = &testcases[i];
+      errno = 0;
+      int result = crypt_verify (t->phrase, t->hash);
+      int err = errno;
+      if (result != t->expected
+          || (t->expected_errno && err != t->expected_errno))
+        {
+          printf ("FAIL: %s/%s: expected %d", t->phrase ? t->phrase : "(null)",
+                  t->hash ? t->hash : "(null)", t->expected);
+          if (t->expected_errno)
+            printf (" (%s)", strerror (t->expected_errno));
+          printf (", got %d", result);
+          if (result == -1)
+            printf (" (%s)", strerror (err));
+          putchar ('\n');
+          status = 1;
+        }
+    }
+
+  /* An overlong passphrase is refused.  */
+  char phrase[CRYPT_MAX_PASSPHRASE_SIZE + 1];
+  memset (phrase, 'a', sizeof phrase - 1);
+  phrase[sizeof phrase - 1] = '\0';
+  errno = 0;
+  if (crypt_verify (phrase, "$1$saltstri$") != -1 || errno != ERANGE)
+    {
+      printf ("FAIL: overlong passphrase not rejected with ERANGE\n");
+      status = 1;
+    }
+
+  return status;
+}
@@ -0,0 +1,138 @@
+/* Test that yescrypt-family hashes come out the same when computed
+   one after another with different memory costs, in one thread and
+   in several, so that reusing a thread's memory between calls (see
+   --enable-yescrypt-cache) cannot leak state from one hash into the
+   next.
+
+   To the extent possible under law, the author(s) have waived all
+   copyright and related or neighboring rights to this work.
+
+   See https://creativecommons.org/publicdomain/zero/1.0/ for further
+   details.  */
+
+#include "crypt-port.h"
+
+#include <stdio.h>
+
+#if INCLUDE_yescrypt || INCLUDE_gost_yescrypt || INCLUDE_sm3_yescrypt
+
+#if ENABLE_YESCRYPT_CACHE
+#include <pthread.h>
+#endif
+
+struct testcase
+{
+  const char *phrase;
+  const char *expected;
+};
+
+/* From ka-table.inc.  Listed so that each hash needs a different
+   amount of memory from the one before it.  */
+static const struct testcase testcases[] =
+{
+#if INCLUDE_yescrypt
+  { "", "$y$j75$.......$/FQush7wojITE6a6KwAF4pUyKZAyYRCYJdWcgqjTeS7" },
+  { "", "$y$j85$LdJMENpBABJJ3hIHjB1Bi.$vBgoYm4d1h/QcOpqPPYz9LsGfXN2mCFVKmYuethZ796" },
+  { " ", "$y$j75$.......$7sY4klKrG.spYAfDnzO4mVv8pcnkbXLPbRu8mK9c3OB" },
+#endif
+#if INCLUDE_gost_yescrypt
+  { "", "$gy$j85$.......$qcWboYF3QMRz3e9REHJfozixjIKov0Uujf7BEu2ZZB2" },
+  { "", "$gy$j75$LdJMENpBABJJ3hIHjB1Bi.$VIvMlb2yKp1wnlflMAxutM8UsAjZPD6dcXHT0nL2UP6" },
+#endif
+#if INCLUDE_yescrypt
+  { "", "$y$j85$.......$zzMmbb9N2eIInsJNTpiAwUZmq5hS27wfdyT35REbpjC" },
+  { "", "$y$j75$LdJMENpBABJJ3hIHjB1Bi.$tUlUF19mIl6XpRTpX7LBp5ABKS8KSmDfP1gXFrZ6Sy8" },
+#endif
+};
+
+/* Hash every test case, forward and then backward, and report any
+   that come out wrong.  */
+static int
+run_testcases (const char *tag)
+{
+  struct crypt_data data;
+  size_t i, n;
+  int result = 0;
+
+  for (n = 0; n < 2 * ARRAY_SIZE (testcases); n++)
+    {
+      i = n < ARRAY_SIZE (testcases) ? n : 2 * ARRAY_SIZE (testcases) - 1 - n;
+      const struct testcase *t = &testcases[i];
+      char *hash = crypt_rn (t->phrase, t->expected, &data, sizeof data);
+      if (!hash || strcmp (hash, t->expected))
+        {
+          printf ("FAIL: %s: \"%s\", %s\n  got: %s\n", tag,
+                  t->phrase, t->expected, hash ? hash : "(null)");
+          result = 1;
+        }
+    }
+  return result;
+}
+
+#if ENABLE_YESCRYPT_CACHE
+struct thread_arg
+{
+  const char *tag;
+  int result;
+};
+
+static void *
+thread_main (void *arg)
+{
+  struct thread_arg *ta = arg;
+  ta->result = run_testcases (ta->tag);
+  return NULL;
+}
+#endif
+
+int
+main (void)
+{
+  int result = 0;
+
+  result |= run_testcases ("main thread");
+
+#if ENABLE_YESCRYPT_CACHE
+  /* Each thread gets memory of its own, and gives it back when it
+     exits.  */
+  struct thread_arg args[] =
+  {
+    { "thread 1", 0 },
+    { "thread 2", 0 },
+    { "thread 3", 0 },
+  };
+  pthread_t threads[ARRAY_SIZE (args)];
+  size_t i;
+
+  for (i = 0; i < ARRAY_SIZE (args); i++)
+    if (pthread_create (&threads[i], NULL, thread_main, &args[i]))
+      {
+        printf ("ERROR: pthread_create failed\n");
+        return 99;
+      }
+  for (i = 0; i < ARRAY_SIZE (args); i++)
+    {
+      if (pthread_join (threads[i], NULL))
+        {
+          printf ("ERROR: pthread_join failed\n");
+          return 99;
+        }
+      result |= args[i].result;
+    }
+#endif
+
+  /* And again, with the main thread's memory still kept around.  */
+  result |= run_testcases ("main thread, again");
+
+  return result;
+}
+
+#else
+
+int
+main (void)
+{
+  return 77; /* UNSUPPORTED */
+}
+
+#endif
@@ -0,0 +1,229 @@
+/* Test crypt_yescrypt_memory_limit and crypt_yescrypt_memory_usage:
+   that the memory used by yescrypt hashes is accounted for, that a
+   hash that would go over the limit fails with EAGAIN or waits,
+   according to the policy, and that hashes computed by several
+   threads under a limit never use more than it allows.  Where ld --wrap
+   is available, also check that memory which fails to be unmapped is
+   no longer counted.
+
+   To the extent possible under law, the author(s) have waived all
+   copyright and related or neighboring rights to this work.
+
+   See https://creativecommons.org/publicdomain/zero/1.0/ for further
+   details.  */
+
+#include "crypt-port.h"
+
+#include <errno.h>
+#include <stdio.h>
+
+#if INCLUDE_yescrypt
+
+#if ENABLE_YESCRYPT_MEMORY_LIMIT
+#include <pthread.h>
+
+#define NTHREADS 4
+#define NHASHES 3
+#endif
+
+static const char phrase[] = "correct horse battery staple";
+static char setting[CRYPT_GENSALT_OUTPUT_SIZE];
+static char expected[CRYPT_OUTPUT_SIZE];
+
+#ifdef HAVE_LD_WRAP
+/* Volatile, because the compiler may assume that crypt_rn doesn't
+   call back into this file.  */
+static volatile bool munmap_should_fail = false;
+static volatile unsigned int munmap_failures;
+
+extern int __real_munmap (void *, size_t);
+extern int __wrap_munmap (void *, size_t);
+int
+__wrap_munmap (void *addr, size_t len)
+{
+  if (munmap_should_fail)
+    {
+      /* Unmap the memory all the same, so that only the accounting
+         can go wrong.  */
+      __real_munmap (addr, len);
+      munmap_failures++;
+      errno = EINVAL;
+      return -1;
+    }
+  return __real_munmap (addr, len);
+}
+#endif
+
+#if ENABLE_YESCRYPT_MEMORY_LIMIT
+static void *
+hash_thread (void *arg)
+{
+  int *failed = arg;
+  struct crypt_data data;
+  int i;
+
+  for (i = 0; i < NHASHES; i++)
+    if (!crypt_rn (phrase, setting, &data, sizeof data)
+        || strcmp (data.output, expected))
+      *failed = 1;
+  return 0;
+}
+
+/* Hash in NTHREADS threads at once with room for only one hash at a
+   time, and check that all hashes come out right and the limit
+   held.  */
+static int
+test_threads (int policy, const char *tag, unsigned long hash_size)
+{
+  pthread_t threads[NTHREADS];
+  int failed[NTHREADS] = { 0 };
+  unsigned long limit = hash_size + hash_size / 2, current, peak;
+  int result = 0;
+  size_t i;
+
+  if (crypt_yescrypt_memory_limit (limit, policy))
+    {
+      printf ("FAIL: %s: cannot set the limit: %s\n", tag, strerror (errno));
+      return 1;
+    }
+  for (i = 0; i < NTHREADS; i++)
+    if (pthread_create (&threads[i], 0, hash_thread, &failed[i]))
+      {
+        printf ("ERROR: %s: pthread_create failed\n", tag);
+        return 1;
+      }
+  for (i = 0; i < NTHREADS; i++)
+    {
+      pthread_join (threads[i], 0);
+      if (failed[i])
+        {
+          printf ("FAIL: %s: thread %zu got a wrong hash\n", tag, i);
+          result = 1;
+        }
+    }
+
+  crypt_yescrypt_memory_usage (&current, &peak);
+  if (current != 0 || peak > limit)
+    {
+      printf ("FAIL: %s: %lu bytes in use, peak %lu, limit %lu\n",
+              tag, current, peak, limit);
+      result = 1;
+    }
+  crypt_yescrypt_memory_limit (0, CRYPT_YESCRYPT_MEMORY_FAIL);
+  return result;
+}
+#endif
+
+int
+main (void)
+{
+  struct crypt_data data;
+  unsigned long current, peak;
+  int result = 0;
+
+  if (!crypt_gensalt_rn ("$y$", 1, 0, 0, setting, sizeof setting)
+      || !crypt_rn (phrase, setting, &data, sizeof data))
+    {
+      printf ("ERROR: cannot hash with %s: %s\n", setting, strerror (errno));
+      return 1;
+    }
+  strcpy (expected, data.output);
+
+  if (crypt_yescrypt_memory_usage (&current, &peak)
+      || peak < (1UL << 20) || current > peak)
+    {
+      printf ("FAIL: after one hash: %lu bytes in use, peak %lu\n",
+              current, peak);
+      return 1;
+    }
+  /* Nothing else in this process has used yescrypt.  */
+  unsigned long hash_size = peak;
+
+#if defined HAVE_LD_WRAP && !ENABLE_YESCRYPT_CACHE
+  /* A hash whose memory can't be unmapped fails, but must not leave
+     that memory charged against the budget.  If libcrypt is linked
+     dynamically, ld --wrap can't reach its calls to munmap, and this
+     hash just succeeds.  */
+  munmap_should_fail = true;
+  crypt_rn (phrase, setting, &data, sizeof data);
+  munmap_should_fail = false;
+  crypt_yescrypt_memory_usage (&current, 0);
+  if (munmap_failures && current != 0)
+    {
+      printf ("FAIL: %lu bytes still in use after munmap failed\n",
+              current);
+      result = 1;
+    }
+#endif
+
+#if ENABLE_YESCRYPT_MEMORY_LIMIT
+  errno = 0;
+  if (crypt_yescrypt_memory_limit (0, 3) != -1 || errno != EINVAL)
+    {
+      printf ("FAIL: bad policy not rejected with EINVAL\n");
+      result = 1;
+    }
+
+  /* A hash larger than the limit fails, whatever the policy.  */
+  static const int policies[] =
+  {
+    CRYPT_YESCRYPT_MEMORY_FAIL,
+    CRYPT_YESCRYPT_MEMORY_BLOCK,
+    CRYPT_YESCRYPT_MEMORY_QUEUE,
+  };
+  size_t i;
+  for (i = 0; i < ARRAY_SIZE (policies); i++)
+    {
+      crypt_yescrypt_memory_limit (hash_size / 2, policies[i]);
+      errno = 0;
+      if (crypt_rn (phrase, setting, &data, sizeof data) || errno != EAGAIN)
+        {
+          printf ("FAIL: policy %d: hash over the limit not rejected "
+                  "with EAGAIN\n", policies[i]);
+          result = 1;
+        }
+    }
+
+  /* With no limit, hashes work again.  */
+  crypt_yescrypt_memory_limit (0, CRYPT_YESCRYPT_MEMORY_FAIL);
+  if (!crypt_rn (phrase, setting, &data, sizeof data)
+      || strcmp (data.output, expected))
+    {
+      printf ("FAIL: hash after removing the limit\n");
+      result = 1;
+    }
+
+  /* The memory cached by this thread, if any, is released by the next
+     hash under a limit; make sure that happens before the threads
+     start.  */
+  crypt_yescrypt_memory_limit (hash_size, CRYPT_YESCRYPT_MEMORY_FAIL);
+  if (!crypt_rn (phrase, setting, &data, sizeof data)
+      || strcmp (data.output, expected))
+    {
+      printf ("FAIL: hash exactly at the limit\n");
+      result = 1;
+    }
+
+  result |= test_threads (CRYPT_YESCRYPT_MEMORY_BLOCK, "block", hash_size);
+  result |= test_threads (CRYPT_YESCRYPT_MEMORY_QUEUE, "queue", hash_size);
+#else
+  errno = 0;
+  if (crypt_yescrypt_memory_limit (hash_size, CRYPT_YESCRYPT_MEMORY_FAIL)
+      != -1 || errno != ENOSYS)
+    {
+      printf ("FAIL: memory limit without --enable-yescrypt-memory-limit\n");
+      result = 1;
+    }
+#endif
+  return result;
+}
+
+#else
+
+int
+main (void)
+{
+  return 77; /* UNSUPPORTED */
+}
+
+#endif
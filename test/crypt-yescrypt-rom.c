@@ -0,0 +1,328 @@
+/* Test crypt_yescrypt_rom_build, crypt_yescrypt_rom_load and
+   crypt_yescrypt_rom_unload: that settings generated while a ROM is
+   loaded ask for it, that hashes using it can only be checked while
+   it is loaded, and that hashes not using it are unaffected.  When
+   linked statically, also test that a ROM a hash is still using
+   outlives its unloading.
+
+   To the extent possible under law, the author(s) have waived all
+   copyright and related or neighboring rights to this work.
+
+   See https://creativecommons.org/publicdomain/zero/1.0/ for further
+   details.  */
+
+#include "crypt-port.h"
+#ifdef TEST_ROM_INTERNALS
+#include "alg-yescrypt.h"
+#endif
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#if INCLUDE_yescrypt && defined __unix__
+
+#define ROM_SEED "libxcrypt test ROM"
+
+/* Fixed bytes for crypt_gensalt, so that the settings, and thus the
+   hashes, are the same every time.  */
+static const char rbytes[16] = "0123456789abcdef";
+
+struct testcase
+{
+  const char *prefix;
+  unsigned long count;
+  const char *expected;
+};
+
+/* Computed with a 1 MiB ROM built from ROM_SEED.  */
+static const struct testcase testcases[] =
+{
+  { "$y$", 1, "$y$j7557$k2XAnEHBqQ1Ct2aMXFKNa/$HQDRRLRt5bJgA0qWw3xdRAtupWdAt/go4xVQ1OfjLD2" },
+  { "$y$", 5, "$y$j9T55$k2XAnEHBqQ1Ct2aMXFKNa/$TWF6da5jMpFQ0IDMBRhO.N5G/VnQ1QgWxSzz4jbdsi." },
+#if INCLUDE_gost_yescrypt
+  { "$gy$", 1, "$gy$j7557$k2XAnEHBqQ1Ct2aMXFKNa/$chdppHp2evZzn58P4eLZPsz4pS5qtImhvJ9v0oiwQU5" },
+#endif
+#if INCLUDE_sm3_yescrypt
+  { "$sm3y$", 1, "$sm3y$j7557$k2XAnEHBqQ1Ct2aMXFKNa/$z.DSAs/Gcb.t8kJE5doKUn/80LQx4kVxxg.DjYwxsv0" },
+#endif
+};
+
+static int
+check_verify (const char *tag, const char *phrase, const char *hash,
+              int expected)
+{
+  int r = crypt_verify (phrase, hash);
+  if (r != expected)
+    {
+      printf ("FAIL: %s: crypt_verify (\"%s\", %s) = %d, expected %d\n",
+              tag, phrase, hash, r, expected);
+      return 1;
+    }
+  return 0;
+}
+
+/* Generate a setting with PREFIX and COUNT, and check that it does or
+   does not ask for a ROM, as WANT_ROM says.  */
+static int
+check_gensalt (const char *prefix, unsigned long count, bool want_rom,
+               char *setting)
+{
+  if (!crypt_gensalt_rn (prefix, count, rbytes, sizeof rbytes,
+                         setting, CRYPT_GENSALT_OUTPUT_SIZE))
+    {
+      printf ("FAIL: crypt_gensalt_rn (%s, %lu) failed: %s\n", prefix,
+              count, strerror (errno));
+      return 1;
+    }
+  /* The settings generated here only have flavor, N and r, unless
+     NROM follows them.  */
+  const char *params = setting + strlen (prefix);
+  bool has_rom = strcspn (params, "$") > 3;
+  if (has_rom != want_rom)
+    {
+      printf ("FAIL: setting %s %s a ROM\n", setting,
+              has_rom ? "asks for" : "does not ask for");
+      return 1;
+    }
+  return 0;
+}
+
+/* Write a file of SIZE bytes of FILL at PATH.  */
+static int
+write_file (const char *path, size_t size, unsigned char fill)
+{
+  char buf[4096];
+  FILE *f = fopen (path, "wb");
+  if (!f)
+    return -1;
+  memset (buf, fill, sizeof buf);
+  while (size > 0)
+    {
+      size_t n = size < sizeof buf ? size : sizeof buf;
+      if (fwrite (buf, 1, n, f) != n)
+        break;
+      size -= n;
+    }
+  return fclose (f) || size ? -1 : 0;
+}
+
+static int
+check_load_fails (const char *tag, const char *path)
+{
+  errno = 0;
+  if (crypt_yescrypt_rom_load (path) != -1 || errno != EINVAL)
+    {
+      printf ("FAIL: %s: crypt_yescrypt_rom_load did not fail with"
+              " EINVAL\n", tag);
+      return 1;
+    }
+  return 0;
+}
+
+#ifdef TEST_ROM_INTERNALS
+/* Hold the loaded ROM the way a hash does, and unload it meanwhile:
+   unloading must not wait for the hash, and must leave the ROM mapped
+   until the hash is done with it.  Loading it again must reuse the
+   bookkeeping of the unloaded ROM.  */
+static int
+check_held_rom (const char *rom_path)
+{
+  yescrypt_shared_t *held = acquire_yescrypt_rom ();
+  yescrypt_shared_t *again;
+  const uint64_t *tag;
+  int result = 0;
+
+  if (!held)
+    {
+      printf ("FAIL: held ROM: no ROM loaded\n");
+      return 1;
+    }
+  if (crypt_yescrypt_rom_unload ())
+    {
+      printf ("FAIL: held ROM: crypt_yescrypt_rom_unload: %s\n",
+              strerror (errno));
+      result = 1;
+    }
+  if (acquire_yescrypt_rom ())
+    {
+      printf ("FAIL: held ROM: still found after unloading\n");
+      result = 1;
+    }
+  tag = (const uint64_t *)
+    ((const uint8_t *) held->aligned + held->aligned_size - 48);
+  if (tag[0] != YESCRYPT_ROM_TAG1 || tag[1] != YESCRYPT_ROM_TAG2)
+    {
+      printf ("FAIL: held ROM: changed after unloading\n");
+      result = 1;
+    }
+  release_yescrypt_rom (held);
+
+  if (crypt_yescrypt_rom_load (rom_path))
+    {
+      printf ("FAIL: held ROM: crypt_yescrypt_rom_load: %s\n",
+              strerror (errno));
+      return 1;
+    }
+  again = acquire_yescrypt_rom ();
+  if (again != held)
+    {
+      printf ("FAIL: held ROM: not reused by the next load\n");
+      result = 1;
+    }
+  release_yescrypt_rom (again);
+  return result;
+}
+#endif
+
+int
+main (void)
+{
+  char rom_path[] = "crypt-yescrypt-rom.XXXXXX";
+  char bad_path[] = "crypt-yescrypt-rom-bad.XXXXXX";
+  char setting[CRYPT_GENSALT_OUTPUT_SIZE];
+  char plain[CRYPT_OUTPUT_SIZE];
+  struct crypt_data data;
+  const char *hash;
+  size_t i;
+  int fd, result = 0;
+
+  /* crypt_yescrypt_rom_build refuses to overwrite a file, so reserve
+     a name and remove the file again.  */
+  fd = mkstemp (rom_path);
+  if (fd == -1)
+    {
+      printf ("ERROR: mkstemp: %s\n", strerror (errno));
+      return 99;
+    }
+  close (fd);
+  unlink (rom_path);
+
+  /* A hash that does not use a ROM.  */
+  if (check_gensalt ("$y$", 1, false, setting))
+    return 1;
+  hash = crypt_rn ("plain", setting, &data, sizeof data);
+  if (!hash || hash[0] == '*')
+    {
+      printf ("FAIL: hashing without a ROM failed\n");
+      return 1;
+    }
+  strcpy (plain, hash);
+
+  errno = 0;
+  if (crypt_yescrypt_rom_build (rom_path, ROM_SEED, sizeof ROM_SEED - 1,
+                                19) != -1 || errno != EINVAL)
+    {
+      printf ("FAIL: a ROM smaller than 1 MiB was built\n");
+      result = 1;
+    }
+  if (crypt_yescrypt_rom_build (rom_path, ROM_SEED, sizeof ROM_SEED - 1, 20))
+    {
+      printf ("ERROR: crypt_yescrypt_rom_build: %s\n", strerror (errno));
+      return 99;
+    }
+  errno = 0;
+  if (crypt_yescrypt_rom_build (rom_path, ROM_SEED, sizeof ROM_SEED - 1,
+                                20) != -1 || errno != EEXIST)
+    {
+      printf ("FAIL: crypt_yescrypt_rom_build replaced an existing file\n");
+      result = 1;
+    }
+
+  if (crypt_yescrypt_rom_load (rom_path))
+    {
+      printf ("FAIL: crypt_yescrypt_rom_load: %s\n", strerror (errno));
+      unlink (rom_path);
+      return 1;
+    }
+
+  for (i = 0; i < ARRAY_SIZE (testcases); i++)
+    {
+      const struct testcase *t = &testcases[i];
+      if (check_gensalt (t->prefix, t->count, true, setting))
+        {
+          result = 1;
+          continue;
+        }
+      hash = crypt_rn ("rom", setting, &data, sizeof data);
+      if (!hash || strcmp (hash, t->expected))
+        {
+          printf ("FAIL: %s\n  expected: %s\n       got: %s\n", setting,
+                  t->expected, hash ? hash : "(null)");
+          result = 1;
+        }
+      result |= check_verify ("loaded", "rom", t->expected, 1);
+      result |= check_verify ("loaded", "wrong", t->expected, 0);
+    }
+  result |= check_verify ("loaded", "plain", plain, 1);
+
+  /* Hashes that ask for a ROM can't be checked without it, but others
+     can.  */
+  if (crypt_yescrypt_rom_unload ())
+    {
+      printf ("FAIL: crypt_yescrypt_rom_unload: %s\n", strerror (errno));
+      result = 1;
+    }
+  for (i = 0; i < ARRAY_SIZE (testcases); i++)
+    result |= check_verify ("unloaded", "rom", testcases[i].expected, -1);
+  result |= check_verify ("unloaded", "plain", plain, 1);
+  result |= check_gensalt ("$y$", 1, false, setting);
+
+  /* Loading the ROM again, over itself, brings them back.  */
+  if (crypt_yescrypt_rom_load (rom_path) || crypt_yescrypt_rom_load (rom_path))
+    {
+      printf ("FAIL: crypt_yescrypt_rom_load again: %s\n", strerror (errno));
+      result = 1;
+    }
+  for (i = 0; i < ARRAY_SIZE (testcases); i++)
+    result |= check_verify ("reloaded", "rom", testcases[i].expected, 1);
+
+  /* Files that are not ROMs are refused, and leave the loaded one.  */
+  fd = mkstemp (bad_path);
+  if (fd == -1)
+    {
+      printf ("ERROR: mkstemp: %s\n", strerror (errno));
+      result = 99;
+    }
+  else
+    {
+      close (fd);
+      if (write_file (bad_path, 1024 * 1024, 0))
+        {
+          printf ("ERROR: writing %s failed\n", bad_path);
+          result = 99;
+        }
+      else
+        result |= check_load_fails ("untagged file", bad_path);
+      if (write_file (bad_path, 1024 * 1024 + 4096, 0))
+        {
+          printf ("ERROR: writing %s failed\n", bad_path);
+          result = 99;
+        }
+      else
+        result |= check_load_fails ("odd-sized file", bad_path);
+      unlink (bad_path);
+    }
+  result |= check_verify ("after bad load", "rom", testcases[0].expected, 1);
+
+#ifdef TEST_ROM_INTERNALS
+  result |= check_held_rom (rom_path);
+  result |= check_verify ("held and reloaded", "rom",
+                          testcases[0].expected, 1);
+#endif
+
+  crypt_yescrypt_rom_unload ();
+  unlink (rom_path);
+  return result;
+}
+
+#else
+
+int
+main (void)
+{
+  return 77; /* UNSUPPORTED */
+}
+
+#endif
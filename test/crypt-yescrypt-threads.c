@@ -0,0 +1,156 @@
+/* Test yescrypt and scrypt hashes with p > 1, whose lanes are computed
+   in parallel when --enable-yescrypt-threads is in use: from one thread,
+   from several threads at once (so that some of them find the pool
+   busy), and in a child process forked after the pool was started.
+
+   To the extent possible under law, the author(s) have waived all
+   copyright and related or neighboring rights to this work.
+
+   See https://creativecommons.org/publicdomain/zero/1.0/ for further
+   details.  */
+
+#include "crypt-port.h"
+
+#include <stdio.h>
+
+#if INCLUDE_yescrypt || INCLUDE_scrypt
+
+#if ENABLE_YESCRYPT_THREADS
+#include <pthread.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+struct testcase
+{
+  const char *phrase;
+  const char *expected;
+};
+
+/* Computed with the serial code.  */
+static const struct testcase testcases[] =
+{
+#if INCLUDE_yescrypt
+  /* p = 2, 4, 3 (with t = 1), and YESCRYPT_WORM with p = 4.  */
+  { "pleaseletmein", "$y$j95..$n34PoBLMgFrQVl4Rn34Po/$7T69RVM9pldc.ZcYkzhcM3L259hBGZNmEFed61GEnM7" },
+  { "pleaseletmein", "$y$j95.0$n34PoBLMgFrQVl4Rn34Po/$AN2Ge3jkV3tzim5DAwB9n1BTp3ccKDNAw6anOtBqil1" },
+  { "pleaseletmein", "$y$j810/.$n34PoBLMgFrQVl4Rn34Po/$pTPIoFM5CnsW2ibtrJYGIMWrdlwihuE3UrSu2jbIx63" },
+  { "pleaseletmein", "$y$/75.0$n34PoBLMgFrQVl4Rn34Po/$grJ66yVd3NCNBk6DRz6l42zYvm8/lnr/G2DmegKtr07" },
+#endif
+#if INCLUDE_scrypt
+  { "password", "$7$A6....1....TrolololoSalt$A1sjhSwzRhCuuwTWLohMakIG6feyWEeT9OtoYqro5./" },
+  { "password", "$7$86....E....NaCl$xffjQo7Bm/.SKRS4B2EuynbOLjAmXU5AbDbRXhoBl64" },
+#endif
+};
+
+static int
+run_testcases (const char *tag)
+{
+  struct crypt_data data;
+  size_t i;
+  int result = 0;
+
+  for (i = 0; i < ARRAY_SIZE (testcases); i++)
+    {
+      const struct testcase *t = &testcases[i];
+      char *hash = crypt_rn (t->phrase, t->expected, &data, sizeof data);
+      if (!hash || strcmp (hash, t->expected))
+        {
+          printf ("FAIL: %s: \"%s\", %s\n  got: %s\n", tag,
+                  t->phrase, t->expected, hash ? hash : "(null)");
+          result = 1;
+        }
+    }
+  return result;
+}
+
+#if ENABLE_YESCRYPT_THREADS
+struct thread_arg
+{
+  const char *tag;
+  int result;
+};
+
+static void *
+thread_main (void *arg)
+{
+  struct thread_arg *ta = arg;
+  ta->result = run_testcases (ta->tag);
+  return NULL;
+}
+#endif
+
+int
+main (void)
+{
+  int result = 0;
+
+#if ENABLE_YESCRYPT_THREADS
+  /* Use a pool even if this machine has only one CPU.  This must be set
+     before the first hash, which starts the pool.  */
+  setenv ("LIBXCRYPT_YESCRYPT_THREADS", "4", 1);
+#endif
+
+  result |= run_testcases ("main thread");
+
+#if ENABLE_YESCRYPT_THREADS
+  struct thread_arg args[] =
+  {
+    { "thread 1", 0 },
+    { "thread 2", 0 },
+    { "thread 3", 0 },
+  };
+  pthread_t threads[ARRAY_SIZE (args)];
+  size_t i;
+
+  for (i = 0; i < ARRAY_SIZE (args); i++)
+    if (pthread_create (&threads[i], NULL, thread_main, &args[i]))
+      {
+        printf ("ERROR: pthread_create failed\n");
+        return 99;
+      }
+  for (i = 0; i < ARRAY_SIZE (args); i++)
+    {
+      if (pthread_join (threads[i], NULL))
+        {
+          printf ("ERROR: pthread_join failed\n");
+          return 99;
+        }
+      result |= args[i].result;
+    }
+
+  /* The child of a fork has none of the pool's workers, and must not
+     wait for them.  */
+  fflush (stdout);
+  pid_t pid = fork ();
+  if (pid == -1)
+    {
+      printf ("ERROR: fork failed\n");
+      return 99;
+    }
+  if (pid == 0)
+    _exit (run_testcases ("forked child"));
+
+  int wstatus;
+  if (waitpid (pid, &wstatus, 0) != pid)
+    {
+      printf ("ERROR: waitpid failed\n");
+      return 99;
+    }
+  if (!WIFEXITED (wstatus) || WEXITSTATUS (wstatus) != 0)
+    result = 1;
+#endif
+
+  return result;
+}
+
+#else
+
+int
+main (void)
+{
+  return 77; /* UNSUPPORTED */
+}
+
+#endif
@@ -0,0 +1,196 @@
+/* Test crypt_gensalt_calibrate: that it makes usable settings for the
+   method asked for, that a longer target never gives a cheaper
+   setting, that it stays within the memory budget, and that it
+   rejects what it can't calibrate.
+
+   Nothing here depends on how fast this machine is, since timings are
+   cached and all calls for one method see the same ones.
+
+   To the extent possible under law, the author(s) have waived all
+   copyright and related or neighboring rights to this work.
+
+   See https://creativecommons.org/publicdomain/zero/1.0/ for further
+   details.  */
+
+#include "crypt-port.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static const char *const prefixes[] =
+{
+#if INCLUDE_yescrypt
+  "$y$",
+#endif
+#if INCLUDE_scrypt
+  "$7$",
+#endif
+#if INCLUDE_bcrypt
+  "$2b$",
+#endif
+#if INCLUDE_sha512crypt
+  "$6$",
+#endif
+#if INCLUDE_sha256crypt
+  "$5$",
+#endif
+};
+
+/* The part of SETTING before the salt.  */
+static size_t
+params_len (const char *setting)
+{
+  const char *last = strrchr (setting, '$');
+  return last ? (size_t) (last - setting) + 1 : 0;
+}
+
+/* The cost of SETTING, from the count it was generated with: found by
+   generating settings for every count until one has the same
+   parameters.  */
+static unsigned long
+setting_count (const char *prefix, const char *setting)
+{
+  static const char rbytes[64];
+  char other[CRYPT_GENSALT_OUTPUT_SIZE];
+  unsigned long count;
+  size_t len = params_len (setting);
+
+  /* Counts that are rounds are spelled out in the setting, unless
+     they are the default of 5000.  */
+  const char *rounds = strstr (setting, "rounds=");
+  if (rounds)
+    return strtoul (rounds + 7, 0, 10);
+  if (!strcmp (prefix, "$5$") || !strcmp (prefix, "$6$"))
+    return 5000;
+
+  for (count = 1; count < 32; count++)
+    if (crypt_gensalt_rn (prefix, count, rbytes, sizeof rbytes,
+                          other, sizeof other)
+        && params_len (other) == len && !strncmp (other, setting, len))
+      return count;
+  return 0;
+}
+
+static int
+test_method (const char *prefix)
+{
+  static const unsigned int targets[] = { 1, 5, 25 };
+  char setting[CRYPT_GENSALT_OUTPUT_SIZE];
+  struct crypt_data data;
+  unsigned long last = 0;
+  size_t i;
+
+  for (i = 0; i < ARRAY_SIZE (targets); i++)
+    {
+      if (!crypt_gensalt_calibrate (prefix, targets[i], 0,
+                                    setting, sizeof setting))
+        {
+          printf ("FAIL: %s/%u ms: %s\n", prefix, targets[i],
+                  strerror (errno));
+          return 1;
+        }
+      if (strncmp (setting, prefix, strlen (prefix))
+          || !crypt_rn ("password", setting, &data, sizeof data))
+        {
+          printf ("FAIL: %s/%u ms: bad setting %s\n", prefix, targets[i],
+                  setting);
+          return 1;
+        }
+      unsigned long count = setting_count (prefix, setting);
+      if (count < last)
+        {
+          printf ("FAIL: %s: %u ms gives a cheaper setting (%s) than %u ms\n",
+                  prefix, targets[i], setting, targets[i - 1]);
+          return 1;
+        }
+      last = count;
+    }
+  return 0;
+}
+
+#if INCLUDE_yescrypt
+/* With a budget of 2 MiB and all the time in the world, yescrypt must
+   use 2 MiB.  */
+static int
+test_memory (void)
+{
+  char setting[CRYPT_GENSALT_OUTPUT_SIZE];
+
+  if (!crypt_gensalt_calibrate ("$y$", 100000, 2UL << 20,
+                                setting, sizeof setting))
+    {
+      printf ("FAIL: $y$ with 2 MiB: %s\n", strerror (errno));
+      return 1;
+    }
+  if (setting_count ("$y$", setting) != 2)
+    {
+      printf ("FAIL: $y$ with 2 MiB: got %s\n", setting);
+      return 1;
+    }
+
+  errno = 0;
+  if (crypt_gensalt_calibrate ("$y$", 100, 1024, setting, sizeof setting)
+      || errno != EINVAL)
+    {
+      printf ("FAIL: $y$ with 1 KiB: not rejected with EINVAL\n");
+      return 1;
+    }
+  return 0;
+}
+#endif
+
+static int
+test_errors (void)
+{
+  char setting[CRYPT_GENSALT_OUTPUT_SIZE];
+  int status = 0;
+
+  errno = 0;
+  if (crypt_gensalt_calibrate ("$unknown$", 100, 0, setting, sizeof setting)
+      || errno != EINVAL)
+    {
+      printf ("FAIL: unknown method not rejected with EINVAL\n");
+      status = 1;
+    }
+#if INCLUDE_md5crypt
+  /* md5crypt has no tunable cost.  */
+  errno = 0;
+  if (crypt_gensalt_calibrate ("$1$", 100, 0, setting, sizeof setting)
+      || errno != EINVAL)
+    {
+      printf ("FAIL: $1$ not rejected with EINVAL\n");
+      status = 1;
+    }
+#endif
+  errno = 0;
+  if (crypt_gensalt_calibrate (0, 0, 0, setting, sizeof setting)
+      || errno != EINVAL)
+    {
+      printf ("FAIL: zero target not rejected with EINVAL\n");
+      status = 1;
+    }
+  errno = 0;
+  if (crypt_gensalt_calibrate (0, 100, 0, setting, 2) || errno != ERANGE
+      || setting[0] != '*')
+    {
+      printf ("FAIL: short output not rejected with ERANGE\n");
+      status = 1;
+    }
+  return status;
+}
+
+int
+main (void)
+{
+  int status = 0;
+  size_t i;
+
+  for (i = 0; i < ARRAY_SIZE (prefixes); i++)
+    status |= test_method (prefixes[i]);
+#if INCLUDE_yescrypt
+  status |= test_memory ();
+#endif
+  status |= test_errors ();
+  return status;
+}
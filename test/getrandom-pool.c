@@ -0,0 +1,226 @@
+/* Test get_random_bytes_pooled: that it has the same interface as
+   get_random_bytes, that it doesn't repeat itself, and that threads,
+   and processes created by fork, don't get the same bytes as each
+   other.
+
+   To the extent possible under law, the author(s) have waived all
+   copyright and related or neighboring rights to this work.
+
+   See https://creativecommons.org/publicdomain/zero/1.0/ for further
+   details.  */
+
+#include "crypt-port.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#if ENABLE_RANDOM_POOL && defined __unix__
+
+#include <pthread.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define CHUNK 16
+/* Enough chunks to go through the pool many times over, and past the
+   point where it mixes in a new seed.  */
+#define NCHUNKS 80000
+
+static uint8_t chunks[NCHUNKS][CHUNK];
+
+static int
+compare_chunks (const void *a, const void *b)
+{
+  return memcmp (a, b, CHUNK);
+}
+
+static int
+get_chunk (const char *tag, uint8_t *buf)
+{
+  if (!get_random_bytes_pooled (buf, CHUNK))
+    {
+      printf ("FAIL: %s: get_random_bytes_pooled: %s\n", tag,
+              strerror (errno));
+      return 1;
+    }
+  return 0;
+}
+
+static int
+test_interface (void)
+{
+  uint8_t buf[257];
+  int result = 0;
+
+  if (!get_random_bytes_pooled (buf, 0))
+    {
+      printf ("FAIL: get_random_bytes_pooled (0) failed: %s\n",
+              strerror (errno));
+      result = 1;
+    }
+  errno = 0;
+  if (get_random_bytes_pooled (buf, 257) || errno != EIO)
+    {
+      printf ("FAIL: get_random_bytes_pooled (257) did not fail with EIO\n");
+      result = 1;
+    }
+  if (!get_random_bytes_pooled (buf, 256))
+    {
+      printf ("FAIL: get_random_bytes_pooled (256) failed: %s\n",
+              strerror (errno));
+      result = 1;
+    }
+  return result;
+}
+
+static int
+test_no_repeats (void)
+{
+  size_t i;
+
+  for (i = 0; i < NCHUNKS; i++)
+    if (get_chunk ("no repeats", chunks[i]))
+      return 1;
+
+  qsort (chunks, NCHUNKS, CHUNK, compare_chunks);
+  for (i = 1; i < NCHUNKS; i++)
+    if (!memcmp (chunks[i - 1], chunks[i], CHUNK))
+      {
+        printf ("FAIL: the same %d bytes came out of the pool twice\n",
+                CHUNK);
+        return 1;
+      }
+  return 0;
+}
+
+/* After fork, the parent and each child must get different bytes.  */
+static int
+test_fork (void)
+{
+  uint8_t parent[CHUNK], child[2][CHUNK];
+  int result = 0;
+  int i;
+
+  /* Make sure the parent's pool is in use before it forks.  */
+  if (get_chunk ("fork", parent))
+    return 1;
+
+  for (i = 0; i < 2; i++)
+    {
+      int fds[2];
+      if (pipe (fds))
+        {
+          printf ("ERROR: pipe: %s\n", strerror (errno));
+          return 99;
+        }
+      fflush (stdout);
+      pid_t pid = fork ();
+      if (pid == -1)
+        {
+          printf ("ERROR: fork: %s\n", strerror (errno));
+          return 99;
+        }
+      if (pid == 0)
+        {
+          uint8_t buf[CHUNK];
+          close (fds[0]);
+          if (get_chunk ("fork child", buf)
+              || write (fds[1], buf, CHUNK) != CHUNK)
+            _exit (1);
+          _exit (0);
+        }
+      close (fds[1]);
+      ssize_t n = read (fds[0], child[i], CHUNK);
+      close (fds[0]);
+      int status;
+      if (waitpid (pid, &status, 0) != pid || !WIFEXITED (status)
+          || WEXITSTATUS (status) != 0 || n != CHUNK)
+        {
+          printf ("FAIL: fork child %d failed\n", i);
+          return 1;
+        }
+    }
+
+  if (get_chunk ("fork", parent))
+    return 1;
+  if (!memcmp (child[0], parent, CHUNK) || !memcmp (child[1], parent, CHUNK))
+    {
+      printf ("FAIL: a child process got the same bytes as its parent\n");
+      result = 1;
+    }
+  if (!memcmp (child[0], child[1], CHUNK))
+    {
+      printf ("FAIL: two child processes got the same bytes\n");
+      result = 1;
+    }
+  return result;
+}
+
+struct thread_arg
+{
+  uint8_t buf[CHUNK];
+  int result;
+};
+
+static void *
+thread_main (void *arg)
+{
+  struct thread_arg *a = arg;
+  a->result = get_chunk ("thread", a->buf);
+  return NULL;
+}
+
+static int
+test_threads (void)
+{
+  struct thread_arg args[2];
+  pthread_t threads[2];
+  size_t i;
+
+  for (i = 0; i < ARRAY_SIZE (args); i++)
+    if (pthread_create (&threads[i], NULL, thread_main, &args[i]))
+      {
+        printf ("ERROR: pthread_create failed\n");
+        return 99;
+      }
+  for (i = 0; i < ARRAY_SIZE (args); i++)
+    if (pthread_join (threads[i], NULL))
+      {
+        printf ("ERROR: pthread_join failed\n");
+        return 99;
+      }
+  if (args[0].result || args[1].result)
+    return 1;
+  if (!memcmp (args[0].buf, args[1].buf, CHUNK))
+    {
+      printf ("FAIL: two threads got the same bytes\n");
+      return 1;
+    }
+  return 0;
+}
+
+int
+main (void)
+{
+  int result = 0, r;
+
+  result |= test_interface ();
+  result |= test_no_repeats ();
+  if ((r = test_fork ()) == 99)
+    return 99;
+  result |= r;
+  if ((r = test_threads ()) == 99)
+    return 99;
+  result |= r;
+  return result;
+}
+
+#else
+
+int
+main (void)
+{
+  return 77; /* UNSUPPORTED */
+}
+
+#endif
@@ -20,8 +20,9 @@ static_assert(' ' == 0x20 && 'C' == 0x43 && '~' == 0x7E,
               "Execution character set does not appear to be ASCII");
 
 /* This test verifies three things at once:
-    - crypt, crypt_r, crypt_rn, and crypt_ra
-      all produce the same outputs for the same inputs.
+    - crypt, crypt_r, crypt_rn, crypt_ra, and crypt_batch_rn
+      all produce the same outputs for the same inputs, and
+      crypt_verify accepts them.
     - given hash <- crypt(phrase, setting),
        then hash == crypt(phrase, hash) also.
     - crypt(phrase, setting) == crypt'(phrase, setting)
@@ -222,6 +223,93 @@ calc_hashes_crypt_ra_recrypt (void)
   return status;
 }
 
+static int
+calc_hashes_crypt_batch_rn (void)
+{
+  struct crypt_batch *items;
+  struct crypt_data data;
+  const struct testcase *t;
+  size_t n, i;
+  int status = 0;
+
+  for (n = 0; tests[n].input != 0; n++)
+    ;
+
+  /* Hash every test case in a single batch, both with its setting and
+     with its expected hash as the setting, as recrypt does.  */
+  items = malloc (2 * n * sizeof *items);
+  if (!items)
+    {
+      printf ("ERROR: malloc: %s\n", strerror (errno));
+      return 1;
+    }
+  for (i = 0; i < n; i++)
+    {
+      items[2 * i].phrase = tests[i].input;
+      items[2 * i].setting = tests[i].salt;
+      items[2 * i + 1].phrase = tests[i].input;
+      items[2 * i + 1].setting = tests[i].expected;
+    }
+
+  errno = 0;
+  int nok = crypt_batch_rn (items, (int) (2 * n), &data, (int) sizeof data);
+  if (nok != (int) (2 * n))
+    {
+      printf ("FAIL: crypt_batch_rn: %d of %zu hashed\n", nok, 2 * n);
+      status = 1;
+    }
+
+  for (i = 0; i < n; i++)
+    {
+      t = &tests[i];
+      status |= report_result ("crypt_batch_rn", items[2 * i].output, errno,
+                               t, true);
+      status |= report_result ("crypt_batch_rn recrypt",
+                               items[2 * i + 1].output, errno, t, true);
+    }
+
+  free (items);
+  return status;
+}
+
+static int
+verify_hashes (void)
+{
+  const struct testcase *t;
+  char wrong[CRYPT_OUTPUT_SIZE];
+  int status = 0;
+  int result;
+
+  for (t = tests; t->input != 0; t++)
+    {
+      errno = 0;
+      result = crypt_verify (t->input, t->expected);
+      if (result != 1)
+        {
+          begin_error_report (t, "crypt_verify");
+          printf ("returned %d for the right passphrase", result);
+          if (errno)
+            printf (", errno = %s", strerror (errno));
+          putchar ('\n');
+          status = 1;
+        }
+
+      /* Change the last character of the hash, which is always part
+         of the hashed passphrase proper.  */
+      snprintf (wrong, sizeof wrong, "%s", t->expected);
+      wrong[strlen (wrong) - 1] ^= 0x01;
+      result = crypt_verify (t->input, wrong);
+      if (result == 1)
+        {
+          begin_error_report (t, "crypt_verify");
+          printf ("accepted a wrong hash %s\n", wrong);
+          status = 1;
+        }
+    }
+
+  return status;
+}
+
 int
 main (void)
 {
@@ -235,6 +323,8 @@ main (void)
   status |= calc_hashes_crypt ();
   status |= calc_hashes_crypt_r_rn ();
   status |= calc_hashes_crypt_ra_recrypt ();
+  status |= calc_hashes_crypt_batch_rn ();
+  status |= verify_hashes ();
 
   return status;
 }